@@ -32,6 +32,8 @@ void Application::Close()
 
 void Application::Run()
 {
+	// Models loaded at init are streamed in before the first frame
+	bool wasStreaming = true;
 	while (!glfwWindowShouldClose(m_WindowHandle))
 	{
 		glfwPollEvents();
@@ -43,7 +45,41 @@ void Application::Run()
 		VulkanRenderer::SceneUpdate(m_TimeStep);
 
 		VulkanRenderer::Draw();
-		std::cout << "Delta time: " << m_TimeStep << "s" << "  / FPS: " << 1.0 / m_TimeStep << std::endl;
+		const ClusterCullStats cullStats = VulkanRenderer::GetClusterCullStats();
+		const MeshCullStats meshCullStats = VulkanRenderer::GetMeshCullStats();
+		const CommandRecordStats recordStats = VulkanRenderer::GetCommandRecordStats();
+		const RenderQueueStats queueStats = VulkanRenderer::GetRenderQueueStats();
+		std::cout << "Delta time: " << m_TimeStep << "s" << "  / FPS: " << 1.0 / m_TimeStep
+			<< "  / Meshes: " << meshCullStats.VisibleMeshCount << " visible, " << meshCullStats.CulledMeshCount << " culled"
+			<< "  / Meshlets: " << cullStats.VisibleClusterCount << "/" << cullStats.ClusterCount
+			<< "  / Triangles: " << cullStats.VisibleTriangleCount << "/" << cullStats.TriangleCount
+			<< "  / Re-records: " << recordStats.RecordCount << "/" << recordStats.SubpassCount
+			<< "  / Binds: " << queueStats.UnsortedBindCount << " -> " << queueStats.SortedBindCount << std::endl;
+
+		// Asset totals once every model streaming in is complete
+		const StreamingStats streamingStats = VulkanRenderer::GetStreamingStats();
+		if (wasStreaming && streamingStats.PendingModelCount == 0)
+		{
+			std::cout << "Textures: " << streamingStats.TextureRequestCount << " requested, "
+				<< streamingStats.UniqueTextureCount << " unique, " << streamingStats.TextureStagedBytes / 1024 << " KB ("
+				<< streamingStats.TextureUncompressedBytes / 1024 << " KB as mipped RGBA8)" << std::endl;
+			std::cout << "Geometry: " << streamingStats.VertexBytesUsed / 1024 << " KB vertices, "
+				<< streamingStats.IndexBytesUsed / 1024 << " KB indices" << std::endl;
+			std::cout << "Assets: " << streamingStats.ModelCount << " models sharing "
+				<< streamingStats.MeshAssetCount << " mesh assets and " << streamingStats.TextureAssetCount << " textures" << std::endl;
+			MemoryAllocator::PrintStats();
+
+			const MeshImportStats importStats = VulkanRenderer::GetMeshImportStats();
+			std::cout << "Meshes: " << importStats.MeshCount << " imported, " << importStats.OptimizedMeshCount << " optimized (ACMR "
+				<< importStats.ACMRBefore << " -> " << importStats.ACMRAfter << ", ATVR " << importStats.ATVRBefore << " -> "
+				<< importStats.ATVRAfter << "), LOD triangles";
+			for (uint32_t lod = 0; lod < MAX_MESH_LODS; lod++)
+			{
+				std::cout << " " << importStats.LodTriangleCounts[lod];
+			}
+			std::cout << std::endl;
+		}
+		wasStreaming = streamingStats.PendingModelCount > 0;
 	}
 
 }
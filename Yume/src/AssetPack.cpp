@@ -0,0 +1,356 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "Lz4.h"
+#include "ThreadPool.h"
+
+static const char s_PackMagic[4] = { 'Y', 'P', 'A', 'K' };
+static const uint32_t s_PackVersion = 1;
+static const uint32_t s_PackBlockSize = 256 * 1024;
+// Blocks that don`t get at least this much smaller are stored, decompressing them would cost more than it saves
+static const double s_MinCompressionRatio = 0.95;
+
+static std::unique_ptr<AssetPack> s_MountedPack;
+
+struct PackHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint64_t EntryCount;
+	uint64_t BlockCount;
+	uint64_t TableOffset;			// entries, then blocks, then names
+	uint64_t NamesSize;
+};
+
+bool AssetPack::Open(const std::string& filepath)
+{
+	m_Entries = nullptr;
+	m_Blocks = nullptr;
+	m_Names = nullptr;
+	m_EntryCount = m_BlockCount = 0;
+
+	if (!m_File.OpenFromDisk(filepath) || m_File.GetSize() < sizeof(PackHeader))
+		return false;
+
+	PackHeader header;
+	memcpy(&header, m_File.GetData(), sizeof(header));
+	if (memcmp(header.Magic, s_PackMagic, sizeof(s_PackMagic)) != 0 || header.Version != s_PackVersion)
+	{
+		m_File.Close();
+		return false;
+	}
+
+	// Tables must lie inside the file (checked without overflowing on hostile counts)
+	const uint64_t fileSize = m_File.GetSize();
+	if (header.TableOffset % alignof(Entry) != 0 || header.TableOffset > fileSize
+		|| header.EntryCount > (fileSize - header.TableOffset) / sizeof(Entry)
+		|| header.BlockCount > (fileSize - header.TableOffset - header.EntryCount * sizeof(Entry)) / sizeof(Block)
+		|| header.NamesSize > fileSize - header.TableOffset - header.EntryCount * sizeof(Entry) - header.BlockCount * sizeof(Block))
+	{
+		m_File.Close();
+		return false;
+	}
+
+	const uint8_t* table = m_File.GetData() + header.TableOffset;
+	m_Entries = reinterpret_cast<const Entry*>(table);
+	m_Blocks = reinterpret_cast<const Block*>(table + header.EntryCount * sizeof(Entry));
+	m_Names = reinterpret_cast<const char*>(m_Blocks + header.BlockCount);
+	m_EntryCount = static_cast<size_t>(header.EntryCount);
+	m_BlockCount = static_cast<size_t>(header.BlockCount);
+
+	// Validate every entry once so reads don`t have to
+	for (size_t i = 0; i < m_EntryCount; i++)
+	{
+		const Entry& entry = m_Entries[i];
+		bool isValid = entry.NameOffset + entry.NameLength <= header.NamesSize && entry.FirstBlock <= m_BlockCount
+			&& entry.BlockCount <= m_BlockCount - entry.FirstBlock;
+
+		uint64_t size = 0;
+		for (uint32_t b = 0; isValid && b < entry.BlockCount; b++)
+		{
+			const Block& block = m_Blocks[entry.FirstBlock + b];
+			isValid = block.Offset <= header.TableOffset && block.CompressedSize <= header.TableOffset - block.Offset
+				&& (!entry.IsStored || block.CompressedSize == block.Size)
+				&& (!entry.IsStored || b == 0 || block.Offset == m_Blocks[entry.FirstBlock + b - 1].Offset + m_Blocks[entry.FirstBlock + b - 1].Size);
+			size += block.Size;
+		}
+
+		if (!isValid || size != entry.Size)
+		{
+			std::cout << "Corrupt asset pack entry " << i << ": " << filepath << std::endl;
+			m_File.Close();
+			m_EntryCount = m_BlockCount = 0;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::string AssetPack::GetName(const Entry& entry) const
+{
+	return std::string(m_Names + entry.NameOffset, entry.NameLength);
+}
+
+const AssetPack::Entry* AssetPack::Find(const std::string& filepath) const
+{
+	const std::string name = NormalizePath(filepath);
+
+	// Entries are sorted by name (bytewise)
+	const Entry* end = m_Entries + m_EntryCount;
+	const Entry* entry = std::lower_bound(m_Entries, end, name, [this](const Entry& candidate, const std::string& key)
+	{
+		const int order = memcmp(m_Names + candidate.NameOffset, key.data(), std::min<size_t>(candidate.NameLength, key.size()));
+		return order < 0 || (order == 0 && candidate.NameLength < key.size());
+	});
+
+	if (entry == end || entry->NameLength != name.size() || memcmp(m_Names + entry->NameOffset, name.data(), name.size()) != 0)
+		return nullptr;
+	return entry;
+}
+
+const uint8_t* AssetPack::GetStoredData(const Entry& entry) const
+{
+	if (!entry.IsStored)
+		return nullptr;
+
+	return entry.BlockCount > 0 ? m_File.GetData() + m_Blocks[entry.FirstBlock].Offset : m_File.GetData();
+}
+
+bool AssetPack::Read(const Entry& entry, uint8_t* destination) const
+{
+	std::vector<uint64_t> blockOffsets(entry.BlockCount);
+	uint64_t offset = 0;
+	for (uint32_t b = 0; b < entry.BlockCount; b++)
+	{
+		blockOffsets[b] = offset;
+		offset += m_Blocks[entry.FirstBlock + b].Size;
+	}
+
+	std::atomic<bool> isCorrupt{ false };
+	auto readBlock = [&](uint32_t b)
+	{
+		const Block& block = m_Blocks[entry.FirstBlock + b];
+		const uint8_t* source = m_File.GetData() + block.Offset;
+		if (block.CompressedSize == block.Size)
+		{
+			memcpy(destination + blockOffsets[b], source, block.Size);
+		}
+		else if (!Lz4::Decompress(source, block.CompressedSize, destination + blockOffsets[b], block.Size))
+		{
+			isCorrupt = true;
+		}
+	};
+
+	// Single block files aren`t worth waking the workers for
+	if (entry.BlockCount == 1)
+		readBlock(0);
+	else
+		ThreadPool::Get().ParallelFor(entry.BlockCount, readBlock);
+
+	return !isCorrupt;
+}
+
+bool AssetPack::Mount(const std::string& filepath)
+{
+	auto pack = std::make_unique<AssetPack>();
+	if (!pack->Open(filepath))
+		return false;
+
+	// One sequential read of the whole pack instead of a seek per file
+	pack->m_File.Prefetch();
+	s_MountedPack = std::move(pack);
+	return true;
+}
+
+const AssetPack* AssetPack::GetMounted()
+{
+	return s_MountedPack.get();
+}
+
+std::string AssetPack::NormalizePath(const std::string& filepath)
+{
+	std::vector<std::string> segments;
+	const bool isAbsolute = !filepath.empty() && (filepath[0] == '/' || filepath[0] == '\\');
+
+	size_t begin = 0;
+	while (begin <= filepath.size())
+	{
+		size_t end = filepath.find_first_of("/\\", begin);
+		if (end == std::string::npos)
+			end = filepath.size();
+
+		const std::string segment = filepath.substr(begin, end - begin);
+		if (segment == "..")
+		{
+			if (!segments.empty() && segments.back() != "..")
+				segments.pop_back();
+			else if (!isAbsolute)
+				segments.push_back(segment);
+		}
+		else if (!segment.empty() && segment != ".")
+		{
+			segments.push_back(segment);
+		}
+		begin = end + 1;
+	}
+
+	std::string path = isAbsolute ? "/" : "";
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		path += (i > 0 ? "/" : "") + segments[i];
+	}
+	return path;
+}
+
+bool AssetPack::Build(const std::string& filepath, const std::vector<std::string>& inputs)
+{
+	namespace fs = std::filesystem;
+
+	// Files to pack, directories are walked recursively
+	std::vector<std::string> names;
+	std::error_code error;
+	for (const auto& input : inputs)
+	{
+		if (fs::is_directory(input, error))
+		{
+			for (const auto& item : fs::recursive_directory_iterator(input, error))
+			{
+				if (item.is_regular_file(error))
+					names.push_back(NormalizePath(item.path().generic_string()));
+			}
+		}
+		else if (fs::is_regular_file(input, error))
+		{
+			names.push_back(NormalizePath(input));
+		}
+		else
+		{
+			std::cout << "Asset pack input not found: " << input << std::endl;
+			return false;
+		}
+	}
+
+	// Leftovers of interrupted writes and the pack itself don`t belong in it
+	const std::string packName = NormalizePath(filepath);
+	names.erase(std::remove_if(names.begin(), names.end(), [&packName](const std::string& name)
+	{
+		return name == packName || (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0);
+	}), names.end());
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+
+	// Write to a temporary file first so a crash never leaves a half written pack behind
+	const std::string tempPath = filepath + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	PackHeader header = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<Entry> entries;
+	std::vector<Block> blocks;
+	std::string nameTable;
+	uint64_t offset = sizeof(header);
+	uint64_t totalSize = 0;
+
+	for (const auto& name : names)
+	{
+		MappedFile source;
+		if (!source.OpenFromDisk(name))
+		{
+			std::cout << "Failed to read asset: " << name << std::endl;
+			file.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+
+		Entry entry = {};
+		entry.NameOffset = nameTable.size();
+		entry.NameLength = static_cast<uint32_t>(name.size());
+		entry.FirstBlock = static_cast<uint32_t>(blocks.size());
+		entry.BlockCount = static_cast<uint32_t>((source.GetSize() + s_PackBlockSize - 1) / s_PackBlockSize);
+		entry.Size = source.GetSize();
+		nameTable += name;
+
+		// Blocks of a file are compressed in parallel, then written in order
+		std::vector<std::vector<uint8_t>> compressedBlocks(entry.BlockCount);
+		ThreadPool::Get().ParallelFor(entry.BlockCount, [&](uint32_t b)
+		{
+			const size_t blockOffset = size_t(b) * s_PackBlockSize;
+			const size_t blockSize = std::min<size_t>(s_PackBlockSize, source.GetSize() - blockOffset);
+
+			std::vector<uint8_t>& compressed = compressedBlocks[b];
+			compressed.resize(Lz4::GetMaxCompressedSize(blockSize));
+			const size_t compressedSize = Lz4::Compress(source.GetData() + blockOffset, blockSize, compressed.data(), compressed.size());
+			if (compressedSize == 0 || compressedSize > blockSize * s_MinCompressionRatio)
+				compressed.assign(source.GetData() + blockOffset, source.GetData() + blockOffset + blockSize);
+			else
+				compressed.resize(compressedSize);
+		});
+
+		entry.IsStored = 1;
+		for (uint32_t b = 0; b < entry.BlockCount; b++)
+		{
+			Block block;
+			block.Offset = offset;
+			block.Size = static_cast<uint32_t>(std::min<size_t>(s_PackBlockSize, source.GetSize() - size_t(b) * s_PackBlockSize));
+			block.CompressedSize = static_cast<uint32_t>(compressedBlocks[b].size());
+			entry.IsStored &= block.CompressedSize == block.Size ? 1 : 0;
+
+			file.write(reinterpret_cast<const char*>(compressedBlocks[b].data()), compressedBlocks[b].size());
+			offset += compressedBlocks[b].size();
+			blocks.push_back(block);
+		}
+
+		totalSize += entry.Size;
+		entries.push_back(entry);
+	}
+
+	// Tables are mapped in place, align them
+	const char padding[8] = {};
+	const uint64_t paddingSize = (alignof(Entry) - offset % alignof(Entry)) % alignof(Entry);
+	file.write(padding, static_cast<std::streamsize>(paddingSize));
+
+	header.Version = s_PackVersion;
+	memcpy(header.Magic, s_PackMagic, sizeof(s_PackMagic));
+	header.EntryCount = entries.size();
+	header.BlockCount = blocks.size();
+	header.TableOffset = offset + paddingSize;
+	header.NamesSize = nameTable.size();
+
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+	file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(Block));
+	file.write(nameTable.data(), nameTable.size());
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	const uint64_t packSize = header.TableOffset + entries.size() * sizeof(Entry) + blocks.size() * sizeof(Block) + nameTable.size();
+	if (!file.good())
+	{
+		file.close();
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	file.close();
+
+	// Replace the old pack (rename doesn`t overwrite on Windows)
+	std::remove(filepath.c_str());
+	if (std::rename(tempPath.c_str(), filepath.c_str()) != 0)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	std::cout << "Packed " << entries.size() << " files, " << totalSize / 1024 << " KB into " << packSize / 1024
+		<< " KB: " << filepath << std::endl;
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Single file archive of scene assets (models, materials, textures, cooked caches, shaders)
+// Layout: header, LZ4 blocks of every file back to back, then the entry table (sorted by name), block table and names
+// Files are split into 256 KB blocks compressed independently, blocks that don`t shrink are stored as is
+// The pack is mapped once and read front to back, opening a file costs a binary search instead of a disk seek
+class AssetPack
+{
+public:
+	struct Entry
+	{
+		uint64_t NameOffset;
+		uint32_t NameLength;
+		uint32_t FirstBlock;
+		uint32_t BlockCount;
+		uint32_t IsStored;			// every block stored uncompressed, the file is contiguous in the pack
+		uint64_t Size;
+	};
+
+	struct Block
+	{
+		uint64_t Offset;
+		uint32_t CompressedSize;	// == Size when stored
+		uint32_t Size;
+	};
+
+	AssetPack() = default;
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	bool Open(const std::string& filepath);
+
+	// Entry of a file, by the path it is opened with (relative to the working directory like the loose files)
+	const Entry* Find(const std::string& filepath) const;
+
+	// Stored files point into the mapping, nullptr for compressed ones
+	const uint8_t* GetStoredData(const Entry& entry) const;
+	// Blocks are decompressed in parallel on the thread pool, false on corrupt blocks
+	bool Read(const Entry& entry, uint8_t* destination) const;
+
+	size_t GetEntryCount() const { return m_EntryCount; }
+
+	// The pack files are read from instead of the disk (see MappedFile::Open), mount before anything is loaded
+	static bool Mount(const std::string& filepath);
+	static const AssetPack* GetMounted();
+
+	// Pack files and directories (recursively) into filepath, names are the paths as given with '/' separators
+	// Blocks are compressed in parallel, the pack is written to filepath.tmp and renamed once complete
+	static bool Build(const std::string& filepath, const std::vector<std::string>& inputs);
+
+	// Same spelling for the same file: '/' separators, no "." segments, ".." resolved
+	static std::string NormalizePath(const std::string& filepath);
+
+private:
+	std::string GetName(const Entry& entry) const;
+
+private:
+	MappedFile m_File;
+	const Entry* m_Entries = nullptr;
+	const Block* m_Blocks = nullptr;
+	const char* m_Names = nullptr;
+	size_t m_EntryCount = 0;
+	size_t m_BlockCount = 0;
+};
@@ -0,0 +1,212 @@
+#include "AssetRegistry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+const Mesh& MeshAsset::GetMesh(size_t index) const
+{
+	if (index >= m_MeshList.size())
+	{
+		throw std::runtime_error("Attempted to access invalid mesh index");
+	}
+
+	return m_MeshList[index];
+}
+
+void MeshAsset::AddMesh(Mesh&& mesh, uint32_t materialIndex)
+{
+	if (materialIndex < m_MaterialTextures.size() && m_MaterialTextures[materialIndex])
+		mesh.SetTextureID(m_MaterialTextures[materialIndex]->DescriptorIndex);
+
+	m_MeshList.push_back(std::move(mesh));
+	m_MeshMaterials.push_back(materialIndex);
+	const Mesh& addedMesh = m_MeshList.back();
+
+	// The whole model switches level at once, so meshes never crack apart
+	m_LodCount = std::max(m_LodCount, addedMesh.GetLodCount());
+	for (uint32_t level = 0; level < m_LodCount; level++)
+	{
+		// A mesh with fewer levels keeps drawing its last one, its error holds for the coarser model levels too
+		m_LodErrors[level] = std::max(m_LodErrors[level], addedMesh.GetLod(level).Error);
+		if (level > 0)
+			m_LodErrors[level] = std::max(m_LodErrors[level], m_LodErrors[level - 1]);
+	}
+
+	// Grow the box and the sphere to enclose the mesh ones
+	const glm::vec4& sphere = addedMesh.GetBoundingSphere();
+	if (m_MeshList.size() == 1)
+	{
+		m_BoundsMin = addedMesh.GetBoundsMin();
+		m_BoundsMax = addedMesh.GetBoundsMax();
+		m_BoundingSphere = sphere;
+		return;
+	}
+
+	m_BoundsMin = glm::min(m_BoundsMin, addedMesh.GetBoundsMin());
+	m_BoundsMax = glm::max(m_BoundsMax, addedMesh.GetBoundsMax());
+
+	const glm::vec3 offset = glm::vec3(sphere) - glm::vec3(m_BoundingSphere);
+	const float distance = glm::length(offset);
+	if (distance + sphere.w <= m_BoundingSphere.w)
+		return;
+	if (distance + m_BoundingSphere.w <= sphere.w)
+	{
+		m_BoundingSphere = sphere;
+		return;
+	}
+
+	const float radius = (distance + m_BoundingSphere.w + sphere.w) * 0.5f;
+	const glm::vec3 center = glm::vec3(m_BoundingSphere) + offset * ((radius - m_BoundingSphere.w) / distance);
+	m_BoundingSphere = glm::vec4(center, radius);
+}
+
+void MeshAsset::SetMaterialTexture(uint32_t materialIndex, const std::shared_ptr<TextureAsset>& texture)
+{
+	if (materialIndex >= m_MaterialTextures.size())
+		m_MaterialTextures.resize(materialIndex + 1);
+	m_MaterialTextures[materialIndex] = texture;
+
+	for (size_t i = 0; i < m_MeshList.size(); i++)
+	{
+		if (m_MeshMaterials[i] == materialIndex)
+			m_MeshList[i].SetTextureID(texture->DescriptorIndex);
+	}
+}
+
+void MeshAsset::DestroyBuffers()
+{
+	for (auto& mesh : m_MeshList)
+	{
+		mesh.DestroyBuffers();
+	}
+	m_MeshList.clear();
+	m_MeshMaterials.clear();
+}
+
+void AssetRegistry::Init(VkDevice device, TextureCache& textureCache)
+{
+	m_Device = device;
+	m_TextureCache = &textureCache;
+}
+
+void AssetRegistry::Destroy()
+{
+	// Destroying a mesh releases its textures, which land at the back of the queue
+	while (!m_ReleasedAssets.empty())
+	{
+		const ReleasedAsset releasedAsset = m_ReleasedAssets.front();
+		m_ReleasedAssets.pop_front();
+
+		if (releasedAsset.Mesh)
+			DestroyAsset(releasedAsset.Mesh);
+		else
+			DestroyAsset(releasedAsset.Texture);
+	}
+
+	m_Meshes.clear();
+	m_FreeDescriptorIndices.clear();
+}
+
+MeshHandle AssetRegistry::FindMesh(const std::string& filepath) const
+{
+	auto it = m_Meshes.find(TextureCache::NormalizePath(filepath));
+	return it != m_Meshes.end() ? it->second.lock() : nullptr;
+}
+
+MeshHandle AssetRegistry::CreateMesh(const std::string& filepath)
+{
+	const std::string path = TextureCache::NormalizePath(filepath);
+	MeshHandle mesh(new MeshAsset(path), [this](MeshAsset* releasedMesh) { Release(releasedMesh); });
+
+	m_Meshes[path] = mesh;
+	m_LiveMeshCount++;
+	return mesh;
+}
+
+TextureHandle AssetRegistry::CreateTexture(VkImage image, const MemoryAllocation& imageMemory, VkImageView imageView, int descriptorIndex)
+{
+	TextureAsset* texture = new TextureAsset();
+	texture->Image = image;
+	texture->ImageMemory = imageMemory;
+	texture->ImageView = imageView;
+	texture->DescriptorIndex = descriptorIndex;
+
+	m_LiveTextureCount++;
+	return TextureHandle(texture, [this](TextureAsset* releasedTexture) { Release(releasedTexture); });
+}
+
+int AssetRegistry::TakeFreeDescriptorIndex()
+{
+	if (m_FreeDescriptorIndices.empty())
+		return -1;
+
+	const int descriptorIndex = m_FreeDescriptorIndices.back();
+	m_FreeDescriptorIndices.pop_back();
+	return descriptorIndex;
+}
+
+void AssetRegistry::Update()
+{
+	m_Frame++;
+
+	// Released in order, so the front is always the oldest
+	while (!m_ReleasedAssets.empty() && m_ReleasedAssets.front().Frame + MAX_FRAME_DRAWS <= m_Frame)
+	{
+		const ReleasedAsset releasedAsset = m_ReleasedAssets.front();
+		m_ReleasedAssets.pop_front();
+
+		if (releasedAsset.Mesh)
+			DestroyAsset(releasedAsset.Mesh);
+		else
+			DestroyAsset(releasedAsset.Texture);
+	}
+}
+
+void AssetRegistry::Release(MeshAsset* mesh)
+{
+	// The path now loads a new asset, the old one only waits for its last frames
+	auto it = m_Meshes.find(mesh->GetPath());
+	if (it != m_Meshes.end() && it->second.expired())
+		m_Meshes.erase(it);
+
+	ReleasedAsset releasedAsset;
+	releasedAsset.Frame = m_Frame;
+	releasedAsset.Mesh = mesh;
+	m_ReleasedAssets.push_back(releasedAsset);
+}
+
+void AssetRegistry::Release(TextureAsset* texture)
+{
+	// The next request for the file decodes it again, even while the old texture waits for its last frames
+	if (texture->CacheEntry)
+	{
+		m_TextureCache->Evict(texture->CacheEntry);
+		texture->CacheEntry.reset();
+	}
+
+	ReleasedAsset releasedAsset;
+	releasedAsset.Frame = m_Frame;
+	releasedAsset.Texture = texture;
+	m_ReleasedAssets.push_back(releasedAsset);
+}
+
+void AssetRegistry::DestroyAsset(MeshAsset* mesh)
+{
+	mesh->DestroyBuffers();
+	// Drops the material textures (released here if this was their last user)
+	delete mesh;
+	m_LiveMeshCount--;
+}
+
+void AssetRegistry::DestroyAsset(TextureAsset* texture)
+{
+	vkDestroyImageView(m_Device, texture->ImageView, nullptr);
+	vkDestroyImage(m_Device, texture->Image, nullptr);
+	MemoryAllocator::Free(texture->ImageMemory);
+
+	// The descriptor set is rewritten by the next texture instead of being freed
+	m_FreeDescriptorIndices.push_back(texture->DescriptorIndex);
+
+	delete texture;
+	m_LiveTextureCount--;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+#include "TextureCache.h"
+#include "Utils.h"
+
+// Uploaded texture, sampled through the sampler descriptor set at DescriptorIndex
+struct TextureAsset
+{
+	VkImage Image = VK_NULL_HANDLE;
+	MemoryAllocation ImageMemory;
+	VkImageView ImageView = VK_NULL_HANDLE;
+	int DescriptorIndex = -1;
+	std::shared_ptr<TextureCache::Entry> CacheEntry;	// evicted from the texture cache when the texture is released
+};
+
+// GPU geometry of one model file and the textures of its materials, shared by every scene model loaded from it
+class MeshAsset
+{
+public:
+	explicit MeshAsset(const std::string& path) : m_Path(path) {}
+
+	const std::string& GetPath() const { return m_Path; }
+
+	size_t GetMeshCount() const { return m_MeshList.size(); }
+	const Mesh& GetMesh(size_t index) const;
+	// Streamed assets grow one mesh at a time, meshes of a material whose texture is set get it right away
+	void AddMesh(Mesh&& mesh, uint32_t materialIndex);
+	// Swap the texture of every mesh using the material, the asset keeps a reference to it
+	void SetMaterialTexture(uint32_t materialIndex, const std::shared_ptr<TextureAsset>& texture);
+
+	// Object space sphere and box around every mesh, and the worst error of each level across the meshes
+	const glm::vec4& GetBoundingSphere() const { return m_BoundingSphere; }
+	const glm::vec3& GetBoundsMin() const { return m_BoundsMin; }
+	const glm::vec3& GetBoundsMax() const { return m_BoundsMax; }
+	uint32_t GetLodCount() const { return m_LodCount; }
+	float GetLodError(uint32_t level) const { return m_LodErrors[level]; }
+
+	// Ranges go back to the arena, only once no frame in flight draws the meshes
+	void DestroyBuffers();
+
+private:
+	std::string m_Path;
+	std::vector<Mesh> m_MeshList;
+	std::vector<uint32_t> m_MeshMaterials;
+	std::vector<std::shared_ptr<TextureAsset>> m_MaterialTextures;
+
+	glm::vec4 m_BoundingSphere = glm::vec4(0.0f);
+	glm::vec3 m_BoundsMin = glm::vec3(0.0f);
+	glm::vec3 m_BoundsMax = glm::vec3(0.0f);
+	uint32_t m_LodCount = 1;
+	float m_LodErrors[MAX_MESH_LODS] = {};
+};
+
+// Reference counted handles, the asset is released when the last copy goes away
+using MeshHandle = std::shared_ptr<MeshAsset>;
+using TextureHandle = std::shared_ptr<TextureAsset>;
+
+// Owner of mesh and texture assets shared between scene models
+// Assets are looked up by normalized path, so loading a file that is still referenced hands out the same upload
+// Released assets are destroyed MAX_FRAME_DRAWS frames later, once no command buffer in flight uses them
+// Main thread only (handles included: they must not be released on worker threads)
+class AssetRegistry
+{
+public:
+	void Init(VkDevice device, TextureCache& textureCache);
+	// Destroy every released asset right away, the device must be idle and no handle left
+	void Destroy();
+
+	// Asset of a file while anything holds it, null otherwise
+	MeshHandle FindMesh(const std::string& filepath) const;
+	// Empty asset for a file, meshes are added as they are uploaded
+	MeshHandle CreateMesh(const std::string& filepath);
+	// Take ownership of an uploaded texture (image, memory and view are destroyed with it)
+	TextureHandle CreateTexture(VkImage image, const MemoryAllocation& imageMemory, VkImageView imageView, int descriptorIndex);
+
+	// Descriptor set of a destroyed texture, to be rewritten for a new one; -1 when none is free
+	int TakeFreeDescriptorIndex();
+
+	// Once per frame after its fence wait: destroy assets released MAX_FRAME_DRAWS frames ago
+	void Update();
+
+	size_t GetMeshCount() const { return m_LiveMeshCount; }
+	size_t GetTextureCount() const { return m_LiveTextureCount; }
+
+private:
+	void Release(MeshAsset* mesh);
+	void Release(TextureAsset* texture);
+	void DestroyAsset(MeshAsset* mesh);
+	void DestroyAsset(TextureAsset* texture);
+
+private:
+	// Released asset waiting for the frames that may still draw it
+	struct ReleasedAsset
+	{
+		uint64_t Frame = 0;
+		MeshAsset* Mesh = nullptr;
+		TextureAsset* Texture = nullptr;
+	};
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	TextureCache* m_TextureCache = nullptr;
+
+	std::unordered_map<std::string, std::weak_ptr<MeshAsset>> m_Meshes;
+	std::deque<ReleasedAsset> m_ReleasedAssets;
+	std::vector<int> m_FreeDescriptorIndices;
+	uint64_t m_Frame = 0;
+	size_t m_LiveMeshCount = 0;
+	size_t m_LiveTextureCount = 0;
+};
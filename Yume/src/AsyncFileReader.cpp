@@ -0,0 +1,429 @@
+#include "AsyncFileReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define YUME_IO_URING 1
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#define YUME_IO_URING 0
+#endif
+
+// Reads in flight at once (one more entry is kept for the wake up read)
+static const uint32_t s_RingEntryCount = 64;
+// Longest single read, bigger files take several
+static const size_t s_MaxReadSize = size_t(1) << 30;
+// user_data of the wake up read, requests use their address
+static const uint64_t s_WakeUpUserData = 0;
+
+struct AsyncFileReader::Request
+{
+	std::string Path;
+	ReadCallback Callback;
+	FileData Data;
+	size_t Offset = 0;
+	int Fd = -1;
+};
+
+// Read the file on the calling thread (through the asset pack when mounted)
+static bool ReadWholeFile(const std::string& filepath, FileData& data)
+{
+	MappedFile file;
+	if (!file.Open(filepath))
+		return false;
+
+	data.assign(file.GetData(), file.GetData() + file.GetSize());
+	return true;
+}
+
+#if YUME_IO_URING
+
+// Mapped submission/completion rings of an io_uring (set up with raw syscalls, no liburing needed)
+struct AsyncFileReader::Ring
+{
+	int Fd = -1;
+	int WakeUpFd = -1;				// eventfd written by Read() and the destructor, read through the ring
+	uint64_t WakeUpValue = 0;
+
+	void* SubmissionRing = nullptr;
+	size_t SubmissionRingSize = 0;
+	void* CompletionRing = nullptr;
+	size_t CompletionRingSize = 0;
+	io_uring_sqe* SubmissionEntries = nullptr;
+	size_t SubmissionEntriesSize = 0;
+
+	uint32_t* SubmissionHead = nullptr;
+	uint32_t* SubmissionTail = nullptr;
+	uint32_t SubmissionMask = 0;
+	uint32_t* SubmissionArray = nullptr;
+	uint32_t EntryCount = 0;
+	uint32_t* CompletionHead = nullptr;
+	uint32_t* CompletionTail = nullptr;
+	uint32_t CompletionMask = 0;
+	io_uring_cqe* CompletionEntries = nullptr;
+
+	uint32_t InFlightCount = 0;		// requests, the wake up read not counted
+	uint32_t PendingSubmitCount = 0;
+
+	~Ring()
+	{
+		if (SubmissionEntries)
+			munmap(SubmissionEntries, SubmissionEntriesSize);
+		if (CompletionRing && CompletionRing != SubmissionRing)
+			munmap(CompletionRing, CompletionRingSize);
+		if (SubmissionRing)
+			munmap(SubmissionRing, SubmissionRingSize);
+		if (Fd >= 0)
+			close(Fd);
+		if (WakeUpFd >= 0)
+			close(WakeUpFd);
+	}
+
+	bool Init()
+	{
+		io_uring_params params = {};
+		Fd = static_cast<int>(syscall(__NR_io_uring_setup, s_RingEntryCount, &params));
+		if (Fd < 0)
+			return false;
+
+		// IORING_OP_READ came with 5.6, same as IORING_FEAT_RW_CUR_POS; older kernels use the thread pool
+		if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_RW_CUR_POS))
+			return false;
+
+		SubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		CompletionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		SubmissionRingSize = CompletionRingSize = std::max(SubmissionRingSize, CompletionRingSize);
+
+		SubmissionRing = mmap(nullptr, SubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQ_RING);
+		if (SubmissionRing == MAP_FAILED)
+		{
+			SubmissionRing = nullptr;
+			return false;
+		}
+		CompletionRing = SubmissionRing;
+
+		SubmissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void* entries = mmap(nullptr, SubmissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, IORING_OFF_SQES);
+		if (entries == MAP_FAILED)
+			return false;
+		SubmissionEntries = static_cast<io_uring_sqe*>(entries);
+
+		uint8_t* submissionRing = static_cast<uint8_t*>(SubmissionRing);
+		SubmissionHead = reinterpret_cast<uint32_t*>(submissionRing + params.sq_off.head);
+		SubmissionTail = reinterpret_cast<uint32_t*>(submissionRing + params.sq_off.tail);
+		SubmissionMask = *reinterpret_cast<uint32_t*>(submissionRing + params.sq_off.ring_mask);
+		SubmissionArray = reinterpret_cast<uint32_t*>(submissionRing + params.sq_off.array);
+		EntryCount = params.sq_entries;
+
+		uint8_t* completionRing = static_cast<uint8_t*>(CompletionRing);
+		CompletionHead = reinterpret_cast<uint32_t*>(completionRing + params.cq_off.head);
+		CompletionTail = reinterpret_cast<uint32_t*>(completionRing + params.cq_off.tail);
+		CompletionMask = *reinterpret_cast<uint32_t*>(completionRing + params.cq_off.ring_mask);
+		CompletionEntries = reinterpret_cast<io_uring_cqe*>(completionRing + params.cq_off.cqes);
+
+		WakeUpFd = eventfd(0, EFD_CLOEXEC);
+		return WakeUpFd >= 0;
+	}
+
+	// Next free submission entry (cleared), null when the ring is full
+	io_uring_sqe* GetSubmissionEntry()
+	{
+		const uint32_t tail = *SubmissionTail;
+		if (tail - __atomic_load_n(SubmissionHead, __ATOMIC_ACQUIRE) >= EntryCount)
+			return nullptr;
+
+		const uint32_t index = tail & SubmissionMask;
+		io_uring_sqe* entry = &SubmissionEntries[index];
+		memset(entry, 0, sizeof(*entry));
+		SubmissionArray[index] = index;
+		return entry;
+	}
+
+	// Publish the entry returned by GetSubmissionEntry, the kernel takes it on the next Enter
+	void CommitSubmissionEntry()
+	{
+		__atomic_store_n(SubmissionTail, *SubmissionTail + 1, __ATOMIC_RELEASE);
+		PendingSubmitCount++;
+	}
+
+	// Submit pending entries and wait for at least one completion
+	void Enter()
+	{
+		const int result = static_cast<int>(syscall(__NR_io_uring_enter, Fd, PendingSubmitCount, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+		if (result > 0)
+			PendingSubmitCount -= std::min<uint32_t>(PendingSubmitCount, static_cast<uint32_t>(result));
+		else if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			throw std::runtime_error("io_uring_enter failed: " + std::string(strerror(errno)));
+	}
+
+	bool SubmitWakeUpRead()
+	{
+		io_uring_sqe* entry = GetSubmissionEntry();
+		if (!entry)
+			return false;
+
+		entry->opcode = IORING_OP_READ;
+		entry->fd = WakeUpFd;
+		entry->addr = reinterpret_cast<uint64_t>(&WakeUpValue);
+		entry->len = sizeof(WakeUpValue);
+		entry->user_data = s_WakeUpUserData;
+		CommitSubmissionEntry();
+		return true;
+	}
+};
+
+#else
+
+struct AsyncFileReader::Ring
+{
+};
+
+#endif
+
+AsyncFileReader::AsyncFileReader()
+{
+#if YUME_IO_URING
+	auto ring = std::make_unique<Ring>();
+	if (ring->Init() && ring->SubmitWakeUpRead())
+	{
+		m_Ring = std::move(ring);
+		m_RingThread = std::thread(&AsyncFileReader::RingLoop, this);
+	}
+#endif
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	if (!m_Ring)
+		return;
+
+#if YUME_IO_URING
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+
+	// Queued reads are finished first, so every callback still runs
+	const uint64_t value = 1;
+	if (write(m_Ring->WakeUpFd, &value, sizeof(value)) < 0)
+	{
+		// The loop also checks for stopping after each completion
+	}
+	m_RingThread.join();
+#endif
+}
+
+AsyncFileReader& AsyncFileReader::Get()
+{
+	static AsyncFileReader s_Reader;
+	return s_Reader;
+}
+
+void AsyncFileReader::Read(const std::string& filepath, ReadCallback callback)
+{
+	// Pack entries are decompressed (or copied out of the mapping) on the pool, nothing to wait for on the disk
+	const AssetPack* pack = AssetPack::GetMounted();
+	if (!m_Ring || (pack && pack->Find(filepath)))
+	{
+		ThreadPool::Get().Submit([filepath, callback]()
+		{
+			FileData data;
+			const bool isRead = ReadWholeFile(filepath, data);
+			callback(std::move(data), isRead);
+		});
+		return;
+	}
+
+#if YUME_IO_URING
+	Request* request = new Request();
+	request->Path = filepath;
+	request->Callback = std::move(callback);
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_QueuedRequests.push_back(request);
+	}
+
+	// Gets the I/O thread out of io_uring_enter to submit it
+	const uint64_t value = 1;
+	if (write(m_Ring->WakeUpFd, &value, sizeof(value)) < 0)
+	{
+		// Only fails when the counter would overflow, the thread is awake then anyway
+	}
+#endif
+}
+
+std::future<FileData> AsyncFileReader::Read(const std::string& filepath)
+{
+	auto promise = std::make_shared<std::promise<FileData>>();
+	std::future<FileData> future = promise->get_future();
+
+	// Without a ring the read happens right here: waiting on a pool task from a pool worker could deadlock the pool
+	const AssetPack* pack = AssetPack::GetMounted();
+	if (!m_Ring || (pack && pack->Find(filepath)))
+	{
+		FileData data;
+		if (ReadWholeFile(filepath, data))
+			promise->set_value(std::move(data));
+		else
+			promise->set_exception(std::make_exception_ptr(std::runtime_error("Failed to read file: " + filepath)));
+		return future;
+	}
+
+	Read(filepath, [promise, filepath](FileData&& data, bool isRead)
+	{
+		if (isRead)
+			promise->set_value(std::move(data));
+		else
+			promise->set_exception(std::make_exception_ptr(std::runtime_error("Failed to read file: " + filepath)));
+	});
+	return future;
+}
+
+void AsyncFileReader::RingLoop()
+{
+#if YUME_IO_URING
+	Ring& ring = *m_Ring;
+	std::deque<Request*> waitingRequests;		// queued, not submitted yet (ring full)
+
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			waitingRequests.insert(waitingRequests.end(), m_QueuedRequests.begin(), m_QueuedRequests.end());
+			m_QueuedRequests.clear();
+
+			if (m_IsStopping && waitingRequests.empty() && ring.InFlightCount == 0)
+				break;
+		}
+
+		// Every file queued since the last wake up goes into one submission
+		while (!waitingRequests.empty() && ring.InFlightCount + 1 < ring.EntryCount)
+		{
+			SubmitRead(waitingRequests.front());
+			waitingRequests.pop_front();
+		}
+
+		ring.Enter();
+
+		uint32_t head = *ring.CompletionHead;
+		while (head != __atomic_load_n(ring.CompletionTail, __ATOMIC_ACQUIRE))
+		{
+			const io_uring_cqe completion = ring.CompletionEntries[head & ring.CompletionMask];
+			head++;
+			__atomic_store_n(ring.CompletionHead, head, __ATOMIC_RELEASE);
+
+			if (completion.user_data == s_WakeUpUserData)
+			{
+				ring.SubmitWakeUpRead();
+				continue;
+			}
+
+			Request* request = reinterpret_cast<Request*>(completion.user_data);
+			if (completion.res == -EINTR || completion.res == -EAGAIN)
+			{
+				ResubmitRead(request);
+				continue;
+			}
+
+			ring.InFlightCount--;
+			if (completion.res < 0)
+			{
+				Complete(request, false);
+				continue;
+			}
+
+			// 0: the file shrank since fstat, keep what was read
+			request->Offset += static_cast<size_t>(completion.res);
+			if (completion.res == 0)
+				request->Data.resize(request->Offset);
+
+			if (request->Offset < request->Data.size())
+			{
+				ring.InFlightCount++;
+				ResubmitRead(request);
+			}
+			else
+			{
+				Complete(request, true);
+			}
+		}
+	}
+#endif
+}
+
+void AsyncFileReader::SubmitRead(Request* request)
+{
+#if YUME_IO_URING
+	// Opening stays synchronous, the reads are what takes the time
+	request->Fd = open(request->Path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat fileStat;
+	if (request->Fd < 0 || fstat(request->Fd, &fileStat) != 0)
+	{
+		Complete(request, false);
+		return;
+	}
+
+	request->Data.resize(static_cast<size_t>(fileStat.st_size));
+	if (request->Data.empty())
+	{
+		Complete(request, true);
+		return;
+	}
+
+	m_Ring->InFlightCount++;
+	ResubmitRead(request);
+#else
+	(void)request;
+#endif
+}
+
+void AsyncFileReader::ResubmitRead(Request* request)
+{
+#if YUME_IO_URING
+	// Completions free their entry before this runs, so there is always one
+	io_uring_sqe* entry = m_Ring->GetSubmissionEntry();
+	if (!entry)
+	{
+		m_Ring->InFlightCount--;
+		Complete(request, false);
+		return;
+	}
+
+	entry->opcode = IORING_OP_READ;
+	entry->fd = request->Fd;
+	entry->addr = reinterpret_cast<uint64_t>(request->Data.data() + request->Offset);
+	entry->len = static_cast<uint32_t>(std::min(request->Data.size() - request->Offset, s_MaxReadSize));
+	entry->off = request->Offset;
+	entry->user_data = reinterpret_cast<uint64_t>(request);
+	m_Ring->CommitSubmissionEntry();
+#else
+	(void)request;
+#endif
+}
+
+void AsyncFileReader::Complete(Request* request, bool isRead)
+{
+#if YUME_IO_URING
+	if (request->Fd >= 0)
+		close(request->Fd);
+#endif
+
+	if (!isRead)
+		request->Data.clear();
+	request->Callback(std::move(request->Data), isRead);
+	delete request;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Whole contents of a file read by AsyncFileReader
+using FileData = std::vector<uint8_t>;
+
+// Asynchronous whole file reads, many in flight at once so disk latency overlaps with decoding
+// Linux: one I/O thread drives an io_uring (reads of every queued file submitted together, completions reaped as they land)
+// Elsewhere, or when the kernel refuses a ring: every read is a thread pool task
+// Files in the mounted AssetPack are served from it on the thread pool
+class AsyncFileReader
+{
+public:
+	// Runs on the I/O thread (or a pool worker), keep it short and hand heavy work to the thread pool
+	using ReadCallback = std::function<void(FileData&& data, bool isRead)>;
+
+	AsyncFileReader();
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+	~AsyncFileReader();
+
+	// Shared reader, created on first use
+	static AsyncFileReader& Get();
+
+	// Thread safe: queue a read, callback gets the bytes (isRead false when the file can`t be opened or read)
+	void Read(const std::string& filepath, ReadCallback callback);
+	// Thread safe: future flavour, throws from get() when the file can`t be read
+	std::future<FileData> Read(const std::string& filepath);
+
+	bool IsUsingUring() const { return m_Ring != nullptr; }
+
+private:
+	struct Request;
+	struct Ring;
+
+	void RingLoop();
+	// Open the file and queue its first read (a file that can`t be opened, or is empty, completes right away)
+	void SubmitRead(Request* request);
+	// Queue the rest of a read the kernel returned short
+	void ResubmitRead(Request* request);
+	static void Complete(Request* request, bool isRead);
+
+private:
+	std::unique_ptr<Ring> m_Ring;		// null when reads go through the thread pool
+	std::thread m_RingThread;
+
+	std::mutex m_Mutex;
+	std::vector<Request*> m_QueuedRequests;
+	bool m_IsStopping = false;
+};
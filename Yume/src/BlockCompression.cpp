@@ -0,0 +1,906 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+// Interpolation weights (out of 64) of BC7 4 bit indices
+static const int s_BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Little endian bit stream over one block
+class BlockBits
+{
+public:
+	explicit BlockBits(uint8_t* data) : m_Data(data) {}
+
+	void Write(uint32_t value, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++, m_Position++)
+		{
+			if ((value >> i) & 1)
+				m_Data[m_Position >> 3] |= static_cast<uint8_t>(1 << (m_Position & 7));
+		}
+	}
+
+	uint32_t Read(uint32_t count)
+	{
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < count; i++, m_Position++)
+		{
+			value |= static_cast<uint32_t>((m_Data[m_Position >> 3] >> (m_Position & 7)) & 1) << i;
+		}
+		return value;
+	}
+
+private:
+	uint8_t* m_Data;
+	uint32_t m_Position = 0;
+};
+
+// 4x4 texels of a block, edges clamp for sizes that aren`t a multiple of 4
+static void LoadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t texels[16][4])
+{
+	for (uint32_t y = 0; y < 4; y++)
+	{
+		const uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+		for (uint32_t x = 0; x < 4; x++)
+		{
+			const uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+			memcpy(texels[y * 4 + x], rgba + (size_t(sourceY) * width + sourceX) * 4, 4);
+		}
+	}
+}
+
+static void StoreBlock(const uint8_t texels[16][4], uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* rgba)
+{
+	for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++)
+	{
+		for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++)
+		{
+			memcpy(rgba + (size_t(blockY * 4 + y) * width + blockX * 4 + x) * 4, texels[y * 4 + x], 4);
+		}
+	}
+}
+
+// Mean and direction of largest variance of the first channelCount channels (power iteration on the covariance)
+static void ComputePrincipalAxis(const float points[16][4], int channelCount, float mean[4], float axis[4])
+{
+	for (int c = 0; c < 4; c++)
+	{
+		mean[c] = 0.0f;
+		axis[c] = 0.0f;
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < channelCount; c++)
+			mean[c] += points[i][c] / 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		for (int r = 0; r < channelCount; r++)
+		{
+			for (int c = 0; c < channelCount; c++)
+				covariance[r][c] += (points[i][r] - mean[r]) * (points[i][c] - mean[c]);
+		}
+	}
+
+	// Start from the row of the widest channel, it is never orthogonal to the principal axis
+	int widest = 0;
+	for (int c = 1; c < channelCount; c++)
+	{
+		if (covariance[c][c] > covariance[widest][widest])
+			widest = c;
+	}
+	for (int c = 0; c < channelCount; c++)
+		axis[c] = covariance[widest][c];
+
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float largest = 0.0f;
+		for (int r = 0; r < channelCount; r++)
+		{
+			for (int c = 0; c < channelCount; c++)
+				next[r] += covariance[r][c] * axis[c];
+			largest = std::max(largest, std::fabs(next[r]));
+		}
+
+		// Flat block, any axis works
+		if (largest < 1e-6f)
+			break;
+
+		for (int c = 0; c < channelCount; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	float length = 0.0f;
+	for (int c = 0; c < channelCount; c++)
+		length += axis[c] * axis[c];
+	length = std::sqrt(length);
+
+	for (int c = 0; c < channelCount; c++)
+		axis[c] = length > 0.0f ? axis[c] / length : 0.0f;
+}
+
+// Endpoints at both ends of the principal axis, endpoints[0] at the far positive end
+static void ComputeAxisEndpoints(const float points[16][4], int channelCount, float endpoints[2][4])
+{
+	float mean[4];
+	float axis[4];
+	ComputePrincipalAxis(points, channelCount, mean, axis);
+
+	float minProjection = FLT_MAX;
+	float maxProjection = -FLT_MAX;
+	for (int i = 0; i < 16; i++)
+	{
+		float projection = 0.0f;
+		for (int c = 0; c < channelCount; c++)
+			projection += (points[i][c] - mean[c]) * axis[c];
+
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = std::min(std::max(mean[c] + axis[c] * maxProjection, 0.0f), 255.0f);
+		endpoints[1][c] = std::min(std::max(mean[c] + axis[c] * minProjection, 0.0f), 255.0f);
+	}
+}
+
+// Endpoints minimizing the squared error for fixed indices, weights[i] is the share of endpoint 1 of texel i
+// false if the system is degenerate (every texel uses the same weight)
+static bool SolveEndpoints(const float points[16][4], const float weights[16], int channelCount, float endpoints[2][4])
+{
+	float a = 0.0f, b = 0.0f, c = 0.0f;
+	float weightedPoints0[4] = {};
+	float weightedPoints1[4] = {};
+
+	for (int i = 0; i < 16; i++)
+	{
+		const float w1 = weights[i];
+		const float w0 = 1.0f - w1;
+		a += w0 * w0;
+		b += w0 * w1;
+		c += w1 * w1;
+
+		for (int channel = 0; channel < channelCount; channel++)
+		{
+			weightedPoints0[channel] += w0 * points[i][channel];
+			weightedPoints1[channel] += w1 * points[i][channel];
+		}
+	}
+
+	const float determinant = a * c - b * b;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+
+	for (int channel = 0; channel < channelCount; channel++)
+	{
+		const float endpoint0 = (c * weightedPoints0[channel] - b * weightedPoints1[channel]) / determinant;
+		const float endpoint1 = (a * weightedPoints1[channel] - b * weightedPoints0[channel]) / determinant;
+		endpoints[0][channel] = std::min(std::max(endpoint0, 0.0f), 255.0f);
+		endpoints[1][channel] = std::min(std::max(endpoint1, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static uint16_t PackColor565(const float color[4])
+{
+	const uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+	const uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+	const uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void UnpackColor565(uint16_t packed, int color[4])
+{
+	const int r = (packed >> 11) & 31;
+	const int g = (packed >> 5) & 63;
+	const int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+	color[3] = 255;
+}
+
+// Best 2 bit indices for a 4 color palette (color0 > color1, or equal with every index 0), returns the squared error
+static uint32_t FitBC1Indices(const uint8_t texels[16][4], uint16_t color0, uint16_t color1, uint32_t* indices)
+{
+	int palette[4][4];
+	UnpackColor565(color0, palette[0]);
+	UnpackColor565(color1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	*indices = 0;
+	uint32_t error = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		uint32_t bestIndex = 0;
+		uint32_t bestError = UINT32_MAX;
+		for (uint32_t index = 0; index < 4; index++)
+		{
+			uint32_t indexError = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				const int difference = texels[i][c] - palette[index][c];
+				indexError += difference * difference;
+			}
+
+			// Ties keep the lower index, a flat block (color0 == color1) never reaches index 3
+			if (indexError < bestError)
+			{
+				bestError = indexError;
+				bestIndex = index;
+			}
+		}
+
+		*indices |= bestIndex << (2 * i);
+		error += bestError;
+	}
+	return error;
+}
+
+static uint32_t FitBC1Endpoints(const uint8_t texels[16][4], const float endpoints[2][4], uint16_t* color0, uint16_t* color1, uint32_t* indices)
+{
+	*color0 = PackColor565(endpoints[0]);
+	*color1 = PackColor565(endpoints[1]);
+
+	// Four color mode needs color0 > color1
+	if (*color0 < *color1)
+		std::swap(*color0, *color1);
+
+	return FitBC1Indices(texels, *color0, *color1, indices);
+}
+
+// RGB block, alpha is ignored (always decoded in four color mode)
+static void EncodeBC1Block(const uint8_t texels[16][4], uint8_t* block)
+{
+	float points[16][4];
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			points[i][c] = texels[i][c];
+	}
+
+	float endpoints[2][4];
+	ComputeAxisEndpoints(points, 3, endpoints);
+
+	uint16_t color0, color1;
+	uint32_t indices;
+	uint32_t error = FitBC1Endpoints(texels, endpoints, &color0, &color1, &indices);
+
+	// One least squares pass over the chosen indices, kept if it lowers the error
+	static const float s_IndexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = s_IndexWeights[(indices >> (2 * i)) & 3];
+
+	if (error > 0 && SolveEndpoints(points, weights, 3, endpoints))
+	{
+		uint16_t refinedColor0, refinedColor1;
+		uint32_t refinedIndices;
+		const uint32_t refinedError = FitBC1Endpoints(texels, endpoints, &refinedColor0, &refinedColor1, &refinedIndices);
+		if (refinedError < error)
+		{
+			color0 = refinedColor0;
+			color1 = refinedColor1;
+			indices = refinedIndices;
+		}
+	}
+
+	block[0] = static_cast<uint8_t>(color0);
+	block[1] = static_cast<uint8_t>(color0 >> 8);
+	block[2] = static_cast<uint8_t>(color1);
+	block[3] = static_cast<uint8_t>(color1 >> 8);
+	for (int b = 0; b < 4; b++)
+		block[4 + b] = static_cast<uint8_t>(indices >> (8 * b));
+}
+
+static void DecodeBC1Block(const uint8_t* block, bool isAlwaysFourColors, uint8_t texels[16][4])
+{
+	const uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+	const uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+	int palette[4][4];
+	UnpackColor565(color0, palette[0]);
+	UnpackColor565(color1, palette[1]);
+	if (color0 > color1 || isAlwaysFourColors)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		palette[2][3] = 255;
+		palette[3][3] = 255;
+	}
+	else
+	{
+		// Three colors and transparent black
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		palette[2][3] = 255;
+		palette[3][3] = 0;
+	}
+
+	const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (uint32_t(block[7]) << 24);
+	for (int i = 0; i < 16; i++)
+	{
+		const int index = (indices >> (2 * i)) & 3;
+		for (int c = 0; c < 4; c++)
+			texels[i][c] = static_cast<uint8_t>(palette[index][c]);
+	}
+}
+
+// Single channel block, the eight value mode (value0 > value1) unless the block is flat
+static void EncodeBC4Block(const uint8_t values[16], uint8_t* block)
+{
+	uint8_t minValue = 255;
+	uint8_t maxValue = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		minValue = std::min(minValue, values[i]);
+		maxValue = std::max(maxValue, values[i]);
+	}
+
+	block[0] = maxValue;
+	block[1] = minValue;
+
+	uint64_t indices = 0;
+	if (maxValue > minValue)
+	{
+		// Step k of 7 from min to max: index 1 is min, index 0 max, indices 2..7 the steps from max down
+		const float scale = 7.0f / static_cast<float>(maxValue - minValue);
+		for (int i = 0; i < 16; i++)
+		{
+			const uint32_t step = static_cast<uint32_t>((values[i] - minValue) * scale + 0.5f);
+			const uint32_t index = step == 7 ? 0 : step == 0 ? 1 : 8 - step;
+			indices |= uint64_t(index) << (3 * i);
+		}
+	}
+
+	for (int b = 0; b < 6; b++)
+		block[2 + b] = static_cast<uint8_t>(indices >> (8 * b));
+}
+
+static void DecodeBC4Block(const uint8_t* block, uint8_t values[16])
+{
+	const uint32_t value0 = block[0];
+	const uint32_t value1 = block[1];
+
+	uint8_t palette[8];
+	palette[0] = static_cast<uint8_t>(value0);
+	palette[1] = static_cast<uint8_t>(value1);
+	if (value0 > value1)
+	{
+		for (uint32_t i = 1; i < 7; i++)
+			palette[i + 1] = static_cast<uint8_t>(((7 - i) * value0 + i * value1 + 3) / 7);
+	}
+	else
+	{
+		for (uint32_t i = 1; i < 5; i++)
+			palette[i + 1] = static_cast<uint8_t>(((5 - i) * value0 + i * value1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t indices = 0;
+	for (int b = 0; b < 6; b++)
+		indices |= uint64_t(block[2 + b]) << (8 * b);
+
+	for (int i = 0; i < 16; i++)
+		values[i] = palette[(indices >> (3 * i)) & 7];
+}
+
+// Endpoint as 7 bit channels plus the p-bit (shared lowest bit) that lands closest, returns the 8 bit channels
+static void QuantizeBC7Endpoint(const float endpoint[4], uint32_t quantized[4], uint32_t* pBit, int expanded[4])
+{
+	float bestError = FLT_MAX;
+	for (uint32_t p = 0; p < 2; p++)
+	{
+		uint32_t candidate[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			const float value = (endpoint[c] - static_cast<float>(p)) / 2.0f + 0.5f;
+			candidate[c] = static_cast<uint32_t>(std::min(std::max(value, 0.0f), 127.0f));
+			const float difference = static_cast<float>(candidate[c] * 2 + p) - endpoint[c];
+			error += difference * difference;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			*pBit = p;
+			for (int c = 0; c < 4; c++)
+			{
+				quantized[c] = candidate[c];
+				expanded[c] = static_cast<int>(candidate[c] * 2 + p);
+			}
+		}
+	}
+}
+
+struct BC7Mode6Block
+{
+	uint32_t Endpoints[2][4];		// 7 bits
+	uint32_t PBits[2];
+	uint8_t Indices[16];			// 4 bits
+};
+
+static uint32_t FitBC7Endpoints(const uint8_t texels[16][4], const float endpoints[2][4], BC7Mode6Block& encoded)
+{
+	int expanded[2][4];
+	for (int e = 0; e < 2; e++)
+		QuantizeBC7Endpoint(endpoints[e], encoded.Endpoints[e], &encoded.PBits[e], expanded[e]);
+
+	int palette[16][4];
+	for (int index = 0; index < 16; index++)
+	{
+		for (int c = 0; c < 4; c++)
+			palette[index][c] = (expanded[0][c] * (64 - s_BC7Weights[index]) + expanded[1][c] * s_BC7Weights[index] + 32) >> 6;
+	}
+
+	uint32_t error = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		uint32_t bestError = UINT32_MAX;
+		for (int index = 0; index < 16; index++)
+		{
+			uint32_t indexError = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				const int difference = texels[i][c] - palette[index][c];
+				indexError += difference * difference;
+			}
+
+			if (indexError < bestError)
+			{
+				bestError = indexError;
+				encoded.Indices[i] = static_cast<uint8_t>(index);
+			}
+		}
+		error += bestError;
+	}
+	return error;
+}
+
+static void EncodeBC7Block(const uint8_t texels[16][4], uint8_t* block)
+{
+	float points[16][4];
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			points[i][c] = texels[i][c];
+	}
+
+	float endpoints[2][4];
+	ComputeAxisEndpoints(points, 4, endpoints);
+
+	BC7Mode6Block encoded;
+	const uint32_t error = FitBC7Endpoints(texels, endpoints, encoded);
+
+	// One least squares pass over the chosen indices, kept if it lowers the error
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = s_BC7Weights[encoded.Indices[i]] / 64.0f;
+
+	BC7Mode6Block refined;
+	if (error > 0 && SolveEndpoints(points, weights, 4, endpoints) && FitBC7Endpoints(texels, endpoints, refined) < error)
+		encoded = refined;
+
+	// Texel 0 stores its index without the top bit (implied 0), mirror the block if it is set
+	if (encoded.Indices[0] & 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(encoded.Endpoints[0][c], encoded.Endpoints[1][c]);
+		std::swap(encoded.PBits[0], encoded.PBits[1]);
+		for (int i = 0; i < 16; i++)
+			encoded.Indices[i] = static_cast<uint8_t>(15 - encoded.Indices[i]);
+	}
+
+	memset(block, 0, 16);
+	BlockBits bits(block);
+	bits.Write(1 << 6, 7);				// mode 6: six 0 bits then a 1
+	for (int c = 0; c < 4; c++)
+	{
+		bits.Write(encoded.Endpoints[0][c], 7);
+		bits.Write(encoded.Endpoints[1][c], 7);
+	}
+	bits.Write(encoded.PBits[0], 1);
+	bits.Write(encoded.PBits[1], 1);
+
+	bits.Write(encoded.Indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		bits.Write(encoded.Indices[i], 4);
+}
+
+// BC7 mode layouts: subsets, partition/rotation/index selection bits, color/alpha bits per endpoint channel,
+// p-bits (per endpoint or shared per subset), bits of the first and second index sets
+struct BC7ModeInfo
+{
+	uint32_t SubsetCount;
+	uint32_t PartitionBits;
+	uint32_t RotationBits;
+	uint32_t IndexSelectionBits;
+	uint32_t ColorBits;
+	uint32_t AlphaBits;
+	uint32_t EndpointPBits;
+	uint32_t SharedPBits;
+	uint32_t IndexBits;
+	uint32_t SecondIndexBits;
+};
+
+static const BC7ModeInfo s_BC7Modes[8] =
+{
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+// Subset of every texel (bit i for texel i) of the 64 two subset partitions
+static const uint16_t s_BC7Partitions2[64] =
+{
+	0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+	0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+	0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+	0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+	0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+	0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+	0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+	0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+};
+
+// Subset of every texel (bits 2i..2i+1 for texel i) of the 64 three subset partitions
+static const uint32_t s_BC7Partitions3[64] =
+{
+	0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+	0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+	0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+	0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+	0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+	0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+	0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+	0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+};
+
+// Anchor texels (index stored with one bit less) of the second subset of two, and of the second and third subsets of three
+static const uint8_t s_BC7Anchors2[64] =
+{
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+static const uint8_t s_BC7Anchors3Second[64] =
+{
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+};
+
+static const uint8_t s_BC7Anchors3Third[64] =
+{
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+};
+
+// Interpolation weights (out of 64) of BC7 2 and 3 bit indices
+static const int s_BC7Weights2[4] = { 0, 21, 43, 64 };
+static const int s_BC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+
+static int GetBC7Weight(uint32_t indexBits, uint32_t index)
+{
+	return indexBits == 2 ? s_BC7Weights2[index] : indexBits == 3 ? s_BC7Weights3[index] : s_BC7Weights[index];
+}
+
+static uint32_t GetBC7Subset(uint32_t subsetCount, uint32_t partition, uint32_t texel)
+{
+	if (subsetCount == 2)
+		return (s_BC7Partitions2[partition] >> texel) & 1;
+	if (subsetCount == 3)
+		return (s_BC7Partitions3[partition] >> (texel * 2)) & 3;
+	return 0;
+}
+
+static bool IsBC7Anchor(uint32_t subsetCount, uint32_t partition, uint32_t texel)
+{
+	if (texel == 0)
+		return true;
+	if (subsetCount == 2)
+		return texel == s_BC7Anchors2[partition];
+	if (subsetCount == 3)
+		return texel == s_BC7Anchors3Second[partition] || texel == s_BC7Anchors3Third[partition];
+	return false;
+}
+
+// Read one index set (anchors have one bit less)
+static void ReadBC7Indices(BlockBits& bits, uint32_t indexBits, uint32_t subsetCount, uint32_t partition, uint32_t indices[16])
+{
+	for (uint32_t i = 0; i < 16; i++)
+		indices[i] = bits.Read(IsBC7Anchor(subsetCount, partition, i) ? indexBits - 1 : indexBits);
+}
+
+static void DecodeBC7Block(const uint8_t* block, uint8_t texels[16][4])
+{
+	// Reserved mode (no bit set) decodes to transparent black
+	if (block[0] == 0)
+	{
+		memset(texels, 0, 16 * 4);
+		return;
+	}
+
+	uint32_t mode = 0;
+	while (!((block[0] >> mode) & 1))
+		mode++;
+	const BC7ModeInfo& info = s_BC7Modes[mode];
+
+	uint8_t data[16];
+	memcpy(data, block, sizeof(data));
+	BlockBits bits(data);
+	bits.Read(mode + 1);
+
+	const uint32_t partition = bits.Read(info.PartitionBits);
+	const uint32_t rotation = bits.Read(info.RotationBits);
+	const uint32_t indexSelection = bits.Read(info.IndexSelectionBits);
+
+	// Endpoints channel by channel: every endpoint`s red, then green, blue and alpha
+	const uint32_t endpointCount = info.SubsetCount * 2;
+	uint32_t endpoints[6][4] = {};
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		const uint32_t channelBits = c < 3 ? info.ColorBits : info.AlphaBits;
+		for (uint32_t e = 0; e < endpointCount; e++)
+			endpoints[e][c] = bits.Read(channelBits);
+	}
+
+	// P-bits extend every channel by one low bit
+	uint32_t precision[4] = { info.ColorBits, info.ColorBits, info.ColorBits, info.AlphaBits };
+	if (info.EndpointPBits || info.SharedPBits)
+	{
+		uint32_t pBits[6];
+		for (uint32_t e = 0; e < endpointCount; e++)
+			pBits[e] = info.EndpointPBits ? bits.Read(1) : (e % 2 == 0 ? bits.Read(1) : pBits[e - 1]);
+
+		for (uint32_t e = 0; e < endpointCount; e++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				if (precision[c] > 0)
+					endpoints[e][c] = (endpoints[e][c] << 1) | pBits[e];
+			}
+		}
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if (precision[c] > 0)
+				precision[c]++;
+		}
+	}
+
+	// Expand to 8 bits by replicating the high bits, modes without alpha are opaque
+	for (uint32_t e = 0; e < endpointCount; e++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			if (precision[c] == 0)
+				endpoints[e][c] = 255;
+			else
+				endpoints[e][c] = ((endpoints[e][c] << (8 - precision[c])) | (endpoints[e][c] >> (2 * precision[c] - 8))) & 0xFF;
+		}
+	}
+
+	uint32_t indices[16];
+	uint32_t secondIndices[16];
+	ReadBC7Indices(bits, info.IndexBits, info.SubsetCount, partition, indices);
+	if (info.SecondIndexBits > 0)
+		ReadBC7Indices(bits, info.SecondIndexBits, info.SubsetCount, partition, secondIndices);
+
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		const uint32_t subset = GetBC7Subset(info.SubsetCount, partition, i);
+		const uint32_t* endpoint0 = endpoints[subset * 2];
+		const uint32_t* endpoint1 = endpoints[subset * 2 + 1];
+
+		// Color and alpha use their own index set when there are two, the selection bit swaps them
+		int colorWeight = GetBC7Weight(info.IndexBits, indices[i]);
+		int alphaWeight = colorWeight;
+		if (info.SecondIndexBits > 0)
+		{
+			alphaWeight = GetBC7Weight(info.SecondIndexBits, secondIndices[i]);
+			if (indexSelection)
+				std::swap(colorWeight, alphaWeight);
+		}
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			const int weight = c < 3 ? colorWeight : alphaWeight;
+			texels[i][c] = static_cast<uint8_t>((endpoint0[c] * (64 - weight) + endpoint1[c] * weight + 32) >> 6);
+		}
+
+		// Rotation swaps alpha with one color channel
+		if (rotation > 0)
+			std::swap(texels[i][3], texels[i][rotation - 1]);
+	}
+}
+
+bool BlockCompression::IsSupported(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint32_t BlockCompression::GetBlockSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		return 16;
+	default:
+		throw std::runtime_error("Unsupported block compressed format!");
+	}
+}
+
+uint32_t BlockCompression::GetChannelCount(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return 1;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		return 2;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+void BlockCompression::Encode(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks)
+{
+	const uint32_t blockSize = GetBlockSize(format);
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+
+	ThreadPool::Get().ParallelFor(blocksY, [&](uint32_t blockY)
+	{
+		uint8_t texels[16][4];
+		uint8_t channel[2][16];
+
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			LoadBlock(rgba, width, height, blockX, blockY, texels);
+			uint8_t* block = blocks + (size_t(blockY) * blocksX + blockX) * blockSize;
+
+			switch (format)
+			{
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+				for (int i = 0; i < 16; i++)
+					channel[0][i] = texels[i][3];
+				EncodeBC4Block(channel[0], block);
+				EncodeBC1Block(texels, block + 8);
+				break;
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+				for (int i = 0; i < 16; i++)
+					channel[0][i] = texels[i][0];
+				EncodeBC4Block(channel[0], block);
+				break;
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+				for (int i = 0; i < 16; i++)
+				{
+					channel[0][i] = texels[i][0];
+					channel[1][i] = texels[i][1];
+				}
+				EncodeBC4Block(channel[0], block);
+				EncodeBC4Block(channel[1], block + 8);
+				break;
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+				EncodeBC7Block(texels, block);
+				break;
+			default:
+				EncodeBC1Block(texels, block);
+				break;
+			}
+		}
+	});
+}
+
+void BlockCompression::Decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+	const uint32_t blockSize = GetBlockSize(format);
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+
+	for (uint32_t blockY = 0; blockY < blocksY; blockY++)
+	{
+		uint8_t texels[16][4];
+		uint8_t channel[2][16];
+
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			const uint8_t* block = blocks + (size_t(blockY) * blocksX + blockX) * blockSize;
+
+			switch (format)
+			{
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+				// No alpha in the RGB variant, the fourth color is opaque black
+				DecodeBC1Block(block, false, texels);
+				for (int i = 0; i < 16; i++)
+					texels[i][3] = 255;
+				break;
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+				DecodeBC1Block(block, false, texels);
+				break;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+				DecodeBC1Block(block + 8, true, texels);
+				DecodeBC4Block(block, channel[0]);
+				for (int i = 0; i < 16; i++)
+					texels[i][3] = channel[0][i];
+				break;
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+				DecodeBC4Block(block, channel[0]);
+				for (int i = 0; i < 16; i++)
+				{
+					texels[i][0] = channel[0][i];
+					texels[i][1] = 0;
+					texels[i][2] = 0;
+					texels[i][3] = 255;
+				}
+				break;
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+				DecodeBC4Block(block, channel[0]);
+				DecodeBC4Block(block + 8, channel[1]);
+				for (int i = 0; i < 16; i++)
+				{
+					texels[i][0] = channel[0][i];
+					texels[i][1] = channel[1][i];
+					texels[i][2] = 0;
+					texels[i][3] = 255;
+				}
+				break;
+			default:
+				DecodeBC7Block(block, texels);
+				break;
+			}
+
+			StoreBlock(texels, width, height, blockX, blockY, rgba);
+		}
+	}
+}
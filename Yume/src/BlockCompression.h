@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Utils.h"
+
+// BCn encoding/decoding of RGBA8 images, 4x4 texel blocks written row by row
+// BC1: opaque RGB, 8 bytes per block
+// BC3: RGB + smooth alpha (BC1 color + BC4 alpha), 16 bytes per block
+// BC4: one channel (red), 8 bytes per block
+// BC5: two channels (red and green, e.g. tangent space normals), 16 bytes per block
+// BC7: RGBA, 16 bytes per block, the encoder only writes mode 6 (one subset, 7777.1 endpoints, 4 bit indices)
+class BlockCompression
+{
+public:
+	static bool IsSupported(VkFormat format);
+	static uint32_t GetBlockSize(VkFormat format);
+	// Channels a format stores (the first ones of an RGBA texel)
+	static uint32_t GetChannelCount(VkFormat format);
+
+	// Block rows are encoded in parallel on the thread pool (the calling thread takes part)
+	static void Encode(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+	// CPU fallback for devices that can`t sample the format, every BC7 mode included
+	// Channels the format doesn`t store decode as 0 (alpha as 255)
+	static void Decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+};
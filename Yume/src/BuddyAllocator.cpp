@@ -0,0 +1,90 @@
+#include "BuddyAllocator.h"
+
+#include <algorithm>
+
+BuddyAllocator::BuddyAllocator(uint64_t capacity, uint64_t minBlockSize)
+	: m_MinBlockSize(minBlockSize)
+{
+	if (capacity < minBlockSize)
+		return;
+
+	// Largest power of two that fits
+	m_Capacity = minBlockSize;
+	while (m_Capacity * 2 <= capacity)
+	{
+		m_Capacity *= 2;
+	}
+
+	m_FreeBlocks.resize(GetOrder(m_Capacity) + 1);
+	m_FreeBlocks.back().insert(0);
+}
+
+bool BuddyAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t* offset, uint64_t* allocatedSize)
+{
+	if (size == 0 || m_FreeBlocks.empty())
+		return false;
+
+	// Blocks are aligned to their size, so asking for at least `alignment` bytes covers the alignment
+	const uint64_t blockSize = std::max(size, alignment);
+	if (blockSize > m_Capacity)
+		return false;
+
+	const uint32_t order = GetOrder(blockSize);
+
+	// Smallest free block that fits
+	uint32_t freeOrder = order;
+	while (freeOrder < m_FreeBlocks.size() && m_FreeBlocks[freeOrder].empty())
+	{
+		freeOrder++;
+	}
+	if (freeOrder >= m_FreeBlocks.size())
+		return false;
+
+	uint64_t blockOffset = *m_FreeBlocks[freeOrder].begin();
+	m_FreeBlocks[freeOrder].erase(m_FreeBlocks[freeOrder].begin());
+
+	// Split down to the wanted order, the upper halves stay free
+	while (freeOrder > order)
+	{
+		freeOrder--;
+		m_FreeBlocks[freeOrder].insert(blockOffset + (m_MinBlockSize << freeOrder));
+	}
+
+	*offset = blockOffset;
+	*allocatedSize = m_MinBlockSize << order;
+	m_UsedSize += *allocatedSize;
+
+	return true;
+}
+
+void BuddyAllocator::Free(uint64_t offset, uint64_t allocatedSize)
+{
+	m_UsedSize -= allocatedSize;
+
+	uint32_t order = GetOrder(allocatedSize);
+
+	// Merge with the buddy as long as it is free as well
+	while (order + 1 < m_FreeBlocks.size())
+	{
+		const uint64_t buddyOffset = offset ^ (m_MinBlockSize << order);
+		auto buddy = m_FreeBlocks[order].find(buddyOffset);
+		if (buddy == m_FreeBlocks[order].end())
+			break;
+
+		m_FreeBlocks[order].erase(buddy);
+		offset = std::min(offset, buddyOffset);
+		order++;
+	}
+
+	m_FreeBlocks[order].insert(offset);
+}
+
+uint32_t BuddyAllocator::GetOrder(uint64_t size) const
+{
+	uint32_t order = 0;
+	while ((m_MinBlockSize << order) < size)
+	{
+		order++;
+	}
+	return order;
+}
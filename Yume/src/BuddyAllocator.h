@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// Offset-only binary buddy allocator over a power of two range. Allocations are rounded up to a
+// power of two and are naturally aligned to their size, freed blocks merge with their buddy
+class BuddyAllocator
+{
+public:
+	BuddyAllocator() = default;
+	// capacity is rounded down to a power of two, minBlockSize must be a power of two
+	BuddyAllocator(uint64_t capacity, uint64_t minBlockSize);
+
+	// alignment must be a power of two; allocatedSize is the rounded size the caller has to free
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t* offset, uint64_t* allocatedSize);
+	void Free(uint64_t offset, uint64_t allocatedSize);
+
+	uint64_t GetCapacity() const { return m_Capacity; }
+	uint64_t GetUsedSize() const { return m_UsedSize; }
+	bool IsEmpty() const { return m_UsedSize == 0; }
+
+private:
+	uint32_t GetOrder(uint64_t size) const;
+
+private:
+	std::vector<std::set<uint64_t>> m_FreeBlocks;	// per order (block size minBlockSize << order), offsets
+	uint64_t m_Capacity = 0;
+	uint64_t m_MinBlockSize = 0;
+	uint64_t m_UsedSize = 0;
+};
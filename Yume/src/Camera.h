@@ -17,9 +17,11 @@ public:
 	void SetViewMatrix(glm::mat4& view) { m_View = view; }
 	void SetCameraPositionAndDirection(glm::vec3& position, glm::vec3& fwdDirection) { m_Position = position; m_ForwardDirection = fwdDirection; }
 
-	glm::mat4& GetProjectionViewMatrix() { return m_Projection * m_View; }
+	glm::mat4 GetProjectionViewMatrix() const { return m_Projection * m_View; }
+	const glm::mat4& GetProjectionMatrix() const { return m_Projection; }
 	glm::mat3 GetTransposeInverseViewMatrix();
 	glm::vec3& GetGazeDirection() { return m_ForwardDirection; }
+	const glm::vec3& GetPosition() const { return m_Position; }
 
 private:
 	void RecalculateProjection();
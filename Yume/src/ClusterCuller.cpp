@@ -0,0 +1,134 @@
+#include "ClusterCuller.h"
+
+#include <algorithm>
+
+#include "MeshCuller.h"
+#include "ThreadPool.h"
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool IsSphereInFrustum(const glm::vec4* planes, const glm::vec3& center, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+static bool IsConeBackFacing(const Meshlet& meshlet, const glm::vec3& cameraPosition)
+{
+	const glm::vec3 toCenter = meshlet.Center - cameraPosition;
+	return glm::dot(toCenter, meshlet.ConeAxis) >= meshlet.ConeCutoff * glm::length(toCenter) + meshlet.Radius;
+}
+
+void ClusterCuller::Init(VkDevice device)
+{
+	m_Device = device;
+}
+
+void ClusterCuller::Destroy()
+{
+	for (auto& stream : m_Streams)
+	{
+		if (stream.Buffer != VK_NULL_HANDLE)
+			DestroyBuffer(m_Device, stream.Buffer, stream.Allocation);
+
+		stream = IndexStream();
+	}
+}
+
+void ClusterCuller::Cull(uint32_t frame, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+	const std::vector<ClusterCullInput>& inputs, std::vector<ClusterDraw>& draws)
+{
+	// Every mesh owns a region big enough for all of its indices, so the workers never coordinate
+	// (regions are 4 byte aligned, which keeps FirstIndex whole for both index types)
+	draws.assign(inputs.size(), ClusterDraw());
+	VkDeviceSize streamSize = 0;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		const Mesh& mesh = *inputs[i].CulledMesh;
+		draws[i].FirstIndex = static_cast<uint32_t>(streamSize / mesh.GetIndexSize());
+		if (!inputs[i].IsCulled)
+			streamSize += AlignUp(VkDeviceSize(mesh.GetIndexSize()) * mesh.GetLod(inputs[i].Lod).IndexCount, 4);
+	}
+
+	// Reserved even when every mesh is culled: the draws bind the stream as index buffer whatever it holds
+	Reserve(frame, std::max<VkDeviceSize>(streamSize, 4));
+	uint8_t* stream = static_cast<uint8_t*>(m_Streams[frame].Allocation.MappedData);
+
+	std::atomic<uint32_t> clusterCount{ 0 };
+	std::atomic<uint32_t> visibleClusterCount{ 0 };
+	std::atomic<uint64_t> triangleCount{ 0 };
+	std::atomic<uint64_t> visibleTriangleCount{ 0 };
+
+	ThreadPool::Get().ParallelFor(static_cast<uint32_t>(inputs.size()), [&](uint32_t i)
+	{
+		const Mesh& mesh = *inputs[i].CulledMesh;
+		const MeshLod& lod = mesh.GetLod(inputs[i].Lod);
+		const uint32_t indexSize = mesh.GetIndexSize();
+
+		clusterCount += lod.MeshletCount;
+		triangleCount += mesh.GetLod(0).IndexCount / 3;
+		if (inputs[i].IsCulled)
+			return;
+
+		// Test in object space: planes of the object`s clip matrix, camera moved into the object
+		glm::vec4 planes[6];
+		MeshCuller::ExtractFrustumPlanes(viewProjection * inputs[i].Model, planes);
+		const glm::vec3 localCamera = glm::vec3(glm::inverse(inputs[i].Model) * glm::vec4(cameraPosition, 1.0f));
+
+		uint8_t* destination = stream + VkDeviceSize(draws[i].FirstIndex) * indexSize;
+		uint32_t indexCount = 0;
+		uint32_t visibleMeshlets = 0;
+		for (uint32_t m = lod.FirstMeshlet; m < lod.FirstMeshlet + lod.MeshletCount; m++)
+		{
+			const Meshlet& meshlet = mesh.GetMeshlets()[m];
+			if (!IsSphereInFrustum(planes, meshlet.Center, meshlet.Radius) || IsConeBackFacing(meshlet, localCamera))
+				continue;
+
+			// Sequential writes only, the stream may be write combined memory
+			const uint32_t meshletIndexCount = meshlet.TriangleCount * 3;
+			memcpy(destination + size_t(indexCount) * indexSize, mesh.GetIndexData() + size_t(meshlet.FirstIndex) * indexSize,
+				size_t(meshletIndexCount) * indexSize);
+			indexCount += meshletIndexCount;
+			visibleMeshlets++;
+		}
+		draws[i].IndexCount = indexCount;
+
+		visibleClusterCount += visibleMeshlets;
+		visibleTriangleCount += indexCount / 3;
+	});
+
+	m_Stats.ClusterCount = clusterCount;
+	m_Stats.VisibleClusterCount = visibleClusterCount;
+	m_Stats.TriangleCount = triangleCount;
+	m_Stats.VisibleTriangleCount = visibleTriangleCount;
+}
+
+void ClusterCuller::BindIndexBuffer(VkCommandBuffer commandBuffer, uint32_t frame, VkIndexType indexType) const
+{
+	vkCmdBindIndexBuffer(commandBuffer, m_Streams[frame].Buffer, 0, indexType);
+}
+
+void ClusterCuller::Reserve(uint32_t frame, VkDeviceSize size)
+{
+	IndexStream& stream = m_Streams[frame];
+	if (stream.Capacity >= size)
+		return;
+
+	// The frame`s last submission has finished, the old buffer can go right away
+	if (stream.Buffer != VK_NULL_HANDLE)
+		DestroyBuffer(m_Device, stream.Buffer, stream.Allocation);
+
+	// Room to grow, models are added between frames
+	stream.Capacity = AlignUp(size + size / 2, 64 * 1024);
+	CreateBuffer(m_Device, stream.Capacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stream.Buffer, &stream.Allocation);
+	m_Generation++;
+}
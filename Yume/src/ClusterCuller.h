@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "Mesh.h"
+#include "Utils.h"
+
+// One mesh to cull and where it is in the world
+struct ClusterCullInput
+{
+	const Mesh* CulledMesh = nullptr;
+	glm::mat4 Model = glm::mat4(1.0f);
+	uint32_t Lod = 0;				// level of detail whose meshlets are culled
+	bool IsCulled = false;			// whole mesh already outside the frustum, nothing to test or copy
+};
+
+// Visible indices of a mesh inside the frame`s index stream, counted in the mesh`s index type
+struct ClusterDraw
+{
+	uint32_t FirstIndex = 0;
+	uint32_t IndexCount = 0;
+};
+
+struct ClusterCullStats
+{
+	uint32_t ClusterCount = 0;
+	uint32_t VisibleClusterCount = 0;
+	uint64_t TriangleCount = 0;				// of the full meshes (level 0)
+	uint64_t VisibleTriangleCount = 0;
+};
+
+// Per-frame meshlet culling on the worker threads
+// Every meshlet is tested against the frustum (bounding sphere) and for facing away from the camera (normal cone),
+// the indices of the visible ones are packed into a host visible index stream per frame in flight, which the
+// draws read instead of the arena index buffer
+class ClusterCuller
+{
+public:
+	void Init(VkDevice device);
+	void Destroy();
+
+	// Fill the frame`s stream (whose last submission must have finished) and draws, 1:1 with inputs
+	void Cull(uint32_t frame, const glm::mat4& viewProjection, const glm::vec3& cameraPosition,
+		const std::vector<ClusterCullInput>& inputs, std::vector<ClusterDraw>& draws);
+
+	// Bind the frame`s stream as index buffer, again whenever the index type changes (16/32 bit)
+	// The stream exists once the frame was culled, even if every mesh was culled
+	void BindIndexBuffer(VkCommandBuffer commandBuffer, uint32_t frame, VkIndexType indexType) const;
+	// Bumped whenever a stream is replaced (it grew), command buffers binding the old one are invalid
+	uint64_t GetGeneration() const { return m_Generation; }
+
+	// Counts of the last Cull
+	ClusterCullStats GetStats() const { return m_Stats; }
+
+private:
+	// Grow the frame`s stream to at least size bytes
+	void Reserve(uint32_t frame, VkDeviceSize size);
+
+private:
+	struct IndexStream
+	{
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		MemoryAllocation Allocation;
+		VkDeviceSize Capacity = 0;
+	};
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	IndexStream m_Streams[MAX_FRAME_DRAWS];
+	uint64_t m_Generation = 0;
+	ClusterCullStats m_Stats;
+};
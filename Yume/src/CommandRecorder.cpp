@@ -0,0 +1,173 @@
+#include "CommandRecorder.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+
+void CommandRecorder::Init(VkDevice device, uint32_t queueFamilyIndex, uint32_t cacheSlotCount)
+{
+	m_Device = device;
+	m_QueueFamilyIndex = queueFamilyIndex;
+
+	// The calling thread records too
+	const uint32_t slotCount = ThreadPool::Get().GetThreadCount() + 1;
+
+	for (auto& frameCommands : m_Frames)
+	{
+		// Re-recorded every frame
+		frameCommands.PrimaryPool = CreatePool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+		VkCommandBufferAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocateInfo.commandPool = frameCommands.PrimaryPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocateInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(m_Device, &allocateInfo, &frameCommands.Primary) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate Command Buffers!");
+		}
+
+		frameCommands.CachedSubpasses.resize(cacheSlotCount);
+		for (auto& cachedSubpass : frameCommands.CachedSubpasses)
+		{
+			cachedSubpass.SlotPools.resize(slotCount);
+			cachedSubpass.SlotBuffers.resize(slotCount);
+			for (uint32_t slot = 0; slot < slotCount; slot++)
+			{
+				// Kept over many frames
+				cachedSubpass.SlotPools[slot] = CreatePool(0);
+
+				allocateInfo.commandPool = cachedSubpass.SlotPools[slot];
+				allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+				if (vkAllocateCommandBuffers(m_Device, &allocateInfo, &cachedSubpass.SlotBuffers[slot]) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to allocate secondary Command Buffers!");
+				}
+			}
+		}
+	}
+}
+
+void CommandRecorder::Destroy()
+{
+	// Destroying a pool frees its buffers
+	for (auto& frameCommands : m_Frames)
+	{
+		if (frameCommands.PrimaryPool != VK_NULL_HANDLE)
+			vkDestroyCommandPool(m_Device, frameCommands.PrimaryPool, nullptr);
+
+		for (auto& cachedSubpass : frameCommands.CachedSubpasses)
+		{
+			for (VkCommandPool pool : cachedSubpass.SlotPools)
+			{
+				vkDestroyCommandPool(m_Device, pool, nullptr);
+			}
+		}
+
+		frameCommands = FrameCommands();
+	}
+}
+
+VkCommandBuffer CommandRecorder::BeginFrame(uint32_t frame)
+{
+	FrameCommands& frameCommands = m_Frames[frame];
+
+	// Resetting the pool resets every buffer allocated from it, much cheaper than one buffer at a time
+	vkResetCommandPool(m_Device, frameCommands.PrimaryPool, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(frameCommands.Primary, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Failed to start recording a Command buffer!");
+
+	return frameCommands.Primary;
+}
+
+void CommandRecorder::RecordSubpass(uint32_t frame, uint32_t cacheSlot, uint64_t key, VkRenderPass renderPass, uint32_t subpass,
+	VkFramebuffer framebuffer, uint32_t drawCount, const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>& record)
+{
+	FrameCommands& frameCommands = m_Frames[frame];
+	CachedSubpass& cachedSubpass = frameCommands.CachedSubpasses[cacheSlot];
+	m_Stats.SubpassCount++;
+
+	// Only this frame in flight executes these buffers and its fence has signalled, so they can be reset
+	if (!CACHE_COMMAND_BUFFERS || !cachedSubpass.IsRecorded || cachedSubpass.Key != key)
+	{
+		for (VkCommandPool pool : cachedSubpass.SlotPools)
+		{
+			vkResetCommandPool(m_Device, pool, 0);
+		}
+
+		// Enough draws per buffer to be worth a thread, at most one buffer per slot
+		const uint32_t slotCount = static_cast<uint32_t>(cachedSubpass.SlotBuffers.size());
+		cachedSubpass.SecondaryCount = std::min(slotCount, (drawCount + MinDrawsPerSecondary - 1) / MinDrawsPerSecondary);
+		cachedSubpass.Key = key;
+		cachedSubpass.IsRecorded = true;
+		m_Stats.RecordCount++;
+
+		VkCommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = subpass;
+		inheritanceInfo.framebuffer = framebuffer;
+
+		// Not one time submit: executed again by later frames
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		// Begin and end stay on this thread so failures can throw, only the draws are recorded on the workers
+		for (uint32_t slot = 0; slot < cachedSubpass.SecondaryCount; slot++)
+		{
+			if (vkBeginCommandBuffer(cachedSubpass.SlotBuffers[slot], &beginInfo) != VK_SUCCESS)
+				throw std::runtime_error("Failed to start recording a secondary Command buffer!");
+		}
+
+		const uint32_t secondaryCount = cachedSubpass.SecondaryCount;
+		const uint32_t drawsPerSecondary = secondaryCount > 0 ? (drawCount + secondaryCount - 1) / secondaryCount : 0;
+		ThreadPool::Get().ParallelFor(secondaryCount, [&](uint32_t slot)
+		{
+			const uint32_t first = slot * drawsPerSecondary;
+			const uint32_t last = std::min(drawCount, first + drawsPerSecondary);
+			record(cachedSubpass.SlotBuffers[slot], first, last);
+		});
+
+		for (uint32_t slot = 0; slot < secondaryCount; slot++)
+		{
+			if (vkEndCommandBuffer(cachedSubpass.SlotBuffers[slot]) != VK_SUCCESS)
+				throw std::runtime_error("Failed to stop recording a secondary Command buffer!");
+		}
+	}
+
+	m_Stats.SecondaryCount = cachedSubpass.SecondaryCount;
+	if (m_Stats.SecondaryCount > 0)
+		vkCmdExecuteCommands(frameCommands.Primary, m_Stats.SecondaryCount, cachedSubpass.SlotBuffers.data());
+}
+
+VkCommandBuffer CommandRecorder::EndFrame(uint32_t frame)
+{
+	if (vkEndCommandBuffer(m_Frames[frame].Primary) != VK_SUCCESS)
+		throw std::runtime_error("Failed to stop recording a Command buffer!");
+
+	return m_Frames[frame].Primary;
+}
+
+VkCommandPool CommandRecorder::CreatePool(VkCommandPoolCreateFlags flags) const
+{
+	// Buffers are never reset on their own, only through their pool
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = flags;
+	poolInfo.queueFamilyIndex = m_QueueFamilyIndex;
+
+	VkCommandPool pool = VK_NULL_HANDLE;
+	if (vkCreateCommandPool(m_Device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create command pool!");
+	}
+	return pool;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "Utils.h"
+
+struct CommandRecordStats
+{
+	uint64_t SubpassCount = 0;			// subpasses executed
+	uint64_t RecordCount = 0;			// of those, recorded again because their key changed
+	uint32_t SecondaryCount = 0;		// secondary buffers executed for the last subpass
+};
+
+// Frame command recording spread over the worker threads, with the draws cached between frames
+// Every frame in flight owns a command pool for its primary buffer, reset and re-recorded every frame (a handful of commands)
+// The draws of a subpass live in secondary buffers cached per frame in flight and cache slot (swapchain image): they are
+// executed again as long as the key they were recorded with matches, and re-recorded on the workers otherwise
+// Each recording slot (a secondary buffer) has its own pool, so no two threads ever touch the same pool
+class CommandRecorder
+{
+public:
+	// Draws a secondary buffer records at least (below that the recording overhead outweighs the split)
+	static const uint32_t MinDrawsPerSecondary = 64;
+
+	// cacheSlotCount: secondary buffer sets kept per frame in flight
+	void Init(VkDevice device, uint32_t queueFamilyIndex, uint32_t cacheSlotCount);
+	void Destroy();
+
+	// Reset the frame`s primary pool (its last submission must have finished) and begin its primary buffer
+	VkCommandBuffer BeginFrame(uint32_t frame);
+	// Execute the draws [0, drawCount) of a subpass into the primary buffer, in order
+	// The cached secondary buffers of (frame, cacheSlot) are reused when recorded with the same key, otherwise
+	// record(commandBuffer, first, last) records draws [first, last) into begun secondary buffers on the workers (must not throw)
+	// The key has to change whenever anything the draws reference changes: the draw list, buffers, descriptor sets, framebuffer
+	// The primary must be inside the subpass, begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	void RecordSubpass(uint32_t frame, uint32_t cacheSlot, uint64_t key, VkRenderPass renderPass, uint32_t subpass,
+		VkFramebuffer framebuffer, uint32_t drawCount, const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>& record);
+	// End the frame`s primary buffer, returns it ready to submit
+	VkCommandBuffer EndFrame(uint32_t frame);
+
+	// Counts since Init
+	CommandRecordStats GetStats() const { return m_Stats; }
+
+private:
+	// Secondary buffers of one subpass, kept until their key changes
+	struct CachedSubpass
+	{
+		std::vector<VkCommandPool> SlotPools;			// one per recording slot
+		std::vector<VkCommandBuffer> SlotBuffers;		// secondary, allocated from the slot`s pool
+		uint32_t SecondaryCount = 0;
+		uint64_t Key = 0;
+		bool IsRecorded = false;
+	};
+
+	struct FrameCommands
+	{
+		VkCommandPool PrimaryPool = VK_NULL_HANDLE;
+		VkCommandBuffer Primary = VK_NULL_HANDLE;
+		std::vector<CachedSubpass> CachedSubpasses;		// per cache slot
+	};
+
+	VkCommandPool CreatePool(VkCommandPoolCreateFlags flags) const;
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	uint32_t m_QueueFamilyIndex = 0;
+	FrameCommands m_Frames[MAX_FRAME_DRAWS];
+	CommandRecordStats m_Stats;
+};
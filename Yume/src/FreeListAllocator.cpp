@@ -0,0 +1,70 @@
+#include "FreeListAllocator.h"
+
+#include <iterator>
+
+FreeListAllocator::FreeListAllocator(uint64_t capacity)
+	: m_Capacity(capacity)
+{
+	if (capacity > 0)
+		m_FreeRanges[0] = capacity;
+}
+
+bool FreeListAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t* offset)
+{
+	if (size == 0)
+		return false;
+
+	for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+	{
+		const uint64_t rangeOffset = it->first;
+		const uint64_t rangeSize = it->second;
+
+		const uint64_t remainder = alignment > 1 ? rangeOffset % alignment : 0;
+		const uint64_t padding = remainder ? alignment - remainder : 0;
+		if (padding + size > rangeSize)
+			continue;
+
+		// Split the range: padding in front stays free, so does whatever is left behind the allocation
+		m_FreeRanges.erase(it);
+		if (padding > 0)
+			m_FreeRanges[rangeOffset] = padding;
+		if (padding + size < rangeSize)
+			m_FreeRanges[rangeOffset + padding + size] = rangeSize - padding - size;
+
+		*offset = rangeOffset + padding;
+		m_UsedSize += size;
+		return true;
+	}
+
+	return false;
+}
+
+void FreeListAllocator::Free(uint64_t offset, uint64_t size)
+{
+	if (size == 0)
+		return;
+
+	m_UsedSize -= size;
+
+	auto next = m_FreeRanges.lower_bound(offset);
+
+	// Merge with the range right behind
+	if (next != m_FreeRanges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = m_FreeRanges.erase(next);
+	}
+
+	// Merge with the range right in front
+	if (next != m_FreeRanges.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+
+	m_FreeRanges.emplace_hint(next, offset, size);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+
+// Offset-only allocator over a range of [0, capacity), free ranges are kept sorted by offset
+// and merged with their neighbours on free. Doesn`t own any memory, callers map offsets to their buffer/memory
+class FreeListAllocator
+{
+public:
+	FreeListAllocator() = default;
+	explicit FreeListAllocator(uint64_t capacity);
+
+	// First fit; alignment doesn`t have to be a power of two (vertex strides aren`t)
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t* offset);
+	void Free(uint64_t offset, uint64_t size);
+
+	uint64_t GetCapacity() const { return m_Capacity; }
+	uint64_t GetUsedSize() const { return m_UsedSize; }
+	size_t GetFreeRangeCount() const { return m_FreeRanges.size(); }
+	bool IsEmpty() const { return m_UsedSize == 0; }
+
+private:
+	std::map<uint64_t, uint64_t> m_FreeRanges;		// offset -> size
+	uint64_t m_Capacity = 0;
+	uint64_t m_UsedSize = 0;
+};
@@ -0,0 +1,85 @@
+#include "GeometryArena.h"
+
+#include <stdexcept>
+
+void GeometryArena::Init(VkDevice device, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity,
+	const std::vector<uint32_t>& queueFamilies)
+{
+	m_Device = device;
+
+	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the gpu and only accessible by it and not CPU (host)
+	CreateBuffer(m_Device, vertexCapacity,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_VertexBuffer, &m_VertexBufferAllocation, queueFamilies);
+
+	CreateBuffer(m_Device, indexCapacity,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_IndexBuffer, &m_IndexBufferAllocation, queueFamilies);
+
+	m_VertexAllocator = FreeListAllocator(vertexCapacity);
+	m_IndexAllocator = FreeListAllocator(indexCapacity);
+}
+
+void GeometryArena::Destroy()
+{
+	DestroyBuffer(m_Device, m_VertexBuffer, m_VertexBufferAllocation);
+	DestroyBuffer(m_Device, m_IndexBuffer, m_IndexBufferAllocation);
+
+	m_VertexBuffer = VK_NULL_HANDLE;
+	m_IndexBuffer = VK_NULL_HANDLE;
+}
+
+GeometryAllocation GeometryArena::AllocateVertices(VkDeviceSize size, VkDeviceSize stride)
+{
+	GeometryAllocation allocation;
+	allocation.Size = size;
+
+	uint64_t offset;
+	if (!m_VertexAllocator.Allocate(size, stride, &offset))
+	{
+		throw std::runtime_error("Geometry arena is out of vertex space!");
+	}
+	allocation.Offset = offset;
+
+	return allocation;
+}
+
+GeometryAllocation GeometryArena::AllocateIndices(VkDeviceSize size)
+{
+	GeometryAllocation allocation;
+	allocation.Size = size;
+
+	uint64_t offset;
+	if (!m_IndexAllocator.Allocate(size, 4, &offset))
+	{
+		throw std::runtime_error("Geometry arena is out of index space!");
+	}
+	allocation.Offset = offset;
+
+	return allocation;
+}
+
+void GeometryArena::FreeVertices(const GeometryAllocation& allocation)
+{
+	m_VertexAllocator.Free(allocation.Offset, allocation.Size);
+}
+
+void GeometryArena::FreeIndices(const GeometryAllocation& allocation)
+{
+	m_IndexAllocator.Free(allocation.Offset, allocation.Size);
+}
+
+void GeometryArena::Bind(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+{
+	VkBuffer vertexBuffers[] = { m_VertexBuffer };	// Buffer to bind
+	VkDeviceSize offsets[] = { 0 };					// offsets into buffers being bound
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+	BindIndexBuffer(commandBuffer, indexType);
+}
+
+void GeometryArena::BindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+{
+	// Index ranges are 4 byte aligned, so firstIndex works for both index sizes
+	vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer, 0, indexType);
+}
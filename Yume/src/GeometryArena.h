@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "FreeListAllocator.h"
+#include "Utils.h"
+
+// Range of one of the arena buffers
+struct GeometryAllocation
+{
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+};
+
+// Scene wide vertex and index buffers, meshes get sub-ranges of them so a frame binds them once
+// and draws with firstIndex/vertexOffset
+class GeometryArena
+{
+public:
+	// queueFamilies: families touching the buffers (uploads and rendering), shared concurrently if more than one
+	void Init(VkDevice device, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity,
+		const std::vector<uint32_t>& queueFamilies);
+	void Destroy();
+
+	// Vertex ranges are aligned to the vertex stride so they can be addressed with vertexOffset,
+	// index ranges to 4 bytes (firstIndex is counted in indices)
+	GeometryAllocation AllocateVertices(VkDeviceSize size, VkDeviceSize stride);
+	GeometryAllocation AllocateIndices(VkDeviceSize size);
+	void FreeVertices(const GeometryAllocation& allocation);
+	void FreeIndices(const GeometryAllocation& allocation);
+
+	// Bind both buffers, once per command buffer
+	void Bind(VkCommandBuffer commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
+	// Rebind the index buffer for meshes with another index type (16/32 bit)
+	void BindIndexBuffer(VkCommandBuffer commandBuffer, VkIndexType indexType) const;
+
+	VkBuffer GetVertexBuffer() const { return m_VertexBuffer; }
+	VkBuffer GetIndexBuffer() const { return m_IndexBuffer; }
+	VkDeviceSize GetVertexBytesUsed() const { return m_VertexAllocator.GetUsedSize(); }
+	VkDeviceSize GetIndexBytesUsed() const { return m_IndexAllocator.GetUsedSize(); }
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+
+	VkBuffer m_VertexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_VertexBufferAllocation;
+	FreeListAllocator m_VertexAllocator;
+
+	VkBuffer m_IndexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_IndexBufferAllocation;
+	FreeListAllocator m_IndexAllocator;
+};
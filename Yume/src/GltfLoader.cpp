@@ -0,0 +1,1031 @@
+#include "GltfLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "MappedFile.h"
+
+static const uint32_t s_GlbMagic = 0x46546C67;			// "glTF"
+static const uint32_t s_GlbJsonChunk = 0x4E4F534A;		// "JSON"
+static const uint32_t s_GlbBinaryChunk = 0x004E4942;	// "BIN\0"
+// Texture names of embedded images: <file>#image<N>
+static const char* const s_EmbeddedImageTag = "#image";
+// Deepest JSON nesting and node hierarchy accepted, guards the recursion against hostile files
+static const uint32_t s_MaxDepth = 256;
+
+enum GltfComponentType : uint32_t
+{
+	Byte = 5120,
+	UnsignedByte = 5121,
+	Short = 5122,
+	UnsignedShort = 5123,
+	UnsignedInt = 5125,
+	Float = 5126
+};
+
+// Minimal JSON document, enough for glTF (numbers as double, no duplicate key checks)
+struct JsonValue
+{
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+	Type ValueType = Type::Null;
+	bool Bool = false;
+	double Number = 0.0;
+	std::string String;
+	std::vector<JsonValue> Elements;
+	std::vector<std::pair<std::string, JsonValue>> Members;
+
+	// Missing members/elements read as null
+	const JsonValue& operator[](const char* key) const
+	{
+		for (const auto& member : Members)
+		{
+			if (member.first == key)
+				return member.second;
+		}
+		return GetNull();
+	}
+	const JsonValue& operator[](size_t index) const { return index < Elements.size() ? Elements[index] : GetNull(); }
+
+	bool IsNull() const { return ValueType == Type::Null; }
+	size_t Size() const { return Elements.size(); }
+	double GetNumber(double fallback) const { return ValueType == Type::Number ? Number : fallback; }
+	// Non-negative integer, fallback otherwise (glTF indices and counts)
+	uint32_t GetIndex(uint32_t fallback = UINT32_MAX) const
+	{
+		return ValueType == Type::Number && Number >= 0.0 && Number < 4294967295.0 ? static_cast<uint32_t>(Number) : fallback;
+	}
+
+	static const JsonValue& GetNull()
+	{
+		static const JsonValue s_Null;
+		return s_Null;
+	}
+};
+
+class JsonParser
+{
+public:
+	JsonParser(const char* begin, const char* end) : m_Position(begin), m_End(end) {}
+
+	JsonValue Parse()
+	{
+		JsonValue value = ParseValue(0);
+		SkipWhitespace();
+		if (m_Position != m_End)
+			Fail();
+		return value;
+	}
+
+private:
+	[[noreturn]] void Fail() const
+	{
+		throw std::runtime_error("Malformed glTF JSON");
+	}
+
+	void SkipWhitespace()
+	{
+		while (m_Position < m_End && (*m_Position == ' ' || *m_Position == '\t' || *m_Position == '\n' || *m_Position == '\r'))
+			m_Position++;
+	}
+
+	bool Consume(const char* literal)
+	{
+		const size_t length = strlen(literal);
+		if (size_t(m_End - m_Position) < length || memcmp(m_Position, literal, length) != 0)
+			return false;
+		m_Position += length;
+		return true;
+	}
+
+	JsonValue ParseValue(uint32_t depth)
+	{
+		if (depth > s_MaxDepth)
+			Fail();
+
+		SkipWhitespace();
+		if (m_Position == m_End)
+			Fail();
+
+		JsonValue value;
+		switch (*m_Position)
+		{
+		case '{':
+			value.ValueType = JsonValue::Type::Object;
+			m_Position++;
+			SkipWhitespace();
+			if (m_Position < m_End && *m_Position == '}')
+			{
+				m_Position++;
+				break;
+			}
+			while (true)
+			{
+				SkipWhitespace();
+				std::string key = ParseString();
+				SkipWhitespace();
+				if (m_Position == m_End || *m_Position++ != ':')
+					Fail();
+				value.Members.emplace_back(std::move(key), ParseValue(depth + 1));
+
+				SkipWhitespace();
+				if (m_Position == m_End)
+					Fail();
+				if (*m_Position == ',')
+				{
+					m_Position++;
+					continue;
+				}
+				if (*m_Position++ != '}')
+					Fail();
+				break;
+			}
+			break;
+
+		case '[':
+			value.ValueType = JsonValue::Type::Array;
+			m_Position++;
+			SkipWhitespace();
+			if (m_Position < m_End && *m_Position == ']')
+			{
+				m_Position++;
+				break;
+			}
+			while (true)
+			{
+				value.Elements.push_back(ParseValue(depth + 1));
+
+				SkipWhitespace();
+				if (m_Position == m_End)
+					Fail();
+				if (*m_Position == ',')
+				{
+					m_Position++;
+					continue;
+				}
+				if (*m_Position++ != ']')
+					Fail();
+				break;
+			}
+			break;
+
+		case '"':
+			value.ValueType = JsonValue::Type::String;
+			value.String = ParseString();
+			break;
+
+		case 't':
+		case 'f':
+			value.ValueType = JsonValue::Type::Bool;
+			value.Bool = *m_Position == 't';
+			if (!Consume(value.Bool ? "true" : "false"))
+				Fail();
+			break;
+
+		case 'n':
+			if (!Consume("null"))
+				Fail();
+			break;
+
+		default:
+			value.ValueType = JsonValue::Type::Number;
+			value.Number = ParseNumber();
+			break;
+		}
+		return value;
+	}
+
+	double ParseNumber()
+	{
+		// strtod needs a terminated string, the document is a mapped file
+		char token[64];
+		size_t length = 0;
+		while (m_Position + length < m_End && length < sizeof(token) - 1
+			&& (std::isdigit(static_cast<unsigned char>(m_Position[length])) || strchr("+-.eE", m_Position[length])))
+		{
+			token[length] = m_Position[length];
+			length++;
+		}
+		token[length] = '\0';
+
+		char* tokenEnd = nullptr;
+		const double number = std::strtod(token, &tokenEnd);
+		if (tokenEnd == token)
+			Fail();
+
+		m_Position += tokenEnd - token;
+		return number;
+	}
+
+	std::string ParseString()
+	{
+		if (m_Position == m_End || *m_Position != '"')
+			Fail();
+		m_Position++;
+
+		std::string result;
+		while (true)
+		{
+			if (m_Position == m_End)
+				Fail();
+
+			const char c = *m_Position++;
+			if (c == '"')
+				return result;
+			if (c != '\\')
+			{
+				result += c;
+				continue;
+			}
+
+			if (m_Position == m_End)
+				Fail();
+			const char escape = *m_Position++;
+			switch (escape)
+			{
+			case '"': result += '"'; break;
+			case '\\': result += '\\'; break;
+			case '/': result += '/'; break;
+			case 'b': result += '\b'; break;
+			case 'f': result += '\f'; break;
+			case 'n': result += '\n'; break;
+			case 'r': result += '\r'; break;
+			case 't': result += '\t'; break;
+			case 'u':
+			{
+				uint32_t codePoint = ParseHex4();
+				// Surrogate pair
+				if (codePoint >= 0xD800 && codePoint < 0xDC00 && Consume("\\u"))
+				{
+					const uint32_t low = ParseHex4();
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				AppendUtf8(result, codePoint);
+				break;
+			}
+			default:
+				Fail();
+			}
+		}
+	}
+
+	uint32_t ParseHex4()
+	{
+		if (m_End - m_Position < 4)
+			Fail();
+
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			const char c = *m_Position++;
+			value <<= 4;
+			if (c >= '0' && c <= '9')
+				value |= c - '0';
+			else if (c >= 'a' && c <= 'f')
+				value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F')
+				value |= c - 'A' + 10;
+			else
+				Fail();
+		}
+		return value;
+	}
+
+	static void AppendUtf8(std::string& result, uint32_t codePoint)
+	{
+		if (codePoint < 0x80)
+		{
+			result += static_cast<char>(codePoint);
+		}
+		else if (codePoint < 0x800)
+		{
+			result += static_cast<char>(0xC0 | (codePoint >> 6));
+			result += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000)
+		{
+			result += static_cast<char>(0xE0 | (codePoint >> 12));
+			result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			result += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+		else
+		{
+			result += static_cast<char>(0xF0 | (codePoint >> 18));
+			result += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+			result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+			result += static_cast<char>(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+private:
+	const char* m_Position;
+	const char* m_End;
+};
+
+// Bytes of a buffer: the GLB binary chunk, a mapped .bin file or a decoded data URI
+struct GltfBuffer
+{
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+};
+
+// Elements of an accessor inside its buffer
+struct GltfAccessor
+{
+	const uint8_t* Data = nullptr;
+	size_t Count = 0;
+	size_t Stride = 0;
+	uint32_t ComponentType = Float;
+	uint32_t ComponentCount = 1;
+	bool IsNormalized = false;
+};
+
+// Everything an accessor read needs, kept alive for the whole load
+struct GltfDocument
+{
+	std::string Path;
+	std::string Directory;		// with trailing slash
+	JsonValue Root;
+	std::vector<GltfBuffer> Buffers;
+	std::vector<std::unique_ptr<MappedFile>> BufferFiles;
+	std::vector<std::vector<uint8_t>> DecodedBuffers;
+};
+
+static uint32_t GetComponentSize(uint32_t componentType)
+{
+	switch (componentType)
+	{
+	case Byte:
+	case UnsignedByte:
+		return 1;
+	case Short:
+	case UnsignedShort:
+		return 2;
+	case UnsignedInt:
+	case Float:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static uint32_t GetComponentCount(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+static std::vector<uint8_t> DecodeBase64(const std::string& text)
+{
+	auto decodeCharacter = [](char c) -> int
+	{
+		if (c >= 'A' && c <= 'Z') return c - 'A';
+		if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+		if (c >= '0' && c <= '9') return c - '0' + 52;
+		if (c == '+' || c == '-') return 62;
+		if (c == '/' || c == '_') return 63;
+		return -1;
+	};
+
+	std::vector<uint8_t> bytes;
+	bytes.reserve(text.size() * 3 / 4);
+	uint32_t bits = 0;
+	int bitCount = 0;
+	for (char c : text)
+	{
+		const int value = decodeCharacter(c);
+		if (value < 0)
+			continue;
+
+		bits = (bits << 6) | uint32_t(value);
+		bitCount += 6;
+		if (bitCount >= 8)
+		{
+			bitCount -= 8;
+			bytes.push_back(static_cast<uint8_t>(bits >> bitCount));
+		}
+	}
+	return bytes;
+}
+
+// data:[<mime>][;base64],<payload>
+static bool IsDataUri(const std::string& uri)
+{
+	return uri.compare(0, 5, "data:") == 0;
+}
+
+static std::vector<uint8_t> DecodeDataUri(const std::string& uri)
+{
+	const size_t comma = uri.find(',');
+	if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+	{
+		throw std::runtime_error("Unsupported data URI in glTF file");
+	}
+
+	return DecodeBase64(uri.substr(comma + 1));
+}
+
+// Relative URIs may escape spaces and other characters
+static std::string DecodeUriPath(const std::string& uri)
+{
+	std::string path;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1]))
+			&& std::isxdigit(static_cast<unsigned char>(uri[i + 2])))
+		{
+			path += static_cast<char>(std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+			i += 2;
+		}
+		else
+		{
+			path += uri[i];
+		}
+	}
+	return path;
+}
+
+static GltfAccessor GetAccessor(const GltfDocument& document, uint32_t accessorIndex)
+{
+	const JsonValue& accessor = document.Root["accessors"][accessorIndex];
+	if (accessor.IsNull())
+	{
+		throw std::runtime_error("Invalid glTF accessor index: " + document.Path);
+	}
+	if (!accessor["sparse"].IsNull())
+	{
+		throw std::runtime_error("Sparse glTF accessors are not supported: " + document.Path);
+	}
+
+	GltfAccessor view;
+	view.Count = accessor["count"].GetIndex(0);
+	view.ComponentType = accessor["componentType"].GetIndex(0);
+	view.ComponentCount = GetComponentCount(accessor["type"].String);
+	view.IsNormalized = accessor["normalized"].Bool;
+
+	const uint32_t elementSize = GetComponentSize(view.ComponentType) * view.ComponentCount;
+	if (elementSize == 0)
+	{
+		throw std::runtime_error("Invalid glTF accessor type: " + document.Path);
+	}
+
+	// Accessors without a buffer view are all zeros, nothing we can draw
+	const JsonValue& bufferView = document.Root["bufferViews"][accessor["bufferView"].GetIndex()];
+	const GltfBuffer* buffer = bufferView.IsNull() ? nullptr
+		: bufferView["buffer"].GetIndex() < document.Buffers.size() ? &document.Buffers[bufferView["buffer"].GetIndex()] : nullptr;
+	if (!buffer)
+	{
+		throw std::runtime_error("glTF accessor without buffer data: " + document.Path);
+	}
+
+	const size_t viewOffset = bufferView["byteOffset"].GetIndex(0);
+	const size_t viewLength = bufferView["byteLength"].GetIndex(0);
+	const size_t accessorOffset = accessor["byteOffset"].GetIndex(0);
+	view.Stride = bufferView["byteStride"].GetIndex(0);
+	if (view.Stride == 0)
+		view.Stride = elementSize;
+
+	// Last element must end inside the view, the view inside the buffer
+	const size_t accessorEnd = view.Count == 0 ? accessorOffset : accessorOffset + (view.Count - 1) * view.Stride + elementSize;
+	if (viewOffset + viewLength > buffer->Size || accessorEnd > viewLength || view.Stride < elementSize)
+	{
+		throw std::runtime_error("glTF accessor out of bounds: " + document.Path);
+	}
+
+	view.Data = buffer->Data + viewOffset + accessorOffset;
+	return view;
+}
+
+static float ReadComponent(const uint8_t* source, uint32_t componentType, bool isNormalized)
+{
+	switch (componentType)
+	{
+	case Float:
+	{
+		float value;
+		memcpy(&value, source, sizeof(value));
+		return value;
+	}
+	case UnsignedByte:
+		return isNormalized ? *source / 255.0f : float(*source);
+	case Byte:
+		return isNormalized ? std::max(int8_t(*source) / 127.0f, -1.0f) : float(int8_t(*source));
+	case UnsignedShort:
+	{
+		uint16_t value;
+		memcpy(&value, source, sizeof(value));
+		return isNormalized ? value / 65535.0f : float(value);
+	}
+	case Short:
+	{
+		int16_t value;
+		memcpy(&value, source, sizeof(value));
+		return isNormalized ? std::max(value / 32767.0f, -1.0f) : float(value);
+	}
+	case UnsignedInt:
+	{
+		uint32_t value;
+		memcpy(&value, source, sizeof(value));
+		return float(value);
+	}
+	default:
+		return 0.0f;
+	}
+}
+
+// N floats per element, one memcpy when the accessor is tightly packed floats
+template<int N>
+static void ReadFloats(const GltfAccessor& accessor, std::vector<glm::vec<N, float, glm::defaultp>>& values)
+{
+	values.resize(accessor.Count);
+	if (accessor.ComponentType == Float && accessor.ComponentCount == N && accessor.Stride == N * sizeof(float))
+	{
+		memcpy(values.data(), accessor.Data, accessor.Count * N * sizeof(float));
+		return;
+	}
+
+	const uint32_t componentSize = GetComponentSize(accessor.ComponentType);
+	const uint32_t componentCount = std::min<uint32_t>(accessor.ComponentCount, N);
+	for (size_t i = 0; i < accessor.Count; i++)
+	{
+		const uint8_t* element = accessor.Data + i * accessor.Stride;
+		for (uint32_t c = 0; c < componentCount; c++)
+		{
+			values[i][c] = ReadComponent(element + c * componentSize, accessor.ComponentType, accessor.IsNormalized);
+		}
+	}
+}
+
+static void ReadIndices(const GltfAccessor& accessor, std::vector<uint32_t>& indices)
+{
+	indices.resize(accessor.Count);
+	if (accessor.ComponentType == UnsignedInt && accessor.Stride == sizeof(uint32_t))
+	{
+		memcpy(indices.data(), accessor.Data, accessor.Count * sizeof(uint32_t));
+		return;
+	}
+
+	for (size_t i = 0; i < accessor.Count; i++)
+	{
+		const uint8_t* element = accessor.Data + i * accessor.Stride;
+		switch (accessor.ComponentType)
+		{
+		case UnsignedByte:
+			indices[i] = *element;
+			break;
+		case UnsignedShort:
+		{
+			uint16_t value;
+			memcpy(&value, element, sizeof(value));
+			indices[i] = value;
+			break;
+		}
+		case UnsignedInt:
+			memcpy(&indices[i], element, sizeof(uint32_t));
+			break;
+		default:
+			throw std::runtime_error("Invalid glTF index type");
+		}
+	}
+}
+
+// Triangle list from a triangles/strip/fan primitive, false for points and lines
+static bool Triangulate(uint32_t mode, const std::vector<uint32_t>& source, std::vector<uint32_t>& triangles)
+{
+	triangles.clear();
+	switch (mode)
+	{
+	case 4:		// TRIANGLES
+		triangles.assign(source.begin(), source.begin() + source.size() / 3 * 3);
+		return true;
+	case 5:		// TRIANGLE_STRIP, every other triangle is flipped back to the strip`s winding
+		for (size_t i = 2; i < source.size(); i++)
+		{
+			const bool isOdd = (i & 1) == 1;
+			triangles.insert(triangles.end(), { source[i - 2], source[isOdd ? i : i - 1], source[isOdd ? i - 1 : i] });
+		}
+		return true;
+	case 6:		// TRIANGLE_FAN
+		for (size_t i = 2; i < source.size(); i++)
+		{
+			triangles.insert(triangles.end(), { source[0], source[i - 1], source[i] });
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+static glm::mat4 GetLocalTransform(const JsonValue& node)
+{
+	const JsonValue& matrix = node["matrix"];
+	if (matrix.Size() == 16)
+	{
+		// Column major, same as glm
+		glm::mat4 transform;
+		for (int i = 0; i < 16; i++)
+		{
+			transform[i / 4][i % 4] = static_cast<float>(matrix[i].GetNumber(0.0));
+		}
+		return transform;
+	}
+
+	const JsonValue& translation = node["translation"];
+	const JsonValue& rotation = node["rotation"];
+	const JsonValue& scale = node["scale"];
+
+	glm::mat4 transform(1.0f);
+	if (translation.Size() == 3)
+	{
+		transform = glm::translate(transform, glm::vec3(translation[size_t(0)].GetNumber(0.0), translation[1].GetNumber(0.0),
+			translation[2].GetNumber(0.0)));
+	}
+	if (rotation.Size() == 4)
+	{
+		// glTF stores x, y, z, w
+		const glm::quat orientation(static_cast<float>(rotation[3].GetNumber(1.0)), static_cast<float>(rotation[size_t(0)].GetNumber(0.0)),
+			static_cast<float>(rotation[1].GetNumber(0.0)), static_cast<float>(rotation[2].GetNumber(0.0)));
+		transform *= glm::mat4_cast(orientation);
+	}
+	if (scale.Size() == 3)
+	{
+		transform = glm::scale(transform, glm::vec3(scale[size_t(0)].GetNumber(1.0), scale[1].GetNumber(1.0), scale[2].GetNumber(1.0)));
+	}
+	return transform;
+}
+
+// Texture name of an image stored inside the file, relative to the model directory (see LoadEmbeddedImage)
+static std::string GetEmbeddedImageName(const GltfDocument& document, uint32_t imageIndex)
+{
+	const size_t lastSlashIndex = document.Path.find_last_of("/\\");
+	const std::string fileName = lastSlashIndex == std::string::npos ? document.Path : document.Path.substr(lastSlashIndex + 1);
+	return fileName + s_EmbeddedImageTag + std::to_string(imageIndex);
+}
+
+// Texture file of every material`s base color, relative to the model directory
+static std::vector<std::string> LoadTextureNames(const GltfDocument& document)
+{
+	const JsonValue& root = document.Root;
+
+	std::vector<std::string> imageNames(root["images"].Size());
+	for (uint32_t i = 0; i < imageNames.size(); i++)
+	{
+		const JsonValue& image = root["images"][i];
+		const std::string& uri = image["uri"].String;
+		if (!uri.empty() && !IsDataUri(uri))
+		{
+			imageNames[i] = DecodeUriPath(uri);
+		}
+		else
+		{
+			// Data URIs and buffer views: decoded straight from the model file by the texture cache
+			imageNames[i] = GetEmbeddedImageName(document, i);
+		}
+	}
+
+	std::vector<std::string> textureNames(root["materials"].Size());
+	for (size_t i = 0; i < textureNames.size(); i++)
+	{
+		const uint32_t textureIndex = root["materials"][i]["pbrMetallicRoughness"]["baseColorTexture"]["index"].GetIndex();
+		const uint32_t imageIndex = root["textures"][textureIndex]["source"].GetIndex();
+		if (imageIndex < imageNames.size())
+			textureNames[i] = imageNames[imageIndex];
+	}
+	return textureNames;
+}
+
+static void LoadBuffers(GltfDocument& document, const uint8_t* binaryChunk, size_t binaryChunkSize)
+{
+	const JsonValue& buffers = document.Root["buffers"];
+	document.Buffers.resize(buffers.Size());
+	for (size_t i = 0; i < buffers.Size(); i++)
+	{
+		const std::string& uri = buffers[i]["uri"].String;
+		GltfBuffer& buffer = document.Buffers[i];
+		if (uri.empty())
+		{
+			// Only the first buffer of a GLB may live in its binary chunk
+			if (i != 0 || !binaryChunk)
+			{
+				throw std::runtime_error("glTF buffer without data: " + document.Path);
+			}
+			buffer.Data = binaryChunk;
+			buffer.Size = binaryChunkSize;
+		}
+		else if (IsDataUri(uri))
+		{
+			document.DecodedBuffers.push_back(DecodeDataUri(uri));
+			buffer.Data = document.DecodedBuffers.back().data();
+			buffer.Size = document.DecodedBuffers.back().size();
+		}
+		else
+		{
+			// Mapped, accessors read straight from the page cache
+			auto file = std::make_unique<MappedFile>();
+			if (!file->Open(document.Directory + DecodeUriPath(uri)))
+			{
+				throw std::runtime_error("Failed to open glTF buffer: " + document.Directory + uri);
+			}
+			buffer.Data = file->GetData();
+			buffer.Size = file->GetSize();
+			document.BufferFiles.push_back(std::move(file));
+		}
+
+		// The declared length is what accessors are checked against
+		buffer.Size = std::min<size_t>(buffer.Size, buffers[i]["byteLength"].GetIndex(0));
+	}
+}
+
+// Append the primitives of a node and its children with their world transforms
+static void LoadNode(const GltfDocument& document, uint32_t nodeIndex, const glm::mat4& parentTransform, uint32_t depth,
+	uint32_t& defaultMaterial, SourceModel& model)
+{
+	const JsonValue& node = document.Root["nodes"][nodeIndex];
+	if (node.IsNull() || depth > s_MaxDepth)
+	{
+		throw std::runtime_error("Invalid glTF node hierarchy: " + document.Path);
+	}
+
+	const glm::mat4 transform = parentTransform * GetLocalTransform(node);
+	const glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+	const bool isIdentity = transform == glm::mat4(1.0f);
+	// Mirroring transforms turn the winding around
+	const bool isMirrored = glm::determinant(glm::mat3(transform)) < 0.0f;
+
+	const uint32_t meshIndex = node["mesh"].GetIndex();
+	const JsonValue& mesh = document.Root["meshes"][meshIndex];
+	const JsonValue& primitives = mesh["primitives"];
+	for (size_t p = 0; p < primitives.Size(); p++)
+	{
+		const JsonValue& primitive = primitives[p];
+		const JsonValue& attributes = primitive["attributes"];
+		const uint32_t positionAccessor = attributes["POSITION"].GetIndex();
+		if (positionAccessor == UINT32_MAX)
+			continue;
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texCoords;
+		ReadFloats(GetAccessor(document, positionAccessor), positions);
+		if (attributes["NORMAL"].GetIndex() != UINT32_MAX)
+			ReadFloats(GetAccessor(document, attributes["NORMAL"].GetIndex()), normals);
+		if (attributes["TEXCOORD_0"].GetIndex() != UINT32_MAX)
+			ReadFloats(GetAccessor(document, attributes["TEXCOORD_0"].GetIndex()), texCoords);
+
+		std::vector<uint32_t> sourceIndices;
+		if (primitive["indices"].GetIndex() != UINT32_MAX)
+		{
+			ReadIndices(GetAccessor(document, primitive["indices"].GetIndex()), sourceIndices);
+		}
+		else
+		{
+			sourceIndices.resize(positions.size());
+			for (uint32_t i = 0; i < sourceIndices.size(); i++)
+				sourceIndices[i] = i;
+		}
+
+		SourceMesh sourceMesh;
+		if (!Triangulate(primitive["mode"].GetIndex(4), sourceIndices, sourceMesh.Indices) || sourceMesh.Indices.empty())
+			continue;
+
+		for (uint32_t index : sourceMesh.Indices)
+		{
+			if (index >= positions.size())
+			{
+				throw std::runtime_error("glTF index out of bounds: " + document.Path);
+			}
+		}
+		if (isMirrored)
+		{
+			for (size_t i = 0; i < sourceMesh.Indices.size(); i += 3)
+				std::swap(sourceMesh.Indices[i + 1], sourceMesh.Indices[i + 2]);
+		}
+
+		// glTF texture coordinates already start at the top left, like Vulkan`s
+		sourceMesh.Vertices.resize(positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+		{
+			Vertex& vertex = sourceMesh.Vertices[i];
+			vertex.Position = isIdentity ? positions[i] : glm::vec3(transform * glm::vec4(positions[i], 1.0f));
+			vertex.Color = { 1.0f, 1.0f, 1.0f };
+			vertex.TextureCoords = i < texCoords.size() ? texCoords[i] : glm::vec2(0.0f);
+			vertex.NormalCoords = glm::vec3(0.0f);
+			if (i < normals.size())
+			{
+				const glm::vec3 normal = isIdentity ? normals[i] : normalTransform * normals[i];
+				const float length = glm::length(normal);
+				vertex.NormalCoords = length > 0.0f ? normal / length : normal;
+			}
+		}
+
+		// Primitives without a material share a default one without texture
+		sourceMesh.MaterialIndex = primitive["material"].GetIndex();
+		if (sourceMesh.MaterialIndex >= model.TextureNames.size())
+		{
+			if (defaultMaterial == UINT32_MAX)
+			{
+				defaultMaterial = static_cast<uint32_t>(model.TextureNames.size());
+				model.TextureNames.emplace_back();
+			}
+			sourceMesh.MaterialIndex = defaultMaterial;
+		}
+
+		sourceMesh.Name = (mesh["name"].String.empty() ? "mesh" + std::to_string(meshIndex) : mesh["name"].String)
+			+ "." + std::to_string(p);
+		model.Meshes.push_back(std::move(sourceMesh));
+	}
+
+	const JsonValue& children = node["children"];
+	for (size_t i = 0; i < children.Size(); i++)
+	{
+		LoadNode(document, children[i].GetIndex(), transform, depth + 1, defaultMaterial, model);
+	}
+}
+
+// Map a .gltf/.glb file, parse its JSON and resolve its buffers (file stays mapped for the document`s lifetime)
+static void OpenDocument(const std::string& filepath, MappedFile& file, GltfDocument& document)
+{
+	if (!file.Open(filepath))
+	{
+		throw std::runtime_error("Failed to open model: " + filepath);
+	}
+
+	document.Path = filepath;
+	const size_t lastSlashIndex = filepath.find_last_of("/\\");
+	if (lastSlashIndex != std::string::npos)
+		document.Directory = filepath.substr(0, lastSlashIndex + 1);
+
+	// GLB: 12 byte header, then chunks (length, type, data), JSON first
+	const uint8_t* data = file.GetData();
+	const size_t size = file.GetSize();
+	const char* jsonBegin = reinterpret_cast<const char*>(data);
+	const char* jsonEnd = jsonBegin + size;
+	const uint8_t* binaryChunk = nullptr;
+	size_t binaryChunkSize = 0;
+
+	uint32_t magic = 0;
+	if (size >= sizeof(magic))
+		memcpy(&magic, data, sizeof(magic));
+	if (magic == s_GlbMagic)
+	{
+		uint32_t header[3];
+		if (size < sizeof(header))
+		{
+			throw std::runtime_error("Truncated GLB file: " + filepath);
+		}
+		memcpy(header, data, sizeof(header));
+		if (header[1] != 2 || header[2] > size)
+		{
+			throw std::runtime_error("Unsupported GLB file: " + filepath);
+		}
+
+		jsonBegin = jsonEnd = nullptr;
+		for (size_t offset = sizeof(header); offset + 8 <= header[2];)
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, data + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			if (chunk[0] > header[2] - offset)
+			{
+				throw std::runtime_error("Truncated GLB chunk: " + filepath);
+			}
+
+			if (chunk[1] == s_GlbJsonChunk && !jsonBegin)
+			{
+				jsonBegin = reinterpret_cast<const char*>(data + offset);
+				jsonEnd = jsonBegin + chunk[0];
+			}
+			else if (chunk[1] == s_GlbBinaryChunk && !binaryChunk)
+			{
+				binaryChunk = data + offset;
+				binaryChunkSize = chunk[0];
+			}
+			offset += (chunk[0] + 3) & ~3u;
+		}
+
+		if (!jsonBegin)
+		{
+			throw std::runtime_error("GLB file without JSON chunk: " + filepath);
+		}
+	}
+
+	document.Root = JsonParser(jsonBegin, jsonEnd).Parse();
+	if (document.Root["asset"]["version"].String.compare(0, 1, "2") != 0)
+	{
+		throw std::runtime_error("Only glTF 2.0 is supported: " + filepath);
+	}
+
+	LoadBuffers(document, binaryChunk, binaryChunkSize);
+}
+
+bool GltfLoader::IsGltfFile(const std::string& filepath)
+{
+	const size_t extensionIndex = filepath.rfind('.');
+	if (extensionIndex == std::string::npos)
+		return false;
+
+	std::string extension = filepath.substr(extensionIndex);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".gltf" || extension == ".glb";
+}
+
+SourceModel GltfLoader::Load(const std::string& filepath)
+{
+	MappedFile file;
+	GltfDocument document;
+	OpenDocument(filepath, file, document);
+
+	SourceModel model;
+	model.TextureNames = LoadTextureNames(document);
+
+	// Nodes of the default scene; without scenes every root node
+	const JsonValue& root = document.Root;
+	std::vector<uint32_t> rootNodes;
+	const JsonValue& scene = root["scenes"][root["scene"].GetIndex(0)];
+	if (!scene.IsNull())
+	{
+		for (size_t i = 0; i < scene["nodes"].Size(); i++)
+			rootNodes.push_back(scene["nodes"][i].GetIndex());
+	}
+	else
+	{
+		std::vector<bool> isChild(root["nodes"].Size(), false);
+		for (size_t i = 0; i < root["nodes"].Size(); i++)
+		{
+			const JsonValue& children = root["nodes"][i]["children"];
+			for (size_t c = 0; c < children.Size(); c++)
+			{
+				if (children[c].GetIndex() < isChild.size())
+					isChild[children[c].GetIndex()] = true;
+			}
+		}
+		for (uint32_t i = 0; i < isChild.size(); i++)
+		{
+			if (!isChild[i])
+				rootNodes.push_back(i);
+		}
+	}
+
+	uint32_t defaultMaterial = UINT32_MAX;
+	for (uint32_t nodeIndex : rootNodes)
+	{
+		LoadNode(document, nodeIndex, glm::mat4(1.0f), 0, defaultMaterial, model);
+	}
+
+	return model;
+}
+
+bool GltfLoader::ParseEmbeddedImagePath(const std::string& path, std::string& filepath, uint32_t& imageIndex)
+{
+	const size_t tagIndex = path.rfind(s_EmbeddedImageTag);
+	if (tagIndex == std::string::npos)
+		return false;
+
+	const std::string digits = path.substr(tagIndex + strlen(s_EmbeddedImageTag));
+	if (digits.empty() || digits.size() > 9 || !std::all_of(digits.begin(), digits.end(), [](unsigned char c) { return std::isdigit(c) != 0; }))
+		return false;
+
+	filepath = path.substr(0, tagIndex);
+	imageIndex = static_cast<uint32_t>(std::strtoul(digits.c_str(), nullptr, 10));
+	return IsGltfFile(filepath);
+}
+
+std::vector<uint8_t> GltfLoader::LoadEmbeddedImage(const std::string& filepath, uint32_t imageIndex)
+{
+	MappedFile file;
+	GltfDocument document;
+	OpenDocument(filepath, file, document);
+
+	const JsonValue& image = document.Root["images"][imageIndex];
+	const std::string& uri = image["uri"].String;
+	if (image.IsNull() || (!uri.empty() && !IsDataUri(uri)))
+	{
+		throw std::runtime_error("No embedded glTF image " + std::to_string(imageIndex) + ": " + filepath);
+	}
+
+	if (!uri.empty())
+		return DecodeDataUri(uri);
+
+	const JsonValue& bufferView = document.Root["bufferViews"][image["bufferView"].GetIndex()];
+	const uint32_t bufferIndex = bufferView["buffer"].GetIndex();
+	const size_t offset = bufferView["byteOffset"].GetIndex(0);
+	const size_t length = bufferView["byteLength"].GetIndex(0);
+	if (bufferView.IsNull() || bufferIndex >= document.Buffers.size() || offset + length > document.Buffers[bufferIndex].Size)
+	{
+		throw std::runtime_error("glTF image out of bounds: " + filepath);
+	}
+
+	const uint8_t* data = document.Buffers[bufferIndex].Data + offset;
+	return std::vector<uint8_t>(data, data + length);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ModelData.h"
+
+// glTF 2.0 import without Assimp, .gltf (JSON + .bin/data URIs) and .glb (JSON and BIN chunks in one file)
+// Files are mapped and accessors read in place: tightly packed float attributes and 32 bit indices are copied
+// with one memcpy, other layouts (strided, normalized integers, 8/16 bit indices) are converted per element
+// Every triangle primitive of every node in the scene becomes a mesh, with the node`s world transform baked in
+// Materials map their base color texture onto the texture cache: external images by file name, images
+// embedded in the file (GLB buffer views, data URIs) as <file>#image<N>, which the cache decodes from the file itself
+class GltfLoader
+{
+public:
+	static bool IsGltfFile(const std::string& filepath);
+
+	// Throws on malformed files, unsupported features (sparse accessors) or out of bounds accessors
+	static SourceModel Load(const std::string& filepath);
+
+	// True for the texture name of an embedded image (<file>#image<N>), with the model file and the image index
+	static bool ParseEmbeddedImagePath(const std::string& path, std::string& filepath, uint32_t& imageIndex);
+	// Encoded bytes (PNG, JPEG) of an embedded image, throws if the model has no such image
+	static std::vector<uint8_t> LoadEmbeddedImage(const std::string& filepath, uint32_t imageIndex);
+};
@@ -0,0 +1,331 @@
+#include "Ktx2.h"
+
+#include <cstdio>
+#include <fstream>
+
+static const uint8_t s_Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const char s_CookKeyName[] = "YumeCookKey";
+static const char s_SwizzleKeyName[] = "KTXswizzle";
+static const char s_WriterKeyName[] = "KTXwriter";
+static const char s_WriterName[] = "Yume";
+
+struct Ktx2Header
+{
+	uint8_t Identifier[12];
+	uint32_t Format;			// VkFormat
+	uint32_t TypeSize;
+	uint32_t PixelWidth;
+	uint32_t PixelHeight;
+	uint32_t PixelDepth;
+	uint32_t LayerCount;
+	uint32_t FaceCount;
+	uint32_t LevelCount;
+	uint32_t SupercompressionScheme;
+	uint32_t DfdByteOffset;
+	uint32_t DfdByteLength;
+	uint32_t KvdByteOffset;
+	uint32_t KvdByteLength;
+	uint64_t SgdByteOffset;
+	uint64_t SgdByteLength;
+};
+
+struct Ktx2LevelIndex
+{
+	uint64_t ByteOffset;
+	uint64_t ByteLength;
+	uint64_t UncompressedByteLength;
+};
+
+// Khronos data format descriptor values of the formats written here
+static const uint8_t s_ColorModelRGBSDA = 1;
+static const uint8_t s_ColorModelBC1A = 128;
+static const uint8_t s_ColorModelBC3 = 130;
+static const uint8_t s_ColorModelBC4 = 131;
+static const uint8_t s_ColorModelBC5 = 132;
+static const uint8_t s_ColorModelBC7 = 134;
+static const uint8_t s_ChannelAlpha = 15;
+
+struct DfdSample
+{
+	uint16_t BitOffset;
+	uint8_t BitLength;				// minus 1
+	uint8_t ChannelType;
+	uint32_t SampleUpper;
+};
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static void AppendBytes(std::vector<uint8_t>& bytes, const void* data, size_t size)
+{
+	const uint8_t* source = static_cast<const uint8_t*>(data);
+	bytes.insert(bytes.end(), source, source + size);
+}
+
+// Basic descriptor block, false for formats that aren`t written here
+static bool BuildDataFormatDescriptor(VkFormat format, std::vector<uint8_t>& dfd, uint32_t* texelBlockSize)
+{
+	uint8_t colorModel;
+	uint8_t blockDimension;				// texel block width/height minus 1
+	uint8_t bytesPlane0;
+	std::vector<DfdSample> samples;
+
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+		colorModel = s_ColorModelRGBSDA;
+		blockDimension = 0;
+		bytesPlane0 = 1;
+		samples = { { 0, 7, 0, 255 } };
+		break;
+	case VK_FORMAT_R8G8_UNORM:
+		colorModel = s_ColorModelRGBSDA;
+		blockDimension = 0;
+		bytesPlane0 = 2;
+		samples = { { 0, 7, 0, 255 }, { 8, 7, 1, 255 } };
+		break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		colorModel = s_ColorModelRGBSDA;
+		blockDimension = 0;
+		bytesPlane0 = 4;
+		samples = { { 0, 7, 0, 255 }, { 8, 7, 1, 255 }, { 16, 7, 2, 255 }, { 24, 7, s_ChannelAlpha, 255 } };
+		break;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		colorModel = s_ColorModelBC1A;
+		blockDimension = 3;
+		bytesPlane0 = 8;
+		samples = { { 0, 63, 0, UINT32_MAX } };
+		break;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+		colorModel = s_ColorModelBC3;
+		blockDimension = 3;
+		bytesPlane0 = 16;
+		samples = { { 0, 63, s_ChannelAlpha, UINT32_MAX }, { 64, 63, 0, UINT32_MAX } };
+		break;
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		colorModel = s_ColorModelBC4;
+		blockDimension = 3;
+		bytesPlane0 = 8;
+		samples = { { 0, 63, 0, UINT32_MAX } };
+		break;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		colorModel = s_ColorModelBC5;
+		blockDimension = 3;
+		bytesPlane0 = 16;
+		samples = { { 0, 63, 0, UINT32_MAX }, { 64, 63, 1, UINT32_MAX } };
+		break;
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		colorModel = s_ColorModelBC7;
+		blockDimension = 3;
+		bytesPlane0 = 16;
+		samples = { { 0, 127, 0, UINT32_MAX } };
+		break;
+	default:
+		return false;
+	}
+
+	*texelBlockSize = bytesPlane0;
+
+	const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+	const uint32_t totalSize = 4 + blockSize;
+	const uint32_t vendorAndType = 0;					// Khronos, basic descriptor block
+	const uint32_t versionAndSize = 2 | (blockSize << 16);
+	const uint8_t modelPrimariesTransferFlags[4] = { colorModel, 1, 1, 0 };	// BT.709 primaries, linear, straight alpha
+	const uint8_t texelBlockDimension[4] = { blockDimension, blockDimension, 0, 0 };
+	const uint8_t bytesPlane[8] = { bytesPlane0, 0, 0, 0, 0, 0, 0, 0 };
+
+	AppendBytes(dfd, &totalSize, sizeof(totalSize));
+	AppendBytes(dfd, &vendorAndType, sizeof(vendorAndType));
+	AppendBytes(dfd, &versionAndSize, sizeof(versionAndSize));
+	AppendBytes(dfd, modelPrimariesTransferFlags, sizeof(modelPrimariesTransferFlags));
+	AppendBytes(dfd, texelBlockDimension, sizeof(texelBlockDimension));
+	AppendBytes(dfd, bytesPlane, sizeof(bytesPlane));
+
+	for (const auto& sample : samples)
+	{
+		const uint32_t samplePosition = 0;
+		const uint32_t sampleLower = 0;
+		AppendBytes(dfd, &sample.BitOffset, sizeof(sample.BitOffset));
+		AppendBytes(dfd, &sample.BitLength, sizeof(sample.BitLength));
+		AppendBytes(dfd, &sample.ChannelType, sizeof(sample.ChannelType));
+		AppendBytes(dfd, &samplePosition, sizeof(samplePosition));
+		AppendBytes(dfd, &sampleLower, sizeof(sampleLower));
+		AppendBytes(dfd, &sample.SampleUpper, sizeof(sample.SampleUpper));
+	}
+
+	return true;
+}
+
+static void AppendKeyValue(std::vector<uint8_t>& kvd, const char* key, size_t keySize, const void* value, size_t valueSize)
+{
+	// Key includes its terminating zero, every entry is padded to 4 bytes
+	const uint32_t length = static_cast<uint32_t>(keySize + valueSize);
+	AppendBytes(kvd, &length, sizeof(length));
+	AppendBytes(kvd, key, keySize);
+	AppendBytes(kvd, value, valueSize);
+	kvd.resize(AlignUp(kvd.size(), 4), 0);
+}
+
+bool Ktx2::Load(const std::string& filepath, Ktx2Texture& texture)
+{
+	MappedFile& file = texture.File;
+	if (!file.Open(filepath) || file.GetSize() < sizeof(Ktx2Header))
+		return false;
+
+	Ktx2Header header;
+	memcpy(&header, file.GetData(), sizeof(header));
+
+	if (memcmp(header.Identifier, s_Identifier, sizeof(s_Identifier)) != 0 ||
+		header.PixelWidth == 0 || header.PixelHeight == 0 || header.PixelDepth != 0 ||
+		header.LayerCount > 1 || header.FaceCount != 1 || header.SupercompressionScheme != 0)
+	{
+		return false;
+	}
+
+	// 0 levels asks the loader to generate them, level 0 is still the only one stored
+	const uint32_t levelCount = header.LevelCount > 0 ? header.LevelCount : 1;
+	if (sizeof(Ktx2Header) + uint64_t(levelCount) * sizeof(Ktx2LevelIndex) > file.GetSize())
+		return false;
+
+	texture.Format = static_cast<VkFormat>(header.Format);
+	texture.Width = header.PixelWidth;
+	texture.Height = header.PixelHeight;
+	texture.Levels.resize(levelCount);
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		Ktx2LevelIndex levelIndex;
+		memcpy(&levelIndex, file.GetData() + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(levelIndex));
+
+		if (levelIndex.ByteLength == 0 || levelIndex.ByteOffset + levelIndex.ByteLength > file.GetSize())
+			return false;
+
+		texture.Levels[level].Offset = levelIndex.ByteOffset;
+		texture.Levels[level].Size = levelIndex.ByteLength;
+	}
+
+	// Look for the cook key and the swizzle among the key/value entries
+	texture.CookKey = 0;
+	texture.Swizzle = "rgba";
+	if (uint64_t(header.KvdByteOffset) + header.KvdByteLength <= file.GetSize())
+	{
+		const uint8_t* kvd = file.GetData() + header.KvdByteOffset;
+		uint32_t position = 0;
+		while (position + sizeof(uint32_t) <= header.KvdByteLength)
+		{
+			uint32_t length;
+			memcpy(&length, kvd + position, sizeof(length));
+			position += sizeof(length);
+			if (position + length > header.KvdByteLength)
+				break;
+
+			if (length == sizeof(s_CookKeyName) + sizeof(uint64_t) && memcmp(kvd + position, s_CookKeyName, sizeof(s_CookKeyName)) == 0)
+			{
+				memcpy(&texture.CookKey, kvd + position + sizeof(s_CookKeyName), sizeof(uint64_t));
+			}
+			else if (length >= sizeof(s_SwizzleKeyName) + 4 && memcmp(kvd + position, s_SwizzleKeyName, sizeof(s_SwizzleKeyName)) == 0)
+			{
+				texture.Swizzle.assign(reinterpret_cast<const char*>(kvd + position + sizeof(s_SwizzleKeyName)), 4);
+			}
+
+			position = static_cast<uint32_t>(AlignUp(position + length, 4));
+		}
+	}
+
+	return true;
+}
+
+bool Ktx2::Save(const std::string& filepath, VkFormat format, uint32_t width, uint32_t height,
+	const std::vector<std::vector<uint8_t>>& levels, const std::string& swizzle, uint64_t cookKey)
+{
+	std::vector<uint8_t> dfd;
+	uint32_t texelBlockSize;
+	if (levels.empty() || !BuildDataFormatDescriptor(format, dfd, &texelBlockSize))
+		return false;
+
+	// Entries sorted by key
+	std::vector<uint8_t> kvd;
+	if (swizzle != "rgba")
+		AppendKeyValue(kvd, s_SwizzleKeyName, sizeof(s_SwizzleKeyName), swizzle.c_str(), swizzle.size() + 1);
+	AppendKeyValue(kvd, s_WriterKeyName, sizeof(s_WriterKeyName), s_WriterName, sizeof(s_WriterName));
+	if (cookKey != 0)
+		AppendKeyValue(kvd, s_CookKeyName, sizeof(s_CookKeyName), &cookKey, sizeof(cookKey));
+
+	const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+
+	Ktx2Header header = {};
+	memcpy(header.Identifier, s_Identifier, sizeof(s_Identifier));
+	header.Format = static_cast<uint32_t>(format);
+	header.TypeSize = 1;
+	header.PixelWidth = width;
+	header.PixelHeight = height;
+	header.PixelDepth = 0;
+	header.LayerCount = 0;
+	header.FaceCount = 1;
+	header.LevelCount = levelCount;
+	header.SupercompressionScheme = 0;
+	header.DfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+	header.DfdByteLength = static_cast<uint32_t>(dfd.size());
+	header.KvdByteOffset = header.DfdByteOffset + header.DfdByteLength;
+	header.KvdByteLength = static_cast<uint32_t>(kvd.size());
+
+	// Levels are stored smallest first, each aligned to lcm(texel block size, 4) (block sizes here are powers of 2)
+	const uint64_t levelAlignment = texelBlockSize > 4 ? texelBlockSize : 4;
+	std::vector<Ktx2LevelIndex> levelIndices(levelCount);
+	uint64_t offset = header.KvdByteOffset + header.KvdByteLength;
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		offset = AlignUp(offset, levelAlignment);
+		levelIndices[level].ByteOffset = offset;
+		levelIndices[level].ByteLength = levels[level].size();
+		levelIndices[level].UncompressedByteLength = levels[level].size();
+		offset += levels[level].size();
+	}
+
+	// Write to a temporary file first so a crash never leaves a half written texture behind
+	const std::string tempPath = filepath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		const char zeros[16] = {};
+		auto writeAt = [&](uint64_t position, const void* source, size_t size)
+		{
+			// Pad up to the requested offset
+			uint64_t current = static_cast<uint64_t>(file.tellp());
+			if (current < position)
+				file.write(zeros, static_cast<std::streamsize>(position - current));
+			if (size > 0)
+				file.write(static_cast<const char*>(source), static_cast<std::streamsize>(size));
+		};
+
+		writeAt(0, &header, sizeof(header));
+		writeAt(sizeof(header), levelIndices.data(), levelIndices.size() * sizeof(Ktx2LevelIndex));
+		writeAt(header.DfdByteOffset, dfd.data(), dfd.size());
+		writeAt(header.KvdByteOffset, kvd.data(), kvd.size());
+		for (uint32_t level = levelCount; level-- > 0;)
+		{
+			writeAt(levelIndices[level].ByteOffset, levels[level].data(), levels[level].size());
+		}
+
+		if (!file.good())
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	// Replace the old file (rename doesn`t overwrite on Windows)
+	std::remove(filepath.c_str());
+	if (std::rename(tempPath.c_str(), filepath.c_str()) != 0)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
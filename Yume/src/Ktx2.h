@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Utils.h"
+
+// Range of one mip level inside a KTX2 file
+struct Ktx2Level
+{
+	uint64_t Offset = 0;
+	uint64_t Size = 0;
+};
+
+// Mapped KTX2 texture, levels are read in place
+struct Ktx2Texture
+{
+	VkFormat Format = VK_FORMAT_UNDEFINED;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint64_t CookKey = 0;				// "YumeCookKey" key/value entry of cooked textures, 0 if there is none
+	std::string Swizzle = "rgba";		// "KTXswizzle" entry, how the stored channels map to rgba (r, g, b, a, 0 or 1 each)
+	std::vector<Ktx2Level> Levels;		// level 0 (largest) first
+	MappedFile File;
+
+	const uint8_t* GetLevelData(uint32_t level) const { return File.GetData() + Levels[level].Offset; }
+};
+
+// KTX 2.0 container (khronos.org/ktx), limited to what textures use here:
+// 2D, one layer and face, no supercompression, BCn, R8, RG8 or RGBA8 data
+class Ktx2
+{
+public:
+	// Map a file; returns false if it isn`t a KTX2 file of that kind
+	static bool Load(const std::string& filepath, Ktx2Texture& texture);
+	// Write levels (level 0 first); returns false if the file couldn`t be written
+	static bool Save(const std::string& filepath, VkFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels, const std::string& swizzle = "rgba", uint64_t cookKey = 0);
+};
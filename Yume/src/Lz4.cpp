@@ -0,0 +1,203 @@
+#include "Lz4.h"
+
+#include <cstring>
+#include <memory>
+
+static const size_t s_MinMatch = 4;
+// The last match must start at least 12 bytes before the end and the last 5 bytes are always literals
+static const size_t s_MatchFindLimit = 12;
+static const size_t s_LastLiterals = 5;
+static const size_t s_MaxOffset = 65535;
+static const uint32_t s_HashBits = 16;
+
+static uint32_t Read32(const uint8_t* source)
+{
+	uint32_t value;
+	memcpy(&value, source, sizeof(value));
+	return value;
+}
+
+static uint32_t Hash(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - s_HashBits);
+}
+
+// Lengths past the 4 bit token field continue in bytes of 255
+static uint8_t* WriteLength(uint8_t* output, size_t length)
+{
+	while (length >= 255)
+	{
+		*output++ = 255;
+		length -= 255;
+	}
+	*output++ = static_cast<uint8_t>(length);
+	return output;
+}
+
+static uint8_t* WriteSequence(uint8_t* output, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+	uint8_t* token = output++;
+	*token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15)
+		output = WriteLength(output, literalLength - 15);
+
+	memcpy(output, literals, literalLength);
+	output += literalLength;
+
+	// Last sequence has literals only
+	if (matchLength == 0)
+		return output;
+
+	*output++ = static_cast<uint8_t>(offset);
+	*output++ = static_cast<uint8_t>(offset >> 8);
+
+	matchLength -= s_MinMatch;
+	*token |= static_cast<uint8_t>(matchLength >= 15 ? 15 : matchLength);
+	if (matchLength >= 15)
+		output = WriteLength(output, matchLength - 15);
+
+	return output;
+}
+
+size_t Lz4::GetMaxCompressedSize(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t Lz4::Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity)
+{
+	// Writing is checked once against the worst case, a smaller buffer goes through a temporary one
+	if (capacity < GetMaxCompressedSize(size))
+	{
+		std::unique_ptr<uint8_t[]> output(new uint8_t[GetMaxCompressedSize(size)]);
+		const size_t compressedSize = Compress(source, size, output.get(), GetMaxCompressedSize(size));
+		if (compressedSize > capacity)
+			return 0;
+
+		memcpy(destination, output.get(), compressedSize);
+		return compressedSize;
+	}
+
+	uint8_t* output = destination;
+	const uint8_t* literals = source;
+	const uint8_t* end = source + size;
+
+	if (size > s_MatchFindLimit)
+	{
+		// Positions of the last sequence seen per hash, relative to source
+		std::unique_ptr<uint32_t[]> table(new uint32_t[size_t(1) << s_HashBits]());
+		const uint8_t* matchLimit = end - s_MatchFindLimit;
+		const uint8_t* position = source + 1;
+
+		while (position < matchLimit)
+		{
+			const uint32_t sequence = Read32(position);
+			const uint32_t hash = Hash(sequence);
+			const uint8_t* candidate = source + table[hash];
+			table[hash] = static_cast<uint32_t>(position - source);
+
+			if (candidate >= position || size_t(position - candidate) > s_MaxOffset || Read32(candidate) != sequence)
+			{
+				// Skip faster through data that doesn`t compress
+				position += 1 + (size_t(position - literals) >> 6);
+				continue;
+			}
+
+			// Extend backwards over literals, then forwards up to the last literals
+			while (position > literals && candidate > source && position[-1] == candidate[-1])
+			{
+				position--;
+				candidate--;
+			}
+
+			const uint8_t* matchEnd = position + s_MinMatch;
+			const uint8_t* candidateEnd = candidate + s_MinMatch;
+			while (matchEnd < end - s_LastLiterals && *matchEnd == *candidateEnd)
+			{
+				matchEnd++;
+				candidateEnd++;
+			}
+
+			output = WriteSequence(output, literals, size_t(position - literals), size_t(position - candidate),
+				size_t(matchEnd - position));
+
+			// Positions inside the match are skipped, only the one before its end is remembered
+			if (matchEnd - 2 > source && matchEnd - 2 < matchLimit)
+				table[Hash(Read32(matchEnd - 2))] = static_cast<uint32_t>(matchEnd - 2 - source);
+
+			position = literals = matchEnd;
+		}
+	}
+
+	output = WriteSequence(output, literals, size_t(end - literals), 0, 0);
+	return size_t(output - destination);
+}
+
+bool Lz4::Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size)
+{
+	const uint8_t* input = source;
+	const uint8_t* inputEnd = source + sourceSize;
+	uint8_t* output = destination;
+	uint8_t* outputEnd = destination + size;
+
+	auto readLength = [&](size_t& length) -> bool
+	{
+		uint8_t byte;
+		do
+		{
+			if (input >= inputEnd)
+				return false;
+			byte = *input++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	};
+
+	while (input < inputEnd)
+	{
+		const uint8_t token = *input++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(literalLength))
+			return false;
+		if (literalLength > size_t(inputEnd - input) || literalLength > size_t(outputEnd - output))
+			return false;
+
+		memcpy(output, input, literalLength);
+		input += literalLength;
+		output += literalLength;
+
+		// Block ends after the literals of the last sequence
+		if (input == inputEnd)
+			break;
+
+		if (inputEnd - input < 2)
+			return false;
+		const size_t offset = input[0] | (size_t(input[1]) << 8);
+		input += 2;
+		if (offset == 0 || offset > size_t(output - destination))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(matchLength))
+			return false;
+		matchLength += s_MinMatch;
+		if (matchLength > size_t(outputEnd - output))
+			return false;
+
+		// Overlapping matches repeat the last offset bytes, they have to be copied forwards one by one
+		const uint8_t* match = output - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(output, match, matchLength);
+			output += matchLength;
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; i++)
+				*output++ = match[i];
+		}
+	}
+
+	return output == outputEnd;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format (no frame header), compatible with LZ4_compress_default/LZ4_decompress_safe
+// The compressor is the greedy single probe one (fast, ~2x on meshes), the decompressor checks every read and write
+class Lz4
+{
+public:
+	// Worst case output size for size input bytes (incompressible data grows slightly)
+	static size_t GetMaxCompressedSize(size_t size);
+
+	// Returns the compressed size, 0 when the output doesn`t fit in capacity
+	static size_t Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity);
+
+	// Fails on malformed input or when the output isn`t exactly size bytes
+	static bool Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size);
+};
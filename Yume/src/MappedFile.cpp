@@ -0,0 +1,202 @@
+#include "MappedFile.h"
+
+#include "AssetPack.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	MoveFrom(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		MoveFrom(other);
+	}
+
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filepath)
+{
+	const AssetPack* pack = AssetPack::GetMounted();
+	const AssetPack::Entry* entry = pack ? pack->Find(filepath) : nullptr;
+	if (!entry)
+		return OpenFromDisk(filepath);
+
+	Close();
+	m_IsPackEntry = true;
+	m_Size = static_cast<size_t>(entry->Size);
+	m_IsEmpty = m_Size == 0;
+	if (m_IsEmpty)
+		return true;
+
+	m_Data = pack->GetStoredData(*entry);
+	if (m_Data)
+		return true;
+
+	m_Buffer.reset(new uint8_t[m_Size]);
+	if (!pack->Read(*entry, m_Buffer.get()))
+	{
+		Close();
+		return false;
+	}
+	m_Data = m_Buffer.get();
+	return true;
+}
+
+bool MappedFile::OpenFromDisk(const std::string& filepath)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	m_FileHandle = file;
+	m_Size = static_cast<size_t>(fileSize.QuadPart);
+	if (m_Size == 0)
+	{
+		m_IsEmpty = true;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		Close();
+		return false;
+	}
+	m_MappingHandle = mapping;
+
+	m_Data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_Data)
+	{
+		Close();
+		return false;
+	}
+#else
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	m_FileDescriptor = fd;
+	m_Size = static_cast<size_t>(fileStat.st_size);
+	if (m_Size == 0)
+	{
+		m_IsEmpty = true;
+		return true;
+	}
+
+	void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	// Whole file is read front to back by every user
+	madvise(data, m_Size, MADV_SEQUENTIAL);
+	m_Data = static_cast<const uint8_t*>(data);
+#endif
+
+	return true;
+}
+
+void MappedFile::Prefetch() const
+{
+	if (!m_Data || m_IsPackEntry)
+		return;
+
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range = { const_cast<uint8_t*>(m_Data), m_Size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	madvise(const_cast<uint8_t*>(m_Data), m_Size, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_Data && !m_IsPackEntry)
+		UnmapViewOfFile(m_Data);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle)
+		CloseHandle(m_FileHandle);
+
+	m_MappingHandle = nullptr;
+	m_FileHandle = nullptr;
+#else
+	if (m_Data && !m_IsPackEntry)
+		munmap(const_cast<uint8_t*>(m_Data), m_Size);
+	if (m_FileDescriptor >= 0)
+		close(m_FileDescriptor);
+
+	m_FileDescriptor = -1;
+#endif
+
+	m_Data = nullptr;
+	m_Size = 0;
+	m_IsEmpty = false;
+	m_IsPackEntry = false;
+	m_Buffer.reset();
+}
+
+void MappedFile::MoveFrom(MappedFile& other)
+{
+	m_Data = other.m_Data;
+	m_Size = other.m_Size;
+	m_IsEmpty = other.m_IsEmpty;
+	m_IsPackEntry = other.m_IsPackEntry;
+	m_Buffer = std::move(other.m_Buffer);
+#ifdef _WIN32
+	m_FileHandle = other.m_FileHandle;
+	m_MappingHandle = other.m_MappingHandle;
+	other.m_FileHandle = nullptr;
+	other.m_MappingHandle = nullptr;
+#else
+	m_FileDescriptor = other.m_FileDescriptor;
+	other.m_FileDescriptor = -1;
+#endif
+
+	other.m_Data = nullptr;
+	other.m_Size = 0;
+	other.m_IsEmpty = false;
+	other.m_IsPackEntry = false;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a whole file
+// The mapping stays valid until Close() or destruction, so pointers returned by GetData()
+// can be handed straight to memcpy (e.g. into a staging buffer) without an intermediate copy
+// Files in the mounted AssetPack are read from it instead: stored ones point into the pack`s mapping,
+// compressed ones are decompressed into memory owned by the MappedFile
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	~MappedFile();
+
+	// Mounted asset pack first, then the disk
+	bool Open(const std::string& filepath);
+	bool OpenFromDisk(const std::string& filepath);
+	void Close();
+
+	// Ask the OS to read the whole mapping ahead in one go
+	void Prefetch() const;
+
+	bool IsOpen() const { return m_Data != nullptr || m_IsEmpty; }
+	const uint8_t* GetData() const { return m_Data; }
+	size_t GetSize() const { return m_Size; }
+
+private:
+	void MoveFrom(MappedFile& other);
+
+private:
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+	bool m_IsEmpty = false;			// empty files can't be mapped, but they are valid files
+	bool m_IsPackEntry = false;		// m_Data belongs to the asset pack or m_Buffer, nothing to unmap
+	std::unique_ptr<uint8_t[]> m_Buffer;
+
+#ifdef _WIN32
+	void* m_FileHandle = nullptr;
+	void* m_MappingHandle = nullptr;
+#else
+	int m_FileDescriptor = -1;
+#endif
+};
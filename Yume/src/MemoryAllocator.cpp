@@ -0,0 +1,405 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "BuddyAllocator.h"
+#include "FreeListAllocator.h"
+
+struct MemoryBlock
+{
+	VkDeviceMemory Memory = VK_NULL_HANDLE;
+	VkDeviceSize Size = 0;
+	uint8_t* MappedData = nullptr;
+	uint32_t AllocationCount = 0;
+	uint32_t PoolIndex = 0;
+	AllocationStrategy Strategy = AllocationStrategy::FreeList;
+
+	// Only the one matching the pool strategy is used
+	FreeListAllocator FreeList;
+	BuddyAllocator Buddy;
+	VkDeviceSize LinearOffset = 0;
+};
+
+struct MemoryPool
+{
+	uint32_t MemoryTypeIndex = 0;
+	AllocationStrategy Strategy = AllocationStrategy::FreeList;
+	bool IsImagePool = false;
+	std::vector<std::unique_ptr<MemoryBlock>> Blocks;
+};
+
+// Default block size, smaller heaps (integrated GPUs, the 256MB BAR heap) get heap / 8
+static const VkDeviceSize s_DefaultBlockSize = 64 * 1024 * 1024;
+// Images this big get their own allocation instead of eating most of a block
+static const VkDeviceSize s_DedicatedImageThreshold = 16 * 1024 * 1024;
+// Smallest buddy block
+static const VkDeviceSize s_MinBuddyBlockSize = 256;
+
+static VkPhysicalDevice s_PhysicalDevice;
+static VkDevice s_Device;
+static VkPhysicalDeviceMemoryProperties s_MemoryProperties;
+static VkDeviceSize s_BufferImageGranularity;
+
+static std::mutex s_Mutex;
+static std::vector<MemoryPool> s_Pools;
+static uint32_t s_DedicatedCount;
+static VkDeviceSize s_DedicatedBytes;
+
+static VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex)
+{
+	const VkDeviceSize heapSize = s_MemoryProperties.memoryHeaps[s_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+	return std::min(s_DefaultBlockSize, heapSize / 8);
+}
+
+static void* MapMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex)
+{
+	if (!(s_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		return nullptr;
+
+	// Mapped once for the lifetime of the memory, a VkDeviceMemory can only be mapped once at a time
+	void* data;
+	if (vkMapMemory(s_Device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to map device memory!");
+	}
+	return data;
+}
+
+static bool AllocateFromBlock(MemoryBlock& block, const VkMemoryRequirements& memRequirements, MemoryAllocation& allocation)
+{
+	uint64_t offset = 0;
+	uint64_t allocatedSize = memRequirements.size;
+
+	switch (block.Strategy)
+	{
+	case AllocationStrategy::FreeList:
+		if (!block.FreeList.Allocate(memRequirements.size, memRequirements.alignment, &offset))
+			return false;
+		break;
+
+	case AllocationStrategy::Linear:
+	{
+		// Linear blocks only grow until they are empty again
+		const VkDeviceSize alignedOffset = (block.LinearOffset + memRequirements.alignment - 1) / memRequirements.alignment * memRequirements.alignment;
+		if (alignedOffset + memRequirements.size > block.Size)
+			return false;
+
+		offset = alignedOffset;
+		block.LinearOffset = alignedOffset + memRequirements.size;
+		break;
+	}
+
+	case AllocationStrategy::Buddy:
+		if (!block.Buddy.Allocate(memRequirements.size, memRequirements.alignment, &offset, &allocatedSize))
+			return false;
+		break;
+	}
+
+	block.AllocationCount++;
+
+	allocation.Memory = block.Memory;
+	allocation.Offset = offset;
+	allocation.Size = memRequirements.size;
+	allocation.AllocatedSize = allocatedSize;
+	allocation.MappedData = block.MappedData ? block.MappedData + offset : nullptr;
+	allocation.Block = &block;
+
+	return true;
+}
+
+void MemoryAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice device)
+{
+	s_PhysicalDevice = physicalDevice;
+	s_Device = device;
+
+	vkGetPhysicalDeviceMemoryProperties(s_PhysicalDevice, &s_MemoryProperties);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(s_PhysicalDevice, &deviceProperties);
+	s_BufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+
+	s_Pools.clear();
+	s_DedicatedCount = 0;
+	s_DedicatedBytes = 0;
+}
+
+void MemoryAllocator::Destroy()
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+
+	uint32_t leakedCount = 0;
+	for (auto& pool : s_Pools)
+	{
+		for (auto& block : pool.Blocks)
+		{
+			leakedCount += block->AllocationCount;
+
+			if (block->MappedData)
+				vkUnmapMemory(s_Device, block->Memory);
+			vkFreeMemory(s_Device, block->Memory, nullptr);
+		}
+	}
+	s_Pools.clear();
+
+	if (leakedCount > 0 || s_DedicatedCount > 0)
+	{
+		std::cout << "Memory allocator destroyed with " << leakedCount + s_DedicatedCount << " live allocations" << std::endl;
+	}
+}
+
+MemoryAllocation MemoryAllocator::AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags propertyFlags, AllocationStrategy strategy)
+{
+	// Get buffer memory requirements
+	VkMemoryRequirements memRequirements = {};
+	vkGetBufferMemoryRequirements(s_Device, buffer, &memRequirements);
+
+	MemoryAllocation allocation = Allocate(memRequirements, propertyFlags, strategy, false, false, buffer, VK_NULL_HANDLE);
+
+	// Bind memory to given buffer
+	vkBindBufferMemory(s_Device, buffer, allocation.Memory, allocation.Offset);
+
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::AllocateImage(VkImage image, VkMemoryPropertyFlags propertyFlags, AllocationStrategy strategy)
+{
+	// Get memory requirements and whether the driver wants the image on its own allocation
+	VkMemoryDedicatedRequirements dedicatedRequirements = {};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 memRequirements2 = {};
+	memRequirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	memRequirements2.pNext = &dedicatedRequirements;
+
+	VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+
+	vkGetImageMemoryRequirements2(s_Device, &requirementsInfo, &memRequirements2);
+	const VkMemoryRequirements& memRequirements = memRequirements2.memoryRequirements;
+
+	const bool isDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation ||
+		memRequirements.size >= s_DedicatedImageThreshold;
+
+	MemoryAllocation allocation = Allocate(memRequirements, propertyFlags, strategy, true, isDedicated, VK_NULL_HANDLE, image);
+
+	// Connect memory to image
+	vkBindImageMemory(s_Device, image, allocation.Memory, allocation.Offset);
+
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags propertyFlags,
+	AllocationStrategy strategy, bool isImage, bool isDedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage)
+{
+	const uint32_t memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, propertyFlags);
+	const VkDeviceSize blockSize = GetBlockSize(memoryTypeIndex);
+
+	MemoryAllocation allocation;
+
+	// Own allocation: requested, or too big to share a block with anything
+	if (isDedicated || memRequirements.size > blockSize / 2)
+	{
+		VkMemoryDedicatedAllocateInfo dedicatedAllocateInfo = {};
+		dedicatedAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicatedAllocateInfo.buffer = dedicatedBuffer;
+		dedicatedAllocateInfo.image = dedicatedImage;
+
+		VkMemoryAllocateInfo memoryAllocateInfo = {};
+		memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryAllocateInfo.pNext = &dedicatedAllocateInfo;
+		memoryAllocateInfo.allocationSize = memRequirements.size;
+		memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkResult result = vkAllocateMemory(s_Device, &memoryAllocateInfo, nullptr, &allocation.Memory);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate dedicated device memory!");
+		}
+
+		allocation.Offset = 0;
+		allocation.Size = memRequirements.size;
+		allocation.AllocatedSize = memRequirements.size;
+		allocation.MappedData = MapMemory(allocation.Memory, memoryTypeIndex);
+
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		s_DedicatedCount++;
+		s_DedicatedBytes += memRequirements.size;
+
+		return allocation;
+	}
+
+	std::lock_guard<std::mutex> lock(s_Mutex);
+
+	// Buffers and images get separate pools: with bufferImageGranularity > 1 linear and optimal
+	// resources would otherwise need padding to granularity pages between neighbours
+	const bool isImagePool = isImage && s_BufferImageGranularity > 1;
+	auto poolIt = std::find_if(s_Pools.begin(), s_Pools.end(), [&](const MemoryPool& pool)
+	{
+		return pool.MemoryTypeIndex == memoryTypeIndex && pool.Strategy == strategy && pool.IsImagePool == isImagePool;
+	});
+
+	if (poolIt == s_Pools.end())
+	{
+		// Pools are never removed, blocks refer to them by index
+		MemoryPool pool;
+		pool.MemoryTypeIndex = memoryTypeIndex;
+		pool.Strategy = strategy;
+		pool.IsImagePool = isImagePool;
+		s_Pools.push_back(std::move(pool));
+		poolIt = s_Pools.end() - 1;
+	}
+
+	MemoryPool& pool = *poolIt;
+
+	for (auto& block : pool.Blocks)
+	{
+		if (AllocateFromBlock(*block, memRequirements, allocation))
+			return allocation;
+	}
+
+	// Every block is full, add one
+	auto block = std::make_unique<MemoryBlock>();
+	block->Size = blockSize;
+	block->PoolIndex = static_cast<uint32_t>(poolIt - s_Pools.begin());
+	block->Strategy = strategy;
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.allocationSize = blockSize;
+	memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkResult result = vkAllocateMemory(s_Device, &memoryAllocateInfo, nullptr, &block->Memory);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate device memory block!");
+	}
+
+	block->MappedData = static_cast<uint8_t*>(MapMemory(block->Memory, memoryTypeIndex));
+	block->FreeList = FreeListAllocator(blockSize);
+	block->Buddy = BuddyAllocator(blockSize, s_MinBuddyBlockSize);
+
+	if (!AllocateFromBlock(*block, memRequirements, allocation))
+	{
+		vkFreeMemory(s_Device, block->Memory, nullptr);
+		throw std::runtime_error("Failed to sub-allocate device memory!");
+	}
+
+	pool.Blocks.push_back(std::move(block));
+
+	return allocation;
+}
+
+void MemoryAllocator::Free(MemoryAllocation& allocation)
+{
+	if (allocation.Memory == VK_NULL_HANDLE)
+		return;
+
+	if (!allocation.Block)
+	{
+		// Dedicated, memory is unmapped implicitly
+		vkFreeMemory(s_Device, allocation.Memory, nullptr);
+
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		s_DedicatedCount--;
+		s_DedicatedBytes -= allocation.Size;
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+
+		MemoryBlock& block = *allocation.Block;
+		MemoryPool& pool = s_Pools[block.PoolIndex];
+		block.AllocationCount--;
+
+		switch (block.Strategy)
+		{
+		case AllocationStrategy::FreeList:
+			block.FreeList.Free(allocation.Offset, allocation.AllocatedSize);
+			break;
+
+		case AllocationStrategy::Linear:
+			// Space comes back all at once when the block is empty
+			if (block.AllocationCount == 0)
+				block.LinearOffset = 0;
+			break;
+
+		case AllocationStrategy::Buddy:
+			block.Buddy.Free(allocation.Offset, allocation.AllocatedSize);
+			break;
+		}
+
+		// Keep one block per pool around so a pool that empties and refills doesn`t hit the driver every time
+		if (block.AllocationCount == 0 && pool.Blocks.size() > 1)
+		{
+			if (block.MappedData)
+				vkUnmapMemory(s_Device, block.Memory);
+			vkFreeMemory(s_Device, block.Memory, nullptr);
+
+			pool.Blocks.erase(std::find_if(pool.Blocks.begin(), pool.Blocks.end(),
+				[&](const std::unique_ptr<MemoryBlock>& poolBlock) { return poolBlock.get() == &block; }));
+		}
+	}
+
+	allocation = MemoryAllocation();
+}
+
+MemoryStats MemoryAllocator::GetStats()
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+
+	MemoryStats stats;
+	stats.DedicatedCount = s_DedicatedCount;
+	stats.DeviceMemoryCount = s_DedicatedCount;
+	stats.AllocationCount = s_DedicatedCount;
+	stats.DeviceMemoryBytes = s_DedicatedBytes;
+	stats.UsedBytes = s_DedicatedBytes;
+
+	for (const auto& pool : s_Pools)
+	{
+		for (const auto& block : pool.Blocks)
+		{
+			stats.BlockCount++;
+			stats.DeviceMemoryCount++;
+			stats.AllocationCount += block->AllocationCount;
+			stats.DeviceMemoryBytes += block->Size;
+
+			switch (block->Strategy)
+			{
+			case AllocationStrategy::FreeList:	stats.UsedBytes += block->FreeList.GetUsedSize(); break;
+			case AllocationStrategy::Linear:	stats.UsedBytes += block->LinearOffset; break;
+			case AllocationStrategy::Buddy:		stats.UsedBytes += block->Buddy.GetUsedSize(); break;
+			}
+		}
+	}
+
+	return stats;
+}
+
+void MemoryAllocator::PrintStats()
+{
+	const MemoryStats stats = GetStats();
+
+	std::cout << "Device memory: " << stats.AllocationCount << " allocations in " << stats.DeviceMemoryCount
+		<< " device allocations (" << stats.BlockCount << " blocks, " << stats.DedicatedCount << " dedicated), "
+		<< stats.UsedBytes / (1024 * 1024) << " of " << stats.DeviceMemoryBytes / (1024 * 1024) << " MB used" << std::endl;
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags propertyFlags)
+{
+	for (uint32_t i = 0; i < s_MemoryProperties.memoryTypeCount; i++)
+	{
+		if ((allowedTypes & (1 << i))	// Index of memory type must match corresponding bit in allowedTypes
+			&& (s_MemoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) // Desired property bit flags are part of memory type`s property flags
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type!");
+}
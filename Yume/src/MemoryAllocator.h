@@ -0,0 +1,65 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+
+// How allocations are placed inside a pool`s blocks
+enum class AllocationStrategy
+{
+	FreeList,		// general purpose, first fit with merging of free ranges
+	Linear,			// bump pointer, the block resets once everything in it was freed (staging, short lived data)
+	Buddy			// power of two blocks, fast and low fragmentation for similar sized resources (textures)
+};
+
+struct MemoryBlock;
+
+// Piece of device memory handed out by the allocator
+struct MemoryAllocation
+{
+	VkDeviceMemory Memory = VK_NULL_HANDLE;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+	void* MappedData = nullptr;		// host visible memory stays mapped, points at Offset
+
+	// Internal
+	MemoryBlock* Block = nullptr;	// null for dedicated allocations
+	VkDeviceSize AllocatedSize = 0;	// size taken from the block (buddy rounds up)
+};
+
+struct MemoryStats
+{
+	uint32_t DeviceMemoryCount = 0;			// live vkAllocateMemory allocations (blocks + dedicated)
+	uint32_t BlockCount = 0;
+	uint32_t DedicatedCount = 0;
+	uint32_t AllocationCount = 0;			// live sub-allocations
+	VkDeviceSize DeviceMemoryBytes = 0;		// bytes allocated from the driver
+	VkDeviceSize UsedBytes = 0;				// bytes handed out to resources
+};
+
+// Device memory sub-allocator: one pool of large blocks per memory type, strategy and resource kind,
+// dedicated allocations for big (or driver preferred) images
+// Buffers and optimal tiling images never share a block, so bufferImageGranularity can`t be violated
+class MemoryAllocator
+{
+public:
+	static void Init(VkPhysicalDevice physicalDevice, VkDevice device);
+	// Frees every block, reports allocations that were never freed
+	static void Destroy();
+
+	// Allocate memory for a buffer/image and bind it (thread safe)
+	static MemoryAllocation AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags propertyFlags,
+		AllocationStrategy strategy = AllocationStrategy::FreeList);
+	static MemoryAllocation AllocateImage(VkImage image, VkMemoryPropertyFlags propertyFlags,
+		AllocationStrategy strategy = AllocationStrategy::Buddy);
+	static void Free(MemoryAllocation& allocation);
+
+	static MemoryStats GetStats();
+	static void PrintStats();
+
+private:
+	static MemoryAllocation Allocate(const VkMemoryRequirements& memRequirements, VkMemoryPropertyFlags propertyFlags,
+		AllocationStrategy strategy, bool isImage, bool isDedicated, VkBuffer dedicatedBuffer, VkImage dedicatedImage);
+	static uint32_t FindMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags propertyFlags);
+};
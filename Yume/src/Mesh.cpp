@@ -1,15 +1,30 @@
 #include "Mesh.h"
 
 
-Mesh::Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-	VkCommandPool transferCmdPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, int textureID)
+Mesh::Mesh(GeometryArena& arena, UploadBatcher& uploader, const SubMeshData& subMesh,
+	const uint8_t* vertexData, const uint8_t* indexData, const Meshlet* meshletData, int textureID)
 {
-	m_IndexCount = indices->size();
-	m_VertexCount = vertices->size();
-	m_PhysicalDevice = newPhysicalDevice;
-	m_Device = newDevice;
-	CreateVertexBuffer(transferQueue, transferCmdPool, vertices);
-	CreateIndexBuffer(transferQueue, transferCmdPool, indices);
+	m_IndexCount = subMesh.IndexCount;
+	m_IndexSize = subMesh.IndexSize;
+	m_VertexCount = subMesh.VertexCount;
+	m_VertexFormat = subMesh.Format;
+	m_Dequantization = subMesh.Dequantization;
+	m_LodCount = subMesh.LodCount;
+	std::copy(subMesh.Lods, subMesh.Lods + subMesh.LodCount, m_Lods);
+	m_BoundingSphere = subMesh.BoundingSphere;
+	m_BoundsMin = subMesh.BoundsMin;
+	m_BoundsMax = subMesh.BoundsMax;
+	m_Arena = &arena;
+	CreateVertexBuffer(uploader, vertexData + subMesh.VertexDataOffset);
+	CreateIndexBuffer(uploader, indexData + subMesh.IndexDataOffset);
+
+	if (CULL_MESHLETS)
+	{
+		// Culling copies the indices of visible meshlets every frame, the arena copy is device local
+		m_Meshlets.assign(meshletData + subMesh.FirstMeshlet, meshletData + subMesh.FirstMeshlet + subMesh.MeshletCount);
+		const uint8_t* subMeshIndexData = indexData + subMesh.IndexDataOffset;
+		m_IndexData.assign(subMeshIndexData, subMeshIndexData + size_t(m_IndexSize) * m_IndexCount);
+	}
 
 	m_UBOModel.Model = glm::mat4(1.0f);
 	m_TextureID = textureID;
@@ -27,98 +42,34 @@ int Mesh::GetVertexCount()
 	return static_cast<int>(m_VertexCount);
 }
 
-VkBuffer Mesh::GetVertexBuffer()
-{
-	return m_VertexBuffer;
-}
-
 void Mesh::DestroyBuffers()
 {
-	vkDestroyBuffer(m_Device, m_VertexBuffer, nullptr);
-	vkFreeMemory(m_Device, m_VertexBufferMemory, nullptr);
-	vkDestroyBuffer(m_Device, m_IndexBuffer, nullptr);
-	vkFreeMemory(m_Device, m_IndexBufferMemory, nullptr);
+	// Give the ranges back to the arena, the arena owns the buffers
+	m_Arena->FreeVertices(m_VertexAllocation);
+	m_Arena->FreeIndices(m_IndexAllocation);
 }
 
-void Mesh::CreateVertexBuffer(VkQueue transferQueue,
-	VkCommandPool transferCmdPool, std::vector<Vertex>* vertices)
+void Mesh::CreateVertexBuffer(UploadBatcher& uploader, const uint8_t* vertexData)
 {
 	// Get size of buffer
-	VkDeviceSize bufferSize = sizeof(Vertex) * vertices->size();
-
-	// temporary buffer to stage vertex data before transferring to GPU
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	// Create staging buffer and allocate memory to it 
-	CreateBuffer(m_PhysicalDevice, m_Device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&stagingBuffer, &stagingBufferMemory);
-
-
-	// Map memory to vertex buffer
-	void* data;			// 1. create pointer to a point in normal memory
-	vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);	// 2. "Map the vertex buffer memory to that point
-	memcpy(data, vertices->data(), (size_t)bufferSize); // 3. Copy memory from vertices vector to the point
-	vkUnmapMemory(m_Device, stagingBufferMemory);		// 4. Unmap the vertex buffer memory
-
-	// Create buffer with TRANSFER_DST_BIT to mark recipient of transfer data (also VERTEX_BUFFER)
-	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the gpu and only accessible by it and not CPU (host)
-	CreateBuffer(m_PhysicalDevice, m_Device, bufferSize, 
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_VertexBuffer, &m_VertexBufferMemory);
+	const VkDeviceSize stride = GetVertexStride(m_VertexFormat);
+	VkDeviceSize bufferSize = stride * m_VertexCount;
 
-	// copy stagin buffer to vertex buffer
-	CopyBuffer(m_Device, transferQueue, transferCmdPool, stagingBuffer, m_VertexBuffer, bufferSize);
-	
-	// cleand stagin buffer parts
-	vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-	vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
+	// Sub-allocate from the scene vertex buffer (device local, TRANSFER_DST | VERTEX_BUFFER)
+	m_VertexAllocation = m_Arena->AllocateVertices(bufferSize, stride);
 
-	//// Create buffer and allocate memory to it 
-	//CreateBuffer(m_PhysicalDevice, m_Device, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-	//	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-	//	&m_VertexBuffer, &m_VertexBufferMemory);
-
-	//// Map memory to vertex buffer
-	//void* data;			// 1. create pointer to a point in normal memory
-	//vkMapMemory(m_Device, m_VertexBufferMemory, 0, bufferSize, 0, &data);	// 2. "Map the vertex buffer memory to that point
-	//memcpy(data, vertices->data(), (size_t)bufferSize); // 3. Copy memory from vertices vector to the point
-	//vkUnmapMemory(m_Device, m_VertexBufferMemory);		// 4. Unmap the vertex buffer memory
+	// Stage vertices (vector or mapped cooked file) in the upload ring and record the copy, submitted with the rest of the batch
+	uploader.UploadBuffer(m_Arena->GetVertexBuffer(), m_VertexAllocation.Offset, vertexData, bufferSize);
 }
 
-void Mesh::CreateIndexBuffer(VkQueue transferQueue, VkCommandPool transferCmdPool, std::vector<uint32_t>* indices)
+void Mesh::CreateIndexBuffer(UploadBatcher& uploader, const uint8_t* indexData)
 {
 	// Get the buffer size
-	VkDeviceSize bufferSize = sizeof(uint32_t) * indices->size();
-
-	//temporary buffer data
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	// Create index buffer
-	// Create staging buffer and allocate memory to it 
-	CreateBuffer(m_PhysicalDevice, m_Device, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&stagingBuffer, &stagingBufferMemory);
-
-	// Map memory to index buffer
-	void* data;			// 1. create pointer to a point in normal memory
-	vkMapMemory(m_Device, stagingBufferMemory, 0, bufferSize, 0, &data);	// 2. "Map the vertex buffer memory to that point
-	memcpy(data, indices->data(), (size_t)bufferSize); // 3. Copy memory from vertices vector to the point
-	vkUnmapMemory(m_Device, stagingBufferMemory);		// 4. Unmap the vertex buffer memory
-	
-	// Buffer memory is to be DEVICE_LOCAL_BIT meaning memory is on the gpu and only accessible by it and not CPU (host)
-	CreateBuffer(m_PhysicalDevice, m_Device, bufferSize,
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_IndexBuffer, &m_IndexBufferMemory);
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(m_IndexSize) * m_IndexCount;
 
+	// Sub-allocate from the scene index buffer
+	m_IndexAllocation = m_Arena->AllocateIndices(bufferSize);
 
-	// copy staging buffer to GPU access buffer
-	CopyBuffer(m_Device, transferQueue, transferCmdPool, stagingBuffer, m_IndexBuffer, bufferSize);
-
-	// cleand stagin buffer parts
-	vkDestroyBuffer(m_Device, stagingBuffer, nullptr);
-	vkFreeMemory(m_Device, stagingBufferMemory, nullptr);
-}
-
+	// Stage indices in the upload ring and record the copy
+	uploader.UploadBuffer(m_Arena->GetIndexBuffer(), m_IndexAllocation.Offset, indexData, bufferSize);
+}
\ No newline at end of file
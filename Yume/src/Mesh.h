@@ -3,9 +3,13 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <vector>
 
 #include "Utils.h"
+#include "GeometryArena.h"
+#include "ModelData.h"
+#include "UploadBatcher.h"
 
 struct UniformBufferObjectModel
 {
@@ -17,31 +21,48 @@ class Mesh
 {
 public:
 	Mesh() = default;
-	Mesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-		VkCommandPool transferCmdPool, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices,
-		int textureID);
+	// Upload a sub-mesh straight from the model blobs (already in its GPU layout)
+	// Meshlets and a CPU copy of the indices are kept for culling when CULL_MESHLETS is set
+	Mesh(GeometryArena& arena, UploadBatcher& uploader, const SubMeshData& subMesh,
+		const uint8_t* vertexData, const uint8_t* indexData, const Meshlet* meshletData, int textureID);
 
 	~Mesh();
 
 	int GetVertexCount();
-	int GetIndexCount() { return static_cast<int>(m_IndexCount); }
+	int GetIndexCount() const { return static_cast<int>(m_IndexCount); }
+	uint32_t GetIndexSize() const { return m_IndexSize; }
 
-	VkBuffer GetVertexBuffer();
-	VkBuffer GetIndexBuffer() { return m_IndexBuffer; }
+	// Where the mesh lives in the geometry arena, in vertices/indices (vkCmdDrawIndexed`s vertexOffset/firstIndex)
+	int32_t GetVertexOffset() const { return static_cast<int32_t>(m_VertexAllocation.Offset / GetVertexStride(m_VertexFormat)); }
+	uint32_t GetFirstIndex() const { return static_cast<uint32_t>(m_IndexAllocation.Offset / m_IndexSize); }
+
+	VertexFormat GetVertexFormat() const { return m_VertexFormat; }
+	VkIndexType GetIndexType() const { return m_IndexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; }
+	const VertexDequantization& GetDequantization() const { return m_Dequantization; }
+
+	// Levels of detail (level 0 is the full mesh), index/meshlet ranges are relative to the mesh
+	uint32_t GetLodCount() const { return m_LodCount; }
+	const MeshLod& GetLod(uint32_t level) const { return m_Lods[std::min(level, m_LodCount - 1)]; }
+	const glm::vec4& GetBoundingSphere() const { return m_BoundingSphere; }
+	// Object space box
+	const glm::vec3& GetBoundsMin() const { return m_BoundsMin; }
+	const glm::vec3& GetBoundsMax() const { return m_BoundsMax; }
+
+	const std::vector<Meshlet>& GetMeshlets() const { return m_Meshlets; }
+	const uint8_t* GetIndexData() const { return m_IndexData.data(); }
 
 	void SetModel(glm::mat4& model) { m_UBOModel.Model = model; };
 	UniformBufferObjectModel GetUniformBufferModel() { return m_UBOModel; }
-	int GetTextureID() { return m_TextureID; };
+	int GetTextureID() const { return m_TextureID; };
+	void SetTextureID(int textureID) { m_TextureID = textureID; }
 
 	void DestroyBuffers();
 
 
 private:
-	void CreateVertexBuffer(VkQueue transferQueue,
-		VkCommandPool transferCmdPool, std::vector<Vertex>* vertices);
+	void CreateVertexBuffer(UploadBatcher& uploader, const uint8_t* vertexData);
 
-	void CreateIndexBuffer(VkQueue transferQueue,
-		VkCommandPool transferCmdPool, std::vector<uint32_t>* indices);
+	void CreateIndexBuffer(UploadBatcher& uploader, const uint8_t* indexData);
 
 private:
 
@@ -50,15 +71,24 @@ private:
 	int m_TextureID;
 
 	size_t m_VertexCount;
-	VkBuffer m_VertexBuffer = nullptr;
-	VkDeviceMemory m_VertexBufferMemory;
+	VertexFormat m_VertexFormat = VertexFormat::Full;
+	VertexDequantization m_Dequantization;
+	GeometryAllocation m_VertexAllocation;
 
 	size_t m_IndexCount;
-	VkBuffer m_IndexBuffer;
-	VkDeviceMemory m_IndexBufferMemory;
+	uint32_t m_IndexSize = sizeof(uint32_t);
+	GeometryAllocation m_IndexAllocation;
+
+	uint32_t m_LodCount = 1;
+	MeshLod m_Lods[MAX_MESH_LODS];
+	glm::vec4 m_BoundingSphere = glm::vec4(0.0f);
+	glm::vec3 m_BoundsMin = glm::vec3(0.0f);
+	glm::vec3 m_BoundsMax = glm::vec3(0.0f);
+
+	std::vector<Meshlet> m_Meshlets;
+	std::vector<uint8_t> m_IndexData;
 
-	VkPhysicalDevice m_PhysicalDevice;
-	VkDevice m_Device;
+	GeometryArena* m_Arena = nullptr;
 
 };
 
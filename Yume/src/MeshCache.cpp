@@ -0,0 +1,401 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// Bump whenever the layout below or the import post-processing changes
+static const uint32_t s_CookedVersion = 8;
+static const char s_CookedMagic[4] = { 'Y', 'M', 'S', 'H' };
+static const uint64_t s_BlobAlignment = 16;
+
+struct CookedHeader
+{
+	char Magic[4];
+	uint32_t Version;
+	uint64_t Key;
+	uint32_t VertexStride;			// sizeof(Vertex) when cooked, guards against layout changes
+	uint32_t SubMeshCount;
+	uint32_t MaterialCount;
+	uint32_t CompactVertexStride;	// sizeof(CompactVertex) when cooked
+	uint32_t MeshletStride;			// sizeof(Meshlet) when cooked
+	uint32_t Padding;
+	uint64_t MaterialTableOffset;
+	uint64_t SubMeshTableOffset;
+	uint64_t VertexDataOffset;
+	uint64_t VertexDataSize;
+	uint64_t IndexDataOffset;
+	uint64_t IndexDataSize;
+	uint64_t MeshletDataOffset;
+	uint64_t MeshletCount;
+	uint64_t FileSize;
+};
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static std::string GetLowerExtension(const std::string& filepath)
+{
+	const size_t extensionIndex = filepath.rfind('.');
+	if (extensionIndex == std::string::npos)
+		return std::string();
+
+	std::string extension = filepath.substr(extensionIndex);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension;
+}
+
+static bool IsLineSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Material libraries of an OBJ file: the rest of every mtllib line, like the loaders read it
+static void FindObjLibraries(const char* p, const char* end, std::vector<std::string>& libraries)
+{
+	while (p < end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (!lineEnd)
+			lineEnd = end;
+
+		while (p < lineEnd && IsLineSpace(*p))
+			p++;
+		if (lineEnd - p > 6 && memcmp(p, "mtllib", 6) == 0 && IsLineSpace(p[6]))
+		{
+			const char* first = p + 6;
+			const char* last = lineEnd;
+			while (first < last && IsLineSpace(*first))
+				first++;
+			while (last > first && IsLineSpace(last[-1]))
+				last--;
+			if (last > first)
+				libraries.emplace_back(first, last);
+		}
+
+		p = lineEnd + 1;
+	}
+}
+
+// "uri" members of the entries of the top level "buffers" array of glTF JSON
+// Just enough of a JSON walk for that: strings (escapes taken literally), nesting and keys
+static void FindGltfBufferUris(const char* p, const char* end, std::vector<std::string>& uris)
+{
+	uint32_t depth = 0;
+	uint32_t buffersDepth = 0;		// depth inside the buffers array, 0 outside it
+	std::string key;				// last string followed by a colon
+	while (p < end)
+	{
+		const char c = *p++;
+		if (c == '"')
+		{
+			std::string value;
+			while (p < end && *p != '"')
+			{
+				if (*p == '\\' && p + 1 < end)
+					p++;
+				value += *p++;
+			}
+			p++;
+
+			while (p < end && (IsLineSpace(*p) || *p == '\n'))
+				p++;
+			if (p < end && *p == ':')
+				key = std::move(value);
+			else if (buffersDepth > 0 && depth == buffersDepth + 1 && key == "uri")
+				uris.push_back(std::move(value));
+		}
+		else if (c == '{' || c == '[')
+		{
+			depth++;
+			if (c == '[' && depth == 2 && key == "buffers")
+				buffersDepth = depth;
+		}
+		else if (c == '}' || c == ']')
+		{
+			if (depth == buffersDepth)
+				buffersDepth = 0;
+			depth--;
+		}
+	}
+}
+
+// glTF URIs are percent-encoded
+static std::string DecodeUri(const std::string& uri)
+{
+	std::string path;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) &&
+			std::isxdigit(static_cast<unsigned char>(uri[i + 2])))
+		{
+			path += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+			i += 2;
+		}
+		else
+		{
+			path += uri[i];
+		}
+	}
+	return path;
+}
+
+// Files the source references, relative to it: material libraries of OBJ files, external buffers of glTF files
+static std::vector<std::string> FindDependencies(const std::string& sourcePath, const MappedFile& source)
+{
+	const char* data = reinterpret_cast<const char*>(source.GetData());
+	const size_t size = source.GetSize();
+
+	std::vector<std::string> references;
+	const std::string extension = GetLowerExtension(sourcePath);
+	if (extension == ".obj")
+	{
+		FindObjLibraries(data, data + size, references);
+	}
+	else if (extension == ".gltf")
+	{
+		FindGltfBufferUris(data, data + size, references);
+	}
+	else if (extension == ".glb" && size >= 20)
+	{
+		// 12 byte header, then the JSON chunk: length, type and the text
+		uint32_t jsonLength;
+		memcpy(&jsonLength, data + 12, sizeof(jsonLength));
+		if (memcmp(data + 16, "JSON", 4) == 0 && jsonLength <= size - 20)
+			FindGltfBufferUris(data + 20, data + 20 + jsonLength, references);
+	}
+
+	std::string directoryPath;
+	const size_t lastSlashIndex = sourcePath.find_last_of("/\\");
+	if (lastSlashIndex != std::string::npos)
+		directoryPath = sourcePath.substr(0, lastSlashIndex + 1);
+
+	std::vector<std::string> dependencies;
+	for (const auto& reference : references)
+	{
+		// Embedded buffers are part of the source already
+		if (reference.compare(0, 5, "data:") == 0)
+			continue;
+		dependencies.push_back(directoryPath + (extension == ".obj" ? reference : DecodeUri(reference)));
+	}
+	return dependencies;
+}
+
+uint64_t MeshCache::ComputeKey(const std::string& sourcePath, uint32_t importFlags)
+{
+	MappedFile source;
+	if (!source.Open(sourcePath))
+		return 0;
+
+	uint64_t key = HashMemory(source.GetData(), source.GetSize(), (uint64_t(s_CookedVersion) << 32) | importFlags);
+
+	// The geometry written depends on the cook switches
+	const uint8_t cookOptions[] = { COMPACT_VERTEX_FORMAT, OPTIMIZE_MESH_OVERDRAW, GENERATE_MESH_LODS, MAX_MESH_LODS, NATIVE_OBJ_IMPORT };
+	key = HashMemory(cookOptions, sizeof(cookOptions), key);
+
+	// Materials of OBJ files and glTF geometry can live in other files, a change there must also invalidate the cache
+	// A missing file still hashes its name, so the key changes once it shows up
+	for (const auto& dependency : FindDependencies(sourcePath, source))
+	{
+		key = HashMemory(dependency.data(), dependency.size(), key);
+
+		MappedFile dependencyFile;
+		if (dependencyFile.Open(dependency))
+			key = HashMemory(dependencyFile.GetData(), dependencyFile.GetSize(), key);
+	}
+	// 0 is reserved for "no key"
+	return key ? key : 1;
+}
+
+std::string MeshCache::GetCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".ymesh";
+}
+
+bool MeshCache::Load(const std::string& cachePath, uint64_t key, ModelData& modelData)
+{
+	if (key == 0)
+		return false;
+
+	MappedFile file;
+	if (!file.Open(cachePath) || file.GetSize() < sizeof(CookedHeader))
+		return false;
+
+	const uint8_t* data = file.GetData();
+	const uint64_t fileSize = file.GetSize();
+
+	CookedHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	// Reject stale or foreign files
+	if (memcmp(header.Magic, s_CookedMagic, sizeof(s_CookedMagic)) != 0 || header.Version != s_CookedVersion
+		|| header.Key != key || header.VertexStride != sizeof(Vertex) || header.CompactVertexStride != sizeof(CompactVertex)
+		|| header.MeshletStride != sizeof(Meshlet) || header.FileSize != fileSize)
+	{
+		return false;
+	}
+
+	// Validate table bounds before trusting any offsets
+	if (header.SubMeshTableOffset + uint64_t(header.SubMeshCount) * sizeof(SubMeshData) > fileSize
+		|| header.VertexDataOffset + header.VertexDataSize > fileSize
+		|| header.IndexDataOffset + header.IndexDataSize > fileSize
+		|| header.MeshletDataOffset + header.MeshletCount * sizeof(Meshlet) > fileSize
+		|| header.MaterialTableOffset > fileSize)
+	{
+		return false;
+	}
+
+	// Material table: [uint32 length][chars] per material, each entry padded to 4 bytes
+	std::vector<std::string> textureNames(header.MaterialCount);
+	uint64_t cursor = header.MaterialTableOffset;
+	for (uint32_t i = 0; i < header.MaterialCount; i++)
+	{
+		uint32_t length;
+		if (cursor + sizeof(length) > fileSize)
+			return false;
+		memcpy(&length, data + cursor, sizeof(length));
+		cursor += sizeof(length);
+
+		if (cursor + length > fileSize)
+			return false;
+		textureNames[i].assign(reinterpret_cast<const char*>(data + cursor), length);
+		cursor = AlignUp(cursor + length, 4);
+	}
+
+	std::vector<SubMeshData> subMeshes(header.SubMeshCount);
+	memcpy(subMeshes.data(), data + header.SubMeshTableOffset, subMeshes.size() * sizeof(SubMeshData));
+
+	const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(data + header.MeshletDataOffset);
+	for (const auto& subMesh : subMeshes)
+	{
+		if ((subMesh.Format != VertexFormat::Full && subMesh.Format != VertexFormat::Compact)
+			|| (subMesh.IndexSize != sizeof(uint16_t) && subMesh.IndexSize != sizeof(uint32_t))
+			|| subMesh.VertexDataOffset + uint64_t(subMesh.VertexCount) * GetVertexStride(subMesh.Format) > header.VertexDataSize
+			|| subMesh.IndexDataOffset + uint64_t(subMesh.IndexCount) * subMesh.IndexSize > header.IndexDataSize
+			|| uint64_t(subMesh.FirstMeshlet) + subMesh.MeshletCount > header.MeshletCount
+			|| subMesh.LodCount == 0 || subMesh.LodCount > MAX_MESH_LODS
+			|| subMesh.MaterialIndex >= header.MaterialCount)
+		{
+			return false;
+		}
+
+		for (uint32_t level = 0; level < subMesh.LodCount; level++)
+		{
+			const MeshLod& lod = subMesh.Lods[level];
+			if (uint64_t(lod.FirstIndex) + lod.IndexCount > subMesh.IndexCount
+				|| uint64_t(lod.FirstMeshlet) + lod.MeshletCount > subMesh.MeshletCount)
+			{
+				return false;
+			}
+		}
+
+		// Culling copies meshlet index ranges, they must stay inside the sub-mesh
+		for (uint32_t i = 0; i < subMesh.MeshletCount; i++)
+		{
+			const Meshlet& meshlet = meshlets[subMesh.FirstMeshlet + i];
+			if (uint64_t(meshlet.FirstIndex) + uint64_t(meshlet.TriangleCount) * 3 > subMesh.IndexCount)
+				return false;
+		}
+	}
+
+	// Hit: geometry views point straight into the mapping
+	modelData.TextureNames = std::move(textureNames);
+	modelData.SubMeshes = std::move(subMeshes);
+	modelData.VertexStorage.clear();
+	modelData.IndexStorage.clear();
+	modelData.MeshletStorage.clear();
+	modelData.VertexData = data + header.VertexDataOffset;
+	modelData.IndexData = data + header.IndexDataOffset;
+	modelData.MeshletData = meshlets;
+	modelData.VertexDataSize = static_cast<size_t>(header.VertexDataSize);
+	modelData.IndexDataSize = static_cast<size_t>(header.IndexDataSize);
+	modelData.MeshletCount = static_cast<size_t>(header.MeshletCount);
+	modelData.CookedFile = std::move(file);
+
+	return true;
+}
+
+bool MeshCache::Save(const std::string& cachePath, uint64_t key, const ModelData& modelData)
+{
+	if (key == 0)
+		return false;
+
+	// Build the material table
+	std::vector<uint8_t> materialTable;
+	for (const auto& name : modelData.TextureNames)
+	{
+		uint32_t length = static_cast<uint32_t>(name.size());
+		size_t offset = materialTable.size();
+		materialTable.resize(AlignUp(offset + sizeof(length) + length, 4), 0);
+		memcpy(materialTable.data() + offset, &length, sizeof(length));
+		memcpy(materialTable.data() + offset + sizeof(length), name.data(), length);
+	}
+
+	// Lay out the file, blobs are aligned so they can be read in place
+	CookedHeader header = {};
+	memcpy(header.Magic, s_CookedMagic, sizeof(s_CookedMagic));
+	header.Version = s_CookedVersion;
+	header.Key = key;
+	header.VertexStride = sizeof(Vertex);
+	header.CompactVertexStride = sizeof(CompactVertex);
+	header.MeshletStride = sizeof(Meshlet);
+	header.SubMeshCount = static_cast<uint32_t>(modelData.SubMeshes.size());
+	header.MaterialCount = static_cast<uint32_t>(modelData.TextureNames.size());
+	header.MaterialTableOffset = sizeof(CookedHeader);
+	header.SubMeshTableOffset = AlignUp(header.MaterialTableOffset + materialTable.size(), s_BlobAlignment);
+	header.VertexDataOffset = AlignUp(header.SubMeshTableOffset + modelData.SubMeshes.size() * sizeof(SubMeshData), s_BlobAlignment);
+	header.VertexDataSize = modelData.VertexDataSize;
+	header.IndexDataOffset = AlignUp(header.VertexDataOffset + modelData.VertexDataSize, s_BlobAlignment);
+	header.IndexDataSize = modelData.IndexDataSize;
+	header.MeshletDataOffset = AlignUp(header.IndexDataOffset + modelData.IndexDataSize, s_BlobAlignment);
+	header.MeshletCount = modelData.MeshletCount;
+	header.FileSize = header.MeshletDataOffset + modelData.MeshletCount * sizeof(Meshlet);
+
+	// Write to a temporary file first so a crash never leaves a half written cache behind
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		const char zeros[s_BlobAlignment] = {};
+		auto writeAt = [&](uint64_t offset, const void* source, size_t size)
+		{
+			// Pad up to the requested offset
+			uint64_t position = static_cast<uint64_t>(file.tellp());
+			if (position < offset)
+				file.write(zeros, static_cast<std::streamsize>(offset - position));
+			if (size > 0)
+				file.write(static_cast<const char*>(source), static_cast<std::streamsize>(size));
+		};
+
+		writeAt(0, &header, sizeof(header));
+		writeAt(header.MaterialTableOffset, materialTable.data(), materialTable.size());
+		writeAt(header.SubMeshTableOffset, modelData.SubMeshes.data(), modelData.SubMeshes.size() * sizeof(SubMeshData));
+		writeAt(header.VertexDataOffset, modelData.VertexData, modelData.VertexDataSize);
+		writeAt(header.IndexDataOffset, modelData.IndexData, modelData.IndexDataSize);
+		writeAt(header.MeshletDataOffset, modelData.MeshletData, modelData.MeshletCount * sizeof(Meshlet));
+
+		if (!file.good())
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	// Replace the old cache (rename doesn`t overwrite on Windows)
+	std::remove(cachePath.c_str());
+	if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include "ModelData.h"
+
+// Cooked binary mesh format (.ymesh)
+// Stores the final vertex/index blobs (already in their GPU layout), the meshlets, the sub-mesh table and the material texture names
+// of an imported model, so warm starts can skip Assimp and copy straight from the mapped file
+class MeshCache
+{
+public:
+	// Cache key: content hash of the source file and the files it references (OBJ material libraries, glTF buffers)
+	// combined with the import flags
+	static uint64_t ComputeKey(const std::string& sourcePath, uint32_t importFlags);
+
+	static std::string GetCachePath(const std::string& sourcePath);
+
+	// Map a cooked file; returns false on a miss (no file, stale key or incompatible layout)
+	static bool Load(const std::string& cachePath, uint64_t key, ModelData& modelData);
+	// Write model data to a cooked file; returns false if the file couldn`t be written
+	static bool Save(const std::string& cachePath, uint64_t key, const ModelData& modelData);
+};
@@ -0,0 +1,188 @@
+#include "MeshCuller.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <immintrin.h>
+#define YUME_CULL_SSE
+#endif
+#if defined(__AVX__)
+#define YUME_CULL_AVX
+#endif
+
+void MeshCuller::Clear()
+{
+	for (auto* values : { &m_MinX, &m_MinY, &m_MinZ, &m_MaxX, &m_MaxY, &m_MaxZ, &m_CenterX, &m_CenterY, &m_CenterZ, &m_Radius })
+	{
+		values->clear();
+	}
+	m_CulledIndices.clear();
+	m_Visible.clear();
+}
+
+void MeshCuller::Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec4& boundingSphere, const glm::mat4& model)
+{
+	glm::vec3 worldMin, worldMax;
+	TransformBounds(boundsMin, boundsMax, model, worldMin, worldMax);
+
+	m_MinX.push_back(worldMin.x);
+	m_MinY.push_back(worldMin.y);
+	m_MinZ.push_back(worldMin.z);
+	m_MaxX.push_back(worldMax.x);
+	m_MaxY.push_back(worldMax.y);
+	m_MaxZ.push_back(worldMax.z);
+
+	// Non uniform scale stretches the sphere, the largest axis scale keeps it enclosing
+	const glm::vec3 sphereCenter = glm::vec3(model * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+	const float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	m_CenterX.push_back(sphereCenter.x);
+	m_CenterY.push_back(sphereCenter.y);
+	m_CenterZ.push_back(sphereCenter.z);
+	m_Radius.push_back(boundingSphere.w * scale);
+}
+
+void MeshCuller::AddCulled()
+{
+	// Still takes its lanes, so indices stay 1:1 with the add order
+	m_CulledIndices.push_back(m_MinX.size());
+	Add(glm::vec3(0.0f), glm::vec3(0.0f), glm::vec4(0.0f), glm::mat4(1.0f));
+}
+
+void MeshCuller::Cull(const glm::mat4& viewProjection)
+{
+	glm::vec4 planes[6];
+	ExtractFrustumPlanes(viewProjection, planes);
+
+	const size_t count = m_MinX.size();
+	m_Visible.assign(count, 0);
+	size_t i = 0;
+
+#ifdef YUME_CULL_AVX
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256 minX = _mm256_loadu_ps(&m_MinX[i]), minY = _mm256_loadu_ps(&m_MinY[i]), minZ = _mm256_loadu_ps(&m_MinZ[i]);
+		const __m256 maxX = _mm256_loadu_ps(&m_MaxX[i]), maxY = _mm256_loadu_ps(&m_MaxY[i]), maxZ = _mm256_loadu_ps(&m_MaxZ[i]);
+		const __m256 centerX = _mm256_loadu_ps(&m_CenterX[i]), centerY = _mm256_loadu_ps(&m_CenterY[i]), centerZ = _mm256_loadu_ps(&m_CenterZ[i]);
+		const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&m_Radius[i]));
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			const __m256 normalX = _mm256_set1_ps(planes[p].x);
+			const __m256 normalY = _mm256_set1_ps(planes[p].y);
+			const __m256 normalZ = _mm256_set1_ps(planes[p].z);
+			const __m256 distance = _mm256_set1_ps(planes[p].w);
+
+			// Sphere center further than the radius behind the plane
+			const __m256 centerDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX, centerX), _mm256_mul_ps(normalY, centerY)),
+				_mm256_add_ps(_mm256_mul_ps(normalZ, centerZ), distance));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(centerDistance, negativeRadius, _CMP_LT_OQ));
+
+			// Box corner furthest along the normal behind the plane (the plane is the same for every lane, so is the corner)
+			const __m256 cornerX = planes[p].x >= 0.0f ? maxX : minX;
+			const __m256 cornerY = planes[p].y >= 0.0f ? maxY : minY;
+			const __m256 cornerZ = planes[p].z >= 0.0f ? maxZ : minZ;
+			const __m256 cornerDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX, cornerX), _mm256_mul_ps(normalY, cornerY)),
+				_mm256_add_ps(_mm256_mul_ps(normalZ, cornerZ), distance));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(cornerDistance, _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		const int outsideMask = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			m_Visible[i + lane] = (outsideMask >> lane & 1) == 0;
+		}
+	}
+#endif
+
+#ifdef YUME_CULL_SSE
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 minX = _mm_loadu_ps(&m_MinX[i]), minY = _mm_loadu_ps(&m_MinY[i]), minZ = _mm_loadu_ps(&m_MinZ[i]);
+		const __m128 maxX = _mm_loadu_ps(&m_MaxX[i]), maxY = _mm_loadu_ps(&m_MaxY[i]), maxZ = _mm_loadu_ps(&m_MaxZ[i]);
+		const __m128 centerX = _mm_loadu_ps(&m_CenterX[i]), centerY = _mm_loadu_ps(&m_CenterY[i]), centerZ = _mm_loadu_ps(&m_CenterZ[i]);
+		const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&m_Radius[i]));
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			const __m128 normalX = _mm_set1_ps(planes[p].x);
+			const __m128 normalY = _mm_set1_ps(planes[p].y);
+			const __m128 normalZ = _mm_set1_ps(planes[p].z);
+			const __m128 distance = _mm_set1_ps(planes[p].w);
+
+			const __m128 centerDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_mul_ps(normalY, centerY)),
+				_mm_add_ps(_mm_mul_ps(normalZ, centerZ), distance));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(centerDistance, negativeRadius));
+
+			const __m128 cornerX = planes[p].x >= 0.0f ? maxX : minX;
+			const __m128 cornerY = planes[p].y >= 0.0f ? maxY : minY;
+			const __m128 cornerZ = planes[p].z >= 0.0f ? maxZ : minZ;
+			const __m128 cornerDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, cornerX), _mm_mul_ps(normalY, cornerY)),
+				_mm_add_ps(_mm_mul_ps(normalZ, cornerZ), distance));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(cornerDistance, _mm_setzero_ps()));
+		}
+
+		const int outsideMask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			m_Visible[i + lane] = (outsideMask >> lane & 1) == 0;
+		}
+	}
+#endif
+
+	// Whatever doesn`t fill a register
+	CullScalar(planes, i, count);
+
+	for (size_t index : m_CulledIndices)
+	{
+		m_Visible[index] = 0;
+	}
+
+	m_Stats.MeshCount = static_cast<uint32_t>(count);
+	m_Stats.VisibleMeshCount = 0;
+	for (uint8_t visible : m_Visible)
+	{
+		m_Stats.VisibleMeshCount += visible;
+	}
+	m_Stats.CulledMeshCount = m_Stats.MeshCount - m_Stats.VisibleMeshCount;
+}
+
+void MeshCuller::CullScalar(const glm::vec4* planes, size_t first, size_t last)
+{
+	for (size_t i = first; i < last; i++)
+	{
+		bool isOutside = false;
+		for (int p = 0; p < 6 && !isOutside; p++)
+		{
+			const glm::vec4& plane = planes[p];
+			const float centerDistance = plane.x * m_CenterX[i] + plane.y * m_CenterY[i] + plane.z * m_CenterZ[i] + plane.w;
+			const float cornerDistance = plane.x * (plane.x >= 0.0f ? m_MaxX[i] : m_MinX[i])
+				+ plane.y * (plane.y >= 0.0f ? m_MaxY[i] : m_MinY[i]) + plane.z * (plane.z >= 0.0f ? m_MaxZ[i] : m_MinZ[i]) + plane.w;
+			isOutside = centerDistance < -m_Radius[i] || cornerDistance < 0.0f;
+		}
+		m_Visible[i] = !isOutside;
+	}
+}
+
+// Near is taken from the OpenGL range (w + z), a little wider than the 0..1 depth one, so it never culls too much
+void MeshCuller::ExtractFrustumPlanes(const glm::mat4& clip, glm::vec4* planes)
+{
+	const glm::vec4 row0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+	const glm::vec4 row1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+	const glm::vec4 row2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+	const glm::vec4 row3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+
+	planes[0] = row3 + row0;	// left
+	planes[1] = row3 - row0;	// right
+	planes[2] = row3 + row1;	// bottom
+	planes[3] = row3 - row1;	// top
+	planes[4] = row3 + row2;	// near
+	planes[5] = row3 - row2;	// far
+
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
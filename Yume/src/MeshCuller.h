@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "Utils.h"
+
+struct MeshCullStats
+{
+	uint32_t MeshCount = 0;
+	uint32_t VisibleMeshCount = 0;
+	uint32_t CulledMeshCount = 0;
+};
+
+// Per-frame frustum culling of whole meshes
+// World space boxes and spheres are kept as structure of arrays, so the six plane tests run on 4 (SSE) or 8 (AVX) meshes at once
+// A mesh is culled when either its sphere or its box is fully outside one plane
+class MeshCuller
+{
+public:
+	// Forget the meshes of the last frame
+	void Clear();
+	// Add a mesh by its object space box and sphere and the model matrix placing it, indices follow the add order
+	void Add(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec4& boundingSphere, const glm::mat4& model);
+	// Add a mesh already known to be outside (its model failed a coarser test), it is counted as culled
+	void AddCulled();
+
+	// Test every added mesh against the frustum of the view projection matrix
+	void Cull(const glm::mat4& viewProjection);
+	bool IsVisible(size_t index) const { return m_Visible[index] != 0; }
+
+	// Counts of the last Cull
+	MeshCullStats GetStats() const { return m_Stats; }
+
+	// Normalized planes (xyz normal pointing inside, w distance) of the frustum of a clip matrix, in the space the matrix maps from
+	static void ExtractFrustumPlanes(const glm::mat4& clip, glm::vec4* planes);
+
+private:
+	// Test meshes [first, last) one at a time
+	void CullScalar(const glm::vec4* planes, size_t first, size_t last);
+
+private:
+	// World space boxes
+	std::vector<float> m_MinX, m_MinY, m_MinZ;
+	std::vector<float> m_MaxX, m_MaxY, m_MaxZ;
+	// World space spheres
+	std::vector<float> m_CenterX, m_CenterY, m_CenterZ, m_Radius;
+
+	std::vector<size_t> m_CulledIndices;	// added with AddCulled
+
+	std::vector<uint8_t> m_Visible;
+	MeshCullStats m_Stats;
+};
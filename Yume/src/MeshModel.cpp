@@ -1,21 +1,21 @@
 #include "MeshModel.h"
 
+#include <algorithm>
+
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include "MeshPacker.h"
+#include "MeshSimplifier.h"
 
-MeshModel::MeshModel(std::vector<Mesh>& meshList)
-	: m_MeshList(meshList)
-{
-	m_Model = glm::mat4(1.0f);
-}
 
 const Mesh& MeshModel::GetMesh(size_t index) const
 {
-	// TODO: insert return statement here
-	if (index >= m_MeshList.size())
+	if (!m_Asset)
 	{
 		throw std::runtime_error("Attempted to access invalid mesh index");
 	}
 
-	return m_MeshList[index];
+	return m_Asset->GetMesh(index);
 }
 
 void MeshModel::SetModel(glm::mat4& newModel)
@@ -23,12 +23,39 @@ void MeshModel::SetModel(glm::mat4& newModel)
 	m_Model = newModel;
 }
 
-void MeshModel::DestroyMeshModel()
+void MeshModel::GetWorldBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const
 {
-	for (auto& mesh : m_MeshList)
+	if (GetMeshCount() == 0)
 	{
-		mesh.DestroyBuffers();
+		boundsMin = boundsMax = glm::vec3(m_Model[3]);
+		return;
 	}
+
+	TransformBounds(m_Asset->GetBoundsMin(), m_Asset->GetBoundsMax(), m_Model, boundsMin, boundsMax);
+}
+
+uint32_t MeshModel::SelectLod(const glm::vec3& cameraPosition, float pixelsPerUnit, float maxPixelError) const
+{
+	if (!m_Asset || m_Asset->GetLodCount() <= 1)
+		return 0;
+
+	// Errors are in object space, scale them (and the sphere) by the largest axis scale of the model matrix
+	const glm::vec4& boundingSphere = m_Asset->GetBoundingSphere();
+	const float scale = std::max({ glm::length(glm::vec3(m_Model[0])), glm::length(glm::vec3(m_Model[1])),
+		glm::length(glm::vec3(m_Model[2])) });
+	const glm::vec3 center = glm::vec3(m_Model * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+
+	// Nearest point of the sphere, full detail when the camera is inside
+	const float distance = glm::length(cameraPosition - center) - boundingSphere.w * scale;
+	if (distance <= 0.0f)
+		return 0;
+
+	for (uint32_t level = m_Asset->GetLodCount() - 1; level > 0; level--)
+	{
+		if (m_Asset->GetLodError(level) * scale / distance * pixelsPerUnit <= maxPixelError)
+			return level;
+	}
+	return 0;
 }
 
 std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
@@ -63,36 +90,33 @@ std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
 	return textureList;
 }
 
-std::vector<Mesh> MeshModel::LoadNode(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int>& materialToTexture)
+void MeshModel::LoadNode(aiNode* node, const aiScene* scene, ModelData& modelData)
 {
-	std::vector<Mesh> meshList;
-
-	// Go through each mesh at this node and create it, then add it out meshList
+	// Go through each mesh at this node and append it to the model data
 	for (size_t i = 0; i < node->mNumMeshes; i++)
 	{
-		// Load mesh and push back to mesh list
-		auto mesh = LoadMesh(newPhysicaldDevice, newDevice, transferQueue,
-			transferCommandPool, scene->mMeshes[node->mMeshes[i]], scene, materialToTexture);
-		meshList.push_back(mesh);
+		LoadMesh(scene->mMeshes[node->mMeshes[i]], scene, modelData);
 	}
 
-	// Go through each node attached to this node and load it, then append their meshs to his node`s  mesh list
+	// Go through each node attached to this node and load it
 	for (size_t i = 0; i < node->mNumChildren; i++)
 	{
-		std::vector<Mesh> newList = LoadNode(newPhysicaldDevice, newDevice, transferQueue,
-			transferCommandPool, node->mChildren[i], scene, materialToTexture);
-		meshList.insert(meshList.end(), newList.begin(), newList.end());
+		LoadNode(node->mChildren[i], scene, modelData);
 	}
-
-	return meshList;
 }
 
-Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue, VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int>& materialToTexture)
+void MeshModel::LoadMesh(aiMesh* mesh, const aiScene* scene, ModelData& modelData)
 {
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	ExtractMesh(mesh, vertices, indices);
+
+	AppendMesh(vertices, indices, mesh->mMaterialIndex, modelData);
+}
 
-	// Resize vertex lit to hold all vertices for mesh
+void MeshModel::ExtractMesh(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	// Resize vertex list to hold all vertices for mesh
 	vertices.resize(mesh->mNumVertices);
 
 	// Go through each vertex and copy it across to our vertices
@@ -122,28 +146,73 @@ Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice
 			tempNormal = tempNormal.Normalize();
 			vertices[i].NormalCoords = { tempNormal.x, tempNormal.y, tempNormal.z };
 		}
+		else
+		{
+			vertices[i].NormalCoords = { 0.0f, 0.0f, 0.0f };
+		}
 	}
 
 	// Iterate over indices through faces and copy across
+	indices.clear();
+	indices.reserve(mesh->mNumFaces * 3);
 	for (size_t i = 0; i < mesh->mNumFaces; i++)
 	{
 		// Get a face
-		aiFace face = mesh->mFaces[i];
+		const aiFace& face = mesh->mFaces[i];
 		// Go through face`s indices and add to list
 		for (size_t j = 0; j < face.mNumIndices; j++)
 		{
 			indices.push_back(face.mIndices[j]);
 		}
 	}
-
-	// Create mesh and return it
-	Mesh newMesh = Mesh(newPhysicaldDevice, newDevice, transferQueue,
-		transferCommandPool, &vertices, &indices, materialToTexture[mesh->mMaterialIndex]);
-
-	return newMesh;
 }
 
-MeshModel::~MeshModel()
+void MeshModel::AppendMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+	uint32_t materialIndex, ModelData& modelData)
 {
-	//DestroyMeshModel();
+	// Reorder for the post-transform vertex cache (and overdraw), then renumber vertices in fetch order
+	const VertexCacheStats statsBefore = MeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+	MeshOptimizer::OptimizeVertexCache(indices, vertices.size());
+	if (OPTIMIZE_MESH_OVERDRAW)
+	{
+		MeshOptimizer::OptimizeOverdraw(indices, vertices, 1.05f);
+	}
+	MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+	const VertexCacheStats statsAfter = MeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+
+	SubMeshImportStats importStats;
+	importStats.ACMRBefore = statsBefore.ACMR;
+	importStats.ACMRAfter = statsAfter.ACMR;
+	importStats.ATVRBefore = statsBefore.ATVR;
+	importStats.ATVRAfter = statsAfter.ATVR;
+
+	// Coarser levels for distant draws, each simplified from the previous one (errors add up) and reordered for the
+	// vertex cache, the vertices stay shared
+	std::vector<MeshLodData> lods(1);
+	lods[0].Indices = std::move(indices);
+	while (GENERATE_MESH_LODS && lods.size() < MAX_MESH_LODS)
+	{
+		const MeshLodData& previous = lods.back();
+
+		MeshLodData lod;
+		const float error = MeshSimplifier::Simplify(vertices, previous.Indices, previous.Indices.size() / 2 / 3 * 3, lod.Indices);
+
+		// Locked borders and seams stop the collapse early, a level that barely shrinks isn`t worth its memory
+		if (lod.Indices.empty() || lod.Indices.size() * 4 > previous.Indices.size() * 3)
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(lod.Indices, vertices.size());
+		lod.Error = previous.Error + error;
+		lods.push_back(std::move(lod));
+	}
+
+	for (auto& lod : lods)
+	{
+		// Clusters for per-frame culling, in the final index order
+		lod.Meshlets = MeshletBuilder::Build(vertices, lod.Indices);
+	}
+
+	// Write it into the model blobs in its GPU layout
+	MeshPacker::AppendSubMesh(vertices, lods, materialIndex, modelData);
+	modelData.ImportStats.push_back(importStats);
 }
@@ -5,33 +5,42 @@
 
 #include <vector>
 
+#include "AssetRegistry.h"
 #include "Mesh.h"
+#include "ModelData.h"
 
+// Scene model: a transform and a handle to the mesh asset it draws (shared with every model of the same file)
 class MeshModel
 {
 public:
 	MeshModel() = default;
-	MeshModel(std::vector<Mesh>& meshList);
-	
+	explicit MeshModel(const MeshHandle& asset) : m_Asset(asset) {}
 
-	size_t GetMeshCount() { return m_MeshList.size(); }
+	// Empty until the asset is set, streamed assets grow one mesh at a time
+	size_t GetMeshCount() const { return m_Asset ? m_Asset->GetMeshCount() : 0; }
 	const Mesh& GetMesh(size_t index) const;
+	const MeshHandle& GetAsset() const { return m_Asset; }
 
 	glm::mat4 GetModel() { return m_Model; }
 	void SetModel(glm::mat4& newModel);
+	// World space box around the meshes uploaded so far (a point at the model origin while there are none)
+	void GetWorldBounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
 
-	void DestroyMeshModel();
+	// Coarsest level of detail whose error projects to at most maxPixelError pixels
+	// pixelsPerUnit: pixels a unit long object covers one unit in front of the camera
+	uint32_t SelectLod(const glm::vec3& cameraPosition, float pixelsPerUnit, float maxPixelError) const;
 
 	static std::vector<std::string> LoadMaterials(const aiScene* scene);
-	static std::vector<Mesh> LoadNode(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue,
-		VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene, std::vector<int>& materialToTexture);
-	static Mesh LoadMesh(VkPhysicalDevice newPhysicaldDevice, VkDevice newDevice, VkQueue transferQueue,
-		VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene, std::vector<int>& materialToTexture);
-
-	~MeshModel();
+	// Append the geometry of a node (and its children) to the model`s vertex/index/meshlet blobs
+	static void LoadNode(aiNode* node, const aiScene* scene, ModelData& modelData);
+	static void LoadMesh(aiMesh* mesh, const aiScene* scene, ModelData& modelData);
+	// Vertices and triangle indices of an Assimp mesh
+	static void ExtractMesh(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+	// Optimize a mesh, build its levels of detail and meshlets and append it to the model blobs
+	static void AppendMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices,
+		uint32_t materialIndex, ModelData& modelData);
 
 private:
-	std::vector<Mesh> m_MeshList;
-	glm::mat4 m_Model;
+	MeshHandle m_Asset;
+	glm::mat4 m_Model = glm::mat4(1.0f);
 };
-
@@ -0,0 +1,299 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Misses per triangle of a FIFO cache, the cache is emptied whenever resetAt[triangle] is set
+class FifoCache
+{
+public:
+	explicit FifoCache(size_t vertexCount)
+		: m_Timestamps(vertexCount, 0), m_Time(MeshOptimizer::VertexCacheSize + 1)
+	{
+	}
+
+	// true on a miss (the vertex gets transformed and pushed)
+	bool Access(uint32_t vertex)
+	{
+		if (m_Time - m_Timestamps[vertex] <= MeshOptimizer::VertexCacheSize)
+			return false;
+
+		m_Timestamps[vertex] = m_Time++;
+		return true;
+	}
+
+	void Reset() { m_Time += MeshOptimizer::VertexCacheSize + 1; }
+
+private:
+	std::vector<uint32_t> m_Timestamps;
+	uint32_t m_Time;
+};
+
+// Triangles using each vertex, flattened (triangles of vertex v are Triangles[Offsets[v]..Offsets[v + 1]])
+struct VertexAdjacency
+{
+	std::vector<uint32_t> Offsets;
+	std::vector<uint32_t> Triangles;
+
+	VertexAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount)
+		: Offsets(vertexCount + 1, 0), Triangles(indices.size())
+	{
+		for (uint32_t index : indices)
+			Offsets[index + 1]++;
+		std::partial_sum(Offsets.begin(), Offsets.end(), Offsets.begin());
+
+		std::vector<uint32_t> cursors(Offsets.begin(), Offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			Triangles[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+};
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || vertexCount == 0)
+		return stats;
+
+	FifoCache cache(vertexCount);
+	std::vector<bool> isUsed(vertexCount, false);
+	size_t misses = 0;
+	size_t usedCount = 0;
+
+	for (uint32_t index : indices)
+	{
+		misses += cache.Access(index) ? 1 : 0;
+		if (!isUsed[index])
+		{
+			isUsed[index] = true;
+			usedCount++;
+		}
+	}
+
+	stats.ACMR = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+	stats.ATVR = static_cast<float>(misses) / static_cast<float>(usedCount);
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	// Sander, Nehab, Barczak - Fast Triangle Reordering for Vertex Locality and Reduced Overdraw (2007)
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	const VertexAdjacency adjacency(indices, vertexCount);
+	const int64_t cacheSize = VertexCacheSize;
+
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		liveTriangles[v] = adjacency.Offsets[v + 1] - adjacency.Offsets[v];
+
+	std::vector<int64_t> timestamps(vertexCount, 0);
+	std::vector<bool> isEmitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;			// recently used vertices, where fanning continues after a dead end
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> optimizedIndices;
+	optimizedIndices.reserve(indices.size());
+
+	int64_t time = cacheSize + 1;
+	size_t cursor = 0;						// scan position for the next vertex with live triangles
+	int64_t fanningVertex = 0;
+
+	while (fanningVertex >= 0)
+	{
+		candidates.clear();
+
+		// Emit every triangle left around the fanning vertex
+		for (uint32_t i = adjacency.Offsets[fanningVertex]; i < adjacency.Offsets[fanningVertex + 1]; i++)
+		{
+			const uint32_t triangle = adjacency.Triangles[i];
+			if (isEmitted[triangle])
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				optimizedIndices.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+
+				// Not in the cache: gets transformed and pushed
+				if (time - timestamps[vertex] > cacheSize)
+					timestamps[vertex] = time++;
+			}
+			isEmitted[triangle] = true;
+		}
+
+		// Next fanning vertex: the candidate that stays in the cache the longest
+		// while all its remaining triangles are emitted
+		int64_t bestVertex = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (time - timestamps[vertex] + 2 * int64_t(liveTriangles[vertex]) <= cacheSize)
+				priority = time - timestamps[vertex];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				bestVertex = vertex;
+			}
+		}
+
+		// Dead end: most recently used vertex with live triangles, else the next one in input order
+		while (bestVertex < 0 && !deadEnds.empty())
+		{
+			const uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0)
+				bestVertex = vertex;
+		}
+		while (bestVertex < 0 && cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+				bestVertex = static_cast<int64_t>(cursor);
+			cursor++;
+		}
+
+		fanningVertex = bestVertex;
+	}
+
+	indices.swap(optimizedIndices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Misses of every triangle in the cache optimized order
+	std::vector<uint32_t> triangleMisses(triangleCount);
+	{
+		FifoCache cache(vertices.size());
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			triangleMisses[t] = 0;
+			for (int corner = 0; corner < 3; corner++)
+				triangleMisses[t] += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+		}
+	}
+
+	// Hard boundaries where the cache was flushed anyway (no vertex shared with the recent triangles),
+	// clusters starting there cost nothing extra when moved
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (t == 0 || triangleMisses[t] == 3)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries: split a hard cluster again once a part of it (starting with a cold cache)
+	// gets close enough to the cluster ACMR
+	std::vector<size_t> clusters;
+	FifoCache cache(vertices.size());
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+	{
+		const size_t start = hardBoundaries[h];
+		const size_t end = hardBoundaries[h + 1];
+
+		size_t clusterMisses = 0;
+		for (size_t t = start; t < end; t++)
+			clusterMisses += triangleMisses[t];
+		const float targetACMR = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+		clusters.push_back(start);
+		cache.Reset();
+		size_t misses = 0;
+		size_t clusterStart = start;
+
+		for (size_t t = start; t < end; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+				misses += cache.Access(indices[t * 3 + corner]) ? 1 : 0;
+
+			// Tiny clusters make the sort noisy, keep at least a fan worth of triangles
+			const size_t clusterSize = t + 1 - clusterStart;
+			if (clusterSize >= 8 && t + 1 < end && static_cast<float>(misses) / static_cast<float>(clusterSize) <= targetACMR)
+			{
+				clusters.push_back(t + 1);
+				clusterStart = t + 1;
+				misses = 0;
+				cache.Reset();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Mesh centroid
+	glm::vec3 meshCentroid(0.0f);
+	for (const auto& vertex : vertices)
+		meshCentroid += vertex.Position;
+	meshCentroid /= static_cast<float>(vertices.size());
+
+	// Clusters facing away from the centroid are on the outside, draw them first
+	const size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[t * 3 + 0]].Position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+
+			// Area weighted
+			const glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+			const float triangleArea = glm::length(triangleNormal);
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += triangleNormal;
+			area += triangleArea;
+		}
+
+		const float normalLength = glm::length(normal);
+		sortKeys[c] = area > 0.0f && normalLength > 0.0f ? glm::dot(centroid / area - meshCentroid, normal / normalLength) : 0.0f;
+	}
+
+	std::vector<size_t> clusterOrder(clusterCount);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> sortedIndices;
+	sortedIndices.reserve(indices.size());
+	for (size_t c : clusterOrder)
+	{
+		sortedIndices.insert(sortedIndices.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+
+	indices.swap(sortedIndices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex> fetchOrderVertices;
+	fetchOrderVertices.reserve(vertices.size());
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = static_cast<uint32_t>(fetchOrderVertices.size());
+			fetchOrderVertices.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(fetchOrderVertices);
+}
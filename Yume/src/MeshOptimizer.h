@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "Utils.h"
+
+// Post-transform vertex cache efficiency of an index buffer (simulated FIFO cache)
+struct VertexCacheStats
+{
+	float ACMR = 0.0f;		// average cache miss ratio: transformed vertices per triangle (0.5 best, 3 worst)
+	float ATVR = 0.0f;		// average transform to vertex ratio: transformed vertices per unique vertex (1 best)
+};
+
+// Import time mesh optimization, run before the mesh is packed
+// Triangles are reordered for the vertex cache (Tipsify) and optionally for overdraw (clusters sorted
+// outside in), then vertices are renumbered in the order the GPU fetches them
+class MeshOptimizer
+{
+public:
+	// Cache size the reordering targets and the stats are simulated with
+	static const uint32_t VertexCacheSize = 16;
+
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Tipsify: fan around the vertex most likely still in the cache
+	static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+	// Split the cache ordered triangles into clusters and sort those so outward facing ones draw first
+	// threshold: how much ACMR may grow for it (1.05 = 5%)
+	static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold);
+	// Renumber vertices in first use order (drops unreferenced vertices)
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+};
@@ -0,0 +1,202 @@
+#include "MeshPacker.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Blob offsets stay aligned so cooked files can be read in place
+static const size_t s_VertexBlobAlignment = 16;
+static const size_t s_IndexBlobAlignment = 4;
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint16_t QuantizeUnorm16(float value, float minValue, float extent)
+{
+	const float normalized = extent > 0.0f ? (value - minValue) / extent : 0.0f;
+	return static_cast<uint16_t>(std::lround(std::min(std::max(normalized, 0.0f), 1.0f) * 65535.0f));
+}
+
+static int16_t QuantizeSnorm16(float value)
+{
+	return static_cast<int16_t>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
+
+static bool HasSingleColor(const std::vector<Vertex>& vertices)
+{
+	for (const auto& vertex : vertices)
+	{
+		if (vertex.Color != vertices[0].Color)
+			return false;
+	}
+	return true;
+}
+
+void MeshPacker::AppendSubMesh(const std::vector<Vertex>& vertices, const std::vector<MeshLodData>& lods,
+	uint32_t materialIndex, ModelData& modelData)
+{
+	// Levels are stored one after the other in the sub-mesh indices/meshlets
+	std::vector<uint32_t> indices;
+	std::vector<Meshlet> meshlets;
+
+	SubMeshData subMesh;
+	subMesh.LodCount = static_cast<uint32_t>(std::min<size_t>(lods.size(), MAX_MESH_LODS));
+	for (uint32_t level = 0; level < subMesh.LodCount; level++)
+	{
+		MeshLod& lod = subMesh.Lods[level];
+		lod.FirstIndex = static_cast<uint32_t>(indices.size());
+		lod.IndexCount = static_cast<uint32_t>(lods[level].Indices.size());
+		lod.FirstMeshlet = static_cast<uint32_t>(meshlets.size());
+		lod.MeshletCount = static_cast<uint32_t>(lods[level].Meshlets.size());
+		lod.Error = lods[level].Error;
+
+		indices.insert(indices.end(), lods[level].Indices.begin(), lods[level].Indices.end());
+		for (Meshlet meshlet : lods[level].Meshlets)
+		{
+			meshlet.FirstIndex += lod.FirstIndex;
+			meshlets.push_back(meshlet);
+		}
+	}
+
+	subMesh.VertexCount = static_cast<uint32_t>(vertices.size());
+	subMesh.IndexCount = static_cast<uint32_t>(indices.size());
+	subMesh.MaterialIndex = materialIndex;
+	subMesh.Format = COMPACT_VERTEX_FORMAT && !vertices.empty() && HasSingleColor(vertices) ? VertexFormat::Compact : VertexFormat::Full;
+	subMesh.IndexSize = vertices.size() <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	// Vertices
+	subMesh.VertexDataOffset = AlignUp(modelData.VertexStorage.size(), s_VertexBlobAlignment);
+	modelData.VertexStorage.resize(static_cast<size_t>(subMesh.VertexDataOffset) + vertices.size() * GetVertexStride(subMesh.Format));
+	uint8_t* vertexData = modelData.VertexStorage.data() + subMesh.VertexDataOffset;
+
+	// Box for culling, sphere around the box center for culling and picking the level of detail
+	if (!vertices.empty())
+	{
+		glm::vec3 minPosition = vertices[0].Position;
+		glm::vec3 maxPosition = vertices[0].Position;
+		for (const auto& vertex : vertices)
+		{
+			minPosition = glm::min(minPosition, vertex.Position);
+			maxPosition = glm::max(maxPosition, vertex.Position);
+		}
+
+		const glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+		float radius = 0.0f;
+		for (const auto& vertex : vertices)
+		{
+			radius = std::max(radius, glm::length(vertex.Position - center));
+		}
+		subMesh.BoundingSphere = glm::vec4(center, radius);
+		subMesh.BoundsMin = minPosition;
+		subMesh.BoundsMax = maxPosition;
+	}
+
+	if (subMesh.Format == VertexFormat::Full)
+	{
+		memcpy(vertexData, vertices.data(), vertices.size() * sizeof(Vertex));
+	}
+	else
+	{
+		// Bounds the positions/uvs are quantized against
+		glm::vec3 minPosition = vertices[0].Position;
+		glm::vec3 maxPosition = vertices[0].Position;
+		glm::vec2 minTextureCoords = vertices[0].TextureCoords;
+		glm::vec2 maxTextureCoords = vertices[0].TextureCoords;
+		for (const auto& vertex : vertices)
+		{
+			minPosition = glm::min(minPosition, vertex.Position);
+			maxPosition = glm::max(maxPosition, vertex.Position);
+			minTextureCoords = glm::min(minTextureCoords, vertex.TextureCoords);
+			maxTextureCoords = glm::max(maxTextureCoords, vertex.TextureCoords);
+		}
+		const glm::vec3 positionExtent = maxPosition - minPosition;
+		const glm::vec2 textureCoordsExtent = maxTextureCoords - minTextureCoords;
+
+		subMesh.Dequantization.PositionScale = glm::vec4(positionExtent, 0.0f);
+		subMesh.Dequantization.PositionOffset = glm::vec4(minPosition, 0.0f);
+		subMesh.Dequantization.TextureCoordsScaleOffset = glm::vec4(textureCoordsExtent, minTextureCoords);
+		subMesh.Dequantization.Color = glm::vec4(vertices[0].Color, 1.0f);
+
+		CompactVertex* compactVertices = reinterpret_cast<CompactVertex*>(vertexData);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex& vertex = vertices[i];
+			CompactVertex& compactVertex = compactVertices[i];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				compactVertex.Position[axis] = QuantizeUnorm16(vertex.Position[axis], minPosition[axis], positionExtent[axis]);
+			}
+			compactVertex.Position[3] = 0;
+
+			OctahedralEncode(vertex.NormalCoords, compactVertex.NormalCoords);
+
+			for (int axis = 0; axis < 2; axis++)
+			{
+				compactVertex.TextureCoords[axis] = QuantizeUnorm16(vertex.TextureCoords[axis], minTextureCoords[axis], textureCoordsExtent[axis]);
+			}
+		}
+	}
+
+	// Indices
+	subMesh.IndexDataOffset = AlignUp(modelData.IndexStorage.size(), s_IndexBlobAlignment);
+	modelData.IndexStorage.resize(static_cast<size_t>(subMesh.IndexDataOffset) + indices.size() * subMesh.IndexSize);
+	uint8_t* indexData = modelData.IndexStorage.data() + subMesh.IndexDataOffset;
+
+	if (subMesh.IndexSize == sizeof(uint32_t))
+	{
+		memcpy(indexData, indices.data(), indices.size() * sizeof(uint32_t));
+	}
+	else
+	{
+		uint16_t* shortIndices = reinterpret_cast<uint16_t*>(indexData);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			shortIndices[i] = static_cast<uint16_t>(indices[i]);
+		}
+	}
+
+	// Meshlets
+	subMesh.FirstMeshlet = static_cast<uint32_t>(modelData.MeshletStorage.size());
+	subMesh.MeshletCount = static_cast<uint32_t>(meshlets.size());
+	modelData.MeshletStorage.insert(modelData.MeshletStorage.end(), meshlets.begin(), meshlets.end());
+
+	modelData.SubMeshes.push_back(subMesh);
+}
+
+void MeshPacker::OctahedralEncode(const glm::vec3& normal, int16_t* encoded)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1, then unfold the lower half over the diagonals
+	const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length == 0.0f)
+	{
+		// Meshes without normals, decodes to +z
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	glm::vec2 projected = glm::vec2(normal.x, normal.y) / length;
+	if (normal.z < 0.0f)
+	{
+		const glm::vec2 signs(projected.x >= 0.0f ? 1.0f : -1.0f, projected.y >= 0.0f ? 1.0f : -1.0f);
+		projected = (glm::vec2(1.0f) - glm::abs(glm::vec2(projected.y, projected.x))) * signs;
+	}
+
+	encoded[0] = QuantizeSnorm16(projected.x);
+	encoded[1] = QuantizeSnorm16(projected.y);
+}
+
+glm::vec3 MeshPacker::OctahedralDecode(const int16_t* encoded)
+{
+	// Same as OctDecode in shader.vert
+	const glm::vec2 projected(std::max(encoded[0] / 32767.0f, -1.0f), std::max(encoded[1] / 32767.0f, -1.0f));
+
+	glm::vec3 normal(projected.x, projected.y, 1.0f - std::abs(projected.x) - std::abs(projected.y));
+	const float fold = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+
+	return glm::normalize(normal);
+}
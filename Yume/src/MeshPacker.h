@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "ModelData.h"
+
+// Level of detail of a sub-mesh before packing, meshlets are relative to its indices
+struct MeshLodData
+{
+	std::vector<uint32_t> Indices;
+	std::vector<Meshlet> Meshlets;
+	float Error = 0.0f;
+};
+
+// Last step of the import: writes sub-meshes into the model`s vertex/index blobs in their GPU layout
+// Vertices are quantized into CompactVertex (positions/uvs against the sub-mesh bounds, octahedral normals)
+// when COMPACT_VERTEX_FORMAT is set and the sub-mesh has a single color, indices are 16 bit when they fit
+class MeshPacker
+{
+public:
+	// Append a sub-mesh with its levels of detail (level 0 first), indices are relative to its first vertex
+	static void AppendSubMesh(const std::vector<Vertex>& vertices, const std::vector<MeshLodData>& lods,
+		uint32_t materialIndex, ModelData& modelData);
+
+	static void OctahedralEncode(const glm::vec3& normal, int16_t* encoded);
+	static glm::vec3 OctahedralDecode(const int16_t* encoded);
+};
@@ -0,0 +1,305 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// Sum of squared distances to planes, weighted by triangle area: q(p) = p^T A p + 2 b.p + c
+struct Quadric
+{
+	double A00 = 0.0, A01 = 0.0, A02 = 0.0, A11 = 0.0, A12 = 0.0, A22 = 0.0;
+	double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+	double C = 0.0;
+	double Weight = 0.0;
+
+	void AddPlane(const glm::dvec3& normal, double distance, double weight)
+	{
+		A00 += weight * normal.x * normal.x;
+		A01 += weight * normal.x * normal.y;
+		A02 += weight * normal.x * normal.z;
+		A11 += weight * normal.y * normal.y;
+		A12 += weight * normal.y * normal.z;
+		A22 += weight * normal.z * normal.z;
+		B0 += weight * normal.x * distance;
+		B1 += weight * normal.y * distance;
+		B2 += weight * normal.z * distance;
+		C += weight * distance * distance;
+		Weight += weight;
+	}
+
+	void Add(const Quadric& other)
+	{
+		A00 += other.A00; A01 += other.A01; A02 += other.A02;
+		A11 += other.A11; A12 += other.A12; A22 += other.A22;
+		B0 += other.B0; B1 += other.B1; B2 += other.B2;
+		C += other.C;
+		Weight += other.Weight;
+	}
+
+	double Evaluate(const glm::vec3& point) const
+	{
+		const double x = point.x, y = point.y, z = point.z;
+		const double value = A00 * x * x + A11 * y * y + A22 * z * z + 2.0 * (A01 * x * y + A02 * x * z + A12 * y * z)
+			+ 2.0 * (B0 * x + B1 * y + B2 * z) + C;
+		return std::max(value, 0.0);
+	}
+};
+
+enum class VertexKind : uint8_t
+{
+	Manifold,		// interior vertex alone at its position, free to collapse
+	Locked			// border, seam or non-manifold, never moves (other vertices may collapse onto it)
+};
+
+struct Collapse
+{
+	uint32_t Vertex;
+	uint32_t Target;
+	double Cost;		// mean squared plane distance after the collapse
+};
+
+static uint64_t GetEdgeKey(uint32_t from, uint32_t to)
+{
+	return (uint64_t(from) << 32) | to;
+}
+
+// Vertex index of the first vertex at each vertex`s position
+static std::vector<uint32_t> BuildPositionRemap(const std::vector<Vertex>& vertices)
+{
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& position) const
+		{
+			// -0 and 0 compare equal, so they must hash the same
+			const glm::vec3 key = position + glm::vec3(0.0f);
+			return static_cast<size_t>(HashMemory(&key, sizeof(key)));
+		}
+	};
+
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> firstVertex;
+	firstVertex.reserve(vertices.size());
+
+	std::vector<uint32_t> remap(vertices.size());
+	for (uint32_t i = 0; i < vertices.size(); i++)
+	{
+		remap[i] = firstVertex.emplace(vertices[i].Position, i).first->second;
+	}
+	return remap;
+}
+
+static std::vector<VertexKind> ClassifyVertices(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionRemap)
+{
+	const size_t vertexCount = positionRemap.size();
+	std::vector<VertexKind> kinds(vertexCount, VertexKind::Manifold);
+
+	// Seams: more than one referenced vertex at a position
+	std::vector<uint32_t> positionVertex(vertexCount, UINT32_MAX);
+	for (uint32_t index : indices)
+	{
+		uint32_t& vertex = positionVertex[positionRemap[index]];
+		if (vertex == UINT32_MAX)
+			vertex = index;
+		else if (vertex != index)
+			kinds[vertex] = kinds[index] = VertexKind::Locked;
+	}
+	for (uint32_t index : indices)
+	{
+		if (kinds[positionVertex[positionRemap[index]]] == VertexKind::Locked)
+			kinds[index] = VertexKind::Locked;
+	}
+
+	// Borders and non-manifold edges, by position so seams don`t look like borders
+	std::unordered_map<uint64_t, uint32_t> edgeCounts;
+	edgeCounts.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t from = positionRemap[indices[i + corner]];
+			const uint32_t to = positionRemap[indices[i + (corner + 1) % 3]];
+			edgeCounts[GetEdgeKey(from, to)]++;
+		}
+	}
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t from = positionRemap[indices[i + corner]];
+			const uint32_t to = positionRemap[indices[i + (corner + 1) % 3]];
+
+			auto reverse = edgeCounts.find(GetEdgeKey(to, from));
+			if (edgeCounts[GetEdgeKey(from, to)] != 1 || reverse == edgeCounts.end() || reverse->second != 1)
+			{
+				kinds[indices[i + corner]] = VertexKind::Locked;
+				kinds[indices[i + (corner + 1) % 3]] = VertexKind::Locked;
+			}
+		}
+	}
+
+	return kinds;
+}
+
+// Would moving vertex onto target flip (or collapse to a sliver) any triangle that keeps both of its other corners?
+static bool IsCollapseFlipping(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	const std::vector<uint32_t>& adjacencyOffsets, const std::vector<uint32_t>& adjacency, uint32_t vertex, uint32_t target)
+{
+	const glm::vec3& targetPosition = vertices[target].Position;
+	for (uint32_t i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; i++)
+	{
+		const uint32_t* triangle = &indices[size_t(adjacency[i]) * 3];
+		if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+			continue;
+
+		// Rotate so the collapsing vertex comes first, the winding stays the same
+		const int corner = triangle[0] == vertex ? 0 : (triangle[1] == vertex ? 1 : 2);
+		const glm::vec3& p1 = vertices[triangle[(corner + 1) % 3]].Position;
+		const glm::vec3& p2 = vertices[triangle[(corner + 2) % 3]].Position;
+
+		const glm::vec3 normalBefore = glm::cross(p1 - vertices[vertex].Position, p2 - vertices[vertex].Position);
+		const glm::vec3 normalAfter = glm::cross(p1 - targetPosition, p2 - targetPosition);
+
+		// Also reject turning by more than ~75 degrees
+		if (glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter))
+			return true;
+	}
+	return false;
+}
+
+float MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+	std::vector<uint32_t>& result)
+{
+	result = indices;
+	if (result.size() <= targetIndexCount || vertices.empty())
+		return 0.0f;
+
+	const std::vector<uint32_t> positionRemap = BuildPositionRemap(vertices);
+	const std::vector<VertexKind> kinds = ClassifyVertices(result, positionRemap);
+
+	// Plane quadrics of every triangle, accumulated on its vertices
+	std::vector<Quadric> quadrics(vertices.size());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		const glm::dvec3 p0 = vertices[result[i]].Position;
+		const glm::dvec3 p1 = vertices[result[i + 1]].Position;
+		const glm::dvec3 p2 = vertices[result[i + 2]].Position;
+
+		const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+		const double doubleArea = glm::length(cross);
+		if (doubleArea == 0.0)
+			continue;
+
+		const glm::dvec3 normal = cross / doubleArea;
+		const double distance = -glm::dot(normal, p0);
+		for (int corner = 0; corner < 3; corner++)
+		{
+			quadrics[result[i + corner]].AddPlane(normal, distance, doubleArea * 0.5);
+		}
+	}
+
+	double maxCost = 0.0;
+	std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint8_t> isPassLocked(vertices.size());
+	std::vector<uint32_t> remap(vertices.size());
+
+	// Passes of independent collapses (no two touch the same triangles), until the target or a pass collapses nothing
+	while (result.size() > targetIndexCount)
+	{
+		const size_t triangleCount = result.size() / 3;
+
+		// Triangles around each vertex
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t index : result)
+			adjacencyOffsets[index + 1]++;
+		for (size_t i = 1; i < adjacencyOffsets.size(); i++)
+			adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+		adjacency.resize(result.size());
+		std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+			adjacency[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+		// Every edge both ways, from its manifold ends
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const uint32_t a = result[i + corner];
+				const uint32_t b = result[i + (corner + 1) % 3];
+				if (a > b)
+					continue;		// the neighbor triangle lists the edge the other way
+
+				for (int direction = 0; direction < 2; direction++)
+				{
+					const uint32_t vertex = direction == 0 ? a : b;
+					const uint32_t target = direction == 0 ? b : a;
+					if (kinds[vertex] != VertexKind::Manifold)
+						continue;
+
+					Quadric merged = quadrics[vertex];
+					merged.Add(quadrics[target]);
+					const double cost = merged.Weight > 0.0 ? merged.Evaluate(vertices[target].Position) / merged.Weight : 0.0;
+					collapses.push_back({ vertex, target, cost });
+				}
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& left, const Collapse& right) { return left.Cost < right.Cost; });
+
+		// Each collapse removes about two triangles
+		const size_t collapseBudget = (result.size() - targetIndexCount) / 6 + 1;
+		size_t collapseCount = 0;
+		std::fill(isPassLocked.begin(), isPassLocked.end(), 0);
+		for (uint32_t i = 0; i < remap.size(); i++)
+			remap[i] = i;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapseCount == collapseBudget)
+				break;
+
+			if (isPassLocked[collapse.Vertex] || isPassLocked[collapse.Target] ||
+				IsCollapseFlipping(vertices, result, adjacencyOffsets, adjacency, collapse.Vertex, collapse.Target))
+			{
+				continue;
+			}
+
+			remap[collapse.Vertex] = collapse.Target;
+			quadrics[collapse.Target].Add(quadrics[collapse.Vertex]);
+			maxCost = std::max(maxCost, collapse.Cost);
+			collapseCount++;
+
+			// The flip test assumed the ring around the vertex stays put
+			for (uint32_t j = adjacencyOffsets[collapse.Vertex]; j < adjacencyOffsets[collapse.Vertex + 1]; j++)
+			{
+				const uint32_t* triangle = &result[size_t(adjacency[j]) * 3];
+				isPassLocked[triangle[0]] = isPassLocked[triangle[1]] = isPassLocked[triangle[2]] = 1;
+			}
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Apply the pass, dropping triangles that lost a corner (by position, so seam vertices count as one)
+		size_t writeIndex = 0;
+		for (size_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			const uint32_t a = remap[result[triangle * 3]];
+			const uint32_t b = remap[result[triangle * 3 + 1]];
+			const uint32_t c = remap[result[triangle * 3 + 2]];
+			if (positionRemap[a] == positionRemap[b] || positionRemap[b] == positionRemap[c] || positionRemap[a] == positionRemap[c])
+				continue;
+
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	return static_cast<float>(std::sqrt(maxCost));
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+#include "Utils.h"
+
+// Import time mesh simplification for levels of detail, by quadric error edge collapse (Garland & Heckbert)
+// Only indices change: a vertex collapses onto a neighbor, so every level shares the sub-mesh`s vertices
+// Vertices on open borders and on attribute seams (several vertices at one position) never move,
+// which keeps silhouettes and texture charts intact at the cost of stopping early on heavily split meshes
+class MeshSimplifier
+{
+public:
+	// Collapse the cheapest edges until at most targetIndexCount indices remain or nothing else can collapse
+	// Returns the geometric error of the result: RMS distance of the collapsed vertices to the planes they were on
+	static float Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+		std::vector<uint32_t>& result);
+};
@@ -0,0 +1,126 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Cones wider than this (every normal within ~84 degrees of the axis) are never culled, the test would hardly hit
+static const float s_MinConeSpread = 0.1f;
+
+std::vector<Meshlet> MeshletBuilder::Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	std::vector<Meshlet> meshlets;
+
+	// Meshlet that last used each vertex, so counting a triangle`s new vertices needs no set
+	std::vector<uint32_t> vertexMeshlet(vertices.size(), UINT32_MAX);
+
+	Meshlet meshlet;
+	uint32_t meshletIndex = 0;
+	const size_t triangleCount = indices.size() / 3;
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		const uint32_t* triangleIndices = &indices[triangle * 3];
+
+		// Repeated corners of degenerate triangles count once
+		const bool isUnique[3] = { true, triangleIndices[1] != triangleIndices[0],
+			triangleIndices[2] != triangleIndices[0] && triangleIndices[2] != triangleIndices[1] };
+
+		uint32_t newVertexCount = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (isUnique[corner] && vertexMeshlet[triangleIndices[corner]] != meshletIndex)
+				newVertexCount++;
+		}
+
+		// Close the meshlet when the triangle doesn`t fit, every corner is new to the next one
+		if (meshlet.TriangleCount == MaxTriangles || meshlet.VertexCount + newVertexCount > MaxVertices)
+		{
+			ComputeBounds(vertices, indices, meshlet);
+			meshlets.push_back(meshlet);
+
+			meshletIndex++;
+			meshlet = Meshlet();
+			meshlet.FirstIndex = static_cast<uint32_t>(triangle * 3);
+			newVertexCount = uint32_t(isUnique[0]) + uint32_t(isUnique[1]) + uint32_t(isUnique[2]);
+		}
+
+		for (int corner = 0; corner < 3; corner++)
+		{
+			vertexMeshlet[triangleIndices[corner]] = meshletIndex;
+		}
+		meshlet.VertexCount += newVertexCount;
+		meshlet.TriangleCount++;
+	}
+
+	if (meshlet.TriangleCount > 0)
+	{
+		ComputeBounds(vertices, indices, meshlet);
+		meshlets.push_back(meshlet);
+	}
+
+	return meshlets;
+}
+
+void MeshletBuilder::ComputeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Meshlet& meshlet)
+{
+	const uint32_t indexCount = meshlet.TriangleCount * 3;
+
+	// Sphere around the box center, loose by at most sqrt(3) but cheap and stable
+	glm::vec3 minPosition = vertices[indices[meshlet.FirstIndex]].Position;
+	glm::vec3 maxPosition = minPosition;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		const glm::vec3& position = vertices[indices[meshlet.FirstIndex + i]].Position;
+		minPosition = glm::min(minPosition, position);
+		maxPosition = glm::max(maxPosition, position);
+	}
+
+	meshlet.Center = (minPosition + maxPosition) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		const glm::vec3 offset = vertices[indices[meshlet.FirstIndex + i]].Position - meshlet.Center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	meshlet.Radius = std::sqrt(radiusSquared);
+
+	// Cone around the average face normal (counter clockwise triangles face the viewer, as the pipeline culls)
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.TriangleCount);
+	glm::vec3 normalSum(0.0f);
+	for (uint32_t i = 0; i < indexCount; i += 3)
+	{
+		const glm::vec3& p0 = vertices[indices[meshlet.FirstIndex + i]].Position;
+		const glm::vec3& p1 = vertices[indices[meshlet.FirstIndex + i + 1]].Position;
+		const glm::vec3& p2 = vertices[indices[meshlet.FirstIndex + i + 2]].Position;
+
+		const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+
+		normals.push_back(normal / length);
+		normalSum += normals.back();
+	}
+
+	meshlet.ConeAxis = glm::vec3(0.0f);
+	meshlet.ConeCutoff = 1.0f;
+
+	const float sumLength = glm::length(normalSum);
+	if (normals.empty() || sumLength == 0.0f)
+		return;
+
+	const glm::vec3 axis = normalSum / sumLength;
+	float minDot = 1.0f;
+	for (const auto& normal : normals)
+	{
+		minDot = std::min(minDot, glm::dot(axis, normal));
+	}
+
+	if (minDot <= s_MinConeSpread)
+		return;
+
+	// sin of the cone half angle: the test compares against the direction to the cluster, which is
+	// perpendicular to the normals at the cone`s edge
+	meshlet.ConeAxis = axis;
+	meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include "ModelData.h"
+
+// Import time split of a sub-mesh into meshlets: small clusters of triangles with a bounding sphere
+// and a normal cone, so whole clusters can be culled against the frustum and for facing away
+// Triangles are taken in index order, the vertex cache (and overdraw) order is kept and no index moves
+class MeshletBuilder
+{
+public:
+	// Limits of one meshlet (the usual mesh shader sizes)
+	static const uint32_t MaxVertices = 64;
+	static const uint32_t MaxTriangles = 124;
+
+	static std::vector<Meshlet> Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	// Sphere and cone of the triangles [firstIndex, firstIndex + 3 * triangleCount)
+	static void ComputeBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Meshlet& meshlet);
+};
@@ -0,0 +1,92 @@
+#include "MipGenerator.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define YUME_MIP_SSE2
+#endif
+
+uint32_t MipGenerator::GetLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levelCount = 1;
+	uint32_t size = width > height ? width : height;
+	while (size > 1)
+	{
+		size >>= 1;
+		levelCount++;
+	}
+	return levelCount;
+}
+
+size_t MipGenerator::GetLevelOffset(uint32_t width, uint32_t height, uint32_t level)
+{
+	size_t offset = 0;
+	for (uint32_t i = 0; i < level; i++)
+	{
+		offset += size_t(GetLevelWidth(width, i)) * GetLevelHeight(height, i) * 4;
+	}
+	return offset;
+}
+
+void MipGenerator::GenerateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levelCount)
+{
+	for (uint32_t level = 1; level < levelCount; level++)
+	{
+		Downsample(chain + GetLevelOffset(width, height, level - 1),
+			GetLevelWidth(width, level - 1), GetLevelHeight(height, level - 1),
+			chain + GetLevelOffset(width, height, level));
+	}
+}
+
+void MipGenerator::Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst)
+{
+	const uint32_t dstWidth = srcWidth > 1 ? srcWidth / 2 : 1;
+	const uint32_t dstHeight = srcHeight > 1 ? srcHeight / 2 : 1;
+
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		// Odd sizes and 1 pixel wide/high levels reuse the last row/column
+		const uint8_t* row0 = src + size_t(y * 2 < srcHeight ? y * 2 : srcHeight - 1) * srcWidth * 4;
+		const uint8_t* row1 = src + size_t(y * 2 + 1 < srcHeight ? y * 2 + 1 : srcHeight - 1) * srcWidth * 4;
+		uint8_t* dstRow = dst + size_t(y) * dstWidth * 4;
+
+		uint32_t x = 0;
+
+#ifdef YUME_MIP_SSE2
+		// Two destination pixels per iteration: 4 source pixels of each row, summed as 16 bit channels
+		if (srcWidth >= 2)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i rounding = _mm_set1_epi16(2);
+
+			for (; x + 2 <= dstWidth && (x + 2) * 2 <= srcWidth; x += 2)
+			{
+				const __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				const __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+				// Vertical sums: pixels 0,1 and 2,3
+				const __m128i sumLow = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				const __m128i sumHigh = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+
+				// Horizontal sums: pixel 0 + 1, pixel 2 + 3
+				const __m128i pairLow = _mm_add_epi16(sumLow, _mm_srli_si128(sumLow, 8));
+				const __m128i pairHigh = _mm_add_epi16(sumHigh, _mm_srli_si128(sumHigh, 8));
+
+				const __m128i average = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(pairLow, pairHigh), rounding), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dstRow + x * 4), _mm_packus_epi16(average, average));
+			}
+		}
+#endif
+
+		for (; x < dstWidth; x++)
+		{
+			const uint32_t x0 = x * 2 < srcWidth ? x * 2 : srcWidth - 1;
+			const uint32_t x1 = x * 2 + 1 < srcWidth ? x * 2 + 1 : srcWidth - 1;
+
+			for (uint32_t channel = 0; channel < 4; channel++)
+			{
+				const uint32_t sum = row0[x0 * 4 + channel] + row0[x1 * 4 + channel] + row1[x0 * 4 + channel] + row1[x1 * 4 + channel];
+				dstRow[x * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+}
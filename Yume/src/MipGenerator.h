@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CPU side mip chains of RGBA8 images, for formats the GPU can`t blit with linear filtering
+// Levels are packed one after another (level 0 first), the same layout image uploads use
+class MipGenerator
+{
+public:
+	// Full chain down to 1x1
+	static uint32_t GetLevelCount(uint32_t width, uint32_t height);
+	static uint32_t GetLevelWidth(uint32_t width, uint32_t level) { return (width >> level) > 0 ? width >> level : 1; }
+	static uint32_t GetLevelHeight(uint32_t height, uint32_t level) { return (height >> level) > 0 ? height >> level : 1; }
+	// Byte offset of a level inside a packed chain, GetLevelOffset(levelCount) is the size of the chain
+	static size_t GetLevelOffset(uint32_t width, uint32_t height, uint32_t level);
+
+	// Fill levels 1..levelCount-1 of a chain whose level 0 is already written
+	static void GenerateMipChain(uint8_t* chain, uint32_t width, uint32_t height, uint32_t levelCount);
+	// 2x2 box filter of src into the next level (edges clamp for odd sizes)
+	static void Downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst);
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Utils.h"
+
+// Layout of a sub-mesh`s vertices inside the vertex blob
+enum class VertexFormat : uint32_t
+{
+	Full = 0,		// Vertex
+	Compact = 1		// CompactVertex
+};
+
+static uint32_t GetVertexStride(VertexFormat format)
+{
+	return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+}
+
+// What the vertex shader needs to turn a sub-mesh`s vertices back into object space (push constants)
+// Full vertices use the identity scale/offset
+struct VertexDequantization
+{
+	glm::vec4 PositionScale = glm::vec4(1.0f);
+	glm::vec4 PositionOffset = glm::vec4(0.0f);
+	glm::vec4 TextureCoordsScaleOffset = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);	// xy scale, zw offset
+	glm::vec4 Color = glm::vec4(1.0f);		// the color stream is dropped, every vertex had this color
+};
+
+// Cluster of a sub-mesh`s triangles (see MeshletBuilder), culled as a whole every frame
+// Bounds are in object space; every triangle faces away from a camera at p when
+// dot(Center - p, ConeAxis) >= ConeCutoff * |Center - p| + Radius
+struct Meshlet
+{
+	glm::vec3 Center = glm::vec3(0.0f);
+	float Radius = 0.0f;
+	glm::vec3 ConeAxis = glm::vec3(0.0f);
+	float ConeCutoff = 1.0f;		// 1 (with a zero axis) when the triangles face too many ways for the test
+	uint32_t FirstIndex = 0;		// into the sub-mesh indices, a meshlet`s triangles are contiguous
+	uint32_t TriangleCount = 0;
+	uint32_t VertexCount = 0;
+	uint32_t Padding = 0;
+};
+
+// Level of detail of a sub-mesh: a range of its indices and meshlets, drawn with the same vertices
+struct MeshLod
+{
+	uint32_t FirstIndex = 0;		// into the sub-mesh indices
+	uint32_t IndexCount = 0;
+	uint32_t FirstMeshlet = 0;		// into the sub-mesh meshlets
+	uint32_t MeshletCount = 0;
+	float Error = 0.0f;				// object space distance the level may be off from the full mesh (0 for level 0)
+};
+
+// Range of a sub-mesh inside the model`s vertex/index/meshlet blobs
+struct SubMeshData
+{
+	uint64_t VertexDataOffset = 0;		// bytes into the vertex blob
+	uint64_t IndexDataOffset = 0;		// bytes into the index blob
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;			// indices of every level, relative to the sub-mesh first vertex
+	uint32_t MaterialIndex = 0;
+	VertexFormat Format = VertexFormat::Full;
+	uint32_t IndexSize = sizeof(uint32_t);	// 2 when every index of the sub-mesh fits in 16 bits
+	uint32_t FirstMeshlet = 0;			// into the meshlet blob
+	uint32_t MeshletCount = 0;			// meshlets of every level
+	uint32_t LodCount = 1;
+	MeshLod Lods[MAX_MESH_LODS];		// level 0 is the full mesh
+	glm::vec4 BoundingSphere = glm::vec4(0.0f);		// object space center and radius
+	glm::vec3 BoundsMin = glm::vec3(0.0f);			// object space box
+	glm::vec3 BoundsMax = glm::vec3(0.0f);
+	VertexDequantization Dequantization;
+};
+
+// Vertex cache efficiency of a freshly imported sub-mesh before and after the import passes (see VertexCacheStats)
+struct SubMeshImportStats
+{
+	float ACMRBefore = 0.0f;
+	float ACMRAfter = 0.0f;
+	float ATVRBefore = 0.0f;
+	float ATVRAfter = 0.0f;
+};
+
+// Mesh as read from a source file by a native loader, before the import passes (optimization, LODs, meshlets)
+struct SourceMesh
+{
+	std::string Name;
+	uint32_t MaterialIndex = 0;
+	std::vector<Vertex> Vertices;
+	std::vector<uint32_t> Indices;		// triangle list
+};
+
+struct SourceModel
+{
+	std::vector<std::string> TextureNames;		// 1:1 with materials, empty string if material has no texture
+	std::vector<SourceMesh> Meshes;
+};
+
+// CPU side model ready to be uploaded
+// Geometry is either owned (fresh import) or points straight into a mapped cooked file
+struct ModelData
+{
+	std::vector<std::string> TextureNames;		// 1:1 with materials, empty string if material has no texture
+	std::vector<SubMeshData> SubMeshes;
+	std::vector<SubMeshImportStats> ImportStats;	// 1:1 with SubMeshes after a fresh import, empty from a cooked file
+
+	std::vector<uint8_t> VertexStorage;
+	std::vector<uint8_t> IndexStorage;
+	std::vector<Meshlet> MeshletStorage;
+	MappedFile CookedFile;
+
+	const uint8_t* VertexData = nullptr;
+	const uint8_t* IndexData = nullptr;
+	const Meshlet* MeshletData = nullptr;
+	size_t VertexDataSize = 0;
+	size_t IndexDataSize = 0;
+	size_t MeshletCount = 0;
+
+	// Point the blob views at the owned storage
+	void UseStorage()
+	{
+		VertexData = VertexStorage.data();
+		IndexData = IndexStorage.data();
+		MeshletData = MeshletStorage.data();
+		VertexDataSize = VertexStorage.size();
+		IndexDataSize = IndexStorage.size();
+		MeshletCount = MeshletStorage.size();
+	}
+};
@@ -0,0 +1,218 @@
+#include "ModelImporter.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/MemoryIOWrapper.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include "AssetPack.h"
+#include "AsyncFileReader.h"
+#include "GltfLoader.h"
+#include "MeshCache.h"
+#include "MeshModel.h"
+#include "ObjLoader.h"
+#include "ThreadPool.h"
+
+// Bytes of a file, held before the memory stream that reads them is constructed
+struct FileDataHolder
+{
+	FileData Data;
+};
+
+// Assimp stream over a file read whole by AsyncFileReader
+class FileDataIOStream : private FileDataHolder, public Assimp::MemoryIOStream
+{
+public:
+	explicit FileDataIOStream(FileData&& data)
+		: FileDataHolder{ std::move(data) }, Assimp::MemoryIOStream(Data.data(), Data.size())
+	{
+	}
+};
+
+// Assimp file system reading through AsyncFileReader (and so from the asset pack too), read only
+class AsyncIOSystem : public Assimp::IOSystem
+{
+public:
+	bool Exists(const char* pFile) const override
+	{
+		const AssetPack* pack = AssetPack::GetMounted();
+		std::error_code error;
+		return (pack && pack->Find(pFile)) || std::filesystem::is_regular_file(pFile, error);
+	}
+
+	char getOsSeparator() const override
+	{
+		return '/';
+	}
+
+	Assimp::IOStream* Open(const char* pFile, const char* pMode) override
+	{
+		if (std::string(pMode).find_first_of("wa+") != std::string::npos)
+			return nullptr;
+
+		try
+		{
+			return new FileDataIOStream(AsyncFileReader::Get().Read(pFile).get());
+		}
+		catch (const std::runtime_error&)
+		{
+			return nullptr;
+		}
+	}
+
+	void Close(Assimp::IOStream* pFile) override
+	{
+		delete pFile;
+	}
+};
+
+const uint32_t ModelImporter::ImportFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices;
+
+ModelData ModelImporter::ImportModelData(const std::string& filepath)
+{
+	// Try the cooked mesh first, it is mapped and uploaded without going through Assimp
+	ModelData modelData;
+	const std::string cachePath = MeshCache::GetCachePath(filepath);
+	const uint64_t cacheKey = MeshCache::ComputeKey(filepath, ImportFlags);
+
+	if (MeshCache::Load(cachePath, cacheKey, modelData))
+		return modelData;
+
+	// Formats with a native loader skip Assimp, their meshes go through the same import passes
+	const bool isObjFile = NATIVE_OBJ_IMPORT && ObjLoader::IsObjFile(filepath);
+	if (isObjFile || GltfLoader::IsGltfFile(filepath))
+	{
+		SourceModel sourceModel = isObjFile ? ObjLoader::Load(filepath) : GltfLoader::Load(filepath);
+		modelData.TextureNames = std::move(sourceModel.TextureNames);
+		for (auto& mesh : sourceModel.Meshes)
+		{
+			MeshModel::AppendMesh(mesh.Vertices, mesh.Indices, mesh.MaterialIndex, modelData);
+		}
+		modelData.UseStorage();
+
+		if (!MeshCache::Save(cachePath, cacheKey, modelData))
+		{
+			std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+		}
+
+		return modelData;
+	}
+
+	// Import model 'scene' (one importer per call, so concurrent imports don`t share state)
+	Assimp::Importer importer;
+	importer.SetIOHandler(new AsyncIOSystem());
+	const aiScene* scene = importer.ReadFile(filepath, ImportFlags);
+
+	if (!scene)
+	{
+		throw std::runtime_error("Failed to load model: " + filepath);
+	}
+
+	// Get vector of all material with 1:1 ID placement
+	modelData.TextureNames = MeshModel::LoadMaterials(scene);
+
+	// Load in all our meshes
+	MeshModel::LoadNode(scene->mRootNode, scene, modelData);
+	modelData.UseStorage();
+
+	// Cook it for the next run
+	if (!MeshCache::Save(cachePath, cacheKey, modelData))
+	{
+		std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+	}
+
+	return modelData;
+}
+
+std::future<ImportedModel> ModelImporter::ImportAsync(const std::string& filepath, TextureCache& textureCache)
+{
+	return ThreadPool::Get().Submit([filepath, &textureCache]()
+	{
+		ImportedModel model;
+		model.Filepath = filepath;
+		model.Data = ImportModelData(filepath);
+
+		// Get the directory of model
+		std::string directoryPath;
+		const size_t lastSlashIndex = filepath.rfind('/');
+		if (std::string::npos != lastSlashIndex)
+		{
+			directoryPath = filepath.substr(0, lastSlashIndex);
+		}
+
+		// Every new texture is decoded as its own task; this task never waits on them, so the pool can`t deadlock
+		model.Textures.resize(model.Data.TextureNames.size());
+		for (size_t i = 0; i < model.Data.TextureNames.size(); i++)
+		{
+			if (model.Data.TextureNames[i].empty())
+				continue;
+
+			model.Textures[i] = textureCache.Request(directoryPath + "/" + model.Data.TextureNames[i]);
+		}
+
+		return model;
+	});
+}
+
+void ModelImporter::BenchmarkObjImport(const std::string& filepath, uint32_t iterations)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	double assimpTime = 1e30;
+	double nativeTime = 1e30;
+	size_t assimpVertexCount = 0, assimpIndexCount = 0;
+	size_t nativeVertexCount = 0, nativeIndexCount = 0;
+
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		// Assimp: scene graph, then the copy LoadMesh makes of every mesh
+		{
+			const auto start = Clock::now();
+
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(filepath, ImportFlags);
+			if (!scene)
+			{
+				throw std::runtime_error("Failed to load model: " + filepath);
+			}
+
+			assimpVertexCount = assimpIndexCount = 0;
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+			{
+				MeshModel::ExtractMesh(scene->mMeshes[m], vertices, indices);
+				assimpVertexCount += vertices.size();
+				assimpIndexCount += indices.size();
+			}
+
+			assimpTime = std::min(assimpTime, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+
+		{
+			const auto start = Clock::now();
+
+			const SourceModel model = ObjLoader::Load(filepath);
+
+			nativeVertexCount = nativeIndexCount = 0;
+			for (const auto& mesh : model.Meshes)
+			{
+				nativeVertexCount += mesh.Vertices.size();
+				nativeIndexCount += mesh.Indices.size();
+			}
+
+			nativeTime = std::min(nativeTime, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+		}
+	}
+
+	std::cout << filepath << ": Assimp " << assimpTime << " ms (" << assimpVertexCount << " vertices, " << assimpIndexCount / 3
+		<< " triangles), ObjLoader " << nativeTime << " ms (" << nativeVertexCount << " vertices, " << nativeIndexCount / 3
+		<< " triangles), " << assimpTime / nativeTime << "x" << std::endl;
+}
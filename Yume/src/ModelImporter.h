@@ -0,0 +1,34 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ModelData.h"
+#include "TextureCache.h"
+
+// Model whose CPU work (parsing, texture decoding) has been done on the worker threads
+struct ImportedModel
+{
+	std::string Filepath;
+	ModelData Data;
+	// 1:1 with materials, null for materials without a texture
+	std::vector<std::shared_ptr<TextureCache::Entry>> Textures;
+};
+
+// CPU side of the model import pipeline; everything here is safe to run on worker threads
+class ModelImporter
+{
+public:
+	static const uint32_t ImportFlags;
+
+	// Parse a model into model data (cooked cache or Assimp)
+	static ModelData ImportModelData(const std::string& filepath);
+
+	// Run ImportModelData on the thread pool, then request the textures from the cache (which decodes on the pool as well)
+	static std::future<ImportedModel> ImportAsync(const std::string& filepath, TextureCache& textureCache);
+
+	// Time parsing an OBJ file into vertex/index arrays with Assimp and with ObjLoader (best of iterations, file cache warm)
+	static void BenchmarkObjImport(const std::string& filepath, uint32_t iterations = 10);
+};
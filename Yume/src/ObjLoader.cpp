@@ -0,0 +1,644 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+// Chunks are at least this big, small files are parsed by the calling thread alone
+static const size_t s_MinChunkSize = 256 * 1024;
+// Corner without texture coordinate/normal
+static const int32_t s_MissingIndex = INT32_MIN;
+
+static const double s_PowersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Corner of a face, 0-based indices into the file`s positions/texture coordinates/normals
+struct ObjCorner
+{
+	int32_t Attributes[3];		// position, texture coordinate, normal
+};
+
+// Lines of one chunk, indices are resolved against the whole file once every chunk is parsed
+struct ObjChunk
+{
+	const char* Begin = nullptr;
+	const char* End = nullptr;
+
+	std::vector<glm::vec3> Positions;
+	std::vector<glm::vec2> TexCoords;
+	std::vector<glm::vec3> Normals;
+	std::vector<ObjCorner> Corners;						// 3 per triangle
+	std::vector<uint32_t> RelativeAttributes;			// corner * 3 + attribute given as negative index, chunk relative until resolved
+	std::vector<std::pair<size_t, std::string>> MaterialSwitches;	// usemtl: first corner using the material
+	std::vector<std::string> Libraries;
+	bool IsValid = true;
+};
+
+// Corners of one material, a range of a chunk
+struct ObjCornerRange
+{
+	const ObjChunk* Chunk = nullptr;
+	size_t Begin = 0;
+	size_t End = 0;
+};
+
+static bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && IsSpace(*p))
+		p++;
+	return p;
+}
+
+// Keyword followed by a space
+static bool IsKeyword(const char* p, const char* end, const char* keyword, size_t length)
+{
+	return size_t(end - p) > length && memcmp(p, keyword, length) == 0 && IsSpace(p[length]);
+}
+
+// Rest of the line without surrounding spaces
+static std::string GetArgument(const char* p, const char* end)
+{
+	p = SkipSpaces(p, end);
+	while (end > p && IsSpace(end[-1]))
+		end--;
+	return std::string(p, end);
+}
+
+// Fast path of fast_float (Clinger): a mantissa of up to 19 digits (exact below 2^53) scaled by an exact power of ten
+// rounds correctly in double, everything else (long mantissas, big exponents, nan/inf) goes through strtod
+static const char* ParseFloat(const char* p, const char* end, float& value)
+{
+	p = SkipSpaces(p, end);
+	const char* start = p;
+
+	bool isNegative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		isNegative = *p == '-';
+		p++;
+	}
+
+	uint64_t mantissa = 0;
+	int digitCount = 0;
+	int exponent = 0;
+	bool hasDigits = false;
+	for (; p < end && unsigned(*p - '0') < 10; p++)
+	{
+		mantissa = mantissa * 10 + unsigned(*p - '0');
+		digitCount += mantissa != 0;
+		hasDigits = true;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && unsigned(*p - '0') < 10; p++)
+		{
+			mantissa = mantissa * 10 + unsigned(*p - '0');
+			digitCount += mantissa != 0;
+			exponent--;
+			hasDigits = true;
+		}
+	}
+	if (hasDigits && p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* exponentStart = p++;
+		bool isExponentNegative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			isExponentNegative = *p == '-';
+			p++;
+		}
+
+		int explicitExponent = 0;
+		const char* digitsStart = p;
+		for (; p < end && unsigned(*p - '0') < 10; p++)
+		{
+			explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 10000);
+		}
+
+		// "1e" is 1 followed by garbage
+		if (p == digitsStart)
+			p = exponentStart;
+		else
+			exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+	}
+
+	if (hasDigits && digitCount <= 19 && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double result = double(mantissa);
+		result = exponent < 0 ? result / s_PowersOf10[-exponent] : result * s_PowersOf10[exponent];
+		value = static_cast<float>(isNegative ? -result : result);
+		return p;
+	}
+
+	// Slow path on a terminated copy of the token
+	char token[64];
+	size_t length = 0;
+	for (p = start; p < end && !IsSpace(*p) && *p != '/' && length < sizeof(token) - 1; p++)
+	{
+		token[length++] = *p;
+	}
+	token[length] = '\0';
+
+	char* tokenEnd = nullptr;
+	const double result = std::strtod(token, &tokenEnd);
+	if (tokenEnd == token)
+		return nullptr;
+
+	value = static_cast<float>(result);
+	return start + (tokenEnd - token);
+}
+
+static const char* ParseInt(const char* p, const char* end, int32_t& value)
+{
+	bool isNegative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		isNegative = *p == '-';
+		p++;
+	}
+
+	const char* digitsStart = p;
+	int64_t result = 0;
+	for (; p < end && unsigned(*p - '0') < 10; p++)
+	{
+		result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+	}
+
+	if (p == digitsStart)
+		return nullptr;
+
+	value = static_cast<int32_t>(isNegative ? -result : result);
+	return p;
+}
+
+// Polygon corner before triangulation, relativeMask flags attributes given as negative indices
+struct ObjPolygonCorner
+{
+	ObjCorner Corner;
+	uint32_t RelativeMask = 0;
+};
+
+static bool ParseFace(ObjChunk& chunk, const char* p, const char* end, std::vector<ObjPolygonCorner>& polygon)
+{
+	const size_t attributeCounts[3] = { chunk.Positions.size(), chunk.TexCoords.size(), chunk.Normals.size() };
+
+	polygon.clear();
+	for (p = SkipSpaces(p, end); p < end && *p != '#'; p = SkipSpaces(p, end))
+	{
+		// v, v/vt, v//vn or v/vt/vn
+		int32_t raw[3] = { 0, 0, 0 };
+		p = ParseInt(p, end, raw[0]);
+		if (!p)
+			return false;
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p != '/')
+			{
+				p = ParseInt(p, end, raw[1]);
+				if (!p)
+					return false;
+			}
+			if (p < end && *p == '/')
+			{
+				p = ParseInt(p + 1, end, raw[2]);
+				if (!p)
+					return false;
+			}
+		}
+		if (raw[0] == 0 || (p < end && !IsSpace(*p)))
+			return false;
+
+		ObjPolygonCorner corner;
+		for (int attribute = 0; attribute < 3; attribute++)
+		{
+			if (raw[attribute] > 0)
+			{
+				corner.Corner.Attributes[attribute] = raw[attribute] - 1;
+			}
+			else if (raw[attribute] < 0)
+			{
+				// Counted back from the attribute just before this line, which may live in an earlier chunk
+				corner.Corner.Attributes[attribute] = static_cast<int32_t>(attributeCounts[attribute]) + raw[attribute];
+				corner.RelativeMask |= 1u << attribute;
+			}
+			else
+			{
+				corner.Corner.Attributes[attribute] = s_MissingIndex;
+			}
+		}
+		polygon.push_back(corner);
+	}
+
+	if (polygon.size() < 3)
+		return false;
+
+	// Fan triangulation, like aiProcess_Triangulate does for convex polygons
+	for (size_t i = 2; i < polygon.size(); i++)
+	{
+		for (const ObjPolygonCorner* corner : { &polygon[0], &polygon[i - 1], &polygon[i] })
+		{
+			for (uint32_t attribute = 0; attribute < 3; attribute++)
+			{
+				if (corner->RelativeMask & (1u << attribute))
+					chunk.RelativeAttributes.push_back(static_cast<uint32_t>(chunk.Corners.size() * 3 + attribute));
+			}
+			chunk.Corners.push_back(corner->Corner);
+		}
+	}
+	return true;
+}
+
+static bool ParseLine(ObjChunk& chunk, const char* p, const char* end, std::vector<ObjPolygonCorner>& polygon)
+{
+	if (IsKeyword(p, end, "v", 1))
+	{
+		glm::vec3 position;
+		p = ParseFloat(p + 1, end, position.x);
+		p = p ? ParseFloat(p, end, position.y) : nullptr;
+		p = p ? ParseFloat(p, end, position.z) : nullptr;
+		chunk.Positions.push_back(position);
+		return p != nullptr;
+	}
+	if (IsKeyword(p, end, "vt", 2))
+	{
+		// v is optional
+		glm::vec2 texCoord(0.0f);
+		p = ParseFloat(p + 2, end, texCoord.x);
+		if (p && SkipSpaces(p, end) < end)
+			p = ParseFloat(p, end, texCoord.y);
+		chunk.TexCoords.push_back(texCoord);
+		return p != nullptr;
+	}
+	if (IsKeyword(p, end, "vn", 2))
+	{
+		glm::vec3 normal;
+		p = ParseFloat(p + 2, end, normal.x);
+		p = p ? ParseFloat(p, end, normal.y) : nullptr;
+		p = p ? ParseFloat(p, end, normal.z) : nullptr;
+		chunk.Normals.push_back(normal);
+		return p != nullptr;
+	}
+	if (IsKeyword(p, end, "f", 1))
+	{
+		return ParseFace(chunk, p + 1, end, polygon);
+	}
+	if (IsKeyword(p, end, "usemtl", 6))
+	{
+		chunk.MaterialSwitches.emplace_back(chunk.Corners.size(), GetArgument(p + 6, end));
+		return true;
+	}
+	if (IsKeyword(p, end, "mtllib", 6))
+	{
+		chunk.Libraries.push_back(GetArgument(p + 6, end));
+		return true;
+	}
+
+	// Comments, groups, smoothing groups, lines and points don`t change the triangles
+	return true;
+}
+
+static void ParseChunk(ObjChunk& chunk)
+{
+	std::vector<ObjPolygonCorner> polygon;
+
+	const char* p = chunk.Begin;
+	while (p < chunk.End)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk.End - p));
+		const char* next = lineEnd ? lineEnd + 1 : chunk.End;
+		if (!lineEnd)
+			lineEnd = chunk.End;
+		if (lineEnd > p && lineEnd[-1] == '\r')
+			lineEnd--;
+
+		p = SkipSpaces(p, lineEnd);
+		if (p < lineEnd && !ParseLine(chunk, p, lineEnd, polygon))
+		{
+			chunk.IsValid = false;
+			return;
+		}
+		p = next;
+	}
+}
+
+// Materials of the libraries in definition order, texture names 1:1 with names
+static void LoadMaterialLibrary(const std::string& filepath, std::vector<std::string>& names, std::vector<std::string>& textureNames)
+{
+	MappedFile file;
+	if (!file.Open(filepath))
+		return;
+
+	const char* p = reinterpret_cast<const char*>(file.GetData());
+	const char* end = p + file.GetSize();
+	while (p < end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* next = lineEnd ? lineEnd + 1 : end;
+		if (!lineEnd)
+			lineEnd = end;
+		if (lineEnd > p && lineEnd[-1] == '\r')
+			lineEnd--;
+
+		p = SkipSpaces(p, lineEnd);
+		if (IsKeyword(p, lineEnd, "newmtl", 6))
+		{
+			names.push_back(GetArgument(p + 6, lineEnd));
+			textureNames.emplace_back();
+		}
+		else if (IsKeyword(p, lineEnd, "map_Kd", 6) && !names.empty())
+		{
+			// Options (-bm 0.5, -s 1 1 1, ...) come first, the file name is last
+			std::string textureName = GetArgument(p + 6, lineEnd);
+			if (!textureName.empty() && textureName[0] == '-')
+			{
+				const size_t lastSpace = textureName.find_last_of(" \t");
+				textureName = lastSpace == std::string::npos ? std::string() : textureName.substr(lastSpace + 1);
+			}
+			textureNames.back() = textureName;
+		}
+		p = next;
+	}
+}
+
+// Corners of nearby faces share nearby positions, hashing by position keeps their probes in the same cache lines
+// (the other attributes only pick one of two neighbouring slots, seams spill over with linear probing)
+static uint32_t HashCorner(const ObjCorner& corner)
+{
+	const uint32_t attributeHash = uint32_t(corner.Attributes[1]) * 0x9E3779B1u ^ uint32_t(corner.Attributes[2]) * 0x85EBCA77u;
+	return uint32_t(corner.Attributes[0]) * 2 + (attributeHash >> 31);
+}
+
+// Unique vertices of a material`s corners, false if a corner references a missing attribute
+static bool WeldCorners(const std::vector<ObjCornerRange>& ranges, const std::vector<glm::vec3>& positions,
+	const std::vector<glm::vec2>& texCoords, const std::vector<glm::vec3>& normals, SourceMesh& mesh)
+{
+	size_t cornerCount = 0;
+	for (const auto& range : ranges)
+	{
+		cornerCount += range.End - range.Begin;
+	}
+
+	// Open addressing, at most half full; unique vertices are usually about as many as positions or texture coordinates,
+	// which keeps the table far smaller (and more cache friendly) than one sized for every corner
+	struct Slot
+	{
+		ObjCorner Corner;
+		uint32_t Vertex = UINT32_MAX;
+	};
+	const size_t expectedVertexCount = std::min(cornerCount, std::max(positions.size(), texCoords.size()));
+	size_t capacity = 16;
+	while (capacity < expectedVertexCount * 2)
+		capacity *= 2;
+	std::vector<Slot> slots(capacity);
+
+	mesh.Indices.reserve(cornerCount);
+	mesh.Vertices.reserve(expectedVertexCount);
+	const int32_t attributeCounts[3] = { static_cast<int32_t>(positions.size()), static_cast<int32_t>(texCoords.size()),
+		static_cast<int32_t>(normals.size()) };
+
+	for (const auto& range : ranges)
+	{
+		for (size_t i = range.Begin; i < range.End; i++)
+		{
+			const ObjCorner& corner = range.Chunk->Corners[i];
+
+			size_t slotIndex = HashCorner(corner) & (capacity - 1);
+			while (slots[slotIndex].Vertex != UINT32_MAX
+				&& memcmp(&slots[slotIndex].Corner, &corner, sizeof(ObjCorner)) != 0)
+			{
+				slotIndex = (slotIndex + 1) & (capacity - 1);
+			}
+
+			Slot& slot = slots[slotIndex];
+			if (slot.Vertex == UINT32_MAX)
+			{
+				for (int attribute = 0; attribute < 3; attribute++)
+				{
+					const int32_t index = corner.Attributes[attribute];
+					if ((attribute == 0 || index != s_MissingIndex) && (index < 0 || index >= attributeCounts[attribute]))
+						return false;
+				}
+
+				Vertex vertex;
+				vertex.Position = positions[corner.Attributes[0]];
+				vertex.Color = { 1.0f, 1.0f, 1.0f };
+				vertex.TextureCoords = { 0.0f, 0.0f };
+				vertex.NormalCoords = { 0.0f, 0.0f, 0.0f };
+				if (corner.Attributes[1] != s_MissingIndex)
+				{
+					const glm::vec2& texCoord = texCoords[corner.Attributes[1]];
+					vertex.TextureCoords = { texCoord.x, 1.0f - texCoord.y };
+				}
+				if (corner.Attributes[2] != s_MissingIndex)
+				{
+					const glm::vec3& normal = normals[corner.Attributes[2]];
+					const float length = glm::length(normal);
+					vertex.NormalCoords = length > 0.0f ? normal / length : normal;
+				}
+
+				slot.Corner = corner;
+				slot.Vertex = static_cast<uint32_t>(mesh.Vertices.size());
+				mesh.Vertices.push_back(vertex);
+				mesh.Indices.push_back(slot.Vertex);
+
+				// Grow past half full
+				if (mesh.Vertices.size() * 2 > capacity)
+				{
+					capacity *= 2;
+					std::vector<Slot> grownSlots(capacity);
+					for (const Slot& oldSlot : slots)
+					{
+						if (oldSlot.Vertex == UINT32_MAX)
+							continue;
+
+						size_t grownIndex = HashCorner(oldSlot.Corner) & (capacity - 1);
+						while (grownSlots[grownIndex].Vertex != UINT32_MAX)
+							grownIndex = (grownIndex + 1) & (capacity - 1);
+						grownSlots[grownIndex] = oldSlot;
+					}
+					slots.swap(grownSlots);
+				}
+				continue;
+			}
+			mesh.Indices.push_back(slot.Vertex);
+		}
+	}
+	return true;
+}
+
+bool ObjLoader::IsObjFile(const std::string& filepath)
+{
+	if (filepath.size() < 4)
+		return false;
+
+	std::string extension = filepath.substr(filepath.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension == ".obj";
+}
+
+SourceModel ObjLoader::Load(const std::string& filepath)
+{
+	MappedFile file;
+	if (!file.Open(filepath))
+	{
+		throw std::runtime_error("Failed to open model: " + filepath);
+	}
+
+	// Split on line boundaries, a few chunks per worker so uneven lines still balance
+	const char* data = reinterpret_cast<const char*>(file.GetData());
+	const size_t size = file.GetSize();
+	const size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / s_MinChunkSize, (ThreadPool::Get().GetThreadCount() + 1) * 4));
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkBegin = data;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = data + size;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = std::max(chunkBegin, data + size * (i + 1) / chunkCount);
+			const char* lineEnd = static_cast<const char*>(memchr(chunkEnd, '\n', data + size - chunkEnd));
+			chunkEnd = lineEnd ? lineEnd + 1 : data + size;
+		}
+		chunks[i].Begin = chunkBegin;
+		chunks[i].End = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	ThreadPool::Get().ParallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t i) { ParseChunk(chunks[i]); });
+
+	// Where each chunk`s attributes start in the file
+	std::vector<size_t> positionBases(chunkCount), texCoordBases(chunkCount), normalBases(chunkCount);
+	size_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		if (!chunks[i].IsValid)
+		{
+			throw std::runtime_error("Malformed OBJ file: " + filepath);
+		}
+
+		positionBases[i] = positionCount;
+		texCoordBases[i] = texCoordCount;
+		normalBases[i] = normalCount;
+		positionCount += chunks[i].Positions.size();
+		texCoordCount += chunks[i].TexCoords.size();
+		normalCount += chunks[i].Normals.size();
+	}
+
+	// Gather the attributes and turn relative indices absolute
+	std::vector<glm::vec3> positions(positionCount);
+	std::vector<glm::vec2> texCoords(texCoordCount);
+	std::vector<glm::vec3> normals(normalCount);
+	ThreadPool::Get().ParallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t i)
+	{
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + positionBases[i]);
+		std::copy(chunk.TexCoords.begin(), chunk.TexCoords.end(), texCoords.begin() + texCoordBases[i]);
+		std::copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + normalBases[i]);
+
+		const size_t bases[3] = { positionBases[i], texCoordBases[i], normalBases[i] };
+		for (uint32_t relativeAttribute : chunk.RelativeAttributes)
+		{
+			const uint32_t attribute = relativeAttribute % 3;
+			chunk.Corners[relativeAttribute / 3].Attributes[attribute] += static_cast<int32_t>(bases[attribute]);
+		}
+	});
+
+	// Materials of every library, relative to the OBJ file
+	std::string directoryPath;
+	const size_t lastSlashIndex = filepath.find_last_of("/\\");
+	if (lastSlashIndex != std::string::npos)
+		directoryPath = filepath.substr(0, lastSlashIndex + 1);
+
+	SourceModel model;
+	std::vector<std::string> materialNames;
+	for (const auto& chunk : chunks)
+	{
+		for (const auto& library : chunk.Libraries)
+		{
+			LoadMaterialLibrary(directoryPath + library, materialNames, model.TextureNames);
+		}
+	}
+
+	std::unordered_map<std::string, uint32_t> materialIndices;
+	for (size_t i = 0; i < materialNames.size(); i++)
+	{
+		materialIndices.emplace(materialNames[i], static_cast<uint32_t>(i));
+	}
+
+	// Corner ranges of every material, faces before any (known) usemtl get a default material without texture
+	std::vector<std::vector<ObjCornerRange>> materialRanges(materialNames.size());
+	uint32_t defaultMaterial = UINT32_MAX;
+	auto findMaterial = [&](const std::string& name)
+	{
+		auto it = materialIndices.find(name);
+		if (it != materialIndices.end())
+			return it->second;
+
+		if (defaultMaterial == UINT32_MAX)
+		{
+			defaultMaterial = static_cast<uint32_t>(materialNames.size());
+			materialNames.push_back("DefaultMaterial");
+			model.TextureNames.emplace_back();
+			materialRanges.emplace_back();
+		}
+		return defaultMaterial;
+	};
+
+	std::string currentMaterial;
+	for (const auto& chunk : chunks)
+	{
+		size_t rangeBegin = 0;
+		for (size_t s = 0; s <= chunk.MaterialSwitches.size(); s++)
+		{
+			const size_t rangeEnd = s < chunk.MaterialSwitches.size() ? chunk.MaterialSwitches[s].first : chunk.Corners.size();
+			if (rangeEnd > rangeBegin)
+			{
+				const uint32_t materialIndex = findMaterial(currentMaterial);
+				materialRanges[materialIndex].push_back({ &chunk, rangeBegin, rangeEnd });
+			}
+
+			if (s < chunk.MaterialSwitches.size())
+				currentMaterial = chunk.MaterialSwitches[s].second;
+			rangeBegin = rangeEnd;
+		}
+	}
+
+	// Weld every material on its own worker
+	std::vector<SourceMesh> meshes(materialRanges.size());
+	std::vector<uint8_t> isWelded(materialRanges.size(), 1);
+	ThreadPool::Get().ParallelFor(static_cast<uint32_t>(materialRanges.size()), [&](uint32_t i)
+	{
+		meshes[i].Name = materialNames[i];
+		meshes[i].MaterialIndex = i;
+		isWelded[i] = WeldCorners(materialRanges[i], positions, texCoords, normals, meshes[i]);
+	});
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (!isWelded[i])
+		{
+			throw std::runtime_error("OBJ file references a missing vertex: " + filepath);
+		}
+
+		if (!meshes[i].Indices.empty())
+			model.Meshes.push_back(std::move(meshes[i]));
+	}
+
+	return model;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ModelData.h"
+
+// Wavefront OBJ/MTL import without Assimp
+// The file is mapped and split on line boundaries into chunks parsed on the thread pool, numbers go through a
+// fast path (exact for up to 19 digits and powers of ten up to 22, strtod otherwise), polygons are triangulated
+// as fans and corners are welded per material through a hash map straight into the final vertex/index arrays
+// Texture coordinates are flipped (v = 1 - v) and normals normalized, same as the Assimp path
+class ObjLoader
+{
+public:
+	static bool IsObjFile(const std::string& filepath);
+
+	// One mesh per used material (named after it), in material order, texture names from map_Kd
+	// Throws when the file can`t be read or references missing vertices
+	static SourceModel Load(const std::string& filepath);
+};
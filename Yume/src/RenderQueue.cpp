@@ -0,0 +1,101 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t s_PipelineShift = 56;
+static const uint32_t s_GeometryShift = 48;
+static const uint32_t s_TextureShift = 32;
+static const uint32_t s_DepthShift = 16;
+
+uint64_t RenderQueue::MakeKey(uint32_t pipeline, uint32_t geometry, uint32_t texture, float depth, uint32_t model)
+{
+	// Bits of a positive float order like the float: the top 16 (exponent and 7 mantissa bits) bucket depth
+	// logarithmically, about 1% apart, so draws only swap when their distances really differ
+	depth = std::max(depth, 0.0f);
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+
+	return (uint64_t(pipeline & 0xFF) << s_PipelineShift) | (uint64_t(geometry & 0xFF) << s_GeometryShift) |
+		(uint64_t(texture & 0xFFFF) << s_TextureShift) | (uint64_t(depthBits >> 16) << s_DepthShift) | uint64_t(model & 0xFFFF);
+}
+
+void RenderQueue::Clear()
+{
+	m_Keys.clear();
+	m_Draws.clear();
+}
+
+void RenderQueue::Push(uint64_t key, uint32_t draw)
+{
+	m_Keys.push_back(key);
+	m_Draws.push_back(draw);
+}
+
+void RenderQueue::Sort()
+{
+	const size_t count = m_Keys.size();
+	m_Stats.DrawCount = static_cast<uint32_t>(count);
+	m_Stats.UnsortedBindCount = CountBinds(m_Keys);
+
+	// Histograms of all 8 bytes in one pass over the keys
+	uint32_t histograms[8][256] = {};
+	for (uint64_t key : m_Keys)
+	{
+		for (uint32_t byte = 0; byte < 8; byte++)
+		{
+			histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+		}
+	}
+
+	m_SortKeys.resize(count);
+	m_SortDraws.resize(count);
+	for (uint32_t byte = 0; byte < 8; byte++)
+	{
+		uint32_t* histogram = histograms[byte];
+
+		// Every key has the same byte here (unused key fields, a single texture...): nothing to reorder
+		const uint32_t firstKeyByte = count > 0 ? uint32_t((m_Keys[0] >> (byte * 8)) & 0xFF) : 0;
+		if (histogram[firstKeyByte] == count)
+			continue;
+
+		// Counts to bucket offsets
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++)
+		{
+			const uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		// Scatter in order, which keeps the sort stable
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t destination = histogram[(m_Keys[i] >> (byte * 8)) & 0xFF]++;
+			m_SortKeys[destination] = m_Keys[i];
+			m_SortDraws[destination] = m_Draws[i];
+		}
+
+		m_Keys.swap(m_SortKeys);
+		m_Draws.swap(m_SortDraws);
+	}
+
+	m_Stats.SortedBindCount = CountBinds(m_Keys);
+}
+
+uint32_t RenderQueue::CountBinds(const std::vector<uint64_t>& keys)
+{
+	// Depth isn`t state, model is the dynamic offset of the uniform descriptor set
+	static const uint64_t s_FieldMasks[] = { 0xFFull << s_PipelineShift, 0xFFull << s_GeometryShift, 0xFFFFull << s_TextureShift, 0xFFFFull };
+
+	uint32_t bindCount = 0;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		for (uint64_t mask : s_FieldMasks)
+		{
+			if (i == 0 || (keys[i] & mask) != (keys[i - 1] & mask))
+				bindCount++;
+		}
+	}
+	return bindCount;
+}
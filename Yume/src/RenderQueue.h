@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "Utils.h"
+
+struct RenderQueueStats
+{
+	uint32_t DrawCount = 0;
+	uint32_t UnsortedBindCount = 0;		// pipeline, index buffer and descriptor set binds in push order
+	uint32_t SortedBindCount = 0;		// the same after sorting
+};
+
+// Draws ordered by a 64 bit sort key so consecutive draws share as much state as possible
+// Key, most significant first: pipeline (8 bits), geometry/index buffer (8), texture set (16), quantized depth (16), model (16)
+// Sorted with a stable LSD radix sort over bytes, passes whose byte is the same in every key are skipped
+class RenderQueue
+{
+public:
+	// depth: distance to the camera, nearer first within the same state
+	// Pass 0 for opaque draws whose order is cached: depth changes with every camera move
+	static uint64_t MakeKey(uint32_t pipeline, uint32_t geometry, uint32_t texture, float depth, uint32_t model);
+
+	void Clear();
+	// Queue a draw (any index the caller resolves) with its key
+	void Push(uint64_t key, uint32_t draw);
+	// Order the queued draws by key, equal keys keep their push order
+	void Sort();
+
+	// Draws in key order after Sort, push order before
+	const std::vector<uint32_t>& GetDraws() const { return m_Draws; }
+	// Counts of the last Sort
+	RenderQueueStats GetStats() const { return m_Stats; }
+
+private:
+	// State binds a walk over the keys in order issues: one per state field differing from the previous draw
+	static uint32_t CountBinds(const std::vector<uint64_t>& keys);
+
+private:
+	std::vector<uint64_t> m_Keys;
+	std::vector<uint32_t> m_Draws;
+	// Radix sort ping-pong buffers
+	std::vector<uint64_t> m_SortKeys;
+	std::vector<uint32_t> m_SortDraws;
+	RenderQueueStats m_Stats;
+};
@@ -0,0 +1,374 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <utility>
+
+static float GetSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	const glm::vec3 size = boundsMax - boundsMin;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static float GetCombinedSurfaceArea(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+{
+	return GetSurfaceArea(glm::min(minA, minB), glm::max(maxA, maxB));
+}
+
+int32_t SceneBvh::Insert(uint32_t object, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	const int32_t leaf = AllocateNode();
+	Node& node = m_Nodes[leaf];
+	node.BoundsMin = boundsMin;
+	node.BoundsMax = boundsMax;
+	node.Object = object;
+	node.Height = 0;
+
+	InsertLeaf(leaf);
+	m_ObjectCount++;
+	return leaf;
+}
+
+void SceneBvh::Remove(int32_t leaf)
+{
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	m_ObjectCount--;
+}
+
+void SceneBvh::Update(int32_t leaf, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	m_Nodes[leaf].BoundsMin = boundsMin;
+	m_Nodes[leaf].BoundsMax = boundsMax;
+
+	// Ancestors of a dirty node are dirty already, stop at the first one
+	for (int32_t index = leaf; index >= 0 && !m_Nodes[index].IsDirty; index = m_Nodes[index].Parent)
+	{
+		m_Nodes[index].IsDirty = true;
+	}
+}
+
+void SceneBvh::Refit()
+{
+	if (m_Root >= 0)
+		RefitNode(m_Root);
+}
+
+void SceneBvh::Clear()
+{
+	m_Nodes.clear();
+	m_Root = -1;
+	m_FreeList = -1;
+	m_ObjectCount = 0;
+}
+
+void SceneBvh::QueryFrustum(const glm::vec4* planes, std::vector<uint32_t>& objects) const
+{
+	if (m_Root < 0)
+		return;
+
+	// Planes a node is fully inside of are dropped for its subtree, once none is left everything below is visible
+	std::vector<std::pair<int32_t, uint32_t>> stack;
+	stack.emplace_back(m_Root, 0x3Fu);
+	while (!stack.empty())
+	{
+		const int32_t index = stack.back().first;
+		uint32_t planeMask = stack.back().second;
+		stack.pop_back();
+
+		const Node& node = m_Nodes[index];
+		bool isOutside = false;
+		for (int p = 0; p < 6 && !isOutside; p++)
+		{
+			if (!(planeMask & (1u << p)))
+				continue;
+
+			// Corners furthest along the normal and against it
+			const glm::vec3 normal(planes[p]);
+			const glm::vec3 positiveCorner(normal.x >= 0.0f ? node.BoundsMax.x : node.BoundsMin.x,
+				normal.y >= 0.0f ? node.BoundsMax.y : node.BoundsMin.y, normal.z >= 0.0f ? node.BoundsMax.z : node.BoundsMin.z);
+			const glm::vec3 negativeCorner(normal.x >= 0.0f ? node.BoundsMin.x : node.BoundsMax.x,
+				normal.y >= 0.0f ? node.BoundsMin.y : node.BoundsMax.y, normal.z >= 0.0f ? node.BoundsMin.z : node.BoundsMax.z);
+
+			if (glm::dot(normal, positiveCorner) + planes[p].w < 0.0f)
+				isOutside = true;
+			else if (glm::dot(normal, negativeCorner) + planes[p].w >= 0.0f)
+				planeMask &= ~(1u << p);
+		}
+
+		if (isOutside)
+			continue;
+
+		if (planeMask == 0)
+		{
+			CollectObjects(index, objects);
+		}
+		else if (node.IsLeaf())
+		{
+			objects.push_back(node.Object);
+		}
+		else
+		{
+			stack.emplace_back(node.Children[0], planeMask);
+			stack.emplace_back(node.Children[1], planeMask);
+		}
+	}
+}
+
+void SceneBvh::QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const
+{
+	if (m_Root < 0)
+		return;
+
+	std::vector<int32_t> stack;
+	stack.push_back(m_Root);
+	while (!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		// Nearest point of the box to the center
+		const glm::vec3 offset = glm::clamp(center, node.BoundsMin, node.BoundsMax) - center;
+		if (glm::dot(offset, offset) > radius * radius)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			objects.push_back(node.Object);
+		}
+		else
+		{
+			stack.push_back(node.Children[0]);
+			stack.push_back(node.Children[1]);
+		}
+	}
+}
+
+void SceneBvh::QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& objects) const
+{
+	if (m_Root < 0)
+		return;
+
+	// Slab test, distances in units of direction
+	const glm::vec3 inverseDirection = 1.0f / direction;
+	std::vector<std::pair<float, uint32_t>> hits;
+	std::vector<int32_t> stack;
+	stack.push_back(m_Root);
+	while (!stack.empty())
+	{
+		const Node& node = m_Nodes[stack.back()];
+		stack.pop_back();
+
+		const glm::vec3 distanceMin = (node.BoundsMin - origin) * inverseDirection;
+		const glm::vec3 distanceMax = (node.BoundsMax - origin) * inverseDirection;
+		const glm::vec3 nearDistance = glm::min(distanceMin, distanceMax);
+		const glm::vec3 farDistance = glm::max(distanceMin, distanceMax);
+		const float entry = std::max({ nearDistance.x, nearDistance.y, nearDistance.z, 0.0f });
+		const float exit = std::min({ farDistance.x, farDistance.y, farDistance.z, maxDistance });
+		if (entry > exit)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			hits.emplace_back(entry, node.Object);
+		}
+		else
+		{
+			stack.push_back(node.Children[0]);
+			stack.push_back(node.Children[1]);
+		}
+	}
+
+	std::sort(hits.begin(), hits.end());
+	for (const auto& hit : hits)
+	{
+		objects.push_back(hit.second);
+	}
+}
+
+int32_t SceneBvh::AllocateNode()
+{
+	if (m_FreeList < 0)
+	{
+		m_Nodes.emplace_back();
+		return static_cast<int32_t>(m_Nodes.size() - 1);
+	}
+
+	const int32_t node = m_FreeList;
+	m_FreeList = m_Nodes[node].Parent;
+	m_Nodes[node] = Node();
+	return node;
+}
+
+void SceneBvh::FreeNode(int32_t node)
+{
+	m_Nodes[node].Parent = m_FreeList;
+	m_Nodes[node].Height = -1;
+	m_FreeList = node;
+}
+
+void SceneBvh::InsertLeaf(int32_t leaf)
+{
+	if (m_Root < 0)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].Parent = -1;
+		return;
+	}
+
+	// Walk down to the sibling whose new parent adds the least surface area (the leaf`s area is paid at every level)
+	const glm::vec3 leafMin = m_Nodes[leaf].BoundsMin;
+	const glm::vec3 leafMax = m_Nodes[leaf].BoundsMax;
+	int32_t index = m_Root;
+	while (!m_Nodes[index].IsLeaf())
+	{
+		const Node& node = m_Nodes[index];
+		const float area = GetSurfaceArea(node.BoundsMin, node.BoundsMax);
+		const float combinedArea = GetCombinedSurfaceArea(node.BoundsMin, node.BoundsMax, leafMin, leafMax);
+
+		// Pairing with this node here, or growing it on the way down to one of its children
+		const float cost = 2.0f * combinedArea;
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = m_Nodes[node.Children[c]];
+			const float childCombinedArea = GetCombinedSurfaceArea(child.BoundsMin, child.BoundsMax, leafMin, leafMax);
+			childCosts[c] = inheritanceCost + (child.IsLeaf() ? childCombinedArea
+				: childCombinedArea - GetSurfaceArea(child.BoundsMin, child.BoundsMax));
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+
+		index = childCosts[0] < childCosts[1] ? node.Children[0] : node.Children[1];
+	}
+
+	// New parent takes the sibling`s place
+	const int32_t sibling = index;
+	const int32_t oldParent = m_Nodes[sibling].Parent;
+	const int32_t newParent = AllocateNode();
+	m_Nodes[newParent].Parent = oldParent;
+	m_Nodes[newParent].Children[0] = sibling;
+	m_Nodes[newParent].Children[1] = leaf;
+	m_Nodes[sibling].Parent = newParent;
+	m_Nodes[leaf].Parent = newParent;
+
+	if (oldParent < 0)
+		m_Root = newParent;
+	else
+		m_Nodes[oldParent].Children[m_Nodes[oldParent].Children[0] == sibling ? 0 : 1] = newParent;
+
+	FixUpwards(newParent);
+}
+
+void SceneBvh::RemoveLeaf(int32_t leaf)
+{
+	if (leaf == m_Root)
+	{
+		m_Root = -1;
+		return;
+	}
+
+	// The sibling takes the parent`s place
+	const int32_t parent = m_Nodes[leaf].Parent;
+	const int32_t grandParent = m_Nodes[parent].Parent;
+	const int32_t sibling = m_Nodes[parent].Children[m_Nodes[parent].Children[0] == leaf ? 1 : 0];
+
+	m_Nodes[sibling].Parent = grandParent;
+	FreeNode(parent);
+
+	if (grandParent < 0)
+	{
+		m_Root = sibling;
+		return;
+	}
+
+	m_Nodes[grandParent].Children[m_Nodes[grandParent].Children[0] == parent ? 0 : 1] = sibling;
+	FixUpwards(grandParent);
+}
+
+int32_t SceneBvh::Balance(int32_t indexA)
+{
+	Node& a = m_Nodes[indexA];
+	if (a.IsLeaf() || a.Height < 2)
+		return indexA;
+
+	// Rotate the taller child up: it becomes the parent of A, A keeps the shorter of its grandchildren
+	const int32_t balance = m_Nodes[a.Children[1]].Height - m_Nodes[a.Children[0]].Height;
+	if (balance >= -1 && balance <= 1)
+		return indexA;
+
+	const int tallSide = balance > 1 ? 1 : 0;
+	const int32_t indexUp = a.Children[tallSide];
+	Node& up = m_Nodes[indexUp];
+	const int32_t tallGrandChild = m_Nodes[up.Children[0]].Height > m_Nodes[up.Children[1]].Height ? up.Children[0] : up.Children[1];
+	const int32_t shortGrandChild = up.Children[0] == tallGrandChild ? up.Children[1] : up.Children[0];
+
+	// Up takes A`s place
+	up.Parent = a.Parent;
+	if (up.Parent < 0)
+		m_Root = indexUp;
+	else
+		m_Nodes[up.Parent].Children[m_Nodes[up.Parent].Children[0] == indexA ? 0 : 1] = indexUp;
+
+	up.Children[0] = indexA;
+	up.Children[1] = tallGrandChild;
+	a.Parent = indexUp;
+	a.Children[tallSide] = shortGrandChild;
+	m_Nodes[shortGrandChild].Parent = indexA;
+
+	UpdateFromChildren(indexA);
+	UpdateFromChildren(indexUp);
+	return indexUp;
+}
+
+void SceneBvh::FixUpwards(int32_t node)
+{
+	for (int32_t index = node; index >= 0; index = m_Nodes[index].Parent)
+	{
+		index = Balance(index);
+		UpdateFromChildren(index);
+	}
+}
+
+void SceneBvh::UpdateFromChildren(int32_t node)
+{
+	Node& parent = m_Nodes[node];
+	const Node& first = m_Nodes[parent.Children[0]];
+	const Node& second = m_Nodes[parent.Children[1]];
+
+	parent.BoundsMin = glm::min(first.BoundsMin, second.BoundsMin);
+	parent.BoundsMax = glm::max(first.BoundsMax, second.BoundsMax);
+	parent.Height = 1 + std::max(first.Height, second.Height);
+	// A dirty child still needs its path refit
+	parent.IsDirty = first.IsDirty || second.IsDirty;
+}
+
+void SceneBvh::RefitNode(int32_t node)
+{
+	Node& current = m_Nodes[node];
+	if (!current.IsDirty)
+		return;
+
+	if (!current.IsLeaf())
+	{
+		RefitNode(current.Children[0]);
+		RefitNode(current.Children[1]);
+		UpdateFromChildren(node);
+	}
+	current.IsDirty = false;
+}
+
+void SceneBvh::CollectObjects(int32_t node, std::vector<uint32_t>& objects) const
+{
+	const Node& current = m_Nodes[node];
+	if (current.IsLeaf())
+	{
+		objects.push_back(current.Object);
+		return;
+	}
+
+	CollectObjects(current.Children[0], objects);
+	CollectObjects(current.Children[1], objects);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include "Utils.h"
+
+// Dynamic bounding volume hierarchy over scene objects (world space boxes)
+// Leaves are inserted where they grow the tree least (surface area) and height balanced by rotations, removal
+// splices the sibling into the parent`s place, so both stay logarithmic instead of rebuilding
+// Moved objects only mark their path: Refit recomputes the boxes of those paths once per frame
+// Queries walk the tree and skip every subtree whose box fails the test, they expect Refit to have run
+class SceneBvh
+{
+public:
+	// Add an object, returns its leaf (stable until removed)
+	int32_t Insert(uint32_t object, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	void Remove(int32_t leaf);
+	// New box of an object that moved, its ancestors are grown/shrunk by the next Refit
+	void Update(int32_t leaf, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// Recompute the boxes of every node above an updated leaf
+	void Refit();
+	void Clear();
+
+	// Objects whose box isn`t fully outside one of the planes (xyz normal pointing inside, w distance)
+	void QueryFrustum(const glm::vec4* planes, std::vector<uint32_t>& objects) const;
+	// Objects whose box touches the sphere
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& objects) const;
+	// Objects whose box the ray enters within maxDistance, nearest entry first
+	void QueryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& objects) const;
+
+	size_t GetObjectCount() const { return m_ObjectCount; }
+	// Longest path from the root to a leaf, in edges
+	int32_t GetHeight() const { return m_Root >= 0 ? m_Nodes[m_Root].Height : 0; }
+
+private:
+	struct Node
+	{
+		glm::vec3 BoundsMin = glm::vec3(0.0f);
+		glm::vec3 BoundsMax = glm::vec3(0.0f);
+		int32_t Parent = -1;			// next free node while on the free list
+		int32_t Children[2] = { -1, -1 };
+		int32_t Height = 0;				// 0 for leaves, -1 for free nodes
+		uint32_t Object = 0;
+		bool IsDirty = false;			// box (or a descendant`s) changed since the last Refit
+
+		bool IsLeaf() const { return Children[0] < 0; }
+	};
+
+	int32_t AllocateNode();
+	void FreeNode(int32_t node);
+
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+	// Rotate the children of an unbalanced node up, returns the node now in its place
+	int32_t Balance(int32_t node);
+	// Refit boxes and heights from node up to the root, rotating where unbalanced
+	void FixUpwards(int32_t node);
+	// Box, height and dirty flag of an inner node from its children
+	void UpdateFromChildren(int32_t node);
+	// Refit the dirty nodes below node, children first
+	void RefitNode(int32_t node);
+	// Add the objects of every leaf below node
+	void CollectObjects(int32_t node, std::vector<uint32_t>& objects) const;
+
+private:
+	std::vector<Node> m_Nodes;
+	int32_t m_Root = -1;
+	int32_t m_FreeList = -1;
+	size_t m_ObjectCount = 0;
+};
@@ -1,5 +1,5 @@
-C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -V shader.vert
-C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -V shader.frag
-C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o second_vert.spv -V second.vert
-C:\VulkanSDK\1.3.204.1\Bin\glslangValidator.exe -o second_frag.spv -V second.frag
+%VULKAN_SDK%\Bin\glslangValidator.exe -V -o vert.spv shader.vert
+%VULKAN_SDK%\Bin\glslangValidator.exe -V -o frag.spv shader.frag
+%VULKAN_SDK%\Bin\glslangValidator.exe -V -o second_vert.spv second.vert
+%VULKAN_SDK%\Bin\glslangValidator.exe -V -o second_frag.spv second.frag
 pause
\ No newline at end of file
@@ -1,10 +1,13 @@
 #version 450 
 
+// Vertex or CompactVertex (position/uv as unorm16 in the mesh bounds, octahedral snorm16 normal)
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
 layout(location = 2) in vec2 texCoords;
 layout(location = 3) in vec3 normalCoords;
 
+// Set for the CompactVertex pipeline
+layout(constant_id = 0) const bool compactVertices = false;
+
 
 layout(set = 0, binding = 0) uniform cameraComponent {
 	mat4 projectionViewMtx;
@@ -17,21 +20,36 @@ layout(set = 0, binding = 1) uniform uboModel {
 	mat4 model;
 } modelMtx;
 
-layout(push_constant) uniform PushModel {
-	mat4 model;
-} pushModel;
+// Per mesh dequantization (identity for full vertices) and constant color
+layout(push_constant) uniform PushMesh {
+	vec4 positionScale;
+	vec4 positionOffset;
+	vec4 texCoordsScaleOffset;
+	vec4 color;
+} pushMesh;
 
 layout(location = 0) out vec3 out_color;
 layout(location = 1) out vec2 fragTex;
 layout(location = 2) out vec3 v_normal;
 layout(location = 3) out vec3 v_gazeDirection;
 
+vec3 OctDecode(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += vec2(normal.x >= 0.0 ? -fold : fold, normal.y >= 0.0 ? -fold : fold);
+	return normalize(normal);
+}
+
 void main()
 {
-	gl_Position = camera.projectionViewMtx * modelMtx.model *vec4(position, 1.0);
-	out_color = color;
-	fragTex = texCoords;
+	vec3 objectPosition = position * pushMesh.positionScale.xyz + pushMesh.positionOffset.xyz;
+	vec3 objectNormal = compactVertices ? OctDecode(normalCoords.xy) : normalCoords;
+
+	gl_Position = camera.projectionViewMtx * modelMtx.model *vec4(objectPosition, 1.0);
+	out_color = pushMesh.color.rgb;
+	fragTex = texCoords * pushMesh.texCoordsScaleOffset.xy + pushMesh.texCoordsScaleOffset.zw;
 	mat3 MVI = camera.inverseTransposeViewMatrix*transpose(inverse(mat3(modelMtx.model)));
-	v_normal = normalize(MVI*normalCoords);
+	v_normal = normalize(MVI*objectNormal);
 	v_gazeDirection = normalize(MVI*camera.gazeDirection);
 }
\ No newline at end of file
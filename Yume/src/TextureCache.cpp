@@ -0,0 +1,584 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <stb_image.h>
+
+#include "AssetRegistry.h"
+#include "AsyncFileReader.h"
+#include "BlockCompression.h"
+#include "GltfLoader.h"
+#include "Ktx2.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+// Bump whenever the cooked texture encoding changes
+static const uint64_t s_CookedVersion = 2;
+
+// Stored channels of an image, picked from what its texels hold
+struct TextureLayout
+{
+	VkFormat Format;				// uncompressed
+	VkFormat CompressedFormat;
+	const char* Swizzle;			// KTX notation, maps the stored channels back to rgba
+};
+
+static uint32_t GetChannelCount(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+		return 1;
+	case VK_FORMAT_R8G8_UNORM:
+		return 2;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return 4;
+	default:
+		return BlockCompression::GetChannelCount(format);
+	}
+}
+
+// Uncompressed format holding the channels of a block compressed format
+static VkFormat GetUncompressedFormat(VkFormat format)
+{
+	switch (GetChannelCount(format))
+	{
+	case 1:
+		return VK_FORMAT_R8_UNORM;
+	case 2:
+		return VK_FORMAT_R8G8_UNORM;
+	default:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+// Picks the layout and moves the channels it keeps to the front of every RGBA texel
+// channels is what the file stores (stbi), it tells whether alpha can be there at all
+static TextureLayout ChooseLayout(uint8_t* rgba, size_t texelCount, int channels)
+{
+	// Grey images are often saved as RGB(A), so look at the texels rather than trusting the file
+	const bool mayHaveAlpha = channels == 2 || channels == 4;
+	bool isGrey = true;
+	bool hasAlpha = false;
+	for (size_t i = 0; i < texelCount && (isGrey || (mayHaveAlpha && !hasAlpha)); i++)
+	{
+		const uint8_t* texel = rgba + i * 4;
+		isGrey = isGrey && texel[0] == texel[1] && texel[1] == texel[2];
+		hasAlpha = hasAlpha || texel[3] != 255;
+	}
+
+	if (isGrey && hasAlpha)
+	{
+		for (size_t i = 0; i < texelCount; i++)
+			rgba[i * 4 + 1] = rgba[i * 4 + 3];
+
+		return { VK_FORMAT_R8G8_UNORM, VK_FORMAT_BC5_UNORM_BLOCK, "rrrg" };
+	}
+
+	if (isGrey)
+		return { VK_FORMAT_R8_UNORM, VK_FORMAT_BC4_UNORM_BLOCK, "rrr1" };
+
+	// BC7 keeps the alpha, opaque textures get by with half the size
+	if (hasAlpha)
+		return { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_BC7_UNORM_BLOCK, "rgba" };
+
+	return { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_BC1_RGB_UNORM_BLOCK, "rgba" };
+}
+
+// View swizzle of a KTX swizzle string, identity for anything else
+static VkComponentMapping ParseSwizzle(const std::string& swizzle)
+{
+	VkComponentSwizzle components[4] = {};
+	for (size_t i = 0; i < 4; i++)
+	{
+		switch (i < swizzle.size() ? swizzle[i] : '\0')
+		{
+		case 'r': components[i] = VK_COMPONENT_SWIZZLE_R; break;
+		case 'g': components[i] = VK_COMPONENT_SWIZZLE_G; break;
+		case 'b': components[i] = VK_COMPONENT_SWIZZLE_B; break;
+		case 'a': components[i] = VK_COMPONENT_SWIZZLE_A; break;
+		case '0': components[i] = VK_COMPONENT_SWIZZLE_ZERO; break;
+		case '1': components[i] = VK_COMPONENT_SWIZZLE_ONE; break;
+		default: return {};
+		}
+	}
+
+	return { components[0], components[1], components[2], components[3] };
+}
+
+// Copy the first channelCount channels of every RGBA texel
+static void PackChannels(const uint8_t* rgba, size_t texelCount, uint32_t channelCount, uint8_t* destination)
+{
+	if (channelCount == 4)
+	{
+		memcpy(destination, rgba, texelCount * 4);
+		return;
+	}
+
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		for (uint32_t channel = 0; channel < channelCount; channel++)
+			destination[i * channelCount + channel] = rgba[i * 4 + channel];
+	}
+}
+
+static bool HasExtension(const std::string& path, const std::string& extension)
+{
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+// Levels of a mapped KTX2 file the cache can upload, false if the format or the level sizes don`t fit
+static bool GetKtx2Levels(const Ktx2Texture& texture, std::vector<const uint8_t*>& levels)
+{
+	if (texture.Format != VK_FORMAT_R8_UNORM && texture.Format != VK_FORMAT_R8G8_UNORM &&
+		texture.Format != VK_FORMAT_R8G8B8A8_UNORM && !BlockCompression::IsSupported(texture.Format))
+	{
+		return false;
+	}
+
+	if (texture.Levels.size() > MipGenerator::GetLevelCount(texture.Width, texture.Height))
+		return false;
+
+	levels.clear();
+	for (uint32_t level = 0; level < texture.Levels.size(); level++)
+	{
+		const VkDeviceSize expectedSize = GetImageSize(texture.Format,
+			MipGenerator::GetLevelWidth(texture.Width, level), MipGenerator::GetLevelHeight(texture.Height, level));
+		if (texture.Levels[level].Size < expectedSize)
+			return false;
+
+		levels.push_back(texture.GetLevelData(level));
+	}
+	return true;
+}
+
+void TextureCache::Init(VkDevice device, const std::vector<VkFormat>& blitFormats, const std::vector<VkFormat>& sampledBlockFormats)
+{
+	m_Device = device;
+	m_BlitFormats = blitFormats;
+	m_SampledBlockFormats = sampledBlockFormats;
+}
+
+void TextureCache::Clear()
+{
+	std::unordered_map<std::string, std::shared_ptr<Entry>> pathEntries;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		pathEntries.swap(m_PathEntries);
+		m_ContentEntries.clear();
+		m_RequestCount = 0;
+	}
+	m_StagedSize = 0;
+	m_UncompressedSize = 0;
+
+	for (auto& pathEntry : pathEntries)
+	{
+		auto& entry = pathEntry.second;
+
+		// Decode may still be writing into the staging buffer (and takes the lock, so wait outside it)
+		if (entry->Decoded.valid())
+			entry->Decoded.wait();
+
+		if (entry->Image.StagingBuffer != VK_NULL_HANDLE)
+		{
+			DestroyBuffer(m_Device, entry->Image.StagingBuffer, entry->Image.StagingBufferAllocation);
+		}
+	}
+}
+
+std::shared_ptr<TextureCache::Entry> TextureCache::Request(const std::string& filepath)
+{
+	const std::string normalizedPath = NormalizePath(filepath);
+
+	std::shared_ptr<Entry> entry;
+	auto decoded = std::make_shared<std::promise<void>>();
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_RequestCount++;
+
+		auto it = m_PathEntries.find(normalizedPath);
+		if (it != m_PathEntries.end())
+			return it->second;
+
+		entry = std::make_shared<Entry>();
+		entry->Path = normalizedPath;
+		// Set under the lock so other requesters never see the entry without its future
+		entry->Decoded = decoded->get_future().share();
+		m_PathEntries[normalizedPath] = entry;
+	}
+
+	// Images embedded in a model have no file of their own, the worker reads them out of the model file
+	std::string modelPath;
+	uint32_t imageIndex = 0;
+	if (GltfLoader::ParseEmbeddedImagePath(normalizedPath, modelPath, imageIndex))
+	{
+		ThreadPool::Get().Submit([this, entry, decoded, modelPath, imageIndex]()
+		{
+			try
+			{
+				Decode(entry, GltfLoader::LoadEmbeddedImage(modelPath, imageIndex));
+				decoded->set_value();
+			}
+			catch (...)
+			{
+				decoded->set_exception(std::current_exception());
+			}
+		});
+		return entry;
+	}
+
+	// Disk read on the I/O thread (outside the lock, the fallback may run the callback right here),
+	// the decode goes to the pool as soon as the bytes land
+	AsyncFileReader::Get().Read(normalizedPath, [this, entry, decoded](FileData&& data, bool isRead)
+	{
+		if (!isRead)
+		{
+			decoded->set_exception(std::make_exception_ptr(std::runtime_error("Failed to load a texture file: " + entry->Path)));
+			return;
+		}
+
+		auto fileData = std::make_shared<FileData>(std::move(data));
+		ThreadPool::Get().Submit([this, entry, decoded, fileData]()
+		{
+			try
+			{
+				Decode(entry, *fileData);
+				decoded->set_value();
+			}
+			catch (...)
+			{
+				decoded->set_exception(std::current_exception());
+			}
+		});
+	});
+
+	return entry;
+}
+
+std::shared_ptr<TextureAsset> TextureCache::Resolve(const std::shared_ptr<Entry>& entry,
+	const std::function<std::shared_ptr<TextureAsset>(const TextureImage&)>& upload)
+{
+	if (auto texture = entry->Texture.lock())
+		return texture;
+
+	// Rethrows a failed decode
+	entry->Decoded.get();
+
+	if (entry->Alias)
+	{
+		auto texture = Resolve(entry->Alias, upload);
+		entry->Texture = texture;
+		return texture;
+	}
+
+	// Uploaded before and released since, the staging buffer is gone: requested again under a fresh entry
+	// (released textures are evicted right away, this only happens to entries requested before the release)
+	if (entry->Image.StagingBuffer == VK_NULL_HANDLE)
+	{
+		Evict(entry);
+		return Resolve(Request(entry->Path), upload);
+	}
+
+	auto texture = upload(entry->Image);
+	texture->CacheEntry = entry;
+	entry->Texture = texture;
+
+	// Upload took ownership of the staging buffer
+	entry->Image.StagingBuffer = VK_NULL_HANDLE;
+	entry->Image.StagingBufferAllocation = MemoryAllocation();
+
+	return texture;
+}
+
+void TextureCache::Evict(const std::shared_ptr<Entry>& entry)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (auto it = m_PathEntries.begin(); it != m_PathEntries.end();)
+	{
+		if (it->second == entry || it->second->Alias == entry)
+			it = m_PathEntries.erase(it);
+		else
+			++it;
+	}
+
+	auto it = m_ContentEntries.find(entry->ContentHash);
+	if (it != m_ContentEntries.end() && it->second == entry)
+		m_ContentEntries.erase(it);
+}
+
+bool TextureCache::IsDecoded(const std::shared_ptr<Entry>& entry)
+{
+	if (!entry->Texture.expired())
+		return true;
+
+	if (entry->Decoded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	return !entry->Alias || IsDecoded(entry->Alias);
+}
+
+VkDeviceSize TextureCache::GetUploadSize(const std::shared_ptr<Entry>& entry)
+{
+	if (!entry->Texture.expired())
+		return 0;
+
+	return entry->Alias ? GetUploadSize(entry->Alias) : entry->Image.Size;
+}
+
+std::string TextureCache::NormalizePath(const std::string& filepath)
+{
+	std::string path = filepath;
+	std::replace(path.begin(), path.end(), '\\', '/');
+
+#ifdef _WIN32
+	// Windows paths are case insensitive
+	std::transform(path.begin(), path.end(), path.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+#endif
+
+	// Collapse "." and "dir/.." segments
+	const bool isAbsolute = !path.empty() && path[0] == '/';
+	std::vector<std::string> segments;
+	size_t start = 0;
+	while (start <= path.size())
+	{
+		size_t end = path.find('/', start);
+		if (end == std::string::npos)
+			end = path.size();
+
+		std::string segment = path.substr(start, end - start);
+		if (segment == "..")
+		{
+			if (!segments.empty() && segments.back() != "..")
+				segments.pop_back();
+			else if (!isAbsolute)
+				segments.push_back(segment);
+		}
+		else if (!segment.empty() && segment != ".")
+		{
+			segments.push_back(segment);
+		}
+
+		start = end + 1;
+	}
+
+	std::string normalizedPath = isAbsolute ? "/" : "";
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		if (i > 0)
+			normalizedPath += '/';
+		normalizedPath += segments[i];
+	}
+
+	return normalizedPath;
+}
+
+std::string TextureCache::GetCookedPath(const std::string& sourcePath)
+{
+	return sourcePath + ".ktx2";
+}
+
+void TextureCache::Decode(const std::shared_ptr<Entry>& entry, const FileData& file)
+{
+	// Same bytes under another path: share that texture and skip the decode
+	entry->ContentHash = HashMemory(file.data(), file.size());
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		auto it = m_ContentEntries.find(entry->ContentHash);
+		if (it != m_ContentEntries.end())
+		{
+			entry->Alias = it->second;
+			return;
+		}
+
+		m_ContentEntries[entry->ContentHash] = entry;
+	}
+
+	std::vector<const uint8_t*> levels;
+
+	// Already block compressed (or at least mipped), upload as stored
+	if (HasExtension(entry->Path, ".ktx2"))
+	{
+		Ktx2Texture texture;
+		if (!Ktx2::Load(entry->Path, texture) || !GetKtx2Levels(texture, levels))
+		{
+			throw std::runtime_error("Failed to load a KTX2 texture file: " + entry->Path);
+		}
+
+		StageLevels(entry->Image, texture.Format, texture.Width, texture.Height, levels, texture.Swizzle);
+		return;
+	}
+
+	// Cooked copy of the same content: skip the decode and the encode
+	const uint64_t cookKey = HashMemory(&entry->ContentHash, sizeof(entry->ContentHash), s_CookedVersion);
+	if (COMPRESS_TEXTURES)
+	{
+		Ktx2Texture texture;
+		if (Ktx2::Load(GetCookedPath(entry->Path), texture) && texture.CookKey == cookKey && GetKtx2Levels(texture, levels))
+		{
+			StageLevels(entry->Image, texture.Format, texture.Width, texture.Height, levels, texture.Swizzle);
+			return;
+		}
+	}
+
+	// number of channels image uses
+	int width, height, channels;
+
+	// load pixel data (as RGBA, channels still reports what the file stores)
+	stbi_uc* pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &channels, STBI_rgb_alpha);
+
+	if (!pixels)
+	{
+		throw std::runtime_error("Failed to load a texture file: " + entry->Path);
+	}
+
+	const TextureLayout layout = ChooseLayout(pixels, size_t(width) * height, channels);
+
+	if (COMPRESS_TEXTURES)
+	{
+		Cook(entry, pixels, width, height, layout, cookKey);
+	}
+	else
+	{
+		Stage(entry->Image, pixels, width, height, layout);
+	}
+
+	stbi_image_free(pixels);
+}
+
+void TextureCache::Stage(TextureImage& image, const uint8_t* pixels, uint32_t width, uint32_t height, const TextureLayout& layout)
+{
+	// Mips are blitted when the device filters the format, built here otherwise
+	const bool generateCpuMips = std::find(m_BlitFormats.begin(), m_BlitFormats.end(), layout.Format) == m_BlitFormats.end();
+	const uint32_t channelCount = GetChannelCount(layout.Format);
+
+	image.Format = layout.Format;
+	image.Swizzle = ParseSwizzle(layout.Swizzle);
+	image.Width = static_cast<int>(width);
+	image.Height = static_cast<int>(height);
+	image.MipLevels = MipGenerator::GetLevelCount(width, height);
+	image.IsMipChainIncluded = generateCpuMips;
+
+	const uint32_t stagedLevelCount = generateCpuMips ? image.MipLevels : 1;
+	image.Size = 0;
+	for (uint32_t level = 0; level < stagedLevelCount; level++)
+	{
+		image.Size += GetImageSize(image.Format, MipGenerator::GetLevelWidth(width, level), MipGenerator::GetLevelHeight(height, level));
+	}
+
+	// Fill the staging buffer here while the pixels are still hot in this worker`s cache,
+	// the main thread only has to record the copy
+	CreateBuffer(m_Device, image.Size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&image.StagingBuffer, &image.StagingBufferAllocation, {}, AllocationStrategy::Linear);
+
+	uint8_t* destination = static_cast<uint8_t*>(image.StagingBufferAllocation.MappedData);
+	if (generateCpuMips)
+	{
+		// Filter in ordinary memory, every level reads the previous one back and staging memory may be write combined
+		std::vector<uint8_t> chain(MipGenerator::GetLevelOffset(width, height, image.MipLevels));
+		memcpy(chain.data(), pixels, size_t(width) * height * 4);
+		MipGenerator::GenerateMipChain(chain.data(), width, height, image.MipLevels);
+
+		for (uint32_t level = 0; level < image.MipLevels; level++)
+		{
+			const size_t texelCount = size_t(MipGenerator::GetLevelWidth(width, level)) * MipGenerator::GetLevelHeight(height, level);
+			PackChannels(chain.data() + MipGenerator::GetLevelOffset(width, height, level), texelCount, channelCount, destination);
+			destination += texelCount * channelCount;
+		}
+	}
+	else
+	{
+		PackChannels(pixels, size_t(width) * height, channelCount, destination);
+	}
+
+	m_StagedSize += image.Size;
+	m_UncompressedSize += MipGenerator::GetLevelOffset(width, height, image.MipLevels);
+}
+
+void TextureCache::Cook(const std::shared_ptr<Entry>& entry, const uint8_t* pixels, uint32_t width, uint32_t height,
+	const TextureLayout& layout, uint64_t cookKey)
+{
+	const VkFormat format = layout.CompressedFormat;
+
+	// Mips are filtered before compression, blits can`t write block compressed levels
+	const uint32_t levelCount = MipGenerator::GetLevelCount(width, height);
+	std::vector<uint8_t> chain(MipGenerator::GetLevelOffset(width, height, levelCount));
+	memcpy(chain.data(), pixels, size_t(width) * height * 4);
+	MipGenerator::GenerateMipChain(chain.data(), width, height, levelCount);
+
+	std::vector<std::vector<uint8_t>> compressedLevels(levelCount);
+	std::vector<const uint8_t*> levels(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		const uint32_t levelWidth = MipGenerator::GetLevelWidth(width, level);
+		const uint32_t levelHeight = MipGenerator::GetLevelHeight(height, level);
+
+		compressedLevels[level].resize(GetImageSize(format, levelWidth, levelHeight));
+		BlockCompression::Encode(format, chain.data() + MipGenerator::GetLevelOffset(width, height, level), levelWidth, levelHeight,
+			compressedLevels[level].data());
+		levels[level] = compressedLevels[level].data();
+	}
+
+	const std::string cookedPath = GetCookedPath(entry->Path);
+	if (!Ktx2::Save(cookedPath, format, width, height, compressedLevels, layout.Swizzle, cookKey))
+	{
+		std::cout << "Failed to write cooked texture: " << cookedPath << std::endl;
+	}
+
+	StageLevels(entry->Image, format, width, height, levels, layout.Swizzle);
+}
+
+void TextureCache::StageLevels(TextureImage& image, VkFormat format, uint32_t width, uint32_t height, const std::vector<const uint8_t*>& levels,
+	const std::string& swizzle)
+{
+	const bool isSampled = !BlockCompression::IsSupported(format) ||
+		std::find(m_SampledBlockFormats.begin(), m_SampledBlockFormats.end(), format) != m_SampledBlockFormats.end();
+
+	image.Format = isSampled ? format : GetUncompressedFormat(format);
+	image.Swizzle = ParseSwizzle(swizzle);
+	image.Width = static_cast<int>(width);
+	image.Height = static_cast<int>(height);
+	image.MipLevels = static_cast<uint32_t>(levels.size());
+	image.IsMipChainIncluded = true;
+
+	image.Size = 0;
+	for (uint32_t level = 0; level < image.MipLevels; level++)
+	{
+		image.Size += GetImageSize(image.Format, MipGenerator::GetLevelWidth(width, level), MipGenerator::GetLevelHeight(height, level));
+	}
+
+	CreateBuffer(m_Device, image.Size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&image.StagingBuffer, &image.StagingBufferAllocation, {}, AllocationStrategy::Linear);
+
+	uint8_t* destination = static_cast<uint8_t*>(image.StagingBufferAllocation.MappedData);
+	std::vector<uint8_t> decoded;
+	for (uint32_t level = 0; level < image.MipLevels; level++)
+	{
+		const uint32_t levelWidth = MipGenerator::GetLevelWidth(width, level);
+		const uint32_t levelHeight = MipGenerator::GetLevelHeight(height, level);
+		const size_t levelSize = static_cast<size_t>(GetImageSize(image.Format, levelWidth, levelHeight));
+
+		if (isSampled)
+		{
+			memcpy(destination, levels[level], levelSize);
+		}
+		else
+		{
+			// Decompress in ordinary memory (staging memory may be write combined), then keep the channels the format stores
+			decoded.resize(size_t(levelWidth) * levelHeight * 4);
+			BlockCompression::Decode(format, levels[level], levelWidth, levelHeight, decoded.data());
+			PackChannels(decoded.data(), size_t(levelWidth) * levelHeight, GetChannelCount(image.Format), destination);
+		}
+		destination += levelSize;
+	}
+
+	m_StagedSize += image.Size;
+	m_UncompressedSize += MipGenerator::GetLevelOffset(width, height, MipGenerator::GetLevelCount(width, height));
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Utils.h"
+
+// Decoded texture waiting in its own staging buffer for the upload
+struct TextureImage
+{
+	VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM;	// R8, RG8, RGBA8 or a block compressed format the device samples
+	VkComponentMapping Swizzle = {};	// view swizzle mapping the stored channels back to rgba (identity by default)
+	int Width = 0;
+	int Height = 0;
+	uint32_t MipLevels = 1;				// full chain down to 1x1
+	bool IsMipChainIncluded = false;	// staging holds every level (packed, see MipGenerator), else level 0 only
+	VkDeviceSize Size = 0;
+	VkBuffer StagingBuffer = VK_NULL_HANDLE;
+	MemoryAllocation StagingBufferAllocation;
+};
+
+struct TextureLayout;
+struct TextureAsset;
+
+// Texture lookup keyed by normalized path and file content hash
+// Every texture file is decoded once (on the thread pool) and uploaded once, later requests
+// for the same path or for a file with identical bytes get the existing texture while anything holds it
+// Images keep only the channels they use: grey as R8 (RG8 with alpha), the rest as RGBA8
+// .ktx2 files are uploaded as stored; other images are cooked into a block compressed <source>.ktx2
+// (BC4/BC5 for one/two channels, BC1 when opaque, BC7 otherwise, full mip chain) when COMPRESS_TEXTURES is set
+// Images embedded in glTF models (<file>#image<N>, see GltfLoader) are read out of the model file instead of a file of their own
+class TextureCache
+{
+public:
+	struct Entry
+	{
+		std::string Path;
+		uint64_t ContentHash = 0;
+		std::shared_future<void> Decoded;
+		TextureImage Image;
+		std::shared_ptr<Entry> Alias;		// set when another path with the same content got there first
+		std::weak_ptr<TextureAsset> Texture;	// main thread only, expires when the last user releases the texture
+	};
+
+	// blitFormats: uncompressed formats the device blits with linear filtering, decode workers build the mip chain of others
+	// sampledBlockFormats: block compressed formats the device samples, others are decompressed on the CPU
+	void Init(VkDevice device, const std::vector<VkFormat>& blitFormats, const std::vector<VkFormat>& sampledBlockFormats);
+	// Wait for pending decodes and release staging memory of textures that were never uploaded
+	void Clear();
+
+	// Thread safe: entry for a texture, its decode is scheduled on the thread pool the first time the path is seen
+	std::shared_ptr<Entry> Request(const std::string& filepath);
+	// Main thread: texture of an entry, calling upload (which owns the staging buffer afterwards) while none is alive
+	// Entries whose texture was released (and evicted) since are requested again, waiting for the new decode
+	std::shared_ptr<TextureAsset> Resolve(const std::shared_ptr<Entry>& entry,
+		const std::function<std::shared_ptr<TextureAsset>(const TextureImage&)>& upload);
+	// Main thread: forget an entry (and the paths aliasing it) once its texture is released, later requests decode again
+	void Evict(const std::shared_ptr<Entry>& entry);
+	// Main thread: true when Resolve won`t wait on a decode (failed decodes count as done, Resolve rethrows)
+	static bool IsDecoded(const std::shared_ptr<Entry>& entry);
+	// Main thread, decoded entries only: staging bytes Resolve will upload, 0 once resident
+	static VkDeviceSize GetUploadSize(const std::shared_ptr<Entry>& entry);
+
+	size_t GetRequestCount() const { std::lock_guard<std::mutex> lock(m_Mutex); return m_RequestCount; }
+	size_t GetUniqueCount() const { std::lock_guard<std::mutex> lock(m_Mutex); return m_ContentEntries.size(); }
+	// Staging bytes of every decoded texture, and what the same textures take as RGBA8 with full mip chains
+	uint64_t GetStagedSize() const { return m_StagedSize; }
+	uint64_t GetUncompressedSize() const { return m_UncompressedSize; }
+
+	static std::string NormalizePath(const std::string& filepath);
+	static std::string GetCookedPath(const std::string& sourcePath);
+
+private:
+	// Decode the file bytes read for the entry into its staging buffer
+	void Decode(const std::shared_ptr<Entry>& entry, const FileData& file);
+	// Stage pixels (stored channels first in every RGBA texel) as the layout`s uncompressed format
+	void Stage(TextureImage& image, const uint8_t* pixels, uint32_t width, uint32_t height, const TextureLayout& layout);
+	// Block compress pixels with their mip chain into the cooked file and stage the result
+	void Cook(const std::shared_ptr<Entry>& entry, const uint8_t* pixels, uint32_t width, uint32_t height, const TextureLayout& layout,
+		uint64_t cookKey);
+	// Fill a staging buffer with packed levels (level 0 first), decompressed when the device can`t sample the format
+	void StageLevels(TextureImage& image, VkFormat format, uint32_t width, uint32_t height, const std::vector<const uint8_t*>& levels,
+		const std::string& swizzle);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	std::vector<VkFormat> m_BlitFormats;
+	std::vector<VkFormat> m_SampledBlockFormats;
+	std::atomic<uint64_t> m_StagedSize{ 0 };
+	std::atomic<uint64_t> m_UncompressedSize{ 0 };
+
+	mutable std::mutex m_Mutex;
+	std::unordered_map<std::string, std::shared_ptr<Entry>> m_PathEntries;
+	std::unordered_map<uint64_t, std::shared_ptr<Entry>> m_ContentEntries;
+	size_t m_RequestCount = 0;
+};
@@ -0,0 +1,111 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	threadCount = std::max(threadCount, 1u);
+
+	m_Workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_Condition.notify_all();
+
+	// Workers drain the remaining tasks before leaving
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool s_Pool(std::thread::hardware_concurrency());
+	return s_Pool;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task)
+{
+	if (count == 0)
+		return;
+
+	// Helpers may only get to run after the loop is done, they must never touch task then
+	struct Loop
+	{
+		std::atomic<uint32_t> Next{ 0 };
+		std::atomic<uint32_t> Done{ 0 };
+		const std::function<void(uint32_t)>* Task = nullptr;
+		uint32_t Count = 0;
+		std::mutex Mutex;
+		std::condition_variable Finished;
+	};
+
+	auto loop = std::make_shared<Loop>();
+	loop->Task = &task;
+	loop->Count = count;
+
+	auto run = [](Loop& state)
+	{
+		for (uint32_t i = state.Next++; i < state.Count; i = state.Next++)
+		{
+			(*state.Task)(i);
+
+			if (++state.Done == state.Count)
+			{
+				std::lock_guard<std::mutex> lock(state.Mutex);
+				state.Finished.notify_all();
+			}
+		}
+	};
+
+	const uint32_t helperCount = std::min(count - 1, GetThreadCount());
+	for (uint32_t i = 0; i < helperCount; i++)
+	{
+		Enqueue([loop, run]() { run(*loop); });
+	}
+
+	run(*loop);
+
+	std::unique_lock<std::mutex> lock(loop->Mutex);
+	loop->Finished.wait(lock, [&]() { return loop->Done == count; });
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Tasks.push(std::move(task));
+	}
+	m_Condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_IsStopping || !m_Tasks.empty(); });
+
+			if (m_Tasks.empty())
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads consuming a FIFO of tasks
+class ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t threadCount);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	// Shared pool sized to the machine, created on first use
+	static ThreadPool& Get();
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+	// Queue a task and get a future for its result (exceptions are forwarded through the future)
+	template<typename Task>
+	auto Submit(Task&& task) -> std::future<std::invoke_result_t<std::decay_t<Task>>>
+	{
+		using Result = std::invoke_result_t<std::decay_t<Task>>;
+
+		// packaged_task is move-only, std::function needs a copyable callable
+		auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+		std::future<Result> future = packagedTask->get_future();
+		Enqueue([packagedTask]() { (*packagedTask)(); });
+
+		return future;
+	}
+
+	// Run task(i) for every i in [0, count), the calling thread takes part and returns once all are done
+	// Safe to call from a worker: the caller only waits for indices already running on other threads (task must not throw)
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+private:
+	void Enqueue(std::function<void()> task);
+	void WorkerLoop();
+
+private:
+	std::vector<std::thread> m_Workers;
+	std::queue<std::function<void()>> m_Tasks;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_IsStopping = false;
+};
@@ -0,0 +1,574 @@
+#include "UploadBatcher.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "MipGenerator.h"
+
+void UploadHandoff::RecordAcquire(VkCommandBuffer commandBuffer) const
+{
+	if (!BufferBarriers.empty() || !ImageBarriers.empty())
+	{
+		vkCmdPipelineBarrier(commandBuffer,
+			WaitStages, WaitStages,			// same stages the submission waits for the semaphore in
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(BufferBarriers.size()), BufferBarriers.data(),
+			static_cast<uint32_t>(ImageBarriers.size()), ImageBarriers.data());
+	}
+
+	if (MipGenerations.empty())
+		return;
+
+	// Every level is in transfer dst with level 0 uploaded, blit each level from the one above it
+	VkImageMemoryBarrier levelBarrier = {};
+	levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	levelBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	levelBarrier.subresourceRange.levelCount = 1;
+	levelBarrier.subresourceRange.baseArrayLayer = 0;
+	levelBarrier.subresourceRange.layerCount = 1;
+
+	std::vector<VkImageMemoryBarrier> shaderReadBarriers;
+	shaderReadBarriers.reserve(MipGenerations.size() * 2);
+
+	for (const auto& mipGeneration : MipGenerations)
+	{
+		levelBarrier.image = mipGeneration.Image;
+
+		for (uint32_t level = 1; level < mipGeneration.MipLevels; level++)
+		{
+			// Level above was written (copy or previous blit), becomes the blit source
+			levelBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			levelBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			levelBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			levelBarrier.subresourceRange.baseMipLevel = level - 1;
+
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+			VkImageBlit blit = {};
+			blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			blit.srcSubresource.mipLevel = level - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = 1;
+			blit.srcOffsets[1].x = static_cast<int32_t>(MipGenerator::GetLevelWidth(mipGeneration.Width, level - 1));
+			blit.srcOffsets[1].y = static_cast<int32_t>(MipGenerator::GetLevelHeight(mipGeneration.Height, level - 1));
+			blit.srcOffsets[1].z = 1;
+			blit.dstSubresource = blit.srcSubresource;
+			blit.dstSubresource.mipLevel = level;
+			blit.dstOffsets[1].x = static_cast<int32_t>(MipGenerator::GetLevelWidth(mipGeneration.Width, level));
+			blit.dstOffsets[1].y = static_cast<int32_t>(MipGenerator::GetLevelHeight(mipGeneration.Height, level));
+			blit.dstOffsets[1].z = 1;
+
+			vkCmdBlitImage(commandBuffer,
+				mipGeneration.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				mipGeneration.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit, VK_FILTER_LINEAR);
+		}
+
+		// Blit sources were only read, the last level was written by the last blit
+		if (mipGeneration.MipLevels > 1)
+		{
+			levelBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			levelBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			levelBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			levelBarrier.subresourceRange.baseMipLevel = 0;
+			levelBarrier.subresourceRange.levelCount = mipGeneration.MipLevels - 1;
+			shaderReadBarriers.push_back(levelBarrier);
+		}
+
+		levelBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		levelBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		levelBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		levelBarrier.subresourceRange.baseMipLevel = mipGeneration.MipLevels - 1;
+		levelBarrier.subresourceRange.levelCount = 1;
+		shaderReadBarriers.push_back(levelBarrier);
+	}
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(shaderReadBarriers.size()), shaderReadBarriers.data());
+}
+
+void UploadBatcher::Init(VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, uint32_t dstQueueFamilyIndex,
+	VkDeviceSize ringSize)
+{
+	m_Device = device;
+	m_Queue = queue;
+	m_QueueFamilyIndex = queueFamilyIndex;
+	m_DstQueueFamilyIndex = dstQueueFamilyIndex;
+
+	// Command buffers are re-recorded once their batch retired
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	VkResult result = vkCreateCommandPool(m_Device, &poolInfo, nullptr, &m_CommandPool);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upload command pool!");
+	}
+
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandPool = m_CommandPool;
+	allocateInfo.commandBufferCount = 1;
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	for (auto& batch : m_Batches)
+	{
+		if (vkAllocateCommandBuffers(m_Device, &allocateInfo, &batch.CommandBuffer) != VK_SUCCESS ||
+			vkCreateFence(m_Device, &fenceCreateInfo, nullptr, &batch.Fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload batch!");
+		}
+	}
+
+	// Timeline semaphore, the render queue waits for the value of the last batch it uses
+	VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {};
+	semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeCreateInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+	result = vkCreateSemaphore(m_Device, &semaphoreCreateInfo, nullptr, &m_Timeline);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create upload timeline semaphore!");
+	}
+
+	// Staging ring stays mapped for the whole lifetime
+	m_RingSize = ringSize;
+	m_RingHead = 0;
+	m_RingTail = 0;
+	CreateBuffer(m_Device, m_RingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&m_RingBuffer, &m_RingBufferAllocation);
+
+	m_RingData = static_cast<uint8_t*>(m_RingBufferAllocation.MappedData);
+}
+
+void UploadBatcher::Destroy()
+{
+	WaitIdle();
+
+	DestroyBuffer(m_Device, m_RingBuffer, m_RingBufferAllocation);
+	m_RingData = nullptr;
+
+	for (auto& batch : m_Batches)
+	{
+		vkDestroyFence(m_Device, batch.Fence, nullptr);
+	}
+	vkDestroySemaphore(m_Device, m_Timeline, nullptr);
+
+	// Frees the command buffers too
+	vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+}
+
+void UploadBatcher::UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	if (size == 0)
+		return;
+
+	VkBuffer srcBuffer = m_RingBuffer;
+	VkDeviceSize srcOffset = 0;
+
+	if (size <= m_RingSize)
+	{
+		srcOffset = AllocateRingSpace(size, 16);
+		memcpy(m_RingData + srcOffset, data, static_cast<size_t>(size));
+	}
+	else
+	{
+		// Too big for the ring, give it its own staging buffer that lives as long as the batch
+		MemoryAllocation stagingBufferAllocation;
+		CreateBuffer(m_Device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&srcBuffer, &stagingBufferAllocation, {}, AllocationStrategy::Linear);
+
+		memcpy(stagingBufferAllocation.MappedData, data, static_cast<size_t>(size));
+
+		GetCommandBuffer();
+		m_Batches[m_Recording].Releases.emplace_back(srcBuffer, stagingBufferAllocation);
+	}
+
+	// Region of data to copy from and to
+	VkBufferCopy bufferCopyRegion = {};
+	bufferCopyRegion.srcOffset = srcOffset;
+	bufferCopyRegion.dstOffset = dstOffset;
+	bufferCopyRegion.size = size;
+
+	// Taken after the ring allocation, which may have flushed the batch being recorded
+	vkCmdCopyBuffer(GetCommandBuffer(), srcBuffer, dstBuffer, 1, &bufferCopyRegion);
+
+	FinishBuffer(dstBuffer, dstOffset, size);
+}
+
+void UploadBatcher::UploadImage(VkImage image, const ImageUploadInfo& info, const void* pixels, VkDeviceSize size)
+{
+	if (size > m_RingSize)
+	{
+		VkBuffer stagingBuffer;
+		MemoryAllocation stagingBufferAllocation;
+		CreateBuffer(m_Device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer, &stagingBufferAllocation, {}, AllocationStrategy::Linear);
+
+		memcpy(stagingBufferAllocation.MappedData, pixels, static_cast<size_t>(size));
+
+		UploadImage(image, info, stagingBuffer, stagingBufferAllocation);
+		return;
+	}
+
+	const VkDeviceSize srcOffset = AllocateRingSpace(size, 16);
+	memcpy(m_RingData + srcOffset, pixels, static_cast<size_t>(size));
+
+	RecordImageCopies(image, info, m_RingBuffer, srcOffset);
+	FinishImage(image, info);
+}
+
+void UploadBatcher::UploadImage(VkImage image, const ImageUploadInfo& info, VkBuffer stagingBuffer, const MemoryAllocation& stagingBufferAllocation)
+{
+	RecordImageCopies(image, info, stagingBuffer, 0);
+	FinishImage(image, info);
+
+	m_Batches[m_Recording].Releases.emplace_back(stagingBuffer, stagingBufferAllocation);
+}
+
+void UploadBatcher::Flush()
+{
+	if (!m_IsRecording)
+		return;
+
+	// Recycle whatever already finished, without waiting
+	while (!m_InFlight.empty() && vkGetFenceStatus(m_Device, m_Batches[m_InFlight.front()].Fence) == VK_SUCCESS)
+	{
+		WaitOldestBatch();
+	}
+
+	Batch& batch = m_Batches[m_Recording];
+
+	// Release the uploaded resources to the render queue family, it acquires them in TakeHandoff`s barriers
+	if (!m_ReleaseBufferBarriers.empty() || !m_ReleaseImageBarriers.empty())
+	{
+		vkCmdPipelineBarrier(batch.CommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			static_cast<uint32_t>(m_ReleaseBufferBarriers.size()), m_ReleaseBufferBarriers.data(),
+			static_cast<uint32_t>(m_ReleaseImageBarriers.size()), m_ReleaseImageBarriers.data());
+
+		// Acquire is the same barrier, access masks moved to the destination side
+		for (auto barrier : m_ReleaseBufferBarriers)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+			m_PendingHandoff.BufferBarriers.push_back(barrier);
+		}
+		for (auto barrier : m_ReleaseImageBarriers)
+		{
+			// Images still in transfer dst get their mips blitted on the render queue first
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ?
+				VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+			m_PendingHandoff.ImageBarriers.push_back(barrier);
+		}
+
+		m_ReleaseBufferBarriers.clear();
+		m_ReleaseImageBarriers.clear();
+	}
+	else if (!IsOwnershipTransferNeeded())
+	{
+		// Make the copied data visible to the vertex input and shaders of later submissions on the same queue
+		// (another queue gets that from the semaphore, a transfer-only queue can`t name those stages anyway)
+		VkMemoryBarrier memoryBarrier = {};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+			VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(batch.CommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, UploadHandoff::WaitStages,
+			0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	vkEndCommandBuffer(batch.CommandBuffer);
+
+	m_PendingHandoff.MipGenerations.insert(m_PendingHandoff.MipGenerations.end(),
+		m_RecordedMipGenerations.begin(), m_RecordedMipGenerations.end());
+	m_RecordedMipGenerations.clear();
+
+	// One submission for the whole batch, completion is tracked by the fence instead of waiting for the queue
+	const uint64_t signalValue = m_SubmitCount + 1;
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.signalSemaphoreValueCount = 1;
+	timelineSubmitInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineSubmitInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.CommandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &m_Timeline;
+
+	VkResult result = vkQueueSubmit(m_Queue, 1, &submitInfo, batch.Fence);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit upload batch!");
+	}
+
+	batch.RingEnd = m_RingHead;
+	m_InFlight.push_back(m_Recording);
+	m_IsRecording = false;
+	m_SubmitCount = signalValue;
+
+	m_PendingHandoff.Semaphore = m_Timeline;
+	m_PendingHandoff.Value = signalValue;
+	m_HasPendingHandoff = true;
+}
+
+void UploadBatcher::WaitIdle()
+{
+	Flush();
+
+	while (!m_InFlight.empty())
+	{
+		WaitOldestBatch();
+	}
+}
+
+bool UploadBatcher::TakeHandoff(UploadHandoff& handoff)
+{
+	if (!m_HasPendingHandoff)
+		return false;
+
+	handoff = std::move(m_PendingHandoff);
+	m_PendingHandoff = UploadHandoff();
+	m_HasPendingHandoff = false;
+
+	return true;
+}
+
+VkDeviceSize UploadBatcher::AllocateRingSpace(VkDeviceSize size, VkDeviceSize alignment)
+{
+	VkDeviceSize offset;
+	while (!TryAllocateRingSpace(size, alignment, &offset))
+	{
+		// Retire older batches first, then the current one if it alone fills the ring
+		if (!m_InFlight.empty())
+		{
+			WaitOldestBatch();
+		}
+		else if (m_IsRecording)
+		{
+			Flush();
+		}
+		else
+		{
+			throw std::runtime_error("Upload does not fit into the staging ring!");
+		}
+	}
+
+	return offset;
+}
+
+bool UploadBatcher::TryAllocateRingSpace(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+	// Empty ring with nothing in flight (whose RingEnd would point at the old head), start over
+	// at the beginning to get the most contiguous space
+	if (m_RingHead == m_RingTail && m_InFlight.empty())
+	{
+		m_RingHead = 0;
+		m_RingTail = 0;
+	}
+
+	const VkDeviceSize alignedHead = (m_RingHead + alignment - 1) & ~(alignment - 1);
+
+	// Head and tail never meet unless the ring is empty, so the free space checks below are strict
+	if (m_RingHead >= m_RingTail)
+	{
+		// Free space is [head, end) and [0, tail)
+		if (alignedHead + size <= m_RingSize)
+		{
+			*offset = alignedHead;
+		}
+		else if (size < m_RingTail)
+		{
+			*offset = 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		// Free space is [head, tail)
+		if (alignedHead + size < m_RingTail)
+		{
+			*offset = alignedHead;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	m_RingHead = *offset + size;
+	return true;
+}
+
+VkCommandBuffer UploadBatcher::GetCommandBuffer()
+{
+	if (m_IsRecording)
+		return m_Batches[m_Recording].CommandBuffer;
+
+	if (m_InFlight.size() == s_MaxBatchesInFlight)
+	{
+		WaitOldestBatch();
+	}
+
+	// Take a batch that is not in flight
+	for (uint32_t i = 0; i < s_MaxBatchesInFlight; i++)
+	{
+		if (std::find(m_InFlight.begin(), m_InFlight.end(), i) == m_InFlight.end())
+		{
+			m_Recording = i;
+			break;
+		}
+	}
+
+	// Info to begin the command buffer record
+	VkCommandBufferBeginInfo cmdBeginInfo = {};
+	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	// Implicitly resets the command buffer (pool has RESET_COMMAND_BUFFER_BIT)
+	vkBeginCommandBuffer(m_Batches[m_Recording].CommandBuffer, &cmdBeginInfo);
+	m_IsRecording = true;
+
+	return m_Batches[m_Recording].CommandBuffer;
+}
+
+void UploadBatcher::WaitOldestBatch()
+{
+	Batch& batch = m_Batches[m_InFlight.front()];
+
+	vkWaitForFences(m_Device, 1, &batch.Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+	vkResetFences(m_Device, 1, &batch.Fence);
+
+	for (auto& release : batch.Releases)
+	{
+		DestroyBuffer(m_Device, release.first, release.second);
+	}
+	batch.Releases.clear();
+
+	// Batches retire in submission order, so everything before its end is free again
+	m_RingTail = batch.RingEnd;
+	m_InFlight.pop_front();
+}
+
+void UploadBatcher::FinishBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	// Same family or concurrent buffer: the memory barrier at the end of the batch and the semaphore are enough
+	if (!IsOwnershipTransferNeeded() || std::find(m_SharedBuffers.begin(), m_SharedBuffers.end(), buffer) != m_SharedBuffers.end())
+		return;
+
+	VkBufferMemoryBarrier bufferMemoryBarrier = {};
+	bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferMemoryBarrier.dstAccessMask = 0;										// ignored for a release
+	bufferMemoryBarrier.srcQueueFamilyIndex = m_QueueFamilyIndex;				// Queue family to transfer from
+	bufferMemoryBarrier.dstQueueFamilyIndex = m_DstQueueFamilyIndex;			// Queue family to transfer to
+	bufferMemoryBarrier.buffer = buffer;
+	bufferMemoryBarrier.offset = offset;
+	bufferMemoryBarrier.size = size;
+
+	m_ReleaseBufferBarriers.push_back(bufferMemoryBarrier);
+}
+
+void UploadBatcher::RecordImageCopies(VkImage image, const ImageUploadInfo& info, VkBuffer srcBuffer, VkDeviceSize srcOffset)
+{
+	VkCommandBuffer commandBuffer = GetCommandBuffer();
+
+	// Blitted levels are written on the render queue, they still need to be in transfer dst there
+	RecordImageLayoutTransition(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, info.MipLevels);
+
+	const uint32_t copiedLevels = info.GenerateMips ? 1 : info.MipLevels;
+	for (uint32_t level = 0; level < copiedLevels; level++)
+	{
+		RecordCopyImageBuffer(commandBuffer, srcBuffer, srcOffset, image,
+			MipGenerator::GetLevelWidth(info.Width, level), MipGenerator::GetLevelHeight(info.Height, level), level);
+		srcOffset += GetLevelSize(info, level);
+	}
+}
+
+VkDeviceSize UploadBatcher::GetLevelSize(const ImageUploadInfo& info, uint32_t level)
+{
+	// Block compressed levels are whole blocks, multiples of the block size keep every level aligned for the copy
+	return GetImageSize(info.Format, MipGenerator::GetLevelWidth(info.Width, level), MipGenerator::GetLevelHeight(info.Height, level));
+}
+
+void UploadBatcher::FinishImage(VkImage image, const ImageUploadInfo& info)
+{
+	// Blits need a graphics queue, stay in transfer dst and let the render queue generate the mips
+	const bool isMipGenerationDeferred = info.GenerateMips && info.MipLevels > 1;
+	if (isMipGenerationDeferred)
+	{
+		UploadHandoff::MipGeneration mipGeneration;
+		mipGeneration.Image = image;
+		mipGeneration.Width = info.Width;
+		mipGeneration.Height = info.Height;
+		mipGeneration.MipLevels = info.MipLevels;
+		m_RecordedMipGenerations.push_back(mipGeneration);
+	}
+
+	if (!IsOwnershipTransferNeeded())
+	{
+		// Transition image to be shader readble for shader usage
+		if (!isMipGenerationDeferred)
+		{
+			RecordImageLayoutTransition(m_Batches[m_Recording].CommandBuffer, image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, info.MipLevels);
+		}
+		return;
+	}
+
+	// The layout transition is part of the release/acquire pair, both halves must use the same layouts
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = 0;										// ignored for a release
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageMemoryBarrier.newLayout = isMipGenerationDeferred ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = m_QueueFamilyIndex;
+	imageMemoryBarrier.dstQueueFamilyIndex = m_DstQueueFamilyIndex;
+	imageMemoryBarrier.image = image;
+	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+	imageMemoryBarrier.subresourceRange.levelCount = info.MipLevels;
+	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+	imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+	m_ReleaseImageBarriers.push_back(imageMemoryBarrier);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "Utils.h"
+
+// Texels of an image upload, mip levels packed one after another (level 0 first)
+struct ImageUploadInfo
+{
+	VkFormat Format = VK_FORMAT_R8G8B8A8_UNORM;		// RGBA8 or a BCn format (see BlockCompression)
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t MipLevels = 1;			// levels of the image
+	bool GenerateMips = false;		// pixels hold level 0 only, the render queue blits the other levels from it
+};
+
+// What the render queue has to do before touching freshly uploaded resources: wait for the upload
+// timeline value and, when uploads run on another queue family, acquire ownership of the resources
+struct UploadHandoff
+{
+	// Image whose levels 1..MipLevels-1 are blitted on the render queue (blits need a graphics queue)
+	struct MipGeneration
+	{
+		VkImage Image = VK_NULL_HANDLE;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t MipLevels = 1;
+	};
+
+	// Stages the render submission waits in (and acquires at), everything that reads uploaded data
+	static const VkPipelineStageFlags WaitStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	VkSemaphore Semaphore = VK_NULL_HANDLE;
+	uint64_t Value = 0;
+	std::vector<VkBufferMemoryBarrier> BufferBarriers;
+	std::vector<VkImageMemoryBarrier> ImageBarriers;
+	std::vector<MipGeneration> MipGenerations;
+
+	// Record the acquire half of the ownership transfers and the mip generation (outside of a render pass)
+	void RecordAcquire(VkCommandBuffer commandBuffer) const;
+};
+
+// Records buffer/image uploads into one command buffer and submits them together
+// Source data is staged in a persistently mapped ring buffer, a batch`s ring space is
+// recycled once the fence of the batch signals, so uploads never wait on the queue going idle
+// Every batch signals a timeline semaphore; the render queue waits on it through TakeHandoff,
+// so uploads can run on their own (transfer) queue without stalling frames on the CPU
+class UploadBatcher
+{
+public:
+	// queue/queueFamilyIndex: where uploads run, dstQueueFamilyIndex: family using the uploaded resources
+	void Init(VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, uint32_t dstQueueFamilyIndex,
+		VkDeviceSize ringSize = 64 * 1024 * 1024);
+	void Destroy();
+
+	// Copy data into ring space and record a copy of it into dstBuffer
+	void UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	// Copy pixels into ring space and record the whole upload (transitions included) of image
+	void UploadImage(VkImage image, const ImageUploadInfo& info, const void* pixels, VkDeviceSize size);
+	// Same as UploadImage, from a staging buffer the batcher owns (and frees) from now on
+	void UploadImage(VkImage image, const ImageUploadInfo& info, VkBuffer stagingBuffer, const MemoryAllocation& stagingBufferAllocation);
+
+	// Submit everything recorded so far, returns without waiting
+	void Flush();
+	// Flush and wait for every submitted batch
+	void WaitIdle();
+
+	// Hand everything flushed since the last call over to the render queue, false if there is nothing new
+	bool TakeHandoff(UploadHandoff& handoff);
+
+	// Buffer created with VK_SHARING_MODE_CONCURRENT, uploads into it need no ownership transfer
+	void MarkShared(VkBuffer buffer) { m_SharedBuffers.push_back(buffer); }
+
+	uint64_t GetSubmitCount() const { return m_SubmitCount; }
+
+private:
+	struct Batch
+	{
+		VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+		VkFence Fence = VK_NULL_HANDLE;
+		VkDeviceSize RingEnd = 0;										// ring space up to here is free once the fence signals
+		std::vector<std::pair<VkBuffer, MemoryAllocation>> Releases;	// buffers to free once the fence signals
+	};
+
+	// Ring space for size bytes, flushes/waits on older batches when the ring is full
+	VkDeviceSize AllocateRingSpace(VkDeviceSize size, VkDeviceSize alignment);
+	bool TryAllocateRingSpace(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+
+	VkCommandBuffer GetCommandBuffer();
+	void WaitOldestBatch();
+
+	// Last command for an uploaded resource: layout transition, or release to the render queue family
+	void FinishBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+	void FinishImage(VkImage image, const ImageUploadInfo& info);
+	// Transition every level to transfer dst and copy the levels present in srcBuffer
+	void RecordImageCopies(VkImage image, const ImageUploadInfo& info, VkBuffer srcBuffer, VkDeviceSize srcOffset);
+	// Bytes of a level inside the packed source data
+	static VkDeviceSize GetLevelSize(const ImageUploadInfo& info, uint32_t level);
+	bool IsOwnershipTransferNeeded() const { return m_QueueFamilyIndex != m_DstQueueFamilyIndex; }
+
+private:
+	static const uint32_t s_MaxBatchesInFlight = 3;
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkQueue m_Queue = VK_NULL_HANDLE;
+	uint32_t m_QueueFamilyIndex = 0;
+	uint32_t m_DstQueueFamilyIndex = 0;
+	VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+
+	// Signaled with the submit count by every batch
+	VkSemaphore m_Timeline = VK_NULL_HANDLE;
+
+	// Ownership releases of the batch being recorded, acquires not yet handed to the render queue
+	std::vector<VkBufferMemoryBarrier> m_ReleaseBufferBarriers;
+	std::vector<VkImageMemoryBarrier> m_ReleaseImageBarriers;
+	std::vector<UploadHandoff::MipGeneration> m_RecordedMipGenerations;		// of the batch being recorded
+	UploadHandoff m_PendingHandoff;
+	bool m_HasPendingHandoff = false;
+	std::vector<VkBuffer> m_SharedBuffers;
+
+	// Staging ring, used space runs from m_RingTail up to m_RingHead (wrapping around)
+	VkBuffer m_RingBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_RingBufferAllocation;
+	uint8_t* m_RingData = nullptr;
+	VkDeviceSize m_RingSize = 0;
+	VkDeviceSize m_RingHead = 0;
+	VkDeviceSize m_RingTail = 0;
+
+	Batch m_Batches[s_MaxBatchesInFlight];
+	std::deque<uint32_t> m_InFlight;		// submitted batches, oldest first
+	uint32_t m_Recording = 0;				// batch currently being recorded
+	bool m_IsRecording = false;
+
+	uint64_t m_SubmitCount = 0;
+};
@@ -1,15 +1,49 @@
 #pragma once
 
 #include <fstream>
+#include <cstring>
+#include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
 
+#include "AsyncFileReader.h"
+#include "MappedFile.h"
+#include "MemoryAllocator.h"
+
 const int MAX_FRAME_DRAWS = 2;
 const int MAX_OBJECTS = 20;
 
+// Size of the scene wide vertex/index buffers meshes are sub-allocated from
+const VkDeviceSize GEOMETRY_VERTEX_CAPACITY = 128 * 1024 * 1024;
+const VkDeviceSize GEOMETRY_INDEX_CAPACITY = 64 * 1024 * 1024;
+// Bytes of streamed geometry/textures uploaded per frame (at least one mesh or texture goes through every frame)
+const VkDeviceSize UPLOAD_BUDGET_PER_FRAME = 8 * 1024 * 1024;
+
+// Pack imported meshes into CompactVertex (quantized against the sub-mesh bounds) instead of Vertex
+const bool COMPACT_VERTEX_FORMAT = true;
+// Reorder triangles of imported meshes outside in (after the vertex cache pass), trading up to 5% ACMR for less overdraw
+const bool OPTIMIZE_MESH_OVERDRAW = true;
+// Parse OBJ files with ObjLoader (mapped, chunked, parsed on the thread pool) instead of Assimp
+const bool NATIVE_OBJ_IMPORT = true;
+// Cook textures into block compressed KTX2 files (<source>.ktx2) and upload those instead of RGBA8
+const bool COMPRESS_TEXTURES = true;
+// Cull whole meshes against the camera frustum each frame (world space boxes and spheres, SIMD batches) before anything else
+const bool CULL_MESHES = true;
+// Cull meshlets of every mesh each frame (frustum and normal cone) and draw only the visible ones
+const bool CULL_MESHLETS = true;
+// Simplify imported meshes into up to MAX_MESH_LODS levels (level 0 is the full mesh), drawn by projected error
+const bool GENERATE_MESH_LODS = true;
+const uint32_t MAX_MESH_LODS = 4;
+// Coarsest level drawn is the last one whose geometric error projects to at most this many pixels
+const float LOD_MAX_PIXEL_ERROR = 1.0f;
+// Keep the recorded draws (secondary command buffers) between frames, recorded again only when the draw list changes
+const bool CACHE_COMMAND_BUFFERS = true;
+// Asset pack mounted at startup when it exists (built with Yume --build-pack), files in it are read from it instead of disk
+const char* const ASSET_PACK_PATH = "Yume.ypak";
+
 static const std::vector<const char*> s_DeviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
@@ -24,11 +58,21 @@ struct Vertex
 
 };
 
+// 16 byte vertex, decoded in the vertex shader with the sub-mesh`s dequantization push constants
+struct CompactVertex
+{
+	uint16_t Position[4];		// unorm16 inside the sub-mesh bounds, w unused
+	int16_t NormalCoords[2];	// snorm16 octahedral encoded unit normal
+	uint16_t TextureCoords[2];	// unorm16 inside the sub-mesh uv bounds
+};
+
 // Indices (locations) of queue families (if they exist at all)
 struct QueueFamilyIndices
 {
 	int GraphicsFamily = -1; // location of graphics queue family
 	int PresentationFamily = -1; // location of presentation queue family
+	int TransferFamily = -1; // location of the family uploads run on (transfer-only if the device has one)
+	int TransferQueueIndex = 0; // queue of TransferFamily to use (1 when sharing the graphics family)
 
 	bool IsValid()
 	{
@@ -52,51 +96,109 @@ struct SwapChainImage
 
 static std::vector<char> readSPVFile(const std::string& filename)
 {
-	//open file
-	std::ifstream file(filename, std::ios::binary | std::ios::ate);
-
-	// Check 
-	if (!file.is_open())
+	// Read through the async reader (or from the asset pack)
+	FileData file;
+	try
+	{
+		file = AsyncFileReader::Get().Read(filename).get();
+	}
+	catch (const std::runtime_error&)
 	{
 		throw std::runtime_error("Failed to open a file in readSPVFile");
 	}
 
-	// get size and create vector
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> fileBuffer(fileSize);
+	const char* data = reinterpret_cast<const char*>(file.data());
+	return std::vector<char>(data, data + file.size());
+}
 
-	// move read position to the start of the file
-	file.seekg(0);
+// 64-bit hash of a block of memory (MurmurHash64A), used to key cooked asset caches by content
+static uint64_t HashMemory(const void* data, size_t size, uint64_t seed = 0)
+{
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
 
-	// Read the file data into the bufer
-	file.read(fileBuffer.data(), fileSize);
+	uint64_t hash = seed ^ (size * m);
 
-	file.close();
+	// Mix 8 bytes at a time
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	const size_t blockCount = size / 8;
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		uint64_t k;
+		memcpy(&k, bytes + i * 8, sizeof(k));
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		hash ^= k;
+		hash *= m;
+	}
 
-	return fileBuffer;
+	// Mix the remaining tail bytes
+	const uint8_t* tail = bytes + blockCount * 8;
+	switch (size & 7)
+	{
+	case 7: hash ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+	case 6: hash ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+	case 5: hash ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+	case 4: hash ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+	case 3: hash ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+	case 2: hash ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+	case 1: hash ^= uint64_t(tail[0]);
+		hash *= m;
+		break;
+	default:
+		break;
+	}
+
+	hash ^= hash >> r;
+	hash *= m;
+	hash ^= hash >> r;
+
+	return hash;
 }
 
-static uint32_t FindMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags propertyFlags)
+// Box around a box transformed by a matrix: the center moves, every axis of the extent spreads over the transformed axes
+static void TransformBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& matrix,
+	glm::vec3& transformedMin, glm::vec3& transformedMax)
 {
-	// Get properties of physical device memory
-	VkPhysicalDeviceMemoryProperties memoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+	const glm::vec3 center = glm::vec3(matrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+	const glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	const glm::vec3 transformedExtent = glm::abs(glm::vec3(matrix[0])) * extent.x + glm::abs(glm::vec3(matrix[1])) * extent.y
+		+ glm::abs(glm::vec3(matrix[2])) * extent.z;
 
-	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+	transformedMin = center - transformedExtent;
+	transformedMax = center + transformedExtent;
+}
+
+// Bytes of a width x height image, whole 4x4 blocks for the block compressed formats
+static VkDeviceSize GetImageSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	const VkDeviceSize blockCount = VkDeviceSize((width + 3) / 4) * ((height + 3) / 4);
+
+	switch (format)
 	{
-		if ((allowedTypes & (1 << i))  // index of memory type must match corresponding bit in allowedTypes
-			&& (memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) // desire property bit flags are part of memory type`s property flags
-		{
-			// This memory type is valid
-			return i;
-		}
+	case VK_FORMAT_R8_UNORM:
+		return VkDeviceSize(width) * height;
+	case VK_FORMAT_R8G8_UNORM:
+		return VkDeviceSize(width) * height * 2;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return blockCount * 8;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+		return blockCount * 16;
+	default:
+		return VkDeviceSize(width) * height * 4;
 	}
-
-	return 0;
 }
 
-static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags,
-	VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, VkDeviceMemory* bufferMemory)
+static void CreateBuffer(VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsageFlags,
+	VkMemoryPropertyFlags bufferProperties, VkBuffer* buffer, MemoryAllocation* bufferAllocation,
+	const std::vector<uint32_t>& sharedQueueFamilies = {}, AllocationStrategy strategy = AllocationStrategy::FreeList)
 {
 	// Info to create a buffer (it doesnt include assigning memory)
 	VkBufferCreateInfo bufferCreateInfo = {};
@@ -105,113 +207,41 @@ static void CreateBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDev
 	bufferCreateInfo.usage = bufferUsageFlags; // multiple type of buffer possible 
 	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;	// Similat to swapchain images, it can share vertex buffer
 
-	VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer);
-	if (result != VK_SUCCESS)
+	// Used by several queue families at once (e.g. written by uploads while being drawn from), no ownership transfers
+	if (sharedQueueFamilies.size() > 1)
 	{
-		throw std::runtime_error("Failed to create a vertex buffer!");
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedQueueFamilies.size());
+		bufferCreateInfo.pQueueFamilyIndices = sharedQueueFamilies.data();
 	}
 
-	// Get buffer memory requirements
-	VkMemoryRequirements memRequirements = {};
-	vkGetBufferMemoryRequirements(device, *buffer, &memRequirements);
-
-	// Allocate memory to buffer
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = FindMemoryTypeIndex(physicalDevice, memRequirements.memoryTypeBits, // index of memory type on physical device that has required bit flags
-		bufferProperties);																	// VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : CPU can interacte with memory
-																							// VK_MEMORY_PROPERTY_HOST_COHERENT_BIT: Allow placement of data straight into buffer after mapping (otherwise it would have to specify manually)
-	// Allocate memory to VkDeviceMemory
-	result = vkAllocateMemory(device, &memoryAllocateInfo, nullptr, bufferMemory);
+	VkResult result = vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer);
 	if (result != VK_SUCCESS)
 	{
-		throw std::runtime_error("Failed to allocate vertex buffer memory!");
+		throw std::runtime_error("Failed to create a vertex buffer!");
 	}
 
-	// Allocate memory to given vertex buffer
-	vkBindBufferMemory(device, *buffer, *bufferMemory, 0);
+	// Sub-allocate memory and bind it to the buffer
+	// VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : CPU can interacte with memory (the allocation comes back mapped)
+	// VK_MEMORY_PROPERTY_HOST_COHERENT_BIT: Allow placement of data straight into buffer after mapping (otherwise it would have to specify manually)
+	*bufferAllocation = MemoryAllocator::AllocateBuffer(*buffer, bufferProperties, strategy);
 }
 
-static VkCommandBuffer BeginCommandBuffer(VkDevice device, VkCommandPool commandPool)
+static void DestroyBuffer(VkDevice device, VkBuffer buffer, MemoryAllocation& bufferAllocation)
 {
-	// Command buffer to hold transfer commands
-	VkCommandBuffer commandBuffer;
-
-	// Command buffer details
-	VkCommandBufferAllocateInfo allocateInfo = {};
-	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocateInfo.commandPool = commandPool;
-	allocateInfo.commandBufferCount = 1;
-
-	// Allocate command buffer from pool
-	vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer);
-
-	// Info to begin the command buffer record
-	VkCommandBufferBeginInfo cmdBeginInfo = {};
-	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT; // We`re only using the command buffer once, so set up for  
-
-
-	// Begin recording transfer commands
-	vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo);
-
-	return commandBuffer;
+	vkDestroyBuffer(device, buffer, nullptr);
+	MemoryAllocator::Free(bufferAllocation);
 }
 
-static void FinishAndSubmitCommandBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer)
+static void RecordCopyImageBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkDeviceSize srcOffset,
+	VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel = 0)
 {
-	// End command
-	vkEndCommandBuffer(commandBuffer);
-
-
-	// Queue submission info
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	// Submit transfer command to transfer queue and wait until it finishes
-	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue);
-
-	// Free temporary command buffer back to pool
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-
-}
-
-static void CopyBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCmdPool,
-	VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize)
-{
-	// Create buffer
-	VkCommandBuffer transferCommandBuffer = BeginCommandBuffer(device, transferCmdPool);
-	
-	// Region of data to copy from and to
-	VkBufferCopy bufferCopyRegion = {};
-	bufferCopyRegion.srcOffset = 0;
-	bufferCopyRegion.dstOffset = 0;
-	bufferCopyRegion.size = bufferSize;
-
-	// Command to copy src buffer to dst buffer
-	vkCmdCopyBuffer(transferCommandBuffer, srcBuffer, dstBuffer, 1, &bufferCopyRegion);
-
-	// End and submit command buffer
-	FinishAndSubmitCommandBuffer(device, transferCmdPool, transferQueue, transferCommandBuffer);
-}
-
-static void CopyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPool transferCommandPool,
-	VkBuffer srcBuffer, VkImage image, uint32_t width, uint32_t height)
-{
-	// Create buffer
-	VkCommandBuffer transferCommandBuffer = BeginCommandBuffer(device, transferCommandPool);
-
 	VkBufferImageCopy imageRegion = {};
-	imageRegion.bufferOffset = 0;											// Offset into data
+	imageRegion.bufferOffset = srcOffset;									// Offset into data
 	imageRegion.bufferRowLength = 0;										// row length of data to calculate data spacing
 	imageRegion.bufferImageHeight = 0;										// image height to calculate data spacing
 	imageRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;	// which aspect of image to copy
-	imageRegion.imageSubresource.mipLevel = 0;								// Mipmap level to copy
+	imageRegion.imageSubresource.mipLevel = mipLevel;						// Mipmap level to copy
 	imageRegion.imageSubresource.baseArrayLayer = 0;						// Starting array layer
 	imageRegion.imageSubresource.layerCount = 1;							// Number of layer to copy starting at baseArrayLayer
 	imageRegion.imageOffset = { 0, 0, 0 };									// Offset into image (as opposed to raw data offset)
@@ -219,18 +249,12 @@ static void CopyImageBuffer(VkDevice device, VkQueue transferQueue, VkCommandPoo
 
 
 	// Command to copy src buffer to dst image buffer
-	vkCmdCopyBufferToImage(transferCommandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
-
-	// End and Submit command buffer
-	FinishAndSubmitCommandBuffer(device, transferCommandPool, transferQueue, transferCommandBuffer);
+	vkCmdCopyBufferToImage(commandBuffer, srcBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageRegion);
 }
 
-
-static void TransitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool commandPool, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+static void RecordImageLayoutTransition(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+	uint32_t mipLevels = 1)
 {
-	// Create buffer
-	VkCommandBuffer commandBuffer = BeginCommandBuffer(device, commandPool);
-
 	// Create
 	VkImageMemoryBarrier imageMemoryBarrier = {};
 	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -241,7 +265,7 @@ static void TransitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool
 	imageMemoryBarrier.image = image;											// image being accessed and modified as part of barrier
 	imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	imageMemoryBarrier.subresourceRange.baseMipLevel = 0;						// First mip level to start alterations on
-	imageMemoryBarrier.subresourceRange.levelCount = 1;							// number of mip leves to alter starting from baseMipLevel
+	imageMemoryBarrier.subresourceRange.levelCount = mipLevels;					// number of mip leves to alter starting from baseMipLevel
 	imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;						// first layer to start alterations on
 	imageMemoryBarrier.subresourceRange.layerCount = 1;							// number of layers to alter starting from baseArrayLayer
 	
@@ -277,7 +301,4 @@ static void TransitionImageLayout(VkDevice device, VkQueue queue, VkCommandPool
 		0, nullptr,				// buffer memory barrier count + data
 		1, &imageMemoryBarrier // Image memory barrier count + data
 	);
-
-	// End and Submit command buffer
-	FinishAndSubmitCommandBuffer(device, commandPool, queue, commandBuffer);
-}
\ No newline at end of file
+}
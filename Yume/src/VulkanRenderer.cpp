@@ -26,21 +26,21 @@ static VkInstance s_Instance;
 static Devices s_MainDevice;
 static VkQueue s_GraphicsQueue;
 static VkQueue s_PresentationQueue;
+static VkQueue s_TransferQueue;
 
 static VkSurfaceKHR s_Surface;
 static VkSwapchainKHR s_Swapchain;
 
 static std::vector<SwapChainImage> s_SwapchainImages;
 static std::vector<VkFramebuffer> s_SwapchainFramebuffers;
-static std::vector<VkCommandBuffer> s_CommandBuffers;
 
 // Color buffer image
 static std::vector<VkImage> s_ColorBufferImage;
-static std::vector<VkDeviceMemory> s_ColorBufferImageMemory;
+static std::vector<MemoryAllocation> s_ColorBufferImageMemory;
 static std::vector<VkImageView> s_ColorBufferImageView;
 // depth buffer image
 static std::vector<VkImage> s_DepthBufferImage;
-static std::vector<VkDeviceMemory> s_DepthBufferImageMemory;
+static std::vector<MemoryAllocation> s_DepthBufferImageMemory;
 static std::vector<VkImageView> s_DepthBufferImageView;
 static VkFormat s_DepthBufferFormat;
 
@@ -61,10 +61,10 @@ static std::vector<VkDescriptorSet> s_SamplerDescriptorSets;
 static std::vector<VkDescriptorSet> s_InputDescriptorSets;
 
 static std::vector<VkBuffer> s_UniformBuffers;
-static std::vector<VkDeviceMemory> s_UniformBufferMemory;
+static std::vector<MemoryAllocation> s_UniformBufferMemory;
 
 static std::vector<VkBuffer> s_UniformDynamicBuffers;
-static std::vector<VkDeviceMemory> s_UniformDynamicBufferMemory;
+static std::vector<MemoryAllocation> s_UniformDynamicBufferMemory;
 
 static VkDeviceSize s_MinUniformBufferOffset;
 static size_t s_ModelUniformAlignment;
@@ -74,12 +74,42 @@ static UniformBufferObjectModel* s_ModelTransferSpace;
 // -- Assets
 //std::vector<MeshModel> m_ModelList;
 
-static std::vector<VkImage> s_TextureImages;
-static std::vector<VkDeviceMemory> s_TextureImageMemory;
-static std::vector<VkImageView> s_TextureImageViews;
+static TextureCache s_TextureCache;
+static AssetRegistry s_AssetRegistry;
+static TextureHandle s_DefaultTexture;
+static std::vector<ModelHandle> s_FreeModelHandles;		// slots of unloaded models, reused first
+static UploadBatcher s_UploadBatcher;
+static GeometryArena s_GeometryArena;
+static MeshCuller s_MeshCuller;					// 1:1 with the scene meshes, in draw order
+static SceneBvh s_SceneBvh;							// world boxes of the scene models, objects are model handles
+static std::vector<int32_t> s_ModelBvhLeaves;		// per scene model, -1 for free slots
+static std::vector<uint32_t> s_VisibleModels;		// frustum query result, refreshed every frame
+static std::vector<uint8_t> s_IsModelVisible;		// per scene model
+static ClusterCuller s_ClusterCuller;
+static std::vector<ClusterCullInput> s_ClusterCullInputs;
+static std::vector<uint32_t> s_ModelLods;			// per scene model, refreshed every frame
+static std::vector<ClusterDraw> s_ClusterDraws;		// 1:1 with the scene meshes, in draw order
+
+// Mesh asset being streamed in, drawn by every scene model holding it as its meshes arrive
+struct StreamingModel
+{
+	MeshHandle Asset;
+	std::future<ImportedModel> Import;
+	ImportedModel Model;
+	bool IsImported = false;
+	size_t NextSubMesh = 0;					// sub-meshes before it are in the draw list
+	std::vector<bool> IsMaterialResident;
+};
+static std::deque<StreamingModel> s_StreamingModels;
+static VkDeviceSize s_UploadBudget = UPLOAD_BUDGET_PER_FRAME;
+static MeshImportStats s_MeshImportStats;			// counts, the averages are made from the sums below
+static uint64_t s_OptimizedTriangleCount = 0;
+static uint64_t s_OptimizedVertexCount = 0;
+static MeshImportStats s_WeightedImportSums;		// ACMR summed over triangles, ATVR over vertices
 
 // -- Pipeline
 static VkPipeline s_GraphicsPipeline;
+static VkPipeline s_CompactGraphicsPipeline;		// same as s_GraphicsPipeline, for CompactVertex meshes
 static VkPipelineLayout s_PipelineLayout;
 static VkRenderPass s_RenderPass;
 
@@ -87,7 +117,33 @@ static VkPipeline s_SecondPipeline;
 static VkPipelineLayout s_SecondPipelineLayout;
 
 // -- Pools
-static VkCommandPool s_GraphicsCommandPool;
+static CommandRecorder s_CommandRecorder;			// per-frame primary buffers, cached secondary buffers per image
+
+// One scene mesh, recorded into whichever secondary command buffer its range falls in
+// Its index range and instance count (0 when culled) are read from the frame`s draw arguments, so culling and
+// level of detail change no recorded command
+struct MeshDraw
+{
+	const Mesh* DrawnMesh = nullptr;
+	uint32_t DynamicOffset = 0;
+	uint32_t ArgumentIndex = 0;						// scene order, as CullMeshes and CullClusters walk the meshes
+};
+static std::vector<MeshDraw> s_MeshDraws;			// every scene mesh in draw (sort key) order
+static RenderQueue s_RenderQueue;
+static uint64_t s_DrawListVersion = 1;				// bumped by every change of the draw list or what its meshes bind
+static uint64_t s_BuiltDrawListVersion = 0;
+// Bumped whenever something recorded draws reference is recreated or rewritten (framebuffers, draw argument buffers,
+// reused texture descriptor sets): handle values alone can`t tell, a new object may get the handle of a destroyed one
+static uint64_t s_DrawResourceGeneration = 0;
+
+// VkDrawIndexedIndirectCommand per MeshDraw, written every frame, per frame in flight
+struct DrawArgumentBuffer
+{
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	MemoryAllocation Allocation;
+	VkDeviceSize Capacity = 0;
+};
+static DrawArgumentBuffer s_DrawArgumentBuffers[MAX_FRAME_DRAWS];
 
 // Utilities
 static VkFormat s_SwapchainImageFormat;
@@ -120,7 +176,6 @@ int VulkanRenderer::Init(GLFWwindow* window)
 		CreateColorBufferImage();
 		CreateFramebuffers();
 		CreateCommandPool();
-		CreateCommandBuffers();
 		CreateTextureSampler();
 		AllocateDynamicBufferTransferSpace();
 		CreateUniformBuffers();
@@ -130,6 +185,38 @@ int VulkanRenderer::Init(GLFWwindow* window)
 		CreateSynchronization();
 
 		// Set scene
+		// Mips are blitted on the GPU when the texture format supports linear blits, built by the decode workers otherwise
+		// Block compressed textures are uploaded as they are when the device can sample them
+		std::vector<VkFormat> blitFormats;
+		for (VkFormat format : { VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8A8_UNORM })
+		{
+			if (CheckLinearBlitSupport(format))
+				blitFormats.push_back(format);
+		}
+		std::vector<VkFormat> sampledBlockFormats;
+		for (VkFormat format : { VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC3_UNORM_BLOCK,
+			VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK })
+		{
+			if (CheckSampledFilterSupport(format))
+				sampledBlockFormats.push_back(format);
+		}
+		s_TextureCache.Init(s_MainDevice.LogicalDevice, blitFormats, sampledBlockFormats);
+		s_AssetRegistry.Init(s_MainDevice.LogicalDevice, s_TextureCache);
+		QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(s_MainDevice.PhysicalDevice);
+		s_UploadBatcher.Init(s_MainDevice.LogicalDevice, s_TransferQueue,
+			queueFamilyIndices.TransferFamily, queueFamilyIndices.GraphicsFamily);
+
+		// Scene geometry is written by the upload queue while being drawn from, share it between both families
+		std::vector<uint32_t> geometryQueueFamilies = { static_cast<uint32_t>(queueFamilyIndices.GraphicsFamily) };
+		if (queueFamilyIndices.TransferFamily != queueFamilyIndices.GraphicsFamily)
+			geometryQueueFamilies.push_back(static_cast<uint32_t>(queueFamilyIndices.TransferFamily));
+
+		s_GeometryArena.Init(s_MainDevice.LogicalDevice, GEOMETRY_VERTEX_CAPACITY,
+			GEOMETRY_INDEX_CAPACITY, geometryQueueFamilies);
+		s_UploadBatcher.MarkShared(s_GeometryArena.GetVertexBuffer());
+		s_UploadBatcher.MarkShared(s_GeometryArena.GetIndexBuffer());
+		s_ClusterCuller.Init(s_MainDevice.LogicalDevice);
+		CreateDefaultTexture();
 		SetScene();
 		
 		
@@ -168,10 +255,12 @@ void VulkanRenderer::SetScene()
 	s_Scene.Camera.OnResize(s_SwapchainExtent.width, s_SwapchainExtent.height);
 
 	//s_Scene.Camera.OnResize((float)s_SwapchainExtent.width, (float)s_SwapchainExtent.height);
-	CreateMeshModel("src/Models/WolfLink/wolfllink.obj");
-	CreateMeshModel("src/Models/Cactuar/cactuar.obj");
-	CreateMeshModel("src/Models/Sora/Sora.obj");
-	CreateMeshModel("src/Models/skybox/skybox.obj");
+	// Streamed in over the first frames, handles are 0..3 in this order
+	for (const char* filepath : { "src/Models/WolfLink/wolfllink.obj", "src/Models/Cactuar/cactuar.obj",
+		"src/Models/Sora/Sora.obj", "src/Models/skybox/skybox.obj" })
+	{
+		LoadModelAsync(filepath);
+	}
 }
 
 
@@ -201,6 +290,7 @@ void VulkanRenderer::SceneUpdate(float ts)
 void VulkanRenderer::UpdateModel(uint32_t meshObjectIndex, glm::mat4& newModel)
 {
 	s_Scene.ModelList[meshObjectIndex].SetModel(newModel);
+	UpdateModelBounds(meshObjectIndex);
 }
 
 void VulkanRenderer::Draw()
@@ -213,13 +303,33 @@ void VulkanRenderer::Draw()
 	// Manually reset (close) fences
 	vkResetFences(s_MainDevice.LogicalDevice, 1, &s_DrawFences[s_CurrentFrame]);
 
+	// Assets released MAX_FRAME_DRAWS frames ago aren`t used by any frame in flight anymore
+	s_AssetRegistry.Update();
+
 	// -- Get next image
 	uint32_t imageIndex;
 	vkAcquireNextImageKHR(s_MainDevice.LogicalDevice, s_Swapchain, std::numeric_limits<uint64_t>::max(), s_SemaphoresImageAvailable[s_CurrentFrame],
 		VK_NULL_HANDLE, &imageIndex);
 
+	SelectLods();
+
+	// New meshes/textures go into this frame`s upload handoff
+	StreamModels(s_UploadBudget, false);
+
+	// After streaming, so meshes uploaded this frame are culled too
+	if (CULL_MESHES)
+		CullMeshes();
+
+	// The frame`s index stream is free again (fence above), fill it with the visible meshlets
+	if (CULL_MESHLETS)
+		CullClusters();
+
+	// Pick up uploads finished since the last frame (semaphore wait + ownership acquire), without waiting on the CPU
+	UploadHandoff uploadHandoff;
+	const bool hasUploadHandoff = s_UploadBatcher.TakeHandoff(uploadHandoff);
+
 	// rec
-	RecordCommands(imageIndex);
+	VkCommandBuffer commandBuffer = RecordCommands(imageIndex, hasUploadHandoff ? &uploadHandoff : nullptr);
 
 	UpdateUniformBuffers(imageIndex);
 
@@ -227,14 +337,23 @@ void VulkanRenderer::Draw()
 	// signalled as available before drawing and signals when it has finished rendering
 	// -- Submit command buffer to render
 	// Queue submission info
+	VkSemaphore waitSemaphores[] = { s_SemaphoresImageAvailable[s_CurrentFrame], uploadHandoff.Semaphore };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, UploadHandoff::WaitStages };
+	uint64_t waitValues[] = { 0, uploadHandoff.Value };		// binary semaphore value is ignored
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineSubmitInfo.waitSemaphoreValueCount = hasUploadHandoff ? 2 : 1;
+	timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;				// number of semaphores to wait on
-	submitInfo.pWaitSemaphores = &s_SemaphoresImageAvailable[s_CurrentFrame];
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	submitInfo.pNext = &timelineSubmitInfo;
+	submitInfo.waitSemaphoreCount = hasUploadHandoff ? 2 : 1;				// number of semaphores to wait on
+	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;  // Stages to check semaphores at
 	submitInfo.commandBufferCount = 1;			// number of command buffer to submit
-	submitInfo.pCommandBuffers = &s_CommandBuffers[imageIndex];
+	submitInfo.pCommandBuffers = &commandBuffer;
 	submitInfo.signalSemaphoreCount = 1;		// number of semaphores to signal
 	submitInfo.pSignalSemaphores = &s_SemaphoresRenderFinished[s_CurrentFrame];		// Semaphores to signal when command buffer finishes
 
@@ -270,10 +389,33 @@ void VulkanRenderer::CleanUp()
 	// Wait until no action being run on device before destroying
 	vkDeviceWaitIdle(s_MainDevice.LogicalDevice);
 
-	// Clean all the meshes buffer
-	for (size_t i = 0; i < s_Scene.ModelList.size(); i++)
+	// Imports still running use the texture cache
+	for (auto& streamingModel : s_StreamingModels)
+	{
+		if (!streamingModel.IsImported)
+			streamingModel.Import.wait();
+	}
+	s_StreamingModels.clear();
+
+	// Last handles go away, the registry destroys every mesh and texture
+	s_Scene.ModelList.clear();
+	s_FreeModelHandles.clear();
+	s_SceneBvh.Clear();
+	s_ModelBvhLeaves.clear();
+	s_DefaultTexture.reset();
+	s_AssetRegistry.Destroy();
+
+	// Drop staging memory of textures that were decoded but never uploaded
+	s_TextureCache.Clear();
+	s_UploadBatcher.Destroy();
+
+	s_GeometryArena.Destroy();
+	s_ClusterCuller.Destroy();
+	for (auto& argumentBuffer : s_DrawArgumentBuffers)
 	{
-		s_Scene.ModelList[i].DestroyMeshModel();
+		if (argumentBuffer.Buffer != VK_NULL_HANDLE)
+			DestroyBuffer(s_MainDevice.LogicalDevice, argumentBuffer.Buffer, argumentBuffer.Allocation);
+		argumentBuffer = DrawArgumentBuffer();
 	}
 
 	vkDestroyDescriptorPool(s_MainDevice.LogicalDevice, s_InputDescriptorPool, nullptr);
@@ -284,20 +426,12 @@ void VulkanRenderer::CleanUp()
 
 	vkDestroySampler(s_MainDevice.LogicalDevice, s_TextureSampler, nullptr);
 
-	// Free texture memory
-	for (size_t i = 0; i < s_TextureImages.size(); i++)
-	{
-		vkDestroyImageView(s_MainDevice.LogicalDevice, s_TextureImageViews[i], nullptr);
-		vkDestroyImage(s_MainDevice.LogicalDevice, s_TextureImages[i], nullptr);
-		vkFreeMemory(s_MainDevice.LogicalDevice, s_TextureImageMemory[i], nullptr);
-	}
-
 	// Clean depth buffer image
 	for (size_t i = 0; i < s_DepthBufferImage.size(); i++)
 	{
 		vkDestroyImageView(s_MainDevice.LogicalDevice, s_DepthBufferImageView[i], nullptr);
 		vkDestroyImage(s_MainDevice.LogicalDevice, s_DepthBufferImage[i], nullptr);
-		vkFreeMemory(s_MainDevice.LogicalDevice, s_DepthBufferImageMemory[i], nullptr);
+		MemoryAllocator::Free(s_DepthBufferImageMemory[i]);
 	}
 
 	// Clean image buffer 
@@ -305,7 +439,7 @@ void VulkanRenderer::CleanUp()
 	{
 		vkDestroyImageView(s_MainDevice.LogicalDevice, s_ColorBufferImageView[i], nullptr);
 		vkDestroyImage(s_MainDevice.LogicalDevice, s_ColorBufferImage[i], nullptr);
-		vkFreeMemory(s_MainDevice.LogicalDevice, s_ColorBufferImageMemory[i], nullptr);
+		MemoryAllocator::Free(s_ColorBufferImageMemory[i]);
 	}
 
 	// Free object memories (dynamic buffer)
@@ -318,11 +452,8 @@ void VulkanRenderer::CleanUp()
 
 	for (size_t i = 0; i < s_SwapchainImages.size(); i++)
 	{
-		vkDestroyBuffer(s_MainDevice.LogicalDevice, s_UniformBuffers[i], nullptr);
-		vkFreeMemory(s_MainDevice.LogicalDevice, s_UniformBufferMemory[i], nullptr);
-
-		vkDestroyBuffer(s_MainDevice.LogicalDevice, s_UniformDynamicBuffers[i], nullptr);
-		vkFreeMemory(s_MainDevice.LogicalDevice, s_UniformDynamicBufferMemory[i], nullptr);
+		DestroyBuffer(s_MainDevice.LogicalDevice, s_UniformBuffers[i], s_UniformBufferMemory[i]);
+		DestroyBuffer(s_MainDevice.LogicalDevice, s_UniformDynamicBuffers[i], s_UniformDynamicBufferMemory[i]);
 	}
 
 
@@ -333,7 +464,7 @@ void VulkanRenderer::CleanUp()
 		vkDestroyFence(s_MainDevice.LogicalDevice, s_DrawFences[i], nullptr);
 	}
 
-	vkDestroyCommandPool(s_MainDevice.LogicalDevice, s_GraphicsCommandPool, nullptr);
+	s_CommandRecorder.Destroy();
 
 	for (size_t i = 0; i < s_SwapchainFramebuffers.size(); i++)
 	{
@@ -345,6 +476,7 @@ void VulkanRenderer::CleanUp()
 	vkDestroyPipelineLayout(s_MainDevice.LogicalDevice, s_SecondPipelineLayout, nullptr);
 
 	vkDestroyPipeline(s_MainDevice.LogicalDevice, s_GraphicsPipeline, nullptr);
+	vkDestroyPipeline(s_MainDevice.LogicalDevice, s_CompactGraphicsPipeline, nullptr);
 	vkDestroyPipelineLayout(s_MainDevice.LogicalDevice, s_PipelineLayout, nullptr);
 
 	vkDestroyRenderPass(s_MainDevice.LogicalDevice, s_RenderPass, nullptr);
@@ -354,6 +486,8 @@ void VulkanRenderer::CleanUp()
 	}
 	vkDestroySwapchainKHR(s_MainDevice.LogicalDevice, s_Swapchain, nullptr);
 	vkDestroySurfaceKHR(s_Instance, s_Surface, nullptr);
+	// Every resource is gone by now, release the memory blocks
+	MemoryAllocator::Destroy();
 	vkDestroyDevice(s_MainDevice.LogicalDevice, nullptr);
 	vkDestroyInstance(s_Instance, nullptr);
 }
@@ -438,9 +572,10 @@ void VulkanRenderer::CreateLogicalDevice()
 
 	// Vector for queue creation information and set for family indices
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> queueFamilyIndices = { indices.GraphicsFamily, indices.PresentationFamily };
-
+	std::set<int> queueFamilyIndices = { indices.GraphicsFamily, indices.PresentationFamily, indices.TransferFamily };
 
+	// Priorities for up to two queues per family (graphics + upload queue when they share a family)
+	static const float s_QueuePriorities[] = { 1.0f, 1.0f };
 
 	// Queue the logical device needs to create and info to do so 
 	for (int queueFamilyIndex : queueFamilyIndices)
@@ -449,8 +584,9 @@ void VulkanRenderer::CreateLogicalDevice()
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
 		queueCreateInfo.queueCount = 1;			// number of queues to create
-		float priority = 1.0f;
-		queueCreateInfo.pQueuePriorities = &priority;
+		if (queueFamilyIndex == indices.TransferFamily)
+			queueCreateInfo.queueCount = indices.TransferQueueIndex + 1;
+		queueCreateInfo.pQueuePriorities = s_QueuePriorities;
 
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
@@ -467,6 +603,13 @@ void VulkanRenderer::CreateLogicalDevice()
 	deviceFeatures.samplerAnisotropy = VK_TRUE;		// Enable anisotropy
 
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;  // physical device feature will use
+
+	// Uploads hand over to the render queue with a timeline semaphore
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+
+	deviceCreateInfo.pNext = &vulkan12Features;
 	
 	if (enableValidationLayers)
 	{
@@ -487,6 +630,10 @@ void VulkanRenderer::CreateLogicalDevice()
 	// From given logical device, of given queue family, of given queue index, place reference in vkQueue
 	vkGetDeviceQueue(s_MainDevice.LogicalDevice, indices.GraphicsFamily, 0, &s_GraphicsQueue);
 	vkGetDeviceQueue(s_MainDevice.LogicalDevice, indices.PresentationFamily, 0, &s_PresentationQueue);
+	vkGetDeviceQueue(s_MainDevice.LogicalDevice, indices.TransferFamily, indices.TransferQueueIndex, &s_TransferQueue);
+
+	// Every buffer and image gets its memory through the allocator
+	MemoryAllocator::Init(s_MainDevice.PhysicalDevice, s_MainDevice.LogicalDevice);
 }
 
 void VulkanRenderer::CreateSurface()
@@ -880,7 +1027,8 @@ void VulkanRenderer::CreateGraphicsPipeline()
 																// VK_VERTEX_INPUT_RATE_INSTANCE: move to a vertex for next 
 
 	// How the data for an attribute is defined within a vertex
-	std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions;
+	// Color isn`t a vertex attribute, it is constant per mesh and comes with the push constants
+	std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions;
 
 	// Position attribute
 	attributeDescriptions[0].binding = 0;
@@ -888,23 +1036,29 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;  // format the data will take (also it helps define size opf data)
 	attributeDescriptions[0].offset = offsetof(Vertex, Position); // where this attribute is defined in the data for a single vertex
 
-	// Color attribute 
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;			// location in shader wherre data will be read from
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;  // format the data will take (also it helps define size opf data)
-	attributeDescriptions[1].offset = offsetof(Vertex, Color); // where this attribute is defined in the data for a single vertex
-	
 	// Texture attribute
-	attributeDescriptions[2].binding = 0;
-	attributeDescriptions[2].location = 2;			// location in shader wherre data will be read from
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;  // format the data will take (also it helps define size opf data)
-	attributeDescriptions[2].offset = offsetof(Vertex, TextureCoords); // where this attribute is defined in the data for a single vertex
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 2;			// location in shader wherre data will be read from
+	attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;  // format the data will take (also it helps define size opf data)
+	attributeDescriptions[1].offset = offsetof(Vertex, TextureCoords); // where this attribute is defined in the data for a single vertex
 
 	// Normal attribute
-	attributeDescriptions[3].binding = 0;
-	attributeDescriptions[3].location = 3;			// location in shader wherre data will be read from
-	attributeDescriptions[3].format = VK_FORMAT_R32G32B32_SFLOAT;  // format the data will take (also it helps define size opf data)
-	attributeDescriptions[3].offset = offsetof(Vertex, NormalCoords); // where this attribute is defined in the data for a single vertex
+	attributeDescriptions[2].binding = 0;
+	attributeDescriptions[2].location = 3;			// location in shader wherre data will be read from
+	attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;  // format the data will take (also it helps define size opf data)
+	attributeDescriptions[2].offset = offsetof(Vertex, NormalCoords); // where this attribute is defined in the data for a single vertex
+
+	// Same attributes for CompactVertex, normalized integers the vertex shader decodes with the mesh push constants
+	VkVertexInputBindingDescription compactBindingDescription = bindingDescription;
+	compactBindingDescription.stride = sizeof(CompactVertex);
+
+	std::array<VkVertexInputAttributeDescription, 3> compactAttributeDescriptions = attributeDescriptions;
+	compactAttributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;		// position in the mesh bounds
+	compactAttributeDescriptions[0].offset = offsetof(CompactVertex, Position);
+	compactAttributeDescriptions[1].format = VK_FORMAT_R16G16_UNORM;			// uv in the mesh uv bounds
+	compactAttributeDescriptions[1].offset = offsetof(CompactVertex, TextureCoords);
+	compactAttributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;			// octahedral normal
+	compactAttributeDescriptions[2].offset = offsetof(CompactVertex, NormalCoords);
 
 	// Create PIPELINE
 	// -- Vertex Input
@@ -915,6 +1069,10 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
 	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); // list of vertex attribite descriptions(data format and where to binding)
 
+	VkPipelineVertexInputStateCreateInfo compactVertexInputCreateInfo = vertexInputCreateInfo;
+	compactVertexInputCreateInfo.pVertexBindingDescriptions = &compactBindingDescription;
+	compactVertexInputCreateInfo.pVertexAttributeDescriptions = compactAttributeDescriptions.data();
+
 
 	// -- Input Assembly
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
@@ -1002,8 +1160,15 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 	pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+
+	// Per mesh vertex dequantization and color
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(VertexDequantization);
+
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	// Create pipeline layout
 	VkResult result = vkCreatePipelineLayout(s_MainDevice.LogicalDevice, &pipelineLayoutCreateInfo, nullptr, &s_PipelineLayout);
@@ -1045,13 +1210,38 @@ void VulkanRenderer::CreateGraphicsPipeline()
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;	// Existing pipeline to derive from...
 	pipelineCreateInfo.basePipelineIndex = -1;		// or index of pipeline being created to derive from (in case creating multiple at once)
 
-	// Create graphics pipeline
-	result = vkCreateGraphicsPipelines(s_MainDevice.LogicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &s_GraphicsPipeline);
+	// Compact vertex variant: its own vertex input, the vertex shader decodes normals with compactVertices (constant_id 0) set
+	const VkBool32 isCompact = VK_TRUE;
+	VkSpecializationMapEntry specializationEntry = {};
+	specializationEntry.constantID = 0;
+	specializationEntry.offset = 0;
+	specializationEntry.size = sizeof(isCompact);
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &specializationEntry;
+	specializationInfo.dataSize = sizeof(isCompact);
+	specializationInfo.pData = &isCompact;
+
+	VkPipelineShaderStageCreateInfo compactShaderStages[] = { vertexShaderCreateInfo , fragmentShaderCreateInfo };
+	compactShaderStages[0].pSpecializationInfo = &specializationInfo;
+
+	VkGraphicsPipelineCreateInfo compactPipelineCreateInfo = pipelineCreateInfo;
+	compactPipelineCreateInfo.pStages = compactShaderStages;
+	compactPipelineCreateInfo.pVertexInputState = &compactVertexInputCreateInfo;
+
+	// Create graphics pipelines
+	std::array<VkGraphicsPipelineCreateInfo, 2> pipelineCreateInfos = { pipelineCreateInfo, compactPipelineCreateInfo };
+	std::array<VkPipeline, 2> pipelines;
+	result = vkCreateGraphicsPipelines(s_MainDevice.LogicalDevice, VK_NULL_HANDLE, static_cast<uint32_t>(pipelineCreateInfos.size()),
+		pipelineCreateInfos.data(), nullptr, pipelines.data());
 
 	if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create a graphics pipeline!");
 	}
+	s_GraphicsPipeline = pipelines[0];
+	s_CompactGraphicsPipeline = pipelines[1];
 
 	// Destroy shader modules
 	vkDestroyShaderModule(s_MainDevice.LogicalDevice, fragmentShaderModule, nullptr);
@@ -1132,8 +1322,9 @@ void VulkanRenderer::CreateDepthBufferImage()
 	for (size_t i = 0; i < s_SwapchainImages.size(); i++)
 	{
 		// Create depth buffer image
-		s_DepthBufferImage[i] = CreateImage(s_SwapchainExtent.width, s_SwapchainExtent.height, s_DepthBufferFormat, VK_IMAGE_TILING_OPTIMAL,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &s_DepthBufferImageMemory[i]);
+		s_DepthBufferImage[i] = CreateImage(s_SwapchainExtent.width, s_SwapchainExtent.height, 1, s_DepthBufferFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &s_DepthBufferImageMemory[i],
+			AllocationStrategy::FreeList);
 
 		// Create depth buffer image view
 		s_DepthBufferImageView[i] = CreateImageView(s_DepthBufferImage[i], s_DepthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
@@ -1160,9 +1351,9 @@ void VulkanRenderer::CreateColorBufferImage()
 	for (size_t i = 0; i < s_SwapchainImages.size(); i++)
 	{
 		// Create depth buffer image
-		s_ColorBufferImage[i] = CreateImage(s_SwapchainExtent.width, s_SwapchainExtent.height, colorBufferFormat, VK_IMAGE_TILING_OPTIMAL,
+		s_ColorBufferImage[i] = CreateImage(s_SwapchainExtent.width, s_SwapchainExtent.height, 1, colorBufferFormat, VK_IMAGE_TILING_OPTIMAL,
 			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &s_ColorBufferImageMemory[i]);
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &s_ColorBufferImageMemory[i], AllocationStrategy::FreeList);
 
 		// Create depth buffer image view
 		s_ColorBufferImageView[i] = CreateImageView(s_ColorBufferImage[i], colorBufferFormat, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -1173,6 +1364,8 @@ void VulkanRenderer::CreateFramebuffers()
 {
 	// Resize framebuffer count to equal the swapchain images count
 	s_SwapchainFramebuffers.resize(s_SwapchainImages.size());
+	// Cached draws inherit the framebuffers
+	s_DrawResourceGeneration++;
 
 	// Create a framebuffer for each swapchain image
 	for (size_t i = 0; i < s_SwapchainFramebuffers.size(); i++)
@@ -1206,37 +1399,9 @@ void VulkanRenderer::CreateCommandPool()
 	// Get indices of queue families from device
 	QueueFamilyIndices queueFamilyIndices = GetQueueFamilies(s_MainDevice.PhysicalDevice);
 
-	VkCommandPoolCreateInfo poolInfo = {};
-	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	poolInfo.queueFamilyIndex = queueFamilyIndices.GraphicsFamily;	//Queue family type that buffers from this command pool will use
-
-	// Create graphics queue family command pool
-	VkResult result = vkCreateCommandPool(s_MainDevice.LogicalDevice, &poolInfo, nullptr, &s_GraphicsCommandPool);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to create command pool!");
-	}
-}
-
-void VulkanRenderer::CreateCommandBuffers()
-{
-	// Resize command buffer count to have one for each framebuffer
-	s_CommandBuffers.resize(s_SwapchainFramebuffers.size());
-
-	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	commandBufferAllocateInfo.commandPool = s_GraphicsCommandPool;
-	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; // VK_COMMAND_BUFFER_LEVEL_PRIMARY : buffer you submit directly to queue. Cant be called by other buffer.
-																	   // VK_COMMAND_BUFFER_LEVEL_SECONDARY : buffer cant be called directly. Can be called from other buffers via vkCmdExecuteCommand when recording commands in primary buffer
-	commandBufferAllocateInfo.commandBufferCount = static_cast<uint32_t>(s_CommandBuffers.size());
-	
-	// Allocate command buffer and place handles in array of buffers
-	VkResult result = vkAllocateCommandBuffers(s_MainDevice.LogicalDevice, &commandBufferAllocateInfo, s_CommandBuffers.data());
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate Command Buffers!");
-	}
+	// Command pools of every frame in flight (one for the primary buffer, one per recording thread) and their buffers,
+	// the draws of every swapchain image are cached apart since they bind its framebuffer and descriptor sets
+	s_CommandRecorder.Init(s_MainDevice.LogicalDevice, queueFamilyIndices.GraphicsFamily, static_cast<uint32_t>(s_SwapchainImages.size()));
 }
 
 void VulkanRenderer::CreateSynchronization()
@@ -1280,7 +1445,7 @@ void VulkanRenderer::CreateTextureSampler()
 	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;		// Mipmap interpolation mode
 	samplerCreateInfo.mipLodBias = 0.0f;								// level of details bias for mip level
 	samplerCreateInfo.minLod = 0.0f;									// minimum level of detail to pick mip level
-	samplerCreateInfo.maxLod = 0.0f;									// maximum level of detail to pick mip level
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;						// maximum level of detail to pick mip level (every level the image has)
 	samplerCreateInfo.anisotropyEnable = VK_TRUE;						// enable anisotropy
 	samplerCreateInfo.maxAnisotropy = 16;								// Anisotropy sample level
 
@@ -1310,11 +1475,11 @@ void VulkanRenderer::CreateUniformBuffers()
 	// Create uniform buffers
 	for (size_t i = 0; i < s_SwapchainImages.size(); i++)
 	{
-		CreateBuffer(s_MainDevice.PhysicalDevice, s_MainDevice.LogicalDevice, bufferSize,
+		CreateBuffer(s_MainDevice.LogicalDevice, bufferSize,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&s_UniformBuffers[i], &s_UniformBufferMemory[i]);
 
-		CreateBuffer(s_MainDevice.PhysicalDevice, s_MainDevice.LogicalDevice, modelBufferSize,
+		CreateBuffer(s_MainDevice.LogicalDevice, modelBufferSize,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&s_UniformDynamicBuffers[i], &s_UniformDynamicBufferMemory[i]);
 	}
@@ -1352,11 +1517,11 @@ void VulkanRenderer::CreateDescriptorPool()
 	// CREATE SAMPLER DESCRIPTOR POOL
 	VkDescriptorPoolSize samplerPooSize = {};
 	samplerPooSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerPooSize.descriptorCount = MAX_OBJECTS; // Assuming 1 texture per object
+	samplerPooSize.descriptorCount = MAX_OBJECTS + 1; // Assuming 1 texture per object, plus the default texture (sets of destroyed textures are reused)
 
 	VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
 	samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
+	samplerPoolCreateInfo.maxSets = MAX_OBJECTS + 1;
 	samplerPoolCreateInfo.poolSizeCount = 1;
 	samplerPoolCreateInfo.pPoolSizes = &samplerPooSize;
 
@@ -1538,12 +1703,8 @@ void VulkanRenderer::UpdateUniformBuffers(uint32_t imageIndex)
 	CameraData.InverseTransposeViewMatrix = s_Scene.Camera.GetTransposeInverseViewMatrix();
 	CameraData.GazeDirection = s_Scene.Camera.GetGazeDirection();
 	// auto CameraData = s_Scene.Camera.GetProjectionViewMatrix();
-	// Copy uniform buffer (view-projection matrix)
-	void* data;
-	vkMapMemory(s_MainDevice.LogicalDevice, s_UniformBufferMemory[imageIndex], 0,
-		sizeof(CameraData), 0, &data);
-	memcpy(data, &CameraData, sizeof(CameraData));
-	vkUnmapMemory(s_MainDevice.LogicalDevice, s_UniformBufferMemory[imageIndex]);
+	// Copy uniform buffer (view-projection matrix), uniform buffers stay mapped
+	memcpy(s_UniformBufferMemory[imageIndex].MappedData, &CameraData, sizeof(CameraData));
 
 	// copy model data (dynamic uniform buffer)
 	size_t Count = 0;
@@ -1575,21 +1736,13 @@ void VulkanRenderer::UpdateUniformBuffers(uint32_t imageIndex)
 	}
 
 	
-	// Map list of dynamic uniform buffer data (model data)
-	vkMapMemory(s_MainDevice.LogicalDevice, s_UniformDynamicBufferMemory[imageIndex], 0,
-		s_ModelUniformAlignment * Count, 0, &data);
-	memcpy(data, s_ModelTransferSpace, s_ModelUniformAlignment * Count);
-	vkUnmapMemory(s_MainDevice.LogicalDevice, s_UniformDynamicBufferMemory[imageIndex]);
+	// Copy list of dynamic uniform buffer data (model data)
+	memcpy(s_UniformDynamicBufferMemory[imageIndex].MappedData, s_ModelTransferSpace, s_ModelUniformAlignment * Count);
 
 }
 
-void VulkanRenderer::RecordCommands(uint32_t currentImageIndex)
+VkCommandBuffer VulkanRenderer::RecordCommands(uint32_t currentImageIndex, const UploadHandoff* uploadHandoff)
 {
-	// Info about how to begin each command buffer
-	VkCommandBufferBeginInfo bufferBeginInfo = { };
-	bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	// bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;  // buffer can be resubmitted when it has already been submitted and is awaiting
-	
 	// Info about how to beging a render pass (only need for graphical applications)
 	VkRenderPassBeginInfo renderPassBeginInfo = {};
 	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1606,76 +1759,327 @@ void VulkanRenderer::RecordCommands(uint32_t currentImageIndex)
 
 	renderPassBeginInfo.framebuffer = s_SwapchainFramebuffers[currentImageIndex];
 
-	// Start recording commands to command buffer
-	VkResult result = vkBeginCommandBuffer(s_CommandBuffers[currentImageIndex], &bufferBeginInfo);
-	if (result != VK_SUCCESS)
-		throw std::runtime_error("Failed to start recording a Command buffer!");
+	// Start recording commands to the frame`s primary command buffer (its pools were reset, the fence has signalled)
+	VkCommandBuffer commandBuffer = s_CommandRecorder.BeginFrame(s_CurrentFrame);
+
+	// Take ownership of freshly uploaded buffers/images before the render pass uses them
+	if (uploadHandoff)
+		uploadHandoff->RecordAcquire(commandBuffer);
 
-	// Begin Render Pass
-	vkCmdBeginRenderPass(s_CommandBuffers[currentImageIndex], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	// Begin Render Pass, the first subpass comes from secondary command buffers
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-	// Start first pipeline (Draw)
+	// Start first pipeline (Draw): the draws recorded for this image are reused until the draw list or a buffer they
+	// bind changes, then recorded again split across the workers
 	{
-		// Bind pipeline to be used in render pass
-		vkCmdBindPipeline(s_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, s_GraphicsPipeline);
-		size_t meshCount = 0;
-		// Draw model
-		for (auto& model : s_Scene.ModelList)
+		BuildMeshDraws();
+		WriteDrawArguments();
+
+		// The arena buffers live as long as the renderer
+		const uint64_t recordKey[] = { s_DrawListVersion, s_DrawResourceGeneration, s_ClusterCuller.GetGeneration() };
+
+		s_CommandRecorder.RecordSubpass(s_CurrentFrame, currentImageIndex, HashMemory(&recordKey, sizeof(recordKey)),
+			s_RenderPass, 0, s_SwapchainFramebuffers[currentImageIndex], static_cast<uint32_t>(s_MeshDraws.size()),
+			[currentImageIndex](VkCommandBuffer secondaryCommandBuffer, uint32_t first, uint32_t last)
 		{
-			// Dynamic offset amount
-			uint32_t dynamicOffset = static_cast<uint32_t>(s_ModelUniformAlignment * meshCount);
-			meshCount++;
+			RecordMeshDraws(secondaryCommandBuffer, currentImageIndex, first, last);
+		});
+	}
 
-			for (size_t k = 0; k < model.GetMeshCount(); k++)
-			{
-				auto currentMeshPart = model.GetMesh(k);
-				VkBuffer vertexBuffers[] = { currentMeshPart.GetVertexBuffer() };	// Buffer to bind
-				VkDeviceSize offsets[] = { 0 };		// offsets into buffers being bound
-				vkCmdBindVertexBuffers(s_CommandBuffers[currentImageIndex], 0, 1, vertexBuffers, offsets);	// Command to bind vertex buffer before drawing with them
+	//  Start second subpass
+	{
+		vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, s_SecondPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, s_SecondPipelineLayout,
+			0, 1, &s_InputDescriptorSets[currentImageIndex], 0, nullptr);
+
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+
+	// End Render Pass
+	vkCmdEndRenderPass(commandBuffer);
 
-				vkCmdBindIndexBuffer(s_CommandBuffers[currentImageIndex], currentMeshPart.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	// Stop recording commands to command buffer
+	return s_CommandRecorder.EndFrame(s_CurrentFrame);
+}
+
+void VulkanRenderer::BuildMeshDraws()
+{
+	// Only when models or meshes came or went (or changed texture)
+	if (s_BuiltDrawListVersion == s_DrawListVersion)
+		return;
+
+	// Sorted by state only: every draw is opaque and the depth buffer resolves the order, camera distance would reorder
+	// (and record again) the cached draws whenever the camera moves
+	// Culled meshes are queued too, so culling never changes the order either
+	std::vector<MeshDraw> sceneDraws;
+	s_RenderQueue.Clear();
+	for (size_t i = 0; i < s_Scene.ModelList.size(); i++)
+	{
+		auto& model = s_Scene.ModelList[i];
+		for (size_t k = 0; k < model.GetMeshCount(); k++)
+		{
+			const Mesh& mesh = model.GetMesh(k);
+
+			MeshDraw draw;
+			draw.DrawnMesh = &mesh;
+			draw.DynamicOffset = static_cast<uint32_t>(s_ModelUniformAlignment * i);		// Dynamic offset amount
+			draw.ArgumentIndex = static_cast<uint32_t>(sceneDraws.size());
 
-				// dynamic offset
+			s_RenderQueue.Push(RenderQueue::MakeKey(mesh.GetVertexFormat() == VertexFormat::Compact ? 1 : 0,
+				mesh.GetIndexType() == VK_INDEX_TYPE_UINT16 ? 1 : 0, static_cast<uint32_t>(mesh.GetTextureID()),
+				0.0f, static_cast<uint32_t>(i)), draw.ArgumentIndex);
+			sceneDraws.push_back(draw);
+		}
+	}
+	s_RenderQueue.Sort();
+
+	s_MeshDraws.clear();
+	for (uint32_t draw : s_RenderQueue.GetDraws())
+	{
+		s_MeshDraws.push_back(sceneDraws[draw]);
+	}
+
+	s_BuiltDrawListVersion = s_DrawListVersion;
+}
+
+void VulkanRenderer::WriteDrawArguments()
+{
+	DrawArgumentBuffer& argumentBuffer = s_DrawArgumentBuffers[s_CurrentFrame];
+	const VkDeviceSize size = sizeof(VkDrawIndexedIndirectCommand) * s_MeshDraws.size();
+	if (size == 0)
+		return;
+
+	// The frame`s last submission has finished, the old buffer can go right away
+	if (argumentBuffer.Capacity < size)
+	{
+		if (argumentBuffer.Buffer != VK_NULL_HANDLE)
+			DestroyBuffer(s_MainDevice.LogicalDevice, argumentBuffer.Buffer, argumentBuffer.Allocation);
 
-				std::array<VkDescriptorSet, 2> descriptorSetGroup = { s_DescriptorSets[currentImageIndex],
-																	s_SamplerDescriptorSets[currentMeshPart.GetTextureID()] };
+		// Room to grow, models are added between frames
+		argumentBuffer.Capacity = size + size / 2;
+		CreateBuffer(s_MainDevice.LogicalDevice, argumentBuffer.Capacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&argumentBuffer.Buffer, &argumentBuffer.Allocation);
+		s_DrawResourceGeneration++;
+	}
 
-				// Bind Descriptor Sets (uniform, uniform_dynamic)
-				vkCmdBindDescriptorSets(s_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS,
-					s_PipelineLayout, 0, static_cast<uint32_t>(descriptorSetGroup.size()),
-					descriptorSetGroup.data(), 1, &dynamicOffset);
+	// Scene order, as CullMeshes and CullClusters walk the meshes, culled meshes draw no instance
+	VkDrawIndexedIndirectCommand* arguments = static_cast<VkDrawIndexedIndirectCommand*>(argumentBuffer.Allocation.MappedData);
+	size_t drawIndex = 0;
+	for (size_t i = 0; i < s_Scene.ModelList.size(); i++)
+	{
+		auto& model = s_Scene.ModelList[i];
+		for (size_t k = 0; k < model.GetMeshCount(); k++, drawIndex++)
+		{
+			const Mesh& currentMeshPart = model.GetMesh(k);
+			const MeshLod& lod = currentMeshPart.GetLod(s_ModelLods[i]);
+
+			VkDrawIndexedIndirectCommand command = {};
+			command.indexCount = lod.IndexCount;
+			command.firstIndex = currentMeshPart.GetFirstIndex() + lod.FirstIndex;
+			command.vertexOffset = currentMeshPart.GetVertexOffset();
+			command.instanceCount = CULL_MESHES && !s_MeshCuller.IsVisible(drawIndex) ? 0 : 1;		// Outside the frustum
+			if (CULL_MESHLETS)
+			{
+				command.indexCount = s_ClusterDraws[drawIndex].IndexCount;
+				command.firstIndex = s_ClusterDraws[drawIndex].FirstIndex;
 
-				// Execute pipeline
-				vkCmdDrawIndexed(s_CommandBuffers[currentImageIndex], currentMeshPart.GetIndexCount(), 1, 0, 0, 0);
+				// Every meshlet culled
+				if (command.indexCount == 0)
+					command.instanceCount = 0;
 			}
+
+			// Sequential writes only, the buffer may be write combined memory
+			arguments[drawIndex] = command;
 		}
+	}
+}
 
-		
+void VulkanRenderer::RecordMeshDraws(VkCommandBuffer commandBuffer, uint32_t currentImageIndex, uint32_t first, uint32_t last)
+{
+	// Secondary buffers inherit no state: every one binds the scene geometry buffers (once) itself
+	// Pipeline (vertex layout), index type, model (dynamic offset) and texture set are only rebound when they change
+	// between draws, which the sort key order keeps rare
+	// With meshlet culling the indices come from the frame`s stream of visible meshlets instead
+	s_GeometryArena.Bind(commandBuffer);
+	if (CULL_MESHLETS)
+		s_ClusterCuller.BindIndexBuffer(commandBuffer, s_CurrentFrame, VK_INDEX_TYPE_UINT32);
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+	bool isModelBound = false;
+	uint32_t boundDynamicOffset = 0;
+	int boundTextureID = -1;
+
+	for (uint32_t i = first; i < last; i++)
+	{
+		const MeshDraw& draw = s_MeshDraws[i];
+		const Mesh& currentMeshPart = *draw.DrawnMesh;
+
+		// Bind pipeline to be used in render pass
+		VkPipeline pipeline = currentMeshPart.GetVertexFormat() == VertexFormat::Compact ? s_CompactGraphicsPipeline : s_GraphicsPipeline;
+		if (pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
+
+		if (currentMeshPart.GetIndexType() != boundIndexType)
+		{
+			if (CULL_MESHLETS)
+				s_ClusterCuller.BindIndexBuffer(commandBuffer, s_CurrentFrame, currentMeshPart.GetIndexType());
+			else
+				s_GeometryArena.BindIndexBuffer(commandBuffer, currentMeshPart.GetIndexType());
+			boundIndexType = currentMeshPart.GetIndexType();
+		}
+
+		// Vertex dequantization and color
+		vkCmdPushConstants(commandBuffer, s_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+			0, sizeof(VertexDequantization), &currentMeshPart.GetDequantization());
+
+		// Bind Descriptor Sets apart (uniform, uniform_dynamic / sampler), binding one leaves the other bound
+		if (!isModelBound || draw.DynamicOffset != boundDynamicOffset)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				s_PipelineLayout, 0, 1, &s_DescriptorSets[currentImageIndex], 1, &draw.DynamicOffset);
+			isModelBound = true;
+			boundDynamicOffset = draw.DynamicOffset;
+		}
+
+		if (currentMeshPart.GetTextureID() != boundTextureID)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				s_PipelineLayout, 1, 1, &s_SamplerDescriptorSets[currentMeshPart.GetTextureID()], 0, nullptr);
+			boundTextureID = currentMeshPart.GetTextureID();
+		}
+
+		// Execute pipeline, with the arguments of the frame (written in scene order)
+		vkCmdDrawIndexedIndirect(commandBuffer, s_DrawArgumentBuffers[s_CurrentFrame].Buffer,
+			sizeof(VkDrawIndexedIndirectCommand) * draw.ArgumentIndex, 1, sizeof(VkDrawIndexedIndirectCommand));
 	}
+}
 
-	//  Start second subpass
+void VulkanRenderer::SelectLods()
+{
+	// Pixels covered by one unit at distance one: projection y scale times half the viewport height
+	const float pixelsPerUnit = std::abs(s_Scene.Camera.GetProjectionMatrix()[1][1]) * s_SwapchainExtent.height * 0.5f;
+
+	s_ModelLods.clear();
+	for (auto& model : s_Scene.ModelList)
 	{
-		vkCmdNextSubpass(s_CommandBuffers[currentImageIndex], VK_SUBPASS_CONTENTS_INLINE);
+		s_ModelLods.push_back(GENERATE_MESH_LODS
+			? model.SelectLod(s_Scene.Camera.GetPosition(), pixelsPerUnit, LOD_MAX_PIXEL_ERROR) : 0);
+	}
+}
 
-		vkCmdBindPipeline(s_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, s_SecondPipeline);
-		vkCmdBindDescriptorSets(s_CommandBuffers[currentImageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, s_SecondPipelineLayout,
-			0, 1, &s_InputDescriptorSets[currentImageIndex], 0, nullptr);
+void VulkanRenderer::CullMeshes()
+{
+	// Models first, through the hierarchy: whole subtrees outside the frustum are skipped
+	s_SceneBvh.Refit();
+	const glm::mat4 viewProjection = s_Scene.Camera.GetProjectionViewMatrix();
+	glm::vec4 planes[6];
+	MeshCuller::ExtractFrustumPlanes(viewProjection, planes);
+	s_VisibleModels.clear();
+	s_SceneBvh.QueryFrustum(planes, s_VisibleModels);
 
-		vkCmdDraw(s_CommandBuffers[currentImageIndex], 3, 1, 0, 0);
+	s_IsModelVisible.assign(s_Scene.ModelList.size(), 0);
+	for (uint32_t handle : s_VisibleModels)
+	{
+		s_IsModelVisible[handle] = 1;
 	}
 
-	// End Render Pass
-	vkCmdEndRenderPass(s_CommandBuffers[currentImageIndex]);
+	// Then the meshes of the visible models, same order as RecordCommands walks them
+	s_MeshCuller.Clear();
+	for (size_t i = 0; i < s_Scene.ModelList.size(); i++)
+	{
+		auto& model = s_Scene.ModelList[i];
+		const glm::mat4 modelMatrix = model.GetModel();
+		for (size_t k = 0; k < model.GetMeshCount(); k++)
+		{
+			const Mesh& mesh = model.GetMesh(k);
+			if (s_IsModelVisible[i])
+				s_MeshCuller.Add(mesh.GetBoundsMin(), mesh.GetBoundsMax(), mesh.GetBoundingSphere(), modelMatrix);
+			else
+				s_MeshCuller.AddCulled();
+		}
+	}
 
-	// Stop recording commands to command buffer
-	result = vkEndCommandBuffer(s_CommandBuffers[currentImageIndex]);
-	if (result != VK_SUCCESS)
-		throw std::runtime_error("Failed to stop recording a Command buffer!");
+	s_MeshCuller.Cull(viewProjection);
+}
+
+void VulkanRenderer::CullClusters()
+{
+	// Same order as RecordCommands walks the meshes
+	s_ClusterCullInputs.clear();
+	for (size_t i = 0; i < s_Scene.ModelList.size(); i++)
+	{
+		auto& model = s_Scene.ModelList[i];
+		for (size_t k = 0; k < model.GetMeshCount(); k++)
+		{
+			ClusterCullInput input;
+			input.CulledMesh = &model.GetMesh(k);
+			input.Model = model.GetModel();
+			input.Lod = s_ModelLods[i];
+			input.IsCulled = CULL_MESHES && !s_MeshCuller.IsVisible(s_ClusterCullInputs.size());
+			s_ClusterCullInputs.push_back(input);
+		}
+	}
+
+	const glm::mat4 viewProjection = s_Scene.Camera.GetProjectionViewMatrix();
+	s_ClusterCuller.Cull(s_CurrentFrame, viewProjection, s_Scene.Camera.GetPosition(), s_ClusterCullInputs, s_ClusterDraws);
+}
+
+ClusterCullStats VulkanRenderer::GetClusterCullStats()
+{
+	return s_ClusterCuller.GetStats();
+}
+
+MeshCullStats VulkanRenderer::GetMeshCullStats()
+{
+	return s_MeshCuller.GetStats();
+}
 
+CommandRecordStats VulkanRenderer::GetCommandRecordStats()
+{
+	return s_CommandRecorder.GetStats();
+}
 
+RenderQueueStats VulkanRenderer::GetRenderQueueStats()
+{
+	return s_RenderQueue.GetStats();
+}
 
+StreamingStats VulkanRenderer::GetStreamingStats()
+{
+	StreamingStats stats;
+	stats.PendingModelCount = static_cast<uint32_t>(s_StreamingModels.size());
+	stats.ModelCount = static_cast<uint32_t>(s_Scene.ModelList.size() - s_FreeModelHandles.size());
+	stats.MeshAssetCount = s_AssetRegistry.GetMeshCount();
+	stats.TextureAssetCount = s_AssetRegistry.GetTextureCount();
+	stats.TextureRequestCount = s_TextureCache.GetRequestCount();
+	stats.UniqueTextureCount = s_TextureCache.GetUniqueCount();
+	stats.TextureStagedBytes = s_TextureCache.GetStagedSize();
+	stats.TextureUncompressedBytes = s_TextureCache.GetUncompressedSize();
+	stats.VertexBytesUsed = s_GeometryArena.GetVertexBytesUsed();
+	stats.IndexBytesUsed = s_GeometryArena.GetIndexBytesUsed();
+	return stats;
+}
 
-	// vkBeginCommandBuffer();
+MeshImportStats VulkanRenderer::GetMeshImportStats()
+{
+	MeshImportStats stats = s_MeshImportStats;
+	if (s_OptimizedTriangleCount > 0)
+	{
+		stats.ACMRBefore = s_WeightedImportSums.ACMRBefore / s_OptimizedTriangleCount;
+		stats.ACMRAfter = s_WeightedImportSums.ACMRAfter / s_OptimizedTriangleCount;
+	}
+	if (s_OptimizedVertexCount > 0)
+	{
+		stats.ATVRBefore = s_WeightedImportSums.ATVRBefore / s_OptimizedVertexCount;
+		stats.ATVRAfter = s_WeightedImportSums.ATVRAfter / s_OptimizedVertexCount;
+	}
+	return stats;
 }
 
 bool VulkanRenderer::CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions)
@@ -1761,6 +2165,23 @@ bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
 	VkPhysicalDeviceFeatures deviceFeatures;
 	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
+	// Uploads hand their copies over to the render queue through a timeline semaphore (core in Vulkan 1.2)
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+	bool hasTimelineSemaphores = false;
+	if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
+		deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures2.pNext = &vulkan12Features;
+		vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
+		hasTimelineSemaphores = vulkan12Features.timelineSemaphore == VK_TRUE;
+	}
+
 	QueueFamilyIndices indices = GetQueueFamilies(device);
 
 	bool hasExtensionsSupported = CheckDeviceExtensionSupport(device);
@@ -1773,7 +2194,27 @@ bool VulkanRenderer::CheckDeviceSuitable(VkPhysicalDevice device)
 	}
 
 	//deviceFeatures.samplerAnisotropy
-	return indices.IsValid() && hasExtensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy;
+	return indices.IsValid() && hasExtensionsSupported && swapChainValid && deviceFeatures.samplerAnisotropy && hasTimelineSemaphores;
+}
+
+bool VulkanRenderer::CheckLinearBlitSupport(VkFormat format)
+{
+	// Mip generation blits every level from the one above it with linear filtering
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(s_MainDevice.PhysicalDevice, format, &properties);
+
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+}
+
+bool VulkanRenderer::CheckSampledFilterSupport(VkFormat format)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(s_MainDevice.PhysicalDevice, format, &properties);
+
+	const VkFormatFeatureFlags sampledFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (properties.optimalTilingFeatures & sampledFeatures) == sampledFeatures;
 }
 
 QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
@@ -1809,6 +2250,26 @@ QueueFamilyIndices VulkanRenderer::GetQueueFamilies(VkPhysicalDevice device)
 		index++;
 	}
 
+	// Uploads: a transfer-only family (DMA engine) runs copies alongside rendering, fall back to
+	// a second queue of the graphics family, or the graphics queue itself if it only has one
+	for (uint32_t i = 0; i < queueFamilyCount; i++)
+	{
+		const auto& queueFamily = queueFamilyList[i];
+		if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+			!(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			indices.TransferFamily = static_cast<int>(i);
+			indices.TransferQueueIndex = 0;
+			break;
+		}
+	}
+
+	if (indices.TransferFamily < 0 && indices.GraphicsFamily >= 0)
+	{
+		indices.TransferFamily = indices.GraphicsFamily;
+		indices.TransferQueueIndex = queueFamilyList[indices.GraphicsFamily].queueCount > 1 ? 1 : 0;
+	}
+
 	return indices;
 }
 
@@ -1964,7 +2425,8 @@ bool VulkanRenderer::CheckValidationLayerSupport()
 	return true;
 }
 
-VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory)
+VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propFlags,
+	MemoryAllocation* imageAllocation, AllocationStrategy strategy)
 {
 	// Create image
 	// Image creation info
@@ -1974,7 +2436,7 @@ VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat fo
 	imageCreateInfo.extent.width = width;					// image extents
 	imageCreateInfo.extent.height = height;
 	imageCreateInfo.extent.depth = 1;						// depth of image extent (just 1, no 3D aspect)
-	imageCreateInfo.mipLevels = 1;							// number of mipmap levels
+	imageCreateInfo.mipLevels = mipLevels;					// number of mipmap levels
 	imageCreateInfo.arrayLayers = 1;						// number of levels in image array
 	imageCreateInfo.format = format;						// format of image (VkFormat)
 	imageCreateInfo.tiling = tiling;
@@ -1991,44 +2453,26 @@ VkImage VulkanRenderer::CreateImage(uint32_t width, uint32_t height, VkFormat fo
 		throw std::runtime_error("Failed to create image!");
 	}
 
-	// Create memory for image
-	VkMemoryRequirements memoryRequirements;
-	vkGetImageMemoryRequirements(s_MainDevice.LogicalDevice, image, &memoryRequirements);
-
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = FindMemoryTypeIndex(s_MainDevice.PhysicalDevice, memoryRequirements.memoryTypeBits, propFlags);
-
-
-	result = vkAllocateMemory(s_MainDevice.LogicalDevice, &memoryAllocateInfo, nullptr, imageMemory);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate memory for image!");
-	}
-
-	// Bind image to a memory (connect memory to image)
-	vkBindImageMemory(s_MainDevice.LogicalDevice, image, *imageMemory, 0);
+	// Sub-allocate memory for the image and bind it (connect memory to image)
+	*imageAllocation = MemoryAllocator::AllocateImage(image, propFlags, strategy);
 
 	return image;
 }
 
-VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView VulkanRenderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels,
+	VkComponentMapping swizzle)
 {
 	VkImageViewCreateInfo viewCreateInfo = {};
 	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewCreateInfo.image = image;	
 	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;		// type of image (1d, 2d, 3d, cube, etc)
 	viewCreateInfo.format = format;
-	viewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;	// Allow remapping opf rgba components
-	viewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-	viewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+	viewCreateInfo.components = swizzle;					// Allow remapping of rgba components (e.g. grey R8 textures read as rrr1)
 
 	// Subresources allow the view to view only a part of an image
 	viewCreateInfo.subresourceRange.aspectMask = aspectFlags; // which aspect of iamge to view
 	viewCreateInfo.subresourceRange.baseMipLevel = 0;			// Start mipmap level to view from
-	viewCreateInfo.subresourceRange.levelCount = 1;				// number of mipmap levels to view
+	viewCreateInfo.subresourceRange.levelCount = mipLevels;		// number of mipmap levels to view
 	viewCreateInfo.subresourceRange.baseArrayLayer = 0;			// start array level to view from
 	viewCreateInfo.subresourceRange.layerCount = 1;
 
@@ -2062,96 +2506,87 @@ VkShaderModule VulkanRenderer::CreateShaderModule(const std::vector<char>& code)
 	return shaderModule;
 }
 
-int VulkanRenderer::CreateTextureImage(const std::string& filepath)
+VkImage VulkanRenderer::CreateTextureImage(const TextureImage& textureImage, MemoryAllocation* imageMemory)
 {
-	// Load image file
-	int width, height;
-	VkDeviceSize imageSize;
-
-	stbi_uc* imageData = LoadTextureFile(filepath, &width, &height, &imageSize);
-
-	// Create staging buffer to hold loaded data, ready to copy to device
-	VkBuffer imageStagingBuffer;
-	VkDeviceMemory imageStagingBufferMemory;
-	CreateBuffer(s_MainDevice.PhysicalDevice, s_MainDevice.LogicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		&imageStagingBuffer, &imageStagingBufferMemory);
-
-
-	// Copy image data to staging buffer
-	void* data;
-	vkMapMemory(s_MainDevice.LogicalDevice, imageStagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, imageData, static_cast<size_t>(imageSize));
-	vkUnmapMemory(s_MainDevice.LogicalDevice, imageStagingBufferMemory);
+	const int width = textureImage.Width;
+	const int height = textureImage.Height;
 
-	// Free original image data
-	stbi_image_free(imageData);
+	// Pixels were already decoded into the staging buffer by the texture cache
+	VkBuffer imageStagingBuffer = textureImage.StagingBuffer;
+	const MemoryAllocation& imageStagingBufferMemory = textureImage.StagingBufferAllocation;
 
-	// Create image to hold final texture
-	VkImage texImage;
-	VkDeviceMemory texImageMemory;
-	texImage = CreateImage(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		&texImageMemory);
+	// Create image to hold final texture, with the full mip chain (transfer src for the blits generating it)
+	VkImage texImage = CreateImage(width, height, textureImage.MipLevels, textureImage.Format, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		imageMemory);
 
+	ImageUploadInfo uploadInfo;
+	uploadInfo.Format = textureImage.Format;
+	uploadInfo.Width = static_cast<uint32_t>(width);
+	uploadInfo.Height = static_cast<uint32_t>(height);
+	uploadInfo.MipLevels = textureImage.MipLevels;
+	uploadInfo.GenerateMips = !textureImage.IsMipChainIncluded;
 
 	// COPY DATA TO IMAGE
-	// transition image to be dst for copy operation
-	TransitionImageLayout(s_MainDevice.LogicalDevice, s_GraphicsQueue, s_GraphicsCommandPool, texImage,
-		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	// Record transition to transfer dst, the copies and the transition to shader readable into the upload batch,
+	// the batcher frees the staging buffer once the batch has executed (missing mips get blitted by the render queue)
+	s_UploadBatcher.UploadImage(texImage, uploadInfo, imageStagingBuffer, imageStagingBufferMemory);
 
-	// copy image data
-	CopyImageBuffer(s_MainDevice.LogicalDevice, s_GraphicsQueue, s_GraphicsCommandPool, imageStagingBuffer,
-		texImage, width, height);
-	
-	// Transition image to be shader readble for shader usage
-	TransitionImageLayout(s_MainDevice.LogicalDevice, s_GraphicsQueue, s_GraphicsCommandPool, texImage,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-	// Add texture data to vector for reference
-	s_TextureImages.push_back(texImage);
-	s_TextureImageMemory.push_back(texImageMemory);
-
-	// Destroy staging buffer
-	vkDestroyBuffer(s_MainDevice.LogicalDevice, imageStagingBuffer, nullptr);
-	vkFreeMemory(s_MainDevice.LogicalDevice, imageStagingBufferMemory, nullptr);
+	return texImage;
+}
 
-	// Return index of new texture image
-	return (int)(s_TextureImages.size() - 1);
+TextureHandle VulkanRenderer::CreateTexture(const std::string& filepath)
+{
+	// Same file (or same bytes) requested before and still alive: share its texture
+	return s_TextureCache.Resolve(s_TextureCache.Request(filepath),
+		[](const TextureImage& textureImage) { return CreateTexture(textureImage); });
 }
 
-int VulkanRenderer::CreateTexture(const std::string& filepath)
+TextureHandle VulkanRenderer::CreateTexture(const TextureImage& textureImage)
 {
-	// Create texture image and get is location in array
-	int textureImageLoc = CreateTextureImage(filepath);
+	// Create texture image
+	MemoryAllocation imageMemory;
+	VkImage image = CreateTextureImage(textureImage, &imageMemory);
 
-	// Create image view and add to list
-	VkImageView imageView = CreateImageView(s_TextureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-	s_TextureImageViews.push_back(imageView);
+	// Create image view
+	VkImageView imageView = CreateImageView(image, textureImage.Format, VK_IMAGE_ASPECT_COLOR_BIT,
+		textureImage.MipLevels, textureImage.Swizzle);
 
-	// Create descriptor set here
+	// Create descriptor set here, the registry destroys all three once the texture is released
 	int descriptorLoc = CreateTextureDescriptor(imageView);
-
-	// Return location of set with texture
-	return descriptorLoc;
+	return s_AssetRegistry.CreateTexture(image, imageMemory, imageView, descriptorLoc);
 }
 
 int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
 {
-	VkDescriptorSet descriptorSet;
+	// Set of a destroyed texture (no frame in flight uses it anymore), else a new one
+	// Rewriting a set invalidates the cached command buffers that bound it
+	int descriptorIndex = s_AssetRegistry.TakeFreeDescriptorIndex();
+	if (descriptorIndex >= 0)
+	{
+		s_DrawResourceGeneration++;
+	}
+	else
+	{
+		VkDescriptorSet descriptorSet;
 
-	// Descriptor set allocation info
-	VkDescriptorSetAllocateInfo setAllocateInfo = {};
-	setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	setAllocateInfo.descriptorPool = s_SamplerDescriptorPool;
-	setAllocateInfo.descriptorSetCount = 1;
-	setAllocateInfo.pSetLayouts = &s_SamplerDescriptorSetLayout;
+		// Descriptor set allocation info
+		VkDescriptorSetAllocateInfo setAllocateInfo = {};
+		setAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		setAllocateInfo.descriptorPool = s_SamplerDescriptorPool;
+		setAllocateInfo.descriptorSetCount = 1;
+		setAllocateInfo.pSetLayouts = &s_SamplerDescriptorSetLayout;
 
-	// ALlocate descriptor sets
-	VkResult result = vkAllocateDescriptorSets(s_MainDevice.LogicalDevice, &setAllocateInfo, &descriptorSet);
-	if (result != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate texture descriptor sets!");
+		// ALlocate descriptor sets
+		VkResult result = vkAllocateDescriptorSets(s_MainDevice.LogicalDevice, &setAllocateInfo, &descriptorSet);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate texture descriptor sets!");
+		}
+
+		// Add descriptor set to list
+		s_SamplerDescriptorSets.push_back(descriptorSet);
+		descriptorIndex = static_cast<int>(s_SamplerDescriptorSets.size() - 1);
 	}
 
 	// Texture image info
@@ -2164,7 +2599,7 @@ int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
 	// Descriptor write info
 	VkWriteDescriptorSet descriptorWrite = {};
 	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrite.dstSet = descriptorSet;
+	descriptorWrite.dstSet = s_SamplerDescriptorSets[descriptorIndex];
 	descriptorWrite.dstBinding = 0;
 	descriptorWrite.dstArrayElement = 0;
 	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -2175,84 +2610,270 @@ int VulkanRenderer::CreateTextureDescriptor(VkImageView textureImage)
 	// Update new descriptor set
 	vkUpdateDescriptorSets(s_MainDevice.LogicalDevice, 1, &descriptorWrite, 0, nullptr);
 
-	// Add descriptor set to list
-	s_SamplerDescriptorSets.push_back(descriptorSet);
-
 	// return descriptor set location
-	return (int)(s_SamplerDescriptorSets.size() - 1);
+	return descriptorIndex;
 
 }
 
-void VulkanRenderer::CreateMeshModel(const std::string& filepath)
+void VulkanRenderer::CreateDefaultTexture()
 {
-	// Import model 'scene'
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(filepath,
-		aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
+	const uint8_t white[4] = { 255, 255, 255, 255 };
+
+	MemoryAllocation texImageMemory;
+	VkImage texImage = CreateImage(1, 1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &texImageMemory);
+
+	ImageUploadInfo uploadInfo;
+	uploadInfo.Width = 1;
+	uploadInfo.Height = 1;
+	s_UploadBatcher.UploadImage(texImage, uploadInfo, white, sizeof(white));
+	s_UploadBatcher.Flush();
+
+	VkImageView imageView = CreateImageView(texImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
 
-	if (!scene)
+	// Held until CleanUp, so descriptor index 0 stays the default texture
+	s_DefaultTexture = s_AssetRegistry.CreateTexture(texImage, texImageMemory, imageView, CreateTextureDescriptor(imageView));
+	if (s_DefaultTexture->DescriptorIndex != 0)
 	{
-		throw std::runtime_error("Failed to load model: " + filepath);
+		throw std::runtime_error("Default texture has to be created before any other texture!");
 	}
+}
+
+void VulkanRenderer::CreateMeshModel(const std::string& filepath)
+{
+	CreateMeshModels({ filepath });
+}
 
-	// Get the directory of model
-	std::string directoryPath;
-	const size_t last_slash_idx = filepath.rfind('//');
-	if (std::string::npos != last_slash_idx)
+void VulkanRenderer::CreateMeshModels(const std::vector<std::string>& filepaths)
+{
+	for (const auto& filepath : filepaths)
 	{
-		directoryPath = filepath.substr(0, last_slash_idx);
+		LoadModelAsync(filepath);
 	}
 
+	// No budget, one submission for every copy: the next Draw waits on it on the GPU
+	StreamModels(std::numeric_limits<VkDeviceSize>::max(), true);
+}
 
-	// Get vector of all material with 1:1 ID placement
-	std::vector<std::string> textureNames = MeshModel::LoadMaterials(scene);
+ModelHandle VulkanRenderer::LoadModelAsync(const std::string& filepath)
+{
+	// The model uniform buffer holds MAX_OBJECTS models
+	if (s_FreeModelHandles.empty() && s_Scene.ModelList.size() >= MAX_OBJECTS)
+	{
+		throw std::runtime_error("Too many models, the scene holds at most " + std::to_string(MAX_OBJECTS));
+	}
 
-	// Conversion from the materials lists IDS to our Descriptor Array IDS
-	std::vector<int> materialToTextures(textureNames.size());
+	// A file some model still holds (resident or streaming) shares its meshes and textures, nothing is loaded again
+	MeshHandle asset = s_AssetRegistry.FindMesh(filepath);
+	if (!asset)
+	{
+		// Parsing and texture decoding run on the worker threads, the slot is drawn (empty) meanwhile
+		StreamingModel streamingModel;
+		streamingModel.Asset = asset = s_AssetRegistry.CreateMesh(filepath);
+		streamingModel.Import = ModelImporter::ImportAsync(filepath, s_TextureCache);
+		s_StreamingModels.push_back(std::move(streamingModel));
+	}
 
-	// Loop over textureNames and create textures for them
-	for (size_t i = 0; i < textureNames.size(); i++)
+	ModelHandle handle = static_cast<ModelHandle>(s_Scene.ModelList.size());
+	if (!s_FreeModelHandles.empty())
 	{
-		// If material has no texture, set `0` to indicate no texture, texture 0 will be reserved for a default texture
-		if (textureNames[i].empty())
-		{
-			materialToTextures[i] = 0;
-		}
-		else
-		{
-			// Otherwise, create texture and set value to index of new texture
-			std::string texturePath = directoryPath + "/" + textureNames[i];
-			materialToTextures[i] = CreateTexture(texturePath);
-		}
+		handle = s_FreeModelHandles.back();
+		s_FreeModelHandles.pop_back();
+		s_Scene.ModelList[handle] = MeshModel(asset);
 	}
+	else
+	{
+		s_Scene.ModelList.push_back(MeshModel(asset));
+		s_ModelBvhLeaves.push_back(-1);
+	}
+
+	glm::vec3 boundsMin, boundsMax;
+	s_Scene.ModelList[handle].GetWorldBounds(boundsMin, boundsMax);
+	s_ModelBvhLeaves[handle] = s_SceneBvh.Insert(handle, boundsMin, boundsMax);
+	s_DrawListVersion++;
+	return handle;
+}
+
+void VulkanRenderer::UnloadModel(ModelHandle handle)
+{
+	if (handle >= s_Scene.ModelList.size() || !s_Scene.ModelList[handle].GetAsset())
+		return;
+
+	// Drops the handle, the registry frees the meshes (and textures) once no other model holds them
+	s_Scene.ModelList[handle] = MeshModel();
+	s_FreeModelHandles.push_back(handle);
 
-	// Load in all our meshes
-	std::vector<Mesh> modelMeshes = MeshModel::LoadNode(s_MainDevice.PhysicalDevice, s_MainDevice.LogicalDevice, s_GraphicsQueue,
-		s_GraphicsCommandPool, scene->mRootNode, scene, materialToTextures);
+	s_SceneBvh.Remove(s_ModelBvhLeaves[handle]);
+	s_ModelBvhLeaves[handle] = -1;
+	s_DrawListVersion++;
+}
+
+void VulkanRenderer::QueryModels(const glm::vec3& center, float radius, std::vector<ModelHandle>& models)
+{
+	s_SceneBvh.Refit();
+	s_SceneBvh.QuerySphere(center, radius, models);
+}
 
-	// Create mesh model and add to list
-	MeshModel meshModel = MeshModel(modelMeshes);
-	s_Scene.ModelList.push_back(meshModel);
-	//m_ModelList.push_back(meshModel);
+void VulkanRenderer::RaycastModels(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<ModelHandle>& models)
+{
+	s_SceneBvh.Refit();
+	s_SceneBvh.QueryRay(origin, direction, maxDistance, models);
 }
 
-stbi_uc* VulkanRenderer::LoadTextureFile(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize)
+void VulkanRenderer::UpdateModelBounds(ModelHandle handle)
 {
-	// number of channels image uses
-	int channels;
+	if (handle >= s_ModelBvhLeaves.size() || s_ModelBvhLeaves[handle] < 0)
+		return;
 
-	// load pixel data 
-	stbi_uc* image = stbi_load(fileName.c_str(), width, height, &channels, STBI_rgb_alpha);
+	glm::vec3 boundsMin, boundsMax;
+	s_Scene.ModelList[handle].GetWorldBounds(boundsMin, boundsMax);
+	s_SceneBvh.Update(s_ModelBvhLeaves[handle], boundsMin, boundsMax);
+}
 
-	if (!image)
+bool VulkanRenderer::IsModelResident(ModelHandle handle)
+{
+	if (handle >= s_Scene.ModelList.size() || !s_Scene.ModelList[handle].GetAsset())
+		return false;
+
+	for (const auto& streamingModel : s_StreamingModels)
 	{
-		throw std::runtime_error("Failed to load a texture file: " + fileName);
+		if (streamingModel.Asset == s_Scene.ModelList[handle].GetAsset())
+			return false;
 	}
+	return true;
+}
 
-	// Calculaate image size using given and known data
-	*imageSize = (*width) * (*height) * 4;
+void VulkanRenderer::SetUploadBudget(VkDeviceSize bytesPerFrame)
+{
+	s_UploadBudget = bytesPerFrame;
+}
 
-	return image;
+void VulkanRenderer::StreamModels(VkDeviceSize budget, bool wait)
+{
+	if (s_StreamingModels.empty())
+		return;
+
+	// Vulkan recording stays on this thread, models are taken in request order once imported
+	// The first upload always goes through, so big meshes/textures still make progress with a small budget
+	VkDeviceSize uploadedSize = 0;
+	bool isUploaded = false;
+	for (auto it = s_StreamingModels.begin(); it != s_StreamingModels.end() && uploadedSize < budget;)
+	{
+		StreamingModel& streamingModel = *it;
+		if (!streamingModel.IsImported)
+		{
+			if (!wait && streamingModel.Import.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+
+			// Rethrows a failed import
+			streamingModel.Model = streamingModel.Import.get();
+			streamingModel.IsImported = true;
+			streamingModel.IsMaterialResident.assign(streamingModel.Model.Textures.size(), false);
+
+			const ModelData& importedData = streamingModel.Model.Data;
+			for (size_t i = 0; i < importedData.SubMeshes.size(); i++)
+			{
+				const SubMeshData& subMesh = importedData.SubMeshes[i];
+				for (uint32_t lod = 0; lod < subMesh.LodCount; lod++)
+				{
+					s_MeshImportStats.LodTriangleCounts[lod] += subMesh.Lods[lod].IndexCount / 3;
+				}
+
+				// Only fresh imports went through the import passes
+				if (i < importedData.ImportStats.size())
+				{
+					const SubMeshImportStats& importStats = importedData.ImportStats[i];
+					const float triangleCount = static_cast<float>(subMesh.Lods[0].IndexCount / 3);
+					const float vertexCount = static_cast<float>(subMesh.VertexCount);
+					s_WeightedImportSums.ACMRBefore += importStats.ACMRBefore * triangleCount;
+					s_WeightedImportSums.ACMRAfter += importStats.ACMRAfter * triangleCount;
+					s_WeightedImportSums.ATVRBefore += importStats.ATVRBefore * vertexCount;
+					s_WeightedImportSums.ATVRAfter += importStats.ATVRAfter * vertexCount;
+					s_OptimizedTriangleCount += subMesh.Lods[0].IndexCount / 3;
+					s_OptimizedVertexCount += subMesh.VertexCount;
+					s_MeshImportStats.OptimizedMeshCount++;
+				}
+			}
+			s_MeshImportStats.MeshCount += static_cast<uint32_t>(importedData.SubMeshes.size());
+		}
+
+		// Every model holding the asset was unloaded before it was complete
+		if (streamingModel.Asset.use_count() == 1)
+		{
+			it = s_StreamingModels.erase(it);
+			continue;
+		}
+
+		MeshAsset& asset = *streamingModel.Asset;
+		const ModelData& modelData = streamingModel.Model.Data;
+
+		// Geometry first: meshes are drawn (with the default texture) as soon as they are in
+		const size_t firstSubMesh = streamingModel.NextSubMesh;
+		while (streamingModel.NextSubMesh < modelData.SubMeshes.size() && uploadedSize < budget)
+		{
+			const SubMeshData& subMesh = modelData.SubMeshes[streamingModel.NextSubMesh++];
+			asset.AddMesh(Mesh(s_GeometryArena, s_UploadBatcher, subMesh, modelData.VertexData, modelData.IndexData,
+				modelData.MeshletData, s_DefaultTexture->DescriptorIndex), subMesh.MaterialIndex);
+
+			uploadedSize += GetVertexStride(subMesh.Format) * subMesh.VertexCount + VkDeviceSize(subMesh.IndexSize) * subMesh.IndexCount;
+			isUploaded = true;
+		}
+
+		// The asset grew, so did the box of every model drawing it and the draw list
+		if (streamingModel.NextSubMesh != firstSubMesh)
+		{
+			s_DrawListVersion++;
+			for (ModelHandle handle = 0; handle < s_Scene.ModelList.size(); handle++)
+			{
+				if (s_Scene.ModelList[handle].GetAsset() == streamingModel.Asset)
+					UpdateModelBounds(handle);
+			}
+		}
+
+		// Then textures, each one swapped in for the default texture once decoded and uploaded
+		bool isComplete = streamingModel.NextSubMesh == modelData.SubMeshes.size();
+		for (uint32_t i = 0; i < streamingModel.IsMaterialResident.size(); i++)
+		{
+			if (streamingModel.IsMaterialResident[i])
+				continue;
+
+			// Materials without a texture keep the default one
+			const auto& texture = streamingModel.Model.Textures[i];
+			if (!texture)
+			{
+				streamingModel.IsMaterialResident[i] = true;
+				continue;
+			}
+
+			if (uploadedSize >= budget || (!wait && !TextureCache::IsDecoded(texture)))
+			{
+				isComplete = false;
+				continue;
+			}
+
+			// Same file (or same bytes) uploaded before and still alive: the texture is shared
+			uploadedSize += TextureCache::GetUploadSize(texture);
+			asset.SetMaterialTexture(i, s_TextureCache.Resolve(texture,
+				[](const TextureImage& textureImage) { return CreateTexture(textureImage); }));
+			streamingModel.IsMaterialResident[i] = true;
+			isUploaded = true;
+
+			// Its meshes bind another descriptor set
+			s_DrawListVersion++;
+		}
+
+		if (isComplete)
+			it = s_StreamingModels.erase(it);
+		else
+			++it;
+	}
+
+	// One submission for the frame`s uploads, the render queue waits on it on the GPU
+	if (isUploaded)
+		s_UploadBatcher.Flush();
 }
 
 void VulkanRenderer::GetPhysicalDevice()
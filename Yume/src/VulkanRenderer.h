@@ -18,14 +18,24 @@
 #include <set>
 #include <algorithm>
 #include <array>
+#include <deque>
+#include <future>
 
 // stb_image
 #include <stb_image.h>
 
 
+#include "AssetRegistry.h"
+#include "ClusterCuller.h"
+#include "CommandRecorder.h"
 #include "Mesh.h"
+#include "MeshCuller.h"
 #include "MeshModel.h"
+#include "ModelImporter.h"
+#include "RenderQueue.h"
 #include "Scene.h"
+#include "SceneBvh.h"
+#include "UploadBatcher.h"
 #include "Utils.h"
 
 
@@ -36,6 +46,34 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+// Index of a model in the scene model list, valid from LoadModelAsync to UnloadModel (the model is empty until its meshes arrive)
+using ModelHandle = uint32_t;
+
+struct StreamingStats
+{
+	uint32_t PendingModelCount = 0;			// models whose meshes or textures are still streaming in
+	uint32_t ModelCount = 0;				// live models
+	size_t MeshAssetCount = 0;				// mesh assets the live models share
+	size_t TextureAssetCount = 0;
+	size_t TextureRequestCount = 0;			// texture requests so far, before deduplication
+	size_t UniqueTextureCount = 0;
+	uint64_t TextureStagedBytes = 0;		// texture bytes uploaded
+	uint64_t TextureUncompressedBytes = 0;	// the same as mipped RGBA8
+	VkDeviceSize VertexBytesUsed = 0;		// geometry arena use
+	VkDeviceSize IndexBytesUsed = 0;
+};
+
+struct MeshImportStats
+{
+	uint32_t MeshCount = 0;					// sub-meshes of the imported models
+	uint32_t OptimizedMeshCount = 0;		// of those, optimized by this run (cooked ones were when cooked)
+	float ACMRBefore = 0.0f;				// vertex cache efficiency of the optimized meshes, over all their triangles
+	float ACMRAfter = 0.0f;
+	float ATVRBefore = 0.0f;				// the same over all their vertices
+	float ATVRAfter = 0.0f;
+	uint64_t LodTriangleCounts[MAX_MESH_LODS] = {};		// triangles of each level of detail over every mesh
+};
+
 
 
 class VulkanRenderer
@@ -55,9 +93,37 @@ public:
 
 	static void UpdateModel(uint32_t meshObjectIndex, glm::mat4& newModel);
 
+	// Start importing a model on the worker threads and return its handle right away
+	// Meshes join the draw list as their geometry is uploaded (drawn with the default texture until theirs is resident),
+	// uploads are spread over frames by the upload budget
+	// A file another model still holds shares that upload (meshes and textures) instead of being loaded again
+	static ModelHandle LoadModelAsync(const std::string& filepath);
+	// Remove a model from the scene, its meshes and textures are freed once no other model uses them
+	static void UnloadModel(ModelHandle handle);
+	// True once every mesh and texture of the model is uploaded
+	static bool IsModelResident(ModelHandle handle);
+	// Models whose world box touches the sphere / is hit by the ray (nearest first), through the scene hierarchy
+	static void QueryModels(const glm::vec3& center, float radius, std::vector<ModelHandle>& models);
+	static void RaycastModels(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<ModelHandle>& models);
+	// Bytes of streamed geometry/textures uploaded per frame
+	static void SetUploadBudget(VkDeviceSize bytesPerFrame);
+
 	static void Draw();
 	static void CleanUp();
 
+	// Meshlet culling counts of the last frame
+	static ClusterCullStats GetClusterCullStats();
+	// Frustum culling counts of the last frame
+	static MeshCullStats GetMeshCullStats();
+	// Draw recording counts: subpasses executed and recorded again
+	static CommandRecordStats GetCommandRecordStats();
+	// State binds of the draw list in scene order and in sort key order
+	static RenderQueueStats GetRenderQueueStats();
+	// Asset, texture and geometry counts of the streamed models
+	static StreamingStats GetStreamingStats();
+	// Import pass results of the imported models
+	static MeshImportStats GetMeshImportStats();
+
 private:
 	// Create functions
 	static void CreateInstance();
@@ -71,7 +137,6 @@ private:
 	static void CreateColorBufferImage();
 	static void CreateFramebuffers();
 	static void CreateCommandPool();
-	static void CreateCommandBuffers();
 	static void CreateSynchronization();
 
 	static void CreateTextureSampler();
@@ -84,7 +149,20 @@ private:
 	static void UpdateUniformBuffers(uint32_t imageIndex);
 
 	// Record functions
-	static void RecordCommands(uint32_t currentImageIndex);
+	// Record the frame into its primary command buffer (draws on the workers), returns it ready to submit
+	static VkCommandBuffer RecordCommands(uint32_t currentImageIndex, const UploadHandoff* uploadHandoff);
+	// Every scene mesh in sort key order (state), rebuilt and sorted only when the draw list changed
+	static void BuildMeshDraws();
+	// Index range (level of detail or visible meshlets) and instance count (0 when culled) of every draw, into the frame`s argument buffer
+	static void WriteDrawArguments();
+	// Record draws [first, last) of the frame into a secondary command buffer (runs on the workers)
+	static void RecordMeshDraws(VkCommandBuffer commandBuffer, uint32_t currentImageIndex, uint32_t first, uint32_t last);
+	// Pick the level of detail of every scene model for the current camera
+	static void SelectLods();
+	// Test every scene mesh against the camera frustum
+	static void CullMeshes();
+	// Cull the meshlets of every scene mesh into the current frame`s index stream
+	static void CullClusters();
 
 	// Get functions
 	static void GetPhysicalDevice();
@@ -97,6 +175,8 @@ private:
 	static bool CheckInstanceExtensionSupport(std::vector<const char*>* checkExtensions);
 	static bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 	static bool CheckDeviceSuitable(VkPhysicalDevice device);
+	static bool CheckLinearBlitSupport(VkFormat format);
+	static bool CheckSampledFilterSupport(VkFormat format);
 	// -- getter functions
 	static QueueFamilyIndices GetQueueFamilies(VkPhysicalDevice device);
 	static SwapChainDetails GetSwapChainDetails(VkPhysicalDevice device);
@@ -112,19 +192,28 @@ private:
 	static bool CheckValidationLayerSupport();
 
 	// -- Create functions
-	static VkImage CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-		VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory* imageMemory);
-	static VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	static VkImage CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling,
+		VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propFlags, MemoryAllocation* imageAllocation,
+		AllocationStrategy strategy = AllocationStrategy::Buddy);
+	static VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1,
+		VkComponentMapping swizzle = {});
 	static VkShaderModule CreateShaderModule(const std::vector<char>& code);
 
-	static int CreateTextureImage(const std::string& filepath);
-	static int CreateTexture(const std::string& filepath);
+	static VkImage CreateTextureImage(const TextureImage& textureImage, MemoryAllocation* imageMemory);
+	static TextureHandle CreateTexture(const std::string& filepath);
+	static TextureHandle CreateTexture(const TextureImage& textureImage);
 	static int CreateTextureDescriptor(VkImageView textureImage);
 
-	static void CreateMeshModel(const std::string& filepath);
+	// Texture 0: white, used by materials without a texture and by meshes whose texture is still streaming
+	static void CreateDefaultTexture();
 
-	// Loader-functions
-	static stbi_uc* LoadTextureFile(const std::string& fileName, int* width, int* height, VkDeviceSize* imageSize);
+	// Blocking versions of LoadModelAsync: import several models in parallel and upload all of them before returning
+	static void CreateMeshModel(const std::string& filepath);
+	static void CreateMeshModels(const std::vector<std::string>& filepaths);
+	// Upload meshes/textures of streaming models until budget bytes are spent, waiting for imports and decodes when wait is set
+	static void StreamModels(VkDeviceSize budget, bool wait);
+	// Move the model`s leaf in the scene hierarchy to its current world box
+	static void UpdateModelBounds(ModelHandle handle);
 
 };
 
@@ -1,9 +1,32 @@
 #include "Application.h"
+#include "AssetPack.h"
+#include "ModelImporter.h"
 
 int main(int argc, char** argv)
 {
+	// Yume --benchmark-obj <file.obj>...: compare OBJ import times, no window
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-obj")
+	{
+		for (int i = 2; i < argc; i++)
+		{
+			ModelImporter::BenchmarkObjImport(argv[i]);
+		}
+		return 0;
+	}
+
+	// Yume --build-pack <file.ypak> <files or directories>...: pack scene assets, no window
+	if (argc > 2 && std::string(argv[1]) == "--build-pack")
+	{
+		return AssetPack::Build(argv[2], std::vector<std::string>(argv + 3, argv + argc)) ? 0 : 1;
+	}
+
+	if (AssetPack::Mount(ASSET_PACK_PATH))
+	{
+		std::cout << "Mounted asset pack: " << ASSET_PACK_PATH << std::endl;
+	}
+
 	Application app("Yume", 800, 600);
 	app.Run();
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -25,6 +25,13 @@ LibraryDir["VulkanSDK"] = "%{VULKAN_SDK}/Lib"
 Library = {}
 Library["Vulkan"] = "%{LibraryDir.VulkanSDK}/vulkan-1.lib"
 
+-- Shaders compiled to SPIR-V next to their source, under the names the renderer loads
+ShaderOutputs = {}
+ShaderOutputs["shader.vert"] = "vert.spv"
+ShaderOutputs["shader.frag"] = "frag.spv"
+ShaderOutputs["second.vert"] = "second_vert.spv"
+ShaderOutputs["second.frag"] = "second_frag.spv"
+
 project "Yume"
 	location "Yume"
 	kind "ConsoleApp"
@@ -39,8 +46,19 @@ project "Yume"
 	files
 	{
 		"%{prj.name}/src/**.h",
-		"%{prj.name}/src/**.cpp"
+		"%{prj.name}/src/**.cpp",
+		"%{prj.name}/src/Shaders/*.vert",
+		"%{prj.name}/src/Shaders/*.frag"
 	}
+
+	-- Recompile a shader whenever its source changes
+	for source, output in pairs(ShaderOutputs) do
+		filter ("files:**/Shaders/" .. source)
+			buildmessage "Compiling shader %{file.name}"
+			buildcommands { "%{VULKAN_SDK}/Bin/glslangValidator.exe -V -o %{file.directory}/" .. output .. " %{file.relpath}" }
+			buildoutputs { "%{file.directory}/" .. output }
+	end
+	filter {}
 		
 	-- Additional library directories
 	libdirs { 	"%{prj.name}/vendor/ASSIMP/lib",